@@ -0,0 +1,203 @@
+#include "AssetCache.h"
+#include "Game.h"
+#include "MeshSimplifier.h"
+
+using namespace DirectX;
+
+
+AssetCache::AssetCache()
+{
+	m_device = NULL;
+	m_effectFactory = NULL;
+	m_pack = NULL;
+	m_modelLoads = 0;
+	m_textureLoads = 0;
+}
+
+
+AssetCache::~AssetCache()
+{
+}
+
+void AssetCache::Initialise(ID3D11Device * device, IEffectFactory * effectFactory)
+{
+	Clear();
+	m_device = device;
+	m_effectFactory = effectFactory;
+}
+
+void AssetCache::Clear()
+{
+	m_models.clear();
+	m_lods.clear();
+	m_bvhs.clear();
+	m_textures.clear();
+}
+
+void AssetCache::TakeWarnings(std::vector<std::string> & warnings)
+{
+	warnings.swap(m_warnings);
+	m_warnings.clear();
+}
+
+ID3D11ShaderResourceView * AssetCache::GetTexture(StringHandle path)
+{
+	auto found = m_textures.find(path);
+	if (found != m_textures.end())
+	{
+		return found->second.Get();
+	}
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> texture;
+	HRESULT rs;
+	const uint8_t * data;
+	size_t size;
+	if (m_pack && m_pack->Find(PACK_TEXTURE, path, data, size))
+	{
+		rs = CreateDDSTextureFromMemory(m_device, data, size, nullptr, texture.GetAddressOf());
+	}
+	else
+	{
+		std::wstring texturewstr = StringToWCHART(StringTable::AssetPaths().Lookup(path));
+		rs = CreateDDSTextureFromFile(m_device, texturewstr.c_str(), nullptr, texture.GetAddressOf());
+	}
+	m_textureLoads++;
+
+	//if texture fails.  load error default
+	if (rs)
+	{
+		m_warnings.push_back("could not load " + StringTable::AssetPaths().Lookup(path));
+		CreateDDSTextureFromFile(m_device, L"database/data/Error.dds", nullptr, texture.ReleaseAndGetAddressOf());
+	}
+
+	m_textures[path] = texture;
+	return texture.Get();
+}
+
+std::shared_ptr<Model> AssetCache::GetModel(StringHandle modelPath, StringHandle texturePath)
+{
+	unsigned long long key = ((unsigned long long)modelPath << 32) | texturePath;
+	auto found = m_models.find(key);
+	if (found != m_models.end())
+	{
+		return found->second;
+	}
+
+	std::shared_ptr<Model> model;
+	const uint8_t * data;
+	size_t size;
+	if (m_pack && m_pack->Find(PACK_MODEL, modelPath, data, size))
+	{
+		model = Model::CreateFromCMO(m_device, data, size, *m_effectFactory, true);
+	}
+	else
+	{
+		std::wstring modelwstr = StringToWCHART(StringTable::AssetPaths().Lookup(modelPath));
+		model = Model::CreateFromCMO(m_device, modelwstr.c_str(), *m_effectFactory, true);	//"False" for LH coordinate system (maya)
+	}
+	m_modelLoads++;
+
+	ApplyTexture(*model, texturePath);
+	m_models[key] = model;
+	return model;
+}
+
+std::shared_ptr<const ModelLods> AssetCache::GetLods(StringHandle modelPath, StringHandle texturePath)
+{
+	unsigned long long key = ((unsigned long long)modelPath << 32) | texturePath;
+	auto found = m_lods.find(key);
+	if (found != m_lods.end())
+	{
+		return found->second;
+	}
+
+	//the levels come from the pack's mapping, or from disk once per model, each texture just makes its own models from them
+	std::shared_ptr<ModelLods> lods = std::make_shared<ModelLods>();
+	std::vector<PackLod> levels;
+	std::vector<LodLevel> loaded;
+	if (!m_pack || !m_pack->FindLods(modelPath, levels))
+	{
+		std::string error;
+		std::string path = StringTable::AssetPaths().Lookup(modelPath);
+		if (!MeshSimplifier::CachedLods(path, loaded, error))
+		{
+			m_warnings.push_back("no levels of detail for " + path + ", " + error);
+		}
+		for (size_t i = 0; i < loaded.size(); i++)
+		{
+			PackLod level;
+			level.error = loaded[i].error;
+			level.cmo = loaded[i].cmo.data();
+			level.size = loaded[i].cmo.size();
+			levels.push_back(level);
+		}
+	}
+	for (size_t i = 0; i < levels.size(); i++)
+	{
+		std::shared_ptr<Model> model = Model::CreateFromCMO(m_device, levels[i].cmo, levels[i].size, *m_effectFactory, true);
+		ApplyTexture(*model, texturePath);
+		lods->models.push_back(model);
+		lods->errors.push_back(levels[i].error);
+	}
+	m_modelLoads += !levels.empty();
+
+	m_lods[key] = lods;
+	return lods;
+}
+
+std::shared_ptr<const MeshBvh> AssetCache::GetBvh(StringHandle modelPath)
+{
+	auto found = m_bvhs.find(modelPath);
+	if (found != m_bvhs.end())
+	{
+		return found->second;
+	}
+
+	//the gpu copy can't be read back, so the positions come from the file, or the pack while one is set
+	std::shared_ptr<MeshBvh> bvh = std::make_shared<MeshBvh>();
+	const std::string & path = StringTable::AssetPaths().Lookup(modelPath);
+	std::vector<uint8_t> file;
+	const uint8_t * data = NULL;
+	size_t size = 0;
+	if (!m_pack || !m_pack->Find(PACK_MODEL, modelPath, data, size))
+	{
+		FILE * stream = fopen(path.c_str(), "rb");
+		if (stream)
+		{
+			fseek(stream, 0, SEEK_END);
+			file.resize(std::max(ftell(stream), 0L));
+			fseek(stream, 0, SEEK_SET);
+			file.resize(fread(file.data(), 1, file.size(), stream));
+			fclose(stream);
+		}
+		data = file.data();
+		size = file.size();
+	}
+	ImportedMesh mesh;
+	std::string error;
+	if (ObjToCmo::Read(data, size, mesh, error))
+	{
+		bvh->Build(mesh);
+	}
+	else
+	{
+		m_warnings.push_back("picking " + path + " by its bounds, " + error);
+	}
+
+	m_bvhs[modelPath] = bvh;
+	return bvh;
+}
+
+void AssetCache::ApplyTexture(Model & model, StringHandle texturePath)
+{
+	//apply the texture to the models effect
+	ID3D11ShaderResourceView * texture = GetTexture(texturePath);
+	model.UpdateEffects([&](IEffect* effect)
+		{
+			auto lights = dynamic_cast<BasicEffect*>(effect);
+			if (lights)
+			{
+				lights->SetTexture(texture);
+			}
+		});
+}
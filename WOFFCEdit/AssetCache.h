@@ -0,0 +1,59 @@
+#pragma once
+#include "pch.h"
+#include "StringTable.h"
+#include "LevelPack.h"
+#include "MeshBvh.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//models and textures loaded once and handed out to every display object that uses them.
+//a model's texture lives in its effects, so objects share a model only when they share a texture as well -
+//there is one model per model / texture pair, and retexturing an object means picking up a different pair.
+//the levels of detail of a model come from its .lod file, built by MeshSimplifier the first time the model is loaded,
+//or from the level pack, which has them cooked in.
+//with a level pack set, models and textures in it are made from its mapping, anything else still comes from its file.
+//a model's triangles are only kept on the cpu for picking, read again from its CMO the first time a ray reaches it.
+
+//the simplified versions of a model, coarsest last, with how far each strays from the full model in its own units
+struct ModelLods
+{
+	std::vector<std::shared_ptr<DirectX::Model>>	models;
+	std::vector<float>								errors;
+};
+
+class AssetCache
+{
+public:
+	AssetCache();
+	~AssetCache();
+
+	void	Initialise(ID3D11Device * device, DirectX::IEffectFactory * effectFactory);
+	void	Clear();		//drops everything, call when the device goes away
+	void	SetPack(const LevelPack * pack) { m_pack = pack; }		//kept open by the caller while assets load, may be NULL
+
+	ID3D11ShaderResourceView *			GetTexture(StringHandle path);		//Error.dds if the file will not load
+	std::shared_ptr<DirectX::Model>		GetModel(StringHandle modelPath, StringHandle texturePath);
+	std::shared_ptr<const ModelLods>	GetLods(StringHandle modelPath, StringHandle texturePath);		//never null, may hold no levels
+	std::shared_ptr<const MeshBvh>		GetBvh(StringHandle modelPath);		//never null, empty when the CMO can't be read
+
+	int		ModelLoads() const { return m_modelLoads; }		//trips to disk, for checking the cache is doing its job
+	int		TextureLoads() const { return m_textureLoads; }
+	void	TakeWarnings(std::vector<std::string> & warnings);	//hands over what failed to load since the last call, for the log
+
+private:
+	void	ApplyTexture(DirectX::Model & model, StringHandle texturePath);
+
+	ID3D11Device *				m_device;
+	DirectX::IEffectFactory *	m_effectFactory;
+	const LevelPack *			m_pack;
+
+	std::unordered_map<StringHandle, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>>	m_textures;
+	std::unordered_map<unsigned long long, std::shared_ptr<DirectX::Model>>			m_models;	//model handle in the high 32 bits, texture in the low
+	std::unordered_map<unsigned long long, std::shared_ptr<const ModelLods>>		m_lods;		//keyed the same
+	std::unordered_map<StringHandle, std::shared_ptr<const MeshBvh>>				m_bvhs;		//one per model whatever its texture
+
+	int		m_modelLoads;
+	int		m_textureLoads;
+	std::vector<std::string>	m_warnings;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+//dense storage for one optional component type. components sit back to back whatever order objects were added in,
+//so "every light" is a straight walk over one array. only objects that own a component pay for it.
+//removal swaps the last component into the hole, so indices into the array are not stable - hold IDs instead.
+
+template <typename T>
+class ComponentArray
+{
+public:
+	void Clear()
+	{
+		m_components.clear();
+		m_owners.clear();
+		m_lookup.clear();
+	}
+
+	//adds the component, or overwrites the one the object already has
+	T & Set(int ID, const T & component)
+	{
+		auto found = m_lookup.find(ID);
+		if (found != m_lookup.end())
+		{
+			m_components[found->second] = component;
+			return m_components[found->second];
+		}
+
+		m_lookup[ID] = (int)m_components.size();
+		m_components.push_back(component);
+		m_owners.push_back(ID);
+		return m_components.back();
+	}
+
+	bool Remove(int ID)
+	{
+		auto found = m_lookup.find(ID);
+		if (found == m_lookup.end())
+		{
+			return false;
+		}
+
+		int index = found->second;
+		int last = (int)m_components.size() - 1;
+		if (index != last)
+		{
+			m_components[index] = m_components[last];
+			m_owners[index] = m_owners[last];
+			m_lookup[m_owners[index]] = index;
+		}
+		m_components.pop_back();
+		m_owners.pop_back();
+		m_lookup.erase(ID);
+		return true;
+	}
+
+	T * Find(int ID)
+	{
+		auto found = m_lookup.find(ID);
+		return found == m_lookup.end() ? NULL : &m_components[found->second];
+	}
+
+	const T * Find(int ID) const
+	{
+		auto found = m_lookup.find(ID);
+		return found == m_lookup.end() ? NULL : &m_components[found->second];
+	}
+
+	int			Size() const			{ return (int)m_components.size(); }
+	T &			operator[](int index)	{ return m_components[index]; }
+	const T &	operator[](int index) const { return m_components[index]; }
+	int			GetOwner(int index) const { return m_owners[index]; }	//database ID of the object owning the component at index
+
+	size_t MemoryUsage() const
+	{
+		//buckets plus one node (key, value, next pointer, cached hash) per entry
+		return m_components.capacity() * sizeof(T) + m_owners.capacity() * sizeof(int)
+			+ m_lookup.bucket_count() * sizeof(void*) + m_lookup.size() * (sizeof(std::pair<const int, int>) + 2 * sizeof(void*));
+	}
+
+private:
+	std::vector<T>					m_components;
+	std::vector<int>				m_owners;		//database ID per component, parallel to m_components
+	std::unordered_map<int, int>	m_lookup;		//database ID -> index in m_components
+};
@@ -0,0 +1,202 @@
+#include "DatabaseMigration.h"
+#include <chrono>
+#include <random>
+#include <sstream>
+
+//the original tables, exactly as they ship in test.db.  only used to build the benchmark database
+static const char * LEGACY_OBJECTS_TABLE =
+	"CREATE TABLE Objects (ID INTEGER, chunk_ID INTEGER, mesh STRING, tex_diffuse STRING, position_x REAL, position_y REAL, position_z REAL, "
+	"rotation_x REAL, rotation_y REAL, rotation_z REAL, scale_x REAL, scale_y REAL, scale_z REAL, render BOOLEAN, collision BOOLEAN, "
+	"collision_mesh STRING, collectable BOOLEAN, destructable BOOLEAN, health_amount INT, editor_render BOOLEAN, editor_texture_vis BOOLEAN, "
+	"editor_normals_vis BOOLEAN, editor_collision_vis, editor_pivot_vis, pivot_x REAL, pivot_y REAL, pivot_z REAL, snap_to_ground BOOLEAN, "
+	"AI_node BOOLEAN, audio_file STRING, volume REAL, pitch REAL, pan REAL, one_shot BOOLEAN, play_on_init BOOLEAN, play_in_editor BOOLEAN, "
+	"min_dist INTEGER, max_dist INTEGER, camera BOOLEAN, path_node BOOLEAN, path_node_start BOOLEAN, path_node_end BOOLEAN, parent_ID INTEGER, "
+	"editor_wireframe BOOLEAN DEFAULT (0), name STRING DEFAULT Name, light_type INTEGER, light_diffuse_r REAL, light_diffuse_g REAL, "
+	"light_diffuse_b REAL, light_specular_r REAL, light_specular_g REAL, light_specular_b REAL, light_spot_cutoff REAL, light_constant REAL, "
+	"light_linear REAL, light_quadratic REAL)";
+
+//version 1. same columns, but ID becomes the rowid so lookups by ID are a b-tree search rather than a scan
+static const char * MIGRATION_1 =
+	"CREATE TABLE Objects_v1 (ID INTEGER PRIMARY KEY, chunk_ID INTEGER, mesh STRING, tex_diffuse STRING, position_x REAL, position_y REAL, position_z REAL, "
+	"rotation_x REAL, rotation_y REAL, rotation_z REAL, scale_x REAL, scale_y REAL, scale_z REAL, render BOOLEAN, collision BOOLEAN, "
+	"collision_mesh STRING, collectable BOOLEAN, destructable BOOLEAN, health_amount INT, editor_render BOOLEAN, editor_texture_vis BOOLEAN, "
+	"editor_normals_vis BOOLEAN, editor_collision_vis, editor_pivot_vis, pivot_x REAL, pivot_y REAL, pivot_z REAL, snap_to_ground BOOLEAN, "
+	"AI_node BOOLEAN, audio_file STRING, volume REAL, pitch REAL, pan REAL, one_shot BOOLEAN, play_on_init BOOLEAN, play_in_editor BOOLEAN, "
+	"min_dist INTEGER, max_dist INTEGER, camera BOOLEAN, path_node BOOLEAN, path_node_start BOOLEAN, path_node_end BOOLEAN, parent_ID INTEGER, "
+	"editor_wireframe BOOLEAN DEFAULT (0), name STRING DEFAULT Name, light_type INTEGER, light_diffuse_r REAL, light_diffuse_g REAL, "
+	"light_diffuse_b REAL, light_specular_r REAL, light_specular_g REAL, light_specular_b REAL, light_spot_cutoff REAL, light_constant REAL, "
+	"light_linear REAL, light_quadratic REAL);"
+	"INSERT INTO Objects_v1 (" OBJECT_COLUMNS ") SELECT " OBJECT_COLUMNS " FROM Objects;"
+	"DROP TABLE Objects;"
+	"ALTER TABLE Objects_v1 RENAME TO Objects;"
+	"CREATE INDEX Objects_chunk_ID ON Objects (chunk_ID);"
+	"CREATE INDEX Objects_parent_ID ON Objects (parent_ID);"
+
+	"CREATE TABLE Chunks_v1 (ID INTEGER PRIMARY KEY, name STRING, chunk_x_size_metres REAL, chunk_z_size_metres REAL, chunk_base_resolution INTEGER, "
+	"heightmap STRING, tex_diffuse STRING, tex_spat_alpha STRING, tex_splat_1 STRING, tex_splat_2 STRING, tex_splat_3 STRING, tex_splat_4 STRING, "
+	"render_wireframe BOOLEAN, render_normals BOOLEAN, diffuse_tiling INTEGER, tex_splat_1_tiling INTEGER, tex_splat_2_tiling INTEGER, "
+	"tex_splat_3_tiling INTEGER, tex_splat_4_tiling INTEGER);"
+	"INSERT INTO Chunks_v1 (" CHUNK_COLUMNS ") SELECT " CHUNK_COLUMNS " FROM Chunks;"
+	"DROP TABLE Chunks;"
+	"ALTER TABLE Chunks_v1 RENAME TO Chunks;"
+
+	"PRAGMA user_version = 1;";
+
+
+DatabaseMigration::DatabaseMigration(sqlite3 * database)
+{
+	m_databaseConnection = database;
+}
+
+
+DatabaseMigration::~DatabaseMigration()
+{
+}
+
+int DatabaseMigration::GetSchemaVersion()
+{
+	int version = 0;
+	sqlite3_stmt *pResults;
+
+	if (sqlite3_prepare_v2(m_databaseConnection, "PRAGMA user_version", -1, &pResults, 0) == SQLITE_OK)
+	{
+		if (sqlite3_step(pResults) == SQLITE_ROW)
+		{
+			version = sqlite3_column_int(pResults, 0);
+		}
+	}
+	sqlite3_finalize(pResults);
+
+	return version;
+}
+
+bool DatabaseMigration::Migrate()
+{
+	if (m_databaseConnection == NULL)
+	{
+		return false;
+	}
+
+	int version = GetSchemaVersion();
+
+	//each migration moves the database on by exactly one version, so an old level catches up one step at a time
+	if (version < 1)
+	{
+		if (!MigrateToVersion1()) return false;
+		version = 1;
+	}
+
+	return version == SCHEMA_VERSION;
+}
+
+bool DatabaseMigration::Exec(const char * sql)
+{
+	char *ErrMSG = 0;
+	int rc = sqlite3_exec(m_databaseConnection, sql, NULL, NULL, &ErrMSG);
+
+	if (ErrMSG)
+	{
+		sqlite3_free(ErrMSG);
+	}
+
+	return rc == SQLITE_OK;
+}
+
+bool DatabaseMigration::MigrateToVersion1()
+{
+	//all or nothing.  if a table has duplicate IDs the primary key insert fails and the level is left exactly as it was
+	if (!Exec("BEGIN TRANSACTION"))
+	{
+		return false;
+	}
+
+	if (!Exec(MIGRATION_1))
+	{
+		Exec("ROLLBACK");
+		return false;
+	}
+
+	return Exec("COMMIT");
+}
+
+//times point reads and writes by ID on a synthetic Objects table.  run once on the legacy layout, then again after migrating it
+std::string DatabaseMigration::Benchmark(int rows)
+{
+	const int queries = 1000;
+	std::stringstream report;
+	sqlite3 *database;
+
+	if (sqlite3_open(":memory:", &database) != SQLITE_OK)
+	{
+		return "Benchmark: could not open in-memory database\n";
+	}
+
+	DatabaseMigration migration(database);
+	migration.Exec(LEGACY_OBJECTS_TABLE);
+	migration.Exec("CREATE TABLE Chunks (ID INT, name STRING, chunk_x_size_metres REAL, chunk_z_size_metres REAL, chunk_base_resolution INTEGER, "
+		"heightmap STRING, tex_diffuse STRING, tex_spat_alpha STRING, tex_splat_1 STRING, tex_splat_2 STRING, tex_splat_3 STRING, tex_splat_4 STRING, "
+		"render_wireframe BOOLEAN, render_normals BOOLEAN, diffuse_tiling INTEGER, tex_splat_1_tiling INTEGER, tex_splat_2_tiling INTEGER, "
+		"tex_splat_3_tiling INTEGER, tex_splat_4_tiling INTEGER)");
+
+	//fill the table in one transaction with a reused statement, otherwise setup dominates the run
+	sqlite3_stmt *pInsert;
+	migration.Exec("BEGIN TRANSACTION");
+	sqlite3_prepare_v2(database, "INSERT INTO Objects (ID, chunk_ID, mesh, tex_diffuse, position_x, position_y, position_z, parent_ID, name) "
+		"VALUES (?, 0, 'database/data/placeholder.cmo', 'database/data/placeholder.dds', ?, 0, ?, 0, 'Name')", -1, &pInsert, 0);
+	for (int i = 0; i < rows; i++)
+	{
+		sqlite3_bind_int(pInsert, 1, i + 1);
+		sqlite3_bind_double(pInsert, 2, i % 512);
+		sqlite3_bind_double(pInsert, 3, i / 512);
+		sqlite3_step(pInsert);
+		sqlite3_reset(pInsert);
+	}
+	sqlite3_finalize(pInsert);
+	migration.Exec("COMMIT");
+
+	for (int pass = 0; pass < 2; pass++)
+	{
+		std::mt19937 random(1234);
+		std::uniform_int_distribution<int> pickID(1, rows);
+
+		sqlite3_stmt *pSelect;
+		sqlite3_stmt *pUpdate;
+		sqlite3_prepare_v2(database, "SELECT position_x, position_y, position_z FROM Objects WHERE ID = ?", -1, &pSelect, 0);
+		sqlite3_prepare_v2(database, "UPDATE Objects SET position_y = ? WHERE ID = ?", -1, &pUpdate, 0);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < queries; i++)
+		{
+			sqlite3_bind_int(pSelect, 1, pickID(random));
+			sqlite3_step(pSelect);
+			sqlite3_reset(pSelect);
+		}
+		auto lookupEnd = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < queries; i++)
+		{
+			sqlite3_bind_double(pUpdate, 1, i);
+			sqlite3_bind_int(pUpdate, 2, pickID(random));
+			sqlite3_step(pUpdate);
+			sqlite3_reset(pUpdate);
+		}
+		auto updateEnd = std::chrono::high_resolution_clock::now();
+
+		sqlite3_finalize(pSelect);
+		sqlite3_finalize(pUpdate);
+
+		double lookupMicro = std::chrono::duration<double, std::micro>(lookupEnd - start).count() / queries;
+		double updateMicro = std::chrono::duration<double, std::micro>(updateEnd - lookupEnd).count() / queries;
+
+		report << "Schema v" << migration.GetSchemaVersion() << ", " << rows << " rows: "
+			<< "lookup " << lookupMicro << " us, update " << updateMicro << " us\n";
+
+		if (pass == 0 && !migration.Migrate())
+		{
+			report << "Migration failed\n";
+			break;
+		}
+	}
+
+	sqlite3_close(database);
+	return report.str();
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "sqlite3.h"
+#include <string>
+
+//version the level database is migrated to on open.  stored in sqlite's PRAGMA user_version
+//	0 - original tables, no keys or indexes
+//	1 - INTEGER PRIMARY KEY on Objects.ID and Chunks.ID, indexes on Objects.chunk_ID and Objects.parent_ID
+#define SCHEMA_VERSION 1
+
+//explicit column lists so loading and saving never depend on the physical column order of the tables
+#define OBJECT_COLUMNS "ID, chunk_ID, mesh, tex_diffuse, position_x, position_y, position_z, rotation_x, rotation_y, rotation_z, "	\
+	"scale_x, scale_y, scale_z, render, collision, collision_mesh, collectable, destructable, health_amount, "					\
+	"editor_render, editor_texture_vis, editor_normals_vis, editor_collision_vis, editor_pivot_vis, pivot_x, pivot_y, pivot_z, "	\
+	"snap_to_ground, AI_node, audio_file, volume, pitch, pan, one_shot, play_on_init, play_in_editor, min_dist, max_dist, "		\
+	"camera, path_node, path_node_start, path_node_end, parent_ID, editor_wireframe, name, "									\
+	"light_type, light_diffuse_r, light_diffuse_g, light_diffuse_b, light_specular_r, light_specular_g, light_specular_b, "		\
+	"light_spot_cutoff, light_constant, light_linear, light_quadratic"
+
+#define CHUNK_COLUMNS "ID, name, chunk_x_size_metres, chunk_z_size_metres, chunk_base_resolution, heightmap, tex_diffuse, "		\
+	"tex_spat_alpha, tex_splat_1, tex_splat_2, tex_splat_3, tex_splat_4, render_wireframe, render_normals, "					\
+	"diffuse_tiling, tex_splat_1_tiling, tex_splat_2_tiling, tex_splat_3_tiling, tex_splat_4_tiling"
+
+class DatabaseMigration
+{
+public:
+	DatabaseMigration(sqlite3 * database);
+	~DatabaseMigration();
+
+	int		GetSchemaVersion();
+	bool	Migrate();						//runs every migration between the stored version and SCHEMA_VERSION. each step is its own transaction
+
+	static std::string Benchmark(int rows);	//point lookup / update latency on an in memory table of the given size, before and after migrating
+
+private:
+	bool	Exec(const char * sql);
+	bool	MigrateToVersion1();
+
+	sqlite3 * m_databaseConnection;
+};
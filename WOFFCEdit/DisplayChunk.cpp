@@ -1,6 +1,8 @@
 #include <string>
+#include <vector>
 #include "DisplayChunk.h"
 #include "Game.h"
+#include "TerrainNormals.h"
 
 
 using namespace DirectX;
@@ -10,7 +12,7 @@ DisplayChunk::DisplayChunk()
 {
 	//terrain size in meters. note that this is hard coded here, we COULD get it from the terrain chunk along with the other info from the tool if we want to be more flexible.
 	m_terrainSize = 512;
-	m_terrainHeightScale = 0.25;  //convert our 0-256 terrain to 64
+	m_terrainHeightScale = TERRAINHEIGHTSCALE;  //convert our 0-256 terrain to 64
 	m_textureCoordStep = 1.0 / (TERRAINRESOLUTION-1);	//-1 becuase its split into chunks. not vertices.  we want tthe last one in each row to have tex coord 1
 	m_terrainPositionScalingFactor = m_terrainSize / (TERRAINRESOLUTION-1);
 }
@@ -71,7 +73,7 @@ void DisplayChunk::InitialiseBatch()
 		for (size_t j = 0; j < TERRAINRESOLUTION; j++)
 		{
 			index = (TERRAINRESOLUTION * i) + j;
-			m_terrainGeometry[i][j].position =			Vector3(j*m_terrainPositionScalingFactor-(0.5*m_terrainSize), (float)(m_heightMap[index])*m_terrainHeightScale, i*m_terrainPositionScalingFactor-(0.5*m_terrainSize));	//This will create a terrain going from -64->64.  rather than 0->128.  So the center of the terrain is on the origin
+			m_terrainGeometry[i][j].position =			Vector3(j*m_terrainPositionScalingFactor-(0.5*m_terrainSize), m_heightMap[index], i*m_terrainPositionScalingFactor-(0.5*m_terrainSize));	//This will create a terrain going from -64->64.  rather than 0->128.  So the center of the terrain is on the origin
 			m_terrainGeometry[i][j].normal =			Vector3(0.0f, 1.0f, 0.0f);						//standard y =up
 			m_terrainGeometry[i][j].textureCoordinate =	Vector2(((float)m_textureCoordStep*j)*m_tex_diffuse_tiling, ((float)m_textureCoordStep*i)*m_tex_diffuse_tiling);				//Spread tex coords so that its distributed evenly across the terrain from 0-1
 			
@@ -81,37 +83,46 @@ void DisplayChunk::InitialiseBatch()
 	
 }
 
-void DisplayChunk::LoadHeightMap(std::shared_ptr<DX::DeviceResources>  DevResources)
+void DisplayChunk::LoadHeightMap(std::shared_ptr<DX::DeviceResources>  DevResources, const LevelPack * pack)
 {
 	auto device = DevResources->GetD3DDevice();
 	auto devicecontext = DevResources->GetD3DDeviceContext();
 
-	//load in heightmap .raw
-	FILE *pFile = NULL;
-
-	// Open The File In Read / Binary Mode.
-
-	pFile = fopen(m_heightmap_path.c_str(), "rb");
-	// Check To See If We Found The File And Could Open It
-	if (pFile == NULL)
+	//a cooked level has the heights ready to copy. the heightmap file itself is then only opened when it is saved
+	int packedResolution = 0;
+	const float * packedHeights = pack ? pack->Heights(packedResolution) : NULL;
+	if (packedHeights && packedResolution == TERRAINRESOLUTION)
+	{
+		m_heightmapFile.Close();
+		memcpy(m_heightMap, packedHeights, sizeof(m_heightMap));
+	}
+	//load in the heightmap. the tiled container beside an old 8 bit .raw wins, the .raw is imported when there is none
+	else if (!OpenHeightmapFile(HeightmapFile::ContainerPath(m_heightmap_path)) && !OpenHeightmapFile(m_heightmap_path))
 	{
 		// Display Error Message And Stop The Function
 		MessageBox(NULL, L"Can't Find The Height Map!", L"Error", MB_OK);
 		return;
 	}
-
-	// Here We Load The .RAW File Into Our pHeightMap Data Array
-	// We Are Only Reading In '1', And The Size Is (Width * Height)
-	fread(m_heightMap, 1, TERRAINRESOLUTION*TERRAINRESOLUTION, pFile);
-
-	fclose(pFile);
+	else
+	{
+		m_heightmapFile.Read(0, 0, TERRAINRESOLUTION, TERRAINRESOLUTION, m_heightMap);
+	}
 
 	//load in texture diffuse
 	
 	//load the diffuse texture
-	std::wstring texturewstr = StringToWCHART(m_tex_diffuse_path);
 	HRESULT rs;	
-	rs = CreateDDSTextureFromFile(device, texturewstr.c_str(), NULL, &m_texture_diffuse);	//load tex into Shader resource	view and resource
+	const uint8_t * textureData;
+	size_t textureSize;
+	if (pack && pack->Find(PACK_TEXTURE, StringTable::AssetPaths().Intern(m_tex_diffuse_path), textureData, textureSize))
+	{
+		rs = CreateDDSTextureFromMemory(device, textureData, textureSize, NULL, &m_texture_diffuse);
+	}
+	else
+	{
+		std::wstring texturewstr = StringToWCHART(m_tex_diffuse_path);
+		rs = CreateDDSTextureFromFile(device, texturewstr.c_str(), NULL, &m_texture_diffuse);	//load tex into Shader resource	view and resource
+	}
 	
 	//setup terrain effect
 	m_terrainEffect = std::make_unique<BasicEffect>(device);
@@ -139,7 +150,7 @@ void DisplayChunk::LoadHeightMap(std::shared_ptr<DX::DeviceResources>  DevResour
 	
 }
 
-void DisplayChunk::SaveHeightMap()
+bool DisplayChunk::SaveHeightMap()
 {
 	//generate heightmap based on terrain y positions
 	int index;
@@ -148,25 +159,37 @@ void DisplayChunk::SaveHeightMap()
 		for (size_t j = 0; j < TERRAINRESOLUTION; j++)
 		{
 			index = (TERRAINRESOLUTION * i) + j;
-			m_heightMap[index] = (float)(m_terrainGeometry[i][j].position.y / m_terrainHeightScale);
+			m_heightMap[index] = m_terrainGeometry[i][j].position.y;
 		}
 	}
 
-	FILE *pFile = NULL;
+	//only the tiles whose heights changed are written back. heights that came from a pack have no file open yet
+	if (m_heightmapFile.Width() == 0 && !OpenHeightmapFile(HeightmapFile::ContainerPath(m_heightmap_path)) && !OpenHeightmapFile(m_heightmap_path))
+	{
+		m_heightmapFile.Create(TERRAINRESOLUTION, TERRAINRESOLUTION, 64, HEIGHTMAP_SAMPLES_UINT16, 0.0f, 256.0f * m_terrainHeightScale);
+	}
+	m_heightmapFile.Write(0, 0, TERRAINRESOLUTION, TERRAINRESOLUTION, m_heightMap);
 
-	// Open The File In Read / Binary Mode.
-	pFile = fopen(m_heightmap_path.c_str(), "wb+");;
-	// Check To See If We Found The File And Could Open It
-	if (pFile == NULL)
+	//always into the container, so an old .raw is left as it was
+	std::string containerPath = HeightmapFile::ContainerPath(m_heightmap_path);
+	if (!m_heightmapFile.Save(containerPath))
 	{
-		// Display Error Message And Stop The Function
-		MessageBox(NULL, L"Can't Find The Height Map!", L"Error", MB_OK);
-		return;
+		MessageBox(NULL, L"Can't Save The Height Map!", L"Error", MB_OK);
+		return false;
 	}
+	m_heightmap_path = containerPath;
+	return true;
+}
 
-	fwrite(m_heightMap, 1, TERRAINRESOLUTION*TERRAINRESOLUTION, pFile);
-	fclose(pFile);
-	
+bool DisplayChunk::OpenHeightmapFile(const std::string & path)
+{
+	if (m_heightmapFile.Open(path, TERRAINRESOLUTION, m_terrainHeightScale)
+		&& m_heightmapFile.Width() == TERRAINRESOLUTION && m_heightmapFile.Height() == TERRAINRESOLUTION)
+	{
+		return true;
+	}
+	m_heightmapFile.Close();
+	return false;
 }
 
 void DisplayChunk::UpdateTerrain()
@@ -178,42 +201,45 @@ void DisplayChunk::UpdateTerrain()
 		for (size_t j = 0; j < TERRAINRESOLUTION; j++)
 		{
 			index = (TERRAINRESOLUTION * i) + j;
-			m_terrainGeometry[i][j].position.y = (float)(m_heightMap[index])*m_terrainHeightScale;	
+			m_terrainGeometry[i][j].position.y = m_heightMap[index];	
 		}
 	}
 	CalculateTerrainNormals();
 
 }
 
-void DisplayChunk::GenerateHeightmap()
+void DisplayChunk::GenerateHeightmap(const HeightmapSettings & settings)
 {
-	//insert how YOU want to update the heigtmap here! :D
+	//the generator works in 0-1, which is stretched over the range the old 0-255 heightmaps covered
+	std::vector<float> heights(TERRAINRESOLUTION*TERRAINRESOLUTION);
+	HeightmapGenerator::Generate(settings, TERRAINRESOLUTION, heights.data());
+	for (int index = 0; index < TERRAINRESOLUTION*TERRAINRESOLUTION; index++)
+	{
+		m_heightMap[index] = heights[index] * 255.0f * m_terrainHeightScale;
+	}
+	UpdateTerrain();
 }
 
 void DisplayChunk::CalculateTerrainNormals()
 {
-	int index1, index2, index3, index4;
-	DirectX::SimpleMath::Vector3 upDownVector, leftRightVector, normalVector;
-
-
-
-	for (int i = 0; i<(TERRAINRESOLUTION - 1); i++)
+	//central differences of the heights, clamped at the edges so the outer rows and columns get normals too
+	std::vector<float> heights(TERRAINRESOLUTION*TERRAINRESOLUTION);
+	std::vector<XMFLOAT3> normals(TERRAINRESOLUTION*TERRAINRESOLUTION);
+	for (int i = 0; i < TERRAINRESOLUTION; i++)
 	{
-		for (int j = 0; j<(TERRAINRESOLUTION - 1); j++)
+		for (int j = 0; j < TERRAINRESOLUTION; j++)
 		{
-			upDownVector.x = (m_terrainGeometry[i + 1][j].position.x - m_terrainGeometry[i - 1][j].position.x);
-			upDownVector.y = (m_terrainGeometry[i + 1][j].position.y - m_terrainGeometry[i - 1][j].position.y);
-			upDownVector.z = (m_terrainGeometry[i + 1][j].position.z - m_terrainGeometry[i - 1][j].position.z);
-
-			leftRightVector.x = (m_terrainGeometry[i][j - 1].position.x - m_terrainGeometry[i][j + 1].position.x);
-			leftRightVector.y = (m_terrainGeometry[i][j - 1].position.y - m_terrainGeometry[i][j + 1].position.y);
-			leftRightVector.z = (m_terrainGeometry[i][j - 1].position.z - m_terrainGeometry[i][j + 1].position.z);
-
+			heights[(TERRAINRESOLUTION * i) + j] = m_terrainGeometry[i][j].position.y;
+		}
+	}
 
-			leftRightVector.Cross(upDownVector, normalVector);	//get cross product
-			normalVector.Normalize();			//normalise it.
+	TerrainNormals::Generate(heights.data(), TERRAINRESOLUTION, m_terrainPositionScalingFactor, normals.data(), NULL);
 
-			m_terrainGeometry[i][j].normal = normalVector;	//set the normal for this point based on our result
+	for (int i = 0; i < TERRAINRESOLUTION; i++)
+	{
+		for (int j = 0; j < TERRAINRESOLUTION; j++)
+		{
+			m_terrainGeometry[i][j].normal = normals[(TERRAINRESOLUTION * i) + j];
 		}
 	}
 }
@@ -2,9 +2,14 @@
 #include "pch.h"
 #include "DeviceResources.h"
 #include "ChunkObject.h"
+#include "HeightmapGenerator.h"
+#include "HeightmapFile.h"
+#include "LevelPack.h"
 
 //geometric resoltuion - note,  hard coded.
 #define TERRAINRESOLUTION 128
+//metres per step of the old 0-255 heightmaps
+#define TERRAINHEIGHTSCALE 0.25f
 
 class DisplayChunk
 {
@@ -14,10 +19,11 @@ public:
 	void PopulateChunkData(ChunkObject * SceneChunk);
 	void RenderBatch(std::shared_ptr<DX::DeviceResources>  DevResources);
 	void InitialiseBatch();	//initial setup, base coordinates etc based on scale
-	void LoadHeightMap(std::shared_ptr<DX::DeviceResources>  DevResources);
-	void SaveHeightMap();			//saves the heigtmap back to file.
+	void LoadHeightMap(std::shared_ptr<DX::DeviceResources>  DevResources, const LevelPack * pack);	//heights and texture from the pack when it has them
+	bool SaveHeightMap();			//saves the heigtmap back to file, only the tiles that changed. an old .raw goes to the container beside it
+	const std::string & GetHeightmapPath() const { return m_heightmap_path; }	//the container once it has been saved
 	void UpdateTerrain();			//updates the geometry based on the heigtmap
-	void GenerateHeightmap();		//creates or alters the heightmap
+	void GenerateHeightmap(const HeightmapSettings & settings);		//replaces the heightmap with a procedural one and updates the geometry
 	void CalculateTerrainNormals();
 	std::unique_ptr<DirectX::PrimitiveBatch<DirectX::VertexPositionNormalTexture>>  m_batch;
 	std::unique_ptr<DirectX::BasicEffect>       m_terrainEffect;
@@ -28,9 +34,10 @@ public:
 	DirectX::VertexPositionNormalTexture m_terrainGeometry[TERRAINRESOLUTION][TERRAINRESOLUTION];
 
 private:
+	bool OpenHeightmapFile(const std::string & path);	//false, and nothing open, unless it holds a map of the terrain's resolution
 	
-	
-	BYTE m_heightMap[TERRAINRESOLUTION*TERRAINRESOLUTION];
+	float m_heightMap[TERRAINRESOLUTION*TERRAINRESOLUTION];		//heights in metres, as last loaded, saved or generated
+	HeightmapFile m_heightmapFile;
 	
 
 	float	m_terrainHeightScale;
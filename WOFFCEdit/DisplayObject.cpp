@@ -4,6 +4,11 @@ DisplayObject::DisplayObject()
 {
 	m_model = NULL;
 	m_texture_diffuse = NULL;
+	m_lod = 0;
+	m_ID = -1;
+	m_parentID = 0;
+	m_model_path = 0;
+	m_tex_diffuse_path = 0;
 	m_orientation.x = 0.0f;
 	m_orientation.y = 0.0f;
 	m_orientation.z = 0.0f;
@@ -14,6 +19,7 @@ DisplayObject::DisplayObject()
 	m_scale.y = 0.0f;
 	m_scale.z = 0.0f;
 	m_render = true;
+	m_snapToGround = false;
 	m_wireframe = false;
 
 	m_light_type =0;
@@ -1,5 +1,8 @@
 #pragma once
 #include "pch.h"
+#include <string>
+#include "StringTable.h"
+#include "AssetCache.h"
 
 
 class DisplayObject
@@ -10,14 +13,20 @@ public:
 
 	std::shared_ptr<DirectX::Model>						m_model;							//main Mesh
 	ID3D11ShaderResourceView *							m_texture_diffuse;					//diffuse texture
+	std::shared_ptr<const ModelLods>					m_lods;								//simplified versions of m_model, null when there are none
+	int													m_lod;								//level drawn last frame, 0 for m_model
 
 
 	int m_ID;
+	int m_parentID;											//database ID of the parent, 0 for none. position, orientation and scale are relative to it
+	StringHandle							m_model_path;						//handles into StringTable::AssetPaths()
+	StringHandle							m_tex_diffuse_path;
 	DirectX::SimpleMath::Vector3			m_position;
 	DirectX::SimpleMath::Vector3			m_orientation;
 	DirectX::SimpleMath::Vector3			m_scale;
 	bool									m_render;
 	bool									m_wireframe;
+	bool									m_snapToGround;						//kept on the terrain surface when the terrain is sculpted
 
 	int		m_light_type;
 	float	m_light_diffuse_r,	m_light_diffuse_g,	m_light_diffuse_b;
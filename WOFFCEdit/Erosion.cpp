@@ -0,0 +1,311 @@
+#include "Erosion.h"
+#include "HeightmapGenerator.h"
+#include "ParallelFor.h"
+#include "SeedHash.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+
+namespace
+{
+	const int	TILE_SIZE = 32;		//cells - must be more than twice the brush radius, so tiles of one pass stay apart
+}
+
+ErosionSettings::ErosionSettings()
+{
+	seed = 1;
+	iterations = 100;
+	dropletsPerCell = 1.0f / 16.0f;
+	lifetime = 30;
+	radius = 3;
+	inertia = 0.05f;
+	capacity = 4.0f;
+	minCapacity = 0.01f;
+	erodeRate = 0.3f;
+	depositRate = 0.3f;
+	evaporateRate = 0.01f;
+	gravity = 4.0f;
+	talusAngle = 40.0f;
+	thermalRate = 0.5f;
+}
+
+Erosion::Erosion()
+{
+	m_resolution = 0;
+	m_spacing = 1.0f;
+	m_iteration = 0;
+}
+
+Erosion::~Erosion()
+{
+}
+
+void Erosion::Begin(const float * heights, int resolution, float spacing, const ErosionSettings & settings)
+{
+	m_settings = settings;
+	m_settings.radius = std::max(0, std::min(settings.radius, TILE_SIZE / 2 - 1));
+	m_resolution = resolution;
+	m_spacing = spacing;
+	m_iteration = 0;
+	m_heights.assign(heights, heights + (size_t)resolution * resolution);
+	m_scratch.resize(m_heights.size());
+
+	//a cone of weights around the cell a particle is in
+	m_brush.clear();
+	float total = 0.0f;
+	int radius = m_settings.radius;
+	for (int dz = -radius; dz <= radius; dz++)
+	{
+		for (int dx = -radius; dx <= radius; dx++)
+		{
+			float weight = 1.0f - sqrtf((float)(dx * dx + dz * dz)) / (radius + 1);
+			if (weight > 0.0f)
+			{
+				BrushCell cell = { dx, dz, weight };
+				m_brush.push_back(cell);
+				total += weight;
+			}
+		}
+	}
+	for (size_t i = 0; i < m_brush.size(); i++)
+	{
+		m_brush[i].weight /= total;
+	}
+}
+
+bool Erosion::Step()
+{
+	if (!IsRunning())
+	{
+		return false;
+	}
+	if (m_resolution >= 2)
+	{
+		Hydraulic();
+		Thermal();
+	}
+	m_iteration++;
+	return IsRunning();
+}
+
+void Erosion::Stop()
+{
+	m_iteration = m_settings.iterations;
+}
+
+void Erosion::Hydraulic()
+{
+	//particles live in [0, resolution - 1) so the four samples around them always exist
+	const int limit = m_resolution - 1;
+	unsigned int shift = Hash(m_settings.seed, m_iteration, 0x5EA5u);
+	int shiftX = shift % TILE_SIZE;
+	int shiftZ = (shift >> 16) % TILE_SIZE;
+	int tilesX = (limit + shiftX + TILE_SIZE - 1) / TILE_SIZE;
+	int tilesZ = (limit + shiftZ + TILE_SIZE - 1) / TILE_SIZE;
+
+	std::vector<int> tiles;
+	for (int pass = 0; pass < 4; pass++)
+	{
+		tiles.clear();
+		for (int tz = pass / 2; tz < tilesZ; tz += 2)
+		{
+			for (int tx = pass % 2; tx < tilesX; tx += 2)
+			{
+				tiles.push_back(tz * tilesX + tx);
+			}
+		}
+
+		ParallelFor((int)tiles.size(), 1, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				int tx = tiles[i] % tilesX;
+				int tz = tiles[i] / tilesX;
+				int x0 = std::max(tx * TILE_SIZE - shiftX, 0);
+				int z0 = std::max(tz * TILE_SIZE - shiftZ, 0);
+				int x1 = std::min((tx + 1) * TILE_SIZE - shiftX, limit);
+				int z1 = std::min((tz + 1) * TILE_SIZE - shiftZ, limit);
+				Droplets(x0, z0, x1, z1, Hash(m_settings.seed, m_iteration, tiles[i]));
+			}
+		});
+	}
+}
+
+void Erosion::Droplets(int x0, int z0, int x1, int z1, unsigned int tileSeed)
+{
+	const int resolution = m_resolution;
+	float * heights = m_heights.data();
+	const ErosionSettings & s = m_settings;
+	//the particle measures heights in terrain widths, the scale its settings are tuned for, so they suit any size of terrain
+	const float unit = m_spacing * (resolution - 1);
+	int droplets = (int)((x1 - x0) * (z1 - z0) * s.dropletsPerCell + 0.5f);
+
+	for (int droplet = 0; droplet < droplets; droplet++)
+	{
+		float x = x0 + HashToUnit(Hash(tileSeed, droplet, 0)) * (x1 - x0);
+		float z = z0 + HashToUnit(Hash(tileSeed, droplet, 1)) * (z1 - z0);
+		float dirX = 0.0f, dirZ = 0.0f;
+		float speed = 1.0f, water = 1.0f, sediment = 0.0f;
+
+		for (int step = 0; step < s.lifetime; step++)
+		{
+			int cellX = (int)x;
+			int cellZ = (int)z;
+			float fx = x - cellX;
+			float fz = z - cellZ;
+			int index = cellZ * resolution + cellX;
+			float h00 = heights[index];
+			float h10 = heights[index + 1];
+			float h01 = heights[index + resolution];
+			float h11 = heights[index + resolution + 1];
+			float height = (h00 * (1 - fx) + h10 * fx) * (1 - fz) + (h01 * (1 - fx) + h11 * fx) * fz;
+			float gradientX = (h10 - h00) * (1 - fz) + (h11 - h01) * fz;
+			float gradientZ = (h01 - h00) * (1 - fx) + (h11 - h10) * fx;
+
+			//downhill, with some of the old direction kept
+			dirX = dirX * s.inertia - gradientX * (1 - s.inertia);
+			dirZ = dirZ * s.inertia - gradientZ * (1 - s.inertia);
+			float length = sqrtf(dirX * dirX + dirZ * dirZ);
+			if (length < 1e-6f)
+			{
+				break;
+			}
+			dirX /= length;
+			dirZ /= length;
+			float nextX = x + dirX;
+			float nextZ = z + dirZ;
+			if (nextX < x0 || nextX >= x1 || nextZ < z0 || nextZ >= z1 || step == s.lifetime - 1)
+			{
+				//it stops here, and leaves what it carries rather than taking it out of the terrain
+				float amount = sediment * unit;
+				heights[index] += amount * (1 - fx) * (1 - fz);
+				heights[index + 1] += amount * fx * (1 - fz);
+				heights[index + resolution] += amount * (1 - fx) * fz;
+				heights[index + resolution + 1] += amount * fx * fz;
+				break;
+			}
+			x = nextX;
+			z = nextZ;
+
+			int nextIndex = (int)z * resolution + (int)x;
+			float nx = x - (int)x;
+			float nz = z - (int)z;
+			float nextHeight = (heights[nextIndex] * (1 - nx) + heights[nextIndex + 1] * nx) * (1 - nz)
+				+ (heights[nextIndex + resolution] * (1 - nx) + heights[nextIndex + resolution + 1] * nx) * nz;
+			float drop = (nextHeight - height) / unit;		//negative going downhill
+
+			float capacity = std::max(-drop * speed * water * s.capacity, s.minCapacity);
+			if (sediment > capacity || drop > 0.0f)
+			{
+				//uphill it fills the hollow it is leaving, otherwise it sheds what it can no longer carry
+				float amount = drop > 0.0f ? std::min(drop, sediment) : (sediment - capacity) * s.depositRate;
+				sediment -= amount;
+				amount *= unit;
+				heights[index] += amount * (1 - fx) * (1 - fz);
+				heights[index + 1] += amount * fx * (1 - fz);
+				heights[index + resolution] += amount * (1 - fx) * fz;
+				heights[index + resolution + 1] += amount * fx * fz;
+			}
+			else
+			{
+				//never take more than the drop, or it would dig a pit behind itself
+				float amount = std::min((capacity - sediment) * s.erodeRate, -drop);
+				sediment += amount;
+				amount *= unit;
+				for (size_t b = 0; b < m_brush.size(); b++)
+				{
+					int bx = cellX + m_brush[b].dx;
+					int bz = cellZ + m_brush[b].dz;
+					if (bx >= 0 && bx < resolution && bz >= 0 && bz < resolution)
+					{
+						heights[bz * resolution + bx] -= amount * m_brush[b].weight;
+					}
+				}
+			}
+
+			speed = sqrtf(std::max(speed * speed - drop * s.gravity, 0.0f));
+			water *= 1.0f - s.evaporateRate;
+		}
+	}
+}
+
+void Erosion::Thermal()
+{
+	//every neighbouring pair swaps the same amount in opposite directions, worked out from the old heights only,
+	//so no material is made or lost and the rows can be done in any order
+	const int resolution = m_resolution;
+	const float * heights = m_heights.data();
+	float * result = m_scratch.data();
+	const float talus = tanf(m_settings.talusAngle * 3.14159265f / 180.0f) * m_spacing;
+	const float rate = m_settings.thermalRate * 0.0625f;	//at most half the excess leaves a cell with all eight neighbours lower
+	const int offsetX[8] = { -1, 0, 1, -1, 1, -1, 0, 1 };
+	const int offsetZ[8] = { -1, -1, -1, 0, 0, 1, 1, 1 };
+	const float limit[8] = { talus * 1.41421356f, talus, talus * 1.41421356f, talus, talus, talus * 1.41421356f, talus, talus * 1.41421356f };
+
+	ParallelFor(resolution, 16, [&](int begin, int end)
+	{
+		for (int z = begin; z < end; z++)
+		{
+			for (int x = 0; x < resolution; x++)
+			{
+				float height = heights[z * resolution + x];
+				float change = 0.0f;
+				for (int n = 0; n < 8; n++)
+				{
+					int nx = x + offsetX[n];
+					int nz = z + offsetZ[n];
+					if (nx < 0 || nx >= resolution || nz < 0 || nz >= resolution)
+					{
+						continue;
+					}
+					float difference = heights[nz * resolution + nx] - height;
+					float excess = fabsf(difference) - limit[n];
+					if (excess > 0.0f)
+					{
+						change += difference > 0.0f ? excess * rate : -excess * rate;
+					}
+				}
+				result[z * resolution + x] = height + change;
+			}
+		}
+	});
+	m_heights.swap(m_scratch);
+}
+
+std::string Erosion::Benchmark(int resolution, int iterations)
+{
+	//a generated terrain in the editor's units - 0 to 64 high, 4 between samples
+	std::vector<float> terrain((size_t)resolution * resolution);
+	HeightmapGenerator::Generate(HeightmapSettings(), resolution, terrain.data());
+	for (size_t i = 0; i < terrain.size(); i++)
+	{
+		terrain[i] *= 64.0f;
+	}
+
+	ErosionSettings settings;
+	settings.iterations = iterations;
+	Erosion erosion;
+	erosion.Begin(terrain.data(), resolution, 4.0f, settings);
+	auto start = std::chrono::high_resolution_clock::now();
+	while (erosion.Step())
+	{
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+
+	Erosion again;
+	again.Begin(terrain.data(), resolution, 4.0f, settings);
+	while (again.Step())
+	{
+	}
+	bool repeatable = std::equal(erosion.m_heights.begin(), erosion.m_heights.end(), again.m_heights.begin());
+
+	double ms = std::chrono::duration<double, std::milli>(end - start).count();
+	int droplets = (int)(resolution * resolution * settings.dropletsPerCell);
+
+	std::ostringstream report;
+	report << "Erosion, " << resolution << " x " << resolution << " with about " << droplets << " particles per iteration on "
+		<< ParallelWorkerCount() << " threads: " << iterations << " iterations in " << ms << " ms, "
+		<< iterations * 1000.0 / ms << " iterations/s" << (repeatable ? "" : " (NOT REPEATABLE)") << "\n";
+	return report.str();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//terrain erosion, run a little at a time so the editor keeps drawing while it works.
+//each iteration drops a batch of water particles that carve sediment out of slopes and lay it down where they slow
+//(hydraulic), then lets any slope steeper than the talus angle slump onto its lower neighbours (thermal).
+//particles are grouped by the square tile they start in, and a particle that leaves its tile stops there. tiles are
+//done in four chequerboard passes so the tiles of a pass never touch the same heights and can go to different threads,
+//and every tile draws its random numbers from the seed, the iteration and its own coordinates - the result is the
+//same however many threads run it. the tile grid moves every iteration so the tile edges leave no seams.
+
+struct ErosionSettings
+{
+	unsigned int	seed;
+	int				iterations;
+	float			dropletsPerCell;		//particles per heightfield cell, per iteration
+	int				lifetime;				//steps a particle takes before it evaporates completely
+	int				radius;					//cells around a particle that it erodes
+	float			inertia;				//0 - 1, how much a particle keeps its direction instead of following the slope
+	float			capacity;				//sediment carried per unit of speed, water and drop
+	float			minCapacity;
+	float			erodeRate;
+	float			depositRate;
+	float			evaporateRate;
+	float			gravity;
+	float			talusAngle;				//degrees, slopes steeper than this slump
+	float			thermalRate;			//0 - 1, fraction of the excess slope that slumps per iteration
+
+	ErosionSettings();
+};
+
+class Erosion
+{
+public:
+	Erosion();
+	~Erosion();
+
+	//takes a copy of a resolution x resolution heightfield, row by row, with spacing between samples
+	void Begin(const float * heights, int resolution, float spacing, const ErosionSettings & settings);
+	bool Step();				//runs one iteration, returns whether there are more to go
+	void Stop();
+
+	bool IsRunning() const		{ return m_iteration < m_settings.iterations && !m_heights.empty(); }
+	int Iteration() const		{ return m_iteration; }
+	const float * Heights() const	{ return m_heights.data(); }
+
+	static std::string Benchmark(int resolution, int iterations);
+
+private:
+	void Hydraulic();
+	void Thermal();
+	void Droplets(int x0, int z0, int x1, int z1, unsigned int tileSeed);	//the particles of one tile
+
+	struct BrushCell
+	{
+		int		dx, dz;
+		float	weight;
+	};
+
+	ErosionSettings			m_settings;
+	int						m_resolution;
+	float					m_spacing;
+	int						m_iteration;
+	std::vector<float>		m_heights;
+	std::vector<float>		m_scratch;		//thermal writes here, then swaps
+	std::vector<BrushCell>	m_brush;		//weights add up to 1
+};
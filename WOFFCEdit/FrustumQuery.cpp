@@ -0,0 +1,197 @@
+#include "FrustumQuery.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace
+{
+	const int GRAIN = 8192;		//boxes per ParallelFor chunk
+}
+
+void FrustumBounds::Resize(int count)
+{
+	centreX.resize(count);
+	centreY.resize(count);
+	centreZ.resize(count);
+	extentX.resize(count);
+	extentY.resize(count);
+	extentZ.resize(count);
+}
+
+void FrustumBounds::Set(int index, const XMFLOAT3 & centre, const XMFLOAT3 & extents)
+{
+	centreX[index] = centre.x;
+	centreY[index] = centre.y;
+	centreZ[index] = centre.z;
+	extentX[index] = extents.x;
+	extentY[index] = extents.y;
+	extentZ[index] = extents.z;
+}
+
+FrustumQuery::FrustumQuery()
+{
+	for (int plane = 0; plane < 6; plane++)
+	{
+		m_planes[plane][0] = m_planes[plane][1] = m_planes[plane][2] = 0.0f;
+		m_planes[plane][3] = 1.0f;
+	}
+}
+
+FrustumQuery::~FrustumQuery()
+{
+}
+
+void FrustumQuery::Set(const XMFLOAT4X4 & viewProjection, float left, float top, float right, float bottom)
+{
+	//clip = point * viewProjection, so column c of the matrix gives clip component c. a point is inside the
+	//rectangle when left * w <= x <= right * w and the same for y, and in front when 0 <= z <= w
+	float low[2] = { std::min(left, right), std::min(top, bottom) };
+	float high[2] = { std::max(left, right), std::max(top, bottom) };
+	for (int i = 0; i < 4; i++)
+	{
+		float x = viewProjection.m[i][0], y = viewProjection.m[i][1], z = viewProjection.m[i][2], w = viewProjection.m[i][3];
+		m_planes[0][i] = x - low[0] * w;
+		m_planes[1][i] = high[0] * w - x;
+		m_planes[2][i] = y - low[1] * w;
+		m_planes[3][i] = high[1] * w - y;
+		m_planes[4][i] = z;
+		m_planes[5][i] = w - z;
+	}
+}
+
+bool FrustumQuery::Intersects(const XMFLOAT3 & centre, const XMFLOAT3 & extents) const
+{
+	for (int plane = 0; plane < 6; plane++)
+	{
+		const float * p = m_planes[plane];
+		float distance = p[0] * centre.x + p[1] * centre.y + p[2] * centre.z + p[3];
+		float reach = fabsf(p[0]) * extents.x + fabsf(p[1]) * extents.y + fabsf(p[2]) * extents.z;
+		if (distance + reach < 0.0f)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void FrustumQuery::QueryRange(const FrustumBounds & bounds, int begin, int end, float * nearest) const
+{
+	//a plane at a time over the whole range, keeping how far inside the worst plane each box reaches.
+	//the inner loop is branch free and vectorises
+	const float * cx = bounds.centreX.data(), * cy = bounds.centreY.data(), * cz = bounds.centreZ.data();
+	const float * ex = bounds.extentX.data(), * ey = bounds.extentY.data(), * ez = bounds.extentZ.data();
+	for (int plane = 0; plane < 6; plane++)
+	{
+		const float nx = m_planes[plane][0], ny = m_planes[plane][1], nz = m_planes[plane][2], d = m_planes[plane][3];
+		const float ax = fabsf(nx), ay = fabsf(ny), az = fabsf(nz);
+		for (int i = begin; i < end; i++)
+		{
+			float reach = nx * cx[i] + ny * cy[i] + nz * cz[i] + d + ax * ex[i] + ay * ey[i] + az * ez[i];
+			nearest[i - begin] = plane == 0 ? reach : std::min(nearest[i - begin], reach);
+		}
+	}
+}
+
+void FrustumQuery::Query(const FrustumBounds & bounds, std::vector<int> & hits) const
+{
+	int count = bounds.Size();
+	std::vector<float> nearest(count);
+	ParallelFor(count, GRAIN, [&](int begin, int end)
+	{
+		QueryRange(bounds, begin, end, &nearest[begin]);
+	});
+
+	hits.clear();
+	for (int i = 0; i < count; i++)
+	{
+		if (nearest[i] >= 0.0f)
+		{
+			hits.push_back(i);
+		}
+	}
+}
+
+std::string FrustumQuery::Benchmark(int boxes)
+{
+	//a camera at the origin looking down +z over a field of props, and a marquee over a quarter of the screen
+	const float nearZ = 0.1f, farZ = 1000.0f, scale = 1.0f / tanf(0.5f * 1.0f);
+	XMFLOAT4X4 viewProjection;
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			viewProjection.m[r][c] = 0.0f;
+		}
+	}
+	viewProjection._11 = scale;
+	viewProjection._22 = scale * 1.5f;
+	viewProjection._33 = farZ / (farZ - nearZ);
+	viewProjection._34 = 1.0f;
+	viewProjection._43 = -nearZ * farZ / (farZ - nearZ);
+
+	std::mt19937 random(99);
+	std::uniform_real_distribution<float> across(-600.0f, 600.0f), depth(-50.0f, 990.0f), size(0.2f, 4.0f);
+	FrustumBounds bounds, points;
+	bounds.Resize(boxes);
+	points.Resize(boxes);
+	for (int i = 0; i < boxes; i++)
+	{
+		XMFLOAT3 centre(across(random), across(random) * 0.2f, depth(random));
+		bounds.Set(i, centre, XMFLOAT3(size(random), size(random), size(random)));
+		points.Set(i, centre, XMFLOAT3(0.0f, 0.0f, 0.0f));
+	}
+
+	FrustumQuery query;
+	query.Set(viewProjection, -0.6f, 0.4f, 0.4f, -0.6f);
+
+	//one at a time through Intersects, the way a loop over the display list would do it
+	std::vector<int> serial;
+	auto serialStart = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < boxes; i++)
+	{
+		if (query.Intersects(XMFLOAT3(bounds.centreX[i], bounds.centreY[i], bounds.centreZ[i]), XMFLOAT3(bounds.extentX[i], bounds.extentY[i], bounds.extentZ[i])))
+		{
+			serial.push_back(i);
+		}
+	}
+	auto serialEnd = std::chrono::high_resolution_clock::now();
+
+	std::vector<int> hits;
+	auto queryStart = std::chrono::high_resolution_clock::now();
+	query.Query(bounds, hits);
+	auto queryEnd = std::chrono::high_resolution_clock::now();
+
+	//points need no planes to check - project them and see if they land in the rectangle
+	std::vector<int> pointHits, projected;
+	query.Query(points, pointHits);
+	for (int i = 0; i < boxes; i++)
+	{
+		float x = points.centreX[i], y = points.centreY[i], z = points.centreZ[i];
+		float clip[4];
+		for (int c = 0; c < 4; c++)
+		{
+			clip[c] = x * viewProjection.m[0][c] + y * viewProjection.m[1][c] + z * viewProjection.m[2][c] + viewProjection.m[3][c];
+		}
+		if (clip[3] > 0.0f && clip[2] >= 0.0f && clip[2] <= clip[3] && clip[0] >= -0.6f * clip[3] && clip[0] <= 0.4f * clip[3]
+			&& clip[1] >= -0.6f * clip[3] && clip[1] <= 0.4f * clip[3])
+		{
+			projected.push_back(i);
+		}
+	}
+	bool correct = hits == serial && pointHits == projected && !hits.empty();
+
+	auto ms = [](std::chrono::high_resolution_clock::duration time)
+	{
+		return std::chrono::duration<double, std::milli>(time).count();
+	};
+	std::ostringstream report;
+	report << "Frustum query, " << boxes << " boxes, " << hits.size() << " inside the marquee: one at a time " << ms(serialEnd - serialStart)
+		<< " ms, by plane on " << ParallelWorkerCount() << " threads " << ms(queryEnd - queryStart) << " ms"
+		<< (correct ? "" : " (QUERY WRONG)") << "\n";
+	return report.str();
+}
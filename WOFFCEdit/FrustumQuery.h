@@ -0,0 +1,43 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+//which of a lot of boxes are at least partly inside a frustum, for marquee selection. the frustum is the part of the
+//view behind a rectangle of the screen - six planes taken straight from the rows of the view projection matrix - and
+//each box is tested against every plane at its nearest corner. the boxes are kept a component per array, so the test
+//runs down them in straight lines, and the array is split over the ParallelFor workers.
+//boxes that only cross a corner of the frustum outside every face can be counted in; selection can live with that.
+
+//world space boxes, centre and half size, one index per box
+struct FrustumBounds
+{
+	std::vector<float>	centreX, centreY, centreZ;
+	std::vector<float>	extentX, extentY, extentZ;
+
+	void	Resize(int count);
+	int		Size() const { return (int)centreX.size(); }
+	void	Set(int index, const DirectX::XMFLOAT3 & centre, const DirectX::XMFLOAT3 & extents);
+};
+
+class FrustumQuery
+{
+public:
+	FrustumQuery();
+	~FrustumQuery();
+
+	//the rectangle is in normalised device coordinates, -1 to 1 with y up, either corner first.
+	//viewProjection as DirectXMath builds it, points are row vectors
+	void	Set(const DirectX::XMFLOAT4X4 & viewProjection, float left, float top, float right, float bottom);
+
+	bool	Intersects(const DirectX::XMFLOAT3 & centre, const DirectX::XMFLOAT3 & extents) const;
+	void	Query(const FrustumBounds & bounds, std::vector<int> & hits) const;	//indices of the boxes inside, ascending
+
+	static std::string Benchmark(int boxes);
+
+private:
+	void	QueryRange(const FrustumBounds & bounds, int begin, int end, float * nearest) const;
+
+	float	m_planes[6][4];		//inward normal and distance, a point is inside when dot(normal, point) + distance >= 0
+};
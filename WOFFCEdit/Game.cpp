@@ -5,7 +5,11 @@
 #include "pch.h"
 #include "Game.h"
 #include "DisplayObject.h"
+#include "ParallelFor.h"
 #include <string>
+#include <typeinfo>
+
+#include "ObjectVS.inc"
 
 
 using namespace DirectX;
@@ -13,6 +17,20 @@ using namespace DirectX::SimpleMath;
 
 using Microsoft::WRL::ComPtr;
 
+namespace
+{
+	const int	TERRAIN_HISTORY_TILE = 16;		//samples across an undo tile, a brush dab touches a handful
+	const float	LOD_PIXEL_ERROR = 1.0f;			//a level of detail is drawn while it strays from the full model by less than this on screen
+
+	//ObjectMatrices in ObjectVS.hlsl, laid out as BasicEffect lays out the same matrices in its own constants
+	struct ObjectMatrices
+	{
+		XMMATRIX	world;
+		XMVECTOR	worldInverseTranspose[3];
+		XMMATRIX	worldViewProj;
+	};
+}
+
 Game::Game()
 
 {
@@ -25,6 +43,11 @@ Game::Game()
 	m_grid = false;
 
     copiedObject.valid = false;
+    m_nextObjectID = 1;
+    m_hierarchyStale = true;
+    m_placementModel = StringTable::AssetPaths().Intern("database/data/placeholder.cmo");
+    m_placementTexture = StringTable::AssetPaths().Intern("database/data/placeholder.dds");
+    m_levelPack = NULL;
 
 }
 
@@ -125,7 +148,10 @@ void Game::Update(DX::StepTimer const& timer)
 	m_displayChunk.m_terrainEffect->SetView(m_view);
 	m_displayChunk.m_terrainEffect->SetWorld(Matrix::Identity);
 
-	
+	if (m_erosion.IsRunning())
+	{
+		StepErosion();
+	}
 
 #ifdef DXTK_AUDIO
     m_audioTimerAcc -= (float)timer.GetElapsedSeconds();
@@ -156,89 +182,45 @@ void Game::Update(DX::StepTimer const& timer)
 }
 #pragma endregion
 
-int Game::MousePicking(bool ignoreGizmo)
+int Game::MousePicking()
 {
-	int selectedID = -1;
-	float pickedDistance = 0;
+	int selectedIndex = -1;
 
-	//setup near and far planes of frustum with mouse X and mouse y passed down from Toolmain. 
-		//they may look the same but note, the difference in Z
-	const XMVECTOR nearSource = XMVectorSet(m_InputCommands.mouse_X, m_InputCommands.mouse_Y, 0.0f, 1.0f);
-	const XMVECTOR farSource = XMVectorSet(m_InputCommands.mouse_X, m_InputCommands.mouse_Y, 1.0f, 1.0f);
+	//the ray under the cursor, compared with every object in world units so their scales don't skew the nearest
+	XMVECTOR origin, direction;
+	MouseRay(origin, direction);
 
 	// initialise as float max
 
 	float minDistance = FLT_MAX;
 
+	UpdateTransforms();
+
 	//Loop through entire display list of objects and pick with each in turn. 
 	for (int i = 0; i < m_displayList.size(); i++)
 	{
-		//Get the scale factor and translation of the object
-		const XMVECTORF32 scale = { m_displayList[i].m_scale.x,		m_displayList[i].m_scale.y,		m_displayList[i].m_scale.z };
-		const XMVECTORF32 translate = { m_displayList[i].m_position.x,		m_displayList[i].m_position.y,	m_displayList[i].m_position.z };
-
-		//convert euler angles into a quaternion for the rotation of the object
-		XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(m_displayList[i].m_orientation.y * 3.1415 / 180, m_displayList[i].m_orientation.x * 3.1415 / 180,
-			m_displayList[i].m_orientation.z * 3.1415 / 180);
-
-		//create set the matrix of the selected object in the world based on the translation, scale and rotation.
-		XMMATRIX local = m_world * XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate);
-
-		//Unproject the points on the near and far plane, with respect to the matrix we just created.
-		XMVECTOR nearPoint = XMVector3Unproject(nearSource, 0.0f, 0.0f, m_ScreenDimensions.right, m_ScreenDimensions.bottom, m_deviceResources->GetScreenViewport().MinDepth, m_deviceResources->GetScreenViewport().MaxDepth, m_projection, m_view, local);
-
-		XMVECTOR farPoint = XMVector3Unproject(farSource, 0.0f, 0.0f, m_ScreenDimensions.right, m_ScreenDimensions.bottom, m_deviceResources->GetScreenViewport().MinDepth, m_deviceResources->GetScreenViewport().MaxDepth, m_projection, m_view, local);
-
-		//turn the transformed points into our picking vector. 
-		XMVECTOR pickingVector = farPoint - nearPoint;
-		pickingVector = XMVector3Normalize(pickingVector);
-
-		//loop through mesh list for object
-		for (int y = 0; y < m_displayList[i].m_model.get()->meshes.size(); y++)
+		float pickedDistance;
+		XMVECTOR normal;
+		if (RaycastObject(i, origin, direction, minDistance, pickedDistance, normal))
 		{
-			//checking for ray intersection
-			if (m_displayList[i].m_model.get()->meshes[y]->boundingBox.Intersects(nearPoint, pickingVector, pickedDistance))
-			{
-				if (pickedDistance < minDistance && (i != 0 && i != 1 && i != 2 && ignoreGizmo))
-				{
-					minDistance = pickedDistance;
-					selectedID = i;
-				}
-                else if (pickedDistance < minDistance) {
-                    minDistance = pickedDistance;
-                    selectedID = i;
-                }
-
-				//selectedID = i;
-			}
+			minDistance = pickedDistance;
+			selectedIndex = i;
 		}
 	}
 
     
-    if (selectedID != -1 && ignoreGizmo) {
+    if (selectedIndex != -1) {
         if (red) {
-            CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"database/data/red.dds", nullptr, &m_displayList[selectedID].m_texture_diffuse);
-     
+            SetDisplayTexture(selectedIndex, StringTable::AssetPaths().Intern("database/data/red.dds"));
         }
         if (green) {
-            CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"database/data/green.dds", nullptr, &m_displayList[selectedID].m_texture_diffuse);
-
+            SetDisplayTexture(selectedIndex, StringTable::AssetPaths().Intern("database/data/green.dds"));
         }
         if (blue) {
-            CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"database/data/blue.dds", nullptr, &m_displayList[selectedID].m_texture_diffuse);
-
+            SetDisplayTexture(selectedIndex, StringTable::AssetPaths().Intern("database/data/blue.dds"));
         }
 		
         if (red || green || blue) {
-            //apply new texture to models effect
-            m_displayList[selectedID].m_model->UpdateEffects([&](IEffect* effect)
-                {
-                    auto lights = dynamic_cast<BasicEffect*>(effect);
-                    if (lights)
-                    {
-                        lights->SetTexture(m_displayList[selectedID].m_texture_diffuse);
-                    }
-                });
             red = false;
             green = false;
             blue = false;
@@ -246,16 +228,65 @@ int Game::MousePicking(bool ignoreGizmo)
     }
     
 
-	//if we got a hit.  return it.  
-	return selectedID;
+	//if we got a hit.  return it
+	return GetObjectID(selectedIndex);
+}
+
+void Game::MarqueeSelect(int x0, int y0, int x1, int y1, std::vector<int> & IDs)
+{
+	//the rectangle as normalised device coordinates, y up
+	float width = (float)m_ScreenDimensions.right, height = (float)m_ScreenDimensions.bottom;
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, m_view * m_projection);
+	FrustumQuery query;
+	query.Set(viewProjection, 2.0f * x0 / width - 1.0f, 1.0f - 2.0f * y0 / height, 2.0f * x1 / width - 1.0f, 1.0f - 2.0f * y1 / height);
+
+	//every object's mesh bounds as a world box, the box of the box where it is rotated
+	UpdateTransforms();
+	int count = (int)m_displayList.size();
+	m_selectionBounds.Resize(count);
+	ParallelFor(count, 4096, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			const DisplayObject & object = m_displayList[i];
+			XMVECTOR low = XMVectorReplicate(FLT_MAX), high = XMVectorReplicate(-FLT_MAX);
+			for (size_t y = 0; y < object.m_model->meshes.size(); y++)
+			{
+				const BoundingBox & box = object.m_model->meshes[y]->boundingBox;
+				low = XMVectorMin(low, XMLoadFloat3(&box.Center) - XMLoadFloat3(&box.Extents));
+				high = XMVectorMax(high, XMLoadFloat3(&box.Center) + XMLoadFloat3(&box.Extents));
+			}
+			XMFLOAT3 centre(0.0f, 0.0f, 0.0f), extents(0.0f, 0.0f, 0.0f);
+			if (!object.m_model->meshes.empty())
+			{
+				XMMATRIX world = m_world * m_hierarchy.GetWorld(i);
+				XMVECTOR half = (high - low) * 0.5f;
+				XMStoreFloat3(&centre, XMVector3TransformCoord((low + high) * 0.5f, world));
+				XMStoreFloat3(&extents, XMVectorAbs(world.r[0]) * XMVectorSplatX(half) + XMVectorAbs(world.r[1]) * XMVectorSplatY(half)
+					+ XMVectorAbs(world.r[2]) * XMVectorSplatZ(half));
+			}
+			m_selectionBounds.Set(i, centre, extents);
+		}
+	});
+
+	std::vector<int> hits;
+	query.Query(m_selectionBounds, hits);
+	IDs.resize(hits.size());
+	for (size_t h = 0; h < hits.size(); h++)
+	{
+		IDs[h] = m_displayList[hits[h]].m_ID;
+	}
+	std::sort(IDs.begin(), IDs.end());
 }
 
 void Game::Copy(int id)
 {
-    if (id == -1)
+    int index = m_displayIndex.Find(id);
+    if (index == -1)
         return;
     //copy
-    copiedObject = m_displayList[id];
+    copiedObject = m_displayList[index];
 }
 
 void Game::Paste(int id)
@@ -264,9 +295,26 @@ void Game::Paste(int id)
         // set the transform of the object to the camera position
         copiedObject.m_position = camera.m_camPosition + (camera.m_camLookDirection * 3);
 
+        // the paste is a new object, so it gets its own ID. the scene model fills in the rest of the row from the original
+        // it is placed in world space, so it does not keep the original's parent
+        int sourceID = copiedObject.m_ID;
+        int sourceParentID = copiedObject.m_parentID;
+        copiedObject.m_ID = m_nextObjectID++;
+        copiedObject.m_parentID = 0;
 
         // push the copied object back to the display list
-        m_displayList.push_back(copiedObject);
+        AddDisplayObject(copiedObject);
+
+        SceneChange change(SCENE_OBJECT_ADDED, copiedObject.m_ID);
+        change.sourceID = sourceID;
+        change.object.model_path = copiedObject.m_model_path;
+        change.object.tex_diffuse_path = copiedObject.m_tex_diffuse_path;
+        CopyTransform(copiedObject, change.object);
+        PushSceneChange(change);
+
+        // keep the copy pointing at the original so a second paste copies the same row
+        copiedObject.m_ID = sourceID;
+        copiedObject.m_parentID = sourceParentID;
 
         erasing = false;
 
@@ -276,8 +324,10 @@ void Game::Paste(int id)
 }
 
 void Game::Delete(int id) {
-    if (erasing == false) {
-        m_displayList.erase(m_displayList.begin() + id);
+    if (erasing == false && m_displayIndex.Find(id) != -1) {
+        PushSceneChange(SceneChange(SCENE_OBJECT_REMOVED, id));
+
+        RemoveDisplayObject(id);
         
         erasing = true;
     }
@@ -285,17 +335,38 @@ void Game::Delete(int id) {
     
 }
 
+void Game::RemoveDisplayObject(int id)
+{
+    int index = m_displayIndex.Find(id);
+    if (index == -1)
+        return;
+
+    // draw order means nothing, so move the last object into the hole instead of shifting everything after it
+    int last = m_displayList.size() - 1;
+    if (index != last) {
+        m_displayList[index] = m_displayList[last];
+        m_displayIndex.Move(m_displayList[index].m_ID, index);
+    }
+    m_displayList.pop_back();
+    m_displayIndex.Remove(id);
+    m_hierarchyStale = true;
+}
+
+void Game::AddDisplayObject(const DisplayObject & displayObject)
+{
+    m_displayIndex.Insert(displayObject.m_ID, m_displayList.size());
+    m_displayList.push_back(displayObject);
+    m_hierarchyStale = true;
+}
+
 void Game::Cut(int id) {
     Copy(id);
     Delete(id);
 }
 
-void Game::MoveObject(int moveX, int moveY, int id, char axis)
+void Game::MoveObject(int moveX, int moveY, const SelectionSet & selection)
 {
-    if (id != -1) {
-
-        // If the selected axis is not one of x, y, or z, default to the passed in axis
-        if (selectedAxis != 'x' && selectedAxis != 'y' && selectedAxis != 'z') selectedAxis = axis;
+    if (!selection.Empty()) {
 
         // Get the proportion of the camera's right vector that corresponds to the x and z axes
         float xProportion = -XMVectorGetX(camera.m_camRight);
@@ -304,120 +375,285 @@ void Game::MoveObject(int moveX, int moveY, int id, char axis)
         // Set the movement sensitivity for the object
         float moveSensitivity = 0.1;
 
-        // Move the object based on the selected axis
-        if (selectedAxis == 'x') {
-            m_displayList[id].m_position += Vector3(moveX * xProportion * moveSensitivity, 0, 0);
+        // Move the objects across the screen, constrained moves go through the gizmo
+        Vector3 move(moveX * xProportion * moveSensitivity, moveY * moveSensitivity, moveX * zProportion * moveSensitivity);
+        TransformObjects(selection, SelectionTransform::Translate(move));
+    }
+
+    
+}
+
+void Game::TransformObjects(const SelectionSet & selection, const SelectionTransform & transform)
+{
+    // a child whose parent is selected too goes where the parent takes it, moving it as well would move it twice
+    UpdateTransforms();
+    const std::vector<int> & selected = selection.IDs();
+    std::shared_ptr<std::vector<int>> IDs = std::make_shared<std::vector<int>>();
+    IDs->reserve(selected.size());
+    m_transformIndices.clear();
+    for (size_t s = 0; s < selected.size(); s++) {
+        int index = m_displayIndex.Find(selected[s]);
+        if (index == -1) {
+            continue;
+        }
+        bool parentSelected = false;
+        for (int parent = m_hierarchy.GetParent(index); parent != -1 && !parentSelected; parent = m_hierarchy.GetParent(parent)) {
+            parentSelected = selection.Contains(m_displayList[parent].m_ID);
+        }
+        if (!parentSelected) {
+            m_transformIndices.push_back(index);
+            IDs->push_back(selected[s]);
         }
-        else if ((selectedAxis == 'y')) {
-            m_displayList[id].m_position += Vector3(0, moveY * moveSensitivity, 0);
+    }
+    int count = (int)m_transformIndices.size();
+    if (count == 0) {
+        return;
+    }
+
+    std::shared_ptr<std::vector<TransformComponent>> transforms = std::make_shared<std::vector<TransformComponent>>(count);
+    ParallelFor(count, 2048, [&](int begin, int end)
+    {
+        TransformComponent * batch = &(*transforms)[begin];
+        for (int i = begin; i < end; i++) {
+            const DisplayObject & displayObject = m_displayList[m_transformIndices[i]];
+            TransformComponent & t = (*transforms)[i];
+            t.posX = displayObject.m_position.x;	t.posY = displayObject.m_position.y;	t.posZ = displayObject.m_position.z;
+            t.rotX = displayObject.m_orientation.x;	t.rotY = displayObject.m_orientation.y;	t.rotZ = displayObject.m_orientation.z;
+            t.scaX = displayObject.m_scale.x;		t.scaY = displayObject.m_scale.y;		t.scaZ = displayObject.m_scale.z;
+            t.pivotX = t.pivotY = t.pivotZ = 0.0f;
         }
-        else if (selectedAxis == 'z') {
-            m_displayList[id].m_position += Vector3(0, 0, moveX * zProportion * moveSensitivity);
+        transform.Apply(batch, end - begin);
+
+        // a child keeps its transform relative to its parent, so it takes the edit in its parent's space instead.
+        // exact for a move, and for a turn or scale under parents that are only turned about y and scaled evenly
+        for (int i = begin; i < end; i++) {
+            int index = m_transformIndices[i];
+            int parent = m_hierarchy.GetParent(index);
+            if (parent != -1) {
+                XMMATRIX toParent = XMMatrixInverse(nullptr, m_hierarchy.GetWorld(parent));
+                SelectionTransform local = transform;
+                XMStoreFloat3(&local.translation, XMVector3TransformNormal(XMLoadFloat3(&transform.translation), toParent));
+                XMStoreFloat3(&local.pivot, XMVector3TransformCoord(XMLoadFloat3(&transform.pivot), toParent));
+                const DisplayObject & displayObject = m_displayList[index];
+                TransformComponent & t = (*transforms)[i];
+                t.posX = displayObject.m_position.x;	t.posY = displayObject.m_position.y;	t.posZ = displayObject.m_position.z;
+                t.rotY = displayObject.m_orientation.y;
+                t.scaX = displayObject.m_scale.x;		t.scaY = displayObject.m_scale.y;		t.scaZ = displayObject.m_scale.z;
+                local.Apply(&t, 1);
+            }
         }
-        else {
-            m_displayList[id].m_position += Vector3(moveX * xProportion * moveSensitivity, moveY * moveSensitivity, moveX * zProportion * moveSensitivity);
+
+        for (int i = begin; i < end; i++) {
+            DisplayObject & displayObject = m_displayList[m_transformIndices[i]];
+            const TransformComponent & t = (*transforms)[i];
+            displayObject.m_position = Vector3(t.posX, t.posY, t.posZ);
+            displayObject.m_orientation = Vector3(t.rotX, t.rotY, t.rotZ);
+            displayObject.m_scale = Vector3(t.scaX, t.scaY, t.scaZ);
         }
+    });
+
+    // the hierarchy's dirty flags are shared, so they are set from one thread
+    for (int i = 0; i < count; i++) {
+        MarkTransformDirty(m_transformIndices[i]);
     }
 
-    
+    SceneChange change(SCENE_OBJECTS_TRANSFORMED, 0);
+    change.IDs = IDs;
+    change.transforms = transforms;
+    PushSceneChange(change);
 }
 
-void Game::WidgetGeneration(int id)
+bool Game::SelectionPivot(const SelectionSet & selection, XMFLOAT3 & pivot)
 {
-    // generate widget at position
-    if (id != -1) {
-        m_displayList[0].m_render = true;
-        m_displayList[0].m_position = Vector3(m_displayList[id].m_position.x, m_displayList[id].m_position.y + 0.5, m_displayList[id].m_position.z);
-        m_displayList[0].m_orientation = m_displayList[id].m_orientation;
-
-        m_displayList[1].m_render = true;
-        m_displayList[1].m_position = Vector3(m_displayList[id].m_position.x, m_displayList[id].m_position.y + 0.5, m_displayList[id].m_position.z);
-        m_displayList[1].m_orientation = m_displayList[id].m_orientation;
+    UpdateTransforms();
+    XMVECTOR low = XMVectorReplicate(FLT_MAX), high = XMVectorReplicate(-FLT_MAX);
+    bool any = false;
+    for (size_t s = 0; s < selection.IDs().size(); s++) {
+        int index = m_displayIndex.Find(selection.IDs()[s]);
+        if (index != -1) {
+            XMVECTOR position = m_hierarchy.GetWorld(index).r[3];
+            low = XMVectorMin(low, position);
+            high = XMVectorMax(high, position);
+            any = true;
+        }
+    }
+    if (any) {
+        XMStoreFloat3(&pivot, (low + high) * 0.5f);
+    }
+    return any;
+}
 
-        m_displayList[2].m_render = true;
-        m_displayList[2].m_position = Vector3(m_displayList[id].m_position.x, m_displayList[id].m_position.y, m_displayList[id].m_position.z - 0.5);
-        m_displayList[2].m_orientation = m_displayList[id].m_orientation;
+void Game::PlaceGizmo(const SelectionSet & selection)
+{
+    // the selection is IDs, so it survives deletes. if everything in it has gone the gizmo just hides
+    XMFLOAT3 pivot;
+    if (SelectionPivot(selection, pivot)) {
+        m_gizmo.Place(pivot);
     }
     else {
-        m_displayList[0].m_render = false;
-        m_displayList[0].m_position = Vector3(100, 100, 100);
+        m_gizmo.Hide();
+    }
 
-        m_displayList[1].m_render = false;
-        m_displayList[1].m_position = Vector3(100, 100, 100);
+    // the same number of pixels on screen however far away it is
+    m_gizmo.FitToScreen(camera.m_camPosition, camera.m_camLookDirection, m_projection._22, (float)m_ScreenDimensions.bottom);
+}
+
+bool Game::BeginGizmoDrag()
+{
+    XMVECTOR origin, direction;
+    MouseRay(origin, direction);
+    XMFLOAT3 rayOrigin, rayDirection;
+    XMStoreFloat3(&rayOrigin, origin);
+    XMStoreFloat3(&rayDirection, direction);
+
+    float distance;
+    return m_gizmo.BeginDrag(m_gizmo.Pick(rayOrigin, rayDirection, distance), rayOrigin, rayDirection);
+}
 
-        m_displayList[2].m_render = false;
-        m_displayList[2].m_position = Vector3(100, 100, 100);
+void Game::GizmoDrag(const SelectionSet & selection)
+{
+    XMVECTOR origin, direction;
+    MouseRay(origin, direction);
+    XMFLOAT3 rayOrigin, rayDirection, translation;
+    XMStoreFloat3(&rayOrigin, origin);
+    XMStoreFloat3(&rayDirection, direction);
+
+    if (m_gizmo.Drag(rayOrigin, rayDirection, translation) && (translation.x != 0.0f || translation.y != 0.0f || translation.z != 0.0f)) {
+        TransformObjects(selection, SelectionTransform::Translate(translation));
     }
 }
 
+void Game::BeginPlacement()
+{
+    m_strokeFirstID = m_nextObjectID;
+    m_strokePlaced = false;
+}
+
 void Game::ObjectPlacement()
 {
-    //setup near and far planes of frustum with mouse X and mouse y passed down from Toolmain. 
-    const XMVECTOR nearSource = XMVectorSet(m_InputCommands.mouse_X, m_InputCommands.mouse_Y, 0.0f, 1.0f);
-    const XMVECTOR farSource = XMVectorSet(m_InputCommands.mouse_X, m_InputCommands.mouse_Y, 1.0f, 1.0f);
+    XMVECTOR origin, direction;
+    MouseRay(origin, direction);
 
-    //convert to wordspace points
-    XMVECTOR nearPoint = XMVector3Unproject(nearSource, 0.0f, 0.0f, m_ScreenDimensions.right, m_ScreenDimensions.bottom, m_deviceResources->GetScreenViewport().MinDepth, m_deviceResources->GetScreenViewport().MaxDepth, m_projection, m_view, m_world);
-    XMVECTOR farPoint = XMVector3Unproject(farSource, 0.0f, 0.0f, m_ScreenDimensions.right, m_ScreenDimensions.bottom, m_deviceResources->GetScreenViewport().MinDepth, m_deviceResources->GetScreenViewport().MaxDepth, m_projection, m_view, m_world);
+    Vector3 point, normal;
+    if (!SurfaceRaycast(origin, direction, m_strokeFirstID, point, normal))
+    {
+        //nothing under the cursor, the first object of a stroke goes 10 units along the ray as it always has
+        if (m_strokePlaced)
+            return;
+        point = origin + direction * 10;
+        normal = Vector3::UnitY;
+    }
 
-    //get mouse cast vector
-    XMVECTOR mouseCast = farPoint - nearPoint;
-    mouseCast = XMVector3Normalize(mouseCast);
+    //painting - wait until the cursor has moved on from the last object before placing another
+    const float brushRadius = 20.0f;
+    const float spacing = m_scatterBrush ? brushRadius : 2.0f;
+    if (m_strokePlaced && Vector3::DistanceSquared(point, m_lastPlacement) < spacing * spacing)
+        return;
 
-    Vector3 newObjPos = nearPoint + mouseCast * 10;
+    if (m_scatterBrush)
+    {
+        ScatterObjects(point.x, point.z, brushRadius);
+        m_lastPlacement = point;
+        m_strokePlaced = true;
+        return;
+    }
 
-    ObjectGeneration(newObjPos);
+    Vector3 orientation = Vector3::Zero;
+    if (m_alignToSurface)
+    {
+        //roll then pitch takes the up axis onto the normal, in the degrees the display objects are kept in
+        orientation.x = XMConvertToDegrees(atan2f(normal.z, normal.y));
+        orientation.z = XMConvertToDegrees(asinf(std::min(std::max(-normal.x, -1.0f), 1.0f)));
+    }
 
+    ObjectGeneration(point, orientation);
+    m_lastPlacement = point;
+    m_strokePlaced = true;
 }
 
-void Game::ObjectGeneration(Vector3 pos)
+void Game::ObjectGeneration(Vector3 pos, Vector3 orientation)
 {
-    auto device = m_deviceResources->GetD3DDevice();
-    auto devicecontext = m_deviceResources->GetD3DDeviceContext();
-	
-    //create a temp display object that we will populate then append to the display list.
-    DisplayObject newDisplayObject;
-    HRESULT rs;
-
-    //load model
-    newDisplayObject.m_model = Model::CreateFromCMO(device, L"database/data/placeholder.cmo", *m_fxFactory, true);//convect string to Wchar
-    CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"database/data/placeholder.dds", nullptr, &newDisplayObject.m_texture_diffuse);
-
-    //apply new texture to models effect
-    newDisplayObject.m_model->UpdateEffects([&](IEffect* effect)
-        {
-            auto lights = dynamic_cast<BasicEffect*>(effect);
-            if (lights)
-            {
-                lights->SetTexture(newDisplayObject.m_texture_diffuse);
-            }
-        });
-
-    //set position
-    newDisplayObject.m_position = pos;
-
-    //setorientation
-    newDisplayObject.m_orientation.x = 0;
-    newDisplayObject.m_orientation.y = 0;
-    newDisplayObject.m_orientation.z = 0;
+    //describe the new object as a scene row, so the renderer and the scene model are built from the same data
+    SceneChange change(SCENE_OBJECT_ADDED, m_nextObjectID++);
+    change.object.model_path = m_placementModel;
+    change.object.tex_diffuse_path = m_placementTexture;
+    change.object.posX = pos.x;
+    change.object.posY = pos.y;
+    change.object.posZ = pos.z;
+    change.object.rotX = orientation.x;
+    change.object.rotY = orientation.y;
+    change.object.rotZ = orientation.z;
+    change.object.scaX = 1;
+    change.object.scaY = 1;
+    change.object.scaZ = 1;
+    change.object.name = "Name";
+
+    AddDisplayObject(CreateDisplayObject(change.object));
+
+    PushSceneChange(change);
+}
 
-    //set scale
-    newDisplayObject.m_scale.x = 1;
-    newDisplayObject.m_scale.y = 1;
-    newDisplayObject.m_scale.z = 1;
+void Game::ScatterObjects(float centreX, float centreZ, float radius)
+{
+    //keep clear of everything already in the world
+    UpdateTransforms();
+    std::vector<XMFLOAT3> avoid;
+    avoid.reserve(m_displayList.size());
+    for (int i = 0; i < (int)m_displayList.size(); i++)
+    {
+        XMFLOAT3 position;
+        XMStoreFloat3(&position, m_hierarchy.GetWorld(i).r[3]);
+        avoid.push_back(position);
+    }
 
-    //set wireframe / render flags
-    newDisplayObject.m_render = true;
-    
+    //a different pattern for every scatter, but the same one for the same history of edits
+    ScatterSettings settings = m_scatterSettings;
+    settings.seed += m_nextObjectID;
+    std::vector<ScatterInstance> instances;
+    Scatter::Generate(m_terrainQuery, settings, centreX, centreZ, radius, avoid, instances);
+    if (instances.empty())
+        return;
 
-    m_displayList.push_back(newDisplayObject);
+    //one batch - the display objects are copies of one template, and the scene model gets a single change for all of them
+    SceneChange change(SCENE_OBJECTS_ADDED, m_nextObjectID);
+    change.object.model_path = m_placementModel;
+    change.object.tex_diffuse_path = m_placementTexture;
+    change.object.scaX = 1;
+    change.object.scaY = 1;
+    change.object.scaZ = 1;
+    change.object.snapToGround = true;
+    change.object.name = "Name";
+
+    std::shared_ptr<std::vector<TransformComponent>> transforms = std::make_shared<std::vector<TransformComponent>>(instances.size());
+    DisplayObject displayObject = CreateDisplayObject(change.object);
+    m_displayList.reserve(m_displayList.size() + instances.size());
+    for (size_t k = 0; k < instances.size(); k++)
+    {
+        const ScatterInstance & instance = instances[k];
+        TransformComponent & transform = (*transforms)[k];
+        transform.posX = instance.position.x;	transform.posY = instance.position.y;	transform.posZ = instance.position.z;
+        transform.rotX = 0.0f;					transform.rotY = instance.yaw;			transform.rotZ = 0.0f;
+        transform.scaX = instance.scale;		transform.scaY = instance.scale;		transform.scaZ = instance.scale;
+        transform.pivotX = 0.0f;				transform.pivotY = 0.0f;				transform.pivotZ = 0.0f;
+
+        displayObject.m_ID = m_nextObjectID++;
+        displayObject.m_position = Vector3(instance.position.x, instance.position.y, instance.position.z);
+        displayObject.m_orientation = Vector3(0.0f, instance.yaw, 0.0f);
+        displayObject.m_scale = Vector3(instance.scale, instance.scale, instance.scale);
+        m_displayIndex.Insert(displayObject.m_ID, (int)m_displayList.size());
+        m_displayList.push_back(displayObject);
+    }
+    m_hierarchyStale = true;
 
-	
+    change.transforms = transforms;
+    PushSceneChange(change);
 }
 
 void Game::TerrainEdit()
 {
+    StopErosion();		//it would paint over the sculpt with its own copy of the terrain, what it did goes in with the stroke
     Vector3 IntersectionPoint = TerrainInfo();
+    int minI = TERRAINRESOLUTION, minJ = TERRAINRESOLUTION, maxI = -1, maxJ = -1;
 
     //loop through vertices and check if they are within a certain radius of the intersection point
     for (int i = 0; i < 128; i++)
@@ -443,12 +679,18 @@ void Game::TerrainEdit()
                 else if (m_displayChunk.m_terrainGeometry[i][j].position.y > 64)
                     m_displayChunk.m_terrainGeometry[i][j].position.y = 64;
 
-                
-
+                minI = std::min(minI, i);
+                maxI = std::max(maxI, i);
+                minJ = std::min(minJ, j);
+                maxJ = std::max(maxJ, j);
             }
         }
     }
 
+    if (maxI >= 0)
+    {
+        m_terrainHistory.Touch(minJ, minI, maxJ + 1, maxI + 1);
+    }
     RecalcuateTerrainNormals();
     
 }
@@ -553,36 +795,19 @@ void Game::Render()
 	WCHAR   Buffer[256];
 	std::wstring var = L"Cam X: " + std::to_wstring(camera.m_camPosition.x) + L"Cam Z: " + std::to_wstring(camera.m_camPosition.z);
 	m_font->DrawString(m_sprites.get(), var.c_str() , XMFLOAT2(100, 10), Colors::Yellow);
+	std::wstring draws = L"Draws: " + std::to_wstring(m_renderItems.size()) + L" State changes: " + std::to_wstring(m_renderChangesSorted.Total())
+		+ L" (" + std::to_wstring(m_renderChanges.Total() - m_renderChangesSorted.Total()) + L" saved by sorting)";
+	m_font->DrawString(m_sprites.get(), draws.c_str(), XMFLOAT2(100, 40), Colors::Yellow);
 	m_sprites->End();
 
     
 
 	//RENDER OBJECTS FROM SCENEGRAPH
-	int numRenderObjects = m_displayList.size();
-	for (int i = 0; i < numRenderObjects; i++)
-	{
-		m_deviceResources->PIXBeginEvent(L"Draw model");
-		const XMVECTORF32 scale = { m_displayList[i].m_scale.x, m_displayList[i].m_scale.y, m_displayList[i].m_scale.z };
-		const XMVECTORF32 translate = { m_displayList[i].m_position.x, m_displayList[i].m_position.y, m_displayList[i].m_position.z };
-
-		//convert degrees into radians for rotation matrix
-		XMVECTOR rotate = Quaternion::CreateFromYawPitchRoll(m_displayList[i].m_orientation.y *3.1415 / 180,
-															m_displayList[i].m_orientation.x *3.1415 / 180,
-															m_displayList[i].m_orientation.z *3.1415 / 180);
-
-		XMMATRIX local = m_world * XMMatrixTransformation(g_XMZero, Quaternion::Identity, scale, g_XMZero, rotate, translate);
-
-        if (i != 0 && i != 1 && i != 2) {
-            m_displayList[i].m_model->Draw(context, *m_states, local, m_view, m_projection, wireframeMode);	//last variable in draw,  make TRUE for wireframe
-        }
-        else {
-            m_displayList[i].m_model->Draw(context, *m_states, local, m_view, m_projection, false);	//last variable in draw,  make TRUE for wireframe
-        }
-		
-		
-
-		m_deviceResources->PIXEndEvent();
-	}
+	UpdateTransforms();
+	m_deviceResources->PIXBeginEvent(L"Draw models");
+	QueueDisplayList();
+	SubmitRenderQueue();
+	m_deviceResources->PIXEndEvent();
     m_deviceResources->PIXEndEvent();
 
 	//RENDER TERRAIN
@@ -595,33 +820,508 @@ void Game::Render()
 	//Render the batch,  This is handled in the Display chunk becuase it has the potential to get complex
 	m_displayChunk.RenderBatch(m_deviceResources);
 
+	//overlays, drawn over the scene without depth
+	if (m_gizmo.IsVisible())
+		DrawGizmo();
+
+	if (m_marqueeShown)
+		DrawMarquee();
+
     m_deviceResources->Present();
 }
 
 void Game::RecalcuateTerrainNormals()
 {
-    // recalculate normals (this is only done when the user lets go of the key when terrain editting
-	// this is very resource intensive to do every frame
+    // recalculate normals, cheap enough to do on every sculpting frame
     m_displayChunk.CalculateTerrainNormals();	
 }
 
+void Game::GenerateTerrain()
+{
+	StopErosion();
+	m_displayChunk.GenerateHeightmap(m_heightmapSettings);
+	m_heightmapSettings.seed++;
+	m_terrainHistory.TouchAll();
+	EndTerrainStroke();
+	SnapToGround();
+}
+
+void Game::ErodeTerrain()
+{
+	EndTerrainStroke();
+	std::vector<float> heights;
+	GetTerrainHeights(heights);
+	float spacing = m_displayChunk.m_terrainGeometry[0][1].position.x - m_displayChunk.m_terrainGeometry[0][0].position.x;
+	m_erosion.Begin(heights.data(), TERRAINRESOLUTION, spacing, m_erosionSettings);
+	m_erosionSettings.seed++;
+}
+
+void Game::StepErosion()
+{
+	bool running = m_erosion.Step();
+	const float * heights = m_erosion.Heights();
+	for (int i = 0; i < TERRAINRESOLUTION; i++)
+	{
+		for (int j = 0; j < TERRAINRESOLUTION; j++)
+		{
+			m_displayChunk.m_terrainGeometry[i][j].position.y = heights[i * TERRAINRESOLUTION + j];
+		}
+	}
+	m_displayChunk.CalculateTerrainNormals();
+
+	if (!running)
+	{
+		m_terrainHistory.TouchAll();
+		EndTerrainStroke();
+		SnapToGround();
+	}
+}
+
+void Game::StopErosion()
+{
+	if (m_erosion.IsRunning())
+	{
+		m_erosion.Stop();
+		m_terrainHistory.TouchAll();
+	}
+}
+
+void Game::EndTerrainStroke()
+{
+	StopErosion();
+	std::vector<float> heights;
+	GetTerrainHeights(heights);
+	if (m_terrainHistory.Commit(heights.data()))
+	{
+		//so the stroke takes its place in the scene journal, next to the objects that snap to it
+		PushSceneChange(SceneChange(SCENE_TERRAIN_CHANGED, 0));
+	}
+}
+
+void Game::UndoTerrain()
+{
+	std::vector<float> heights(TERRAINRESOLUTION * TERRAINRESOLUTION);
+	if (m_terrainHistory.Undo(heights.data()))
+	{
+		ApplyTerrainHistory(heights);
+	}
+}
+
+void Game::RedoTerrain()
+{
+	std::vector<float> heights(TERRAINRESOLUTION * TERRAINRESOLUTION);
+	if (m_terrainHistory.Redo(heights.data()))
+	{
+		ApplyTerrainHistory(heights);
+	}
+}
+
+void Game::ApplyTerrainHistory(const std::vector<float> & heights)
+{
+	const std::vector<int> & tiles = m_terrainHistory.Changed();
+	for (size_t k = 0; k < tiles.size(); k++)
+	{
+		int x0, z0, x1, z1;
+		m_terrainHistory.TileRect(tiles[k], x0, z0, x1, z1);
+		for (int i = z0; i < z1; i++)
+		{
+			for (int j = x0; j < x1; j++)
+			{
+				m_displayChunk.m_terrainGeometry[i][j].position.y = heights[i * TERRAINRESOLUTION + j];
+			}
+		}
+	}
+	m_displayChunk.CalculateTerrainNormals();
+	RefreshTerrainQuery();
+}
+
+void Game::GetTerrainHeights(std::vector<float> & heights)
+{
+	heights.resize(TERRAINRESOLUTION * TERRAINRESOLUTION);
+	for (int i = 0; i < TERRAINRESOLUTION; i++)
+	{
+		for (int j = 0; j < TERRAINRESOLUTION; j++)
+		{
+			heights[i * TERRAINRESOLUTION + j] = m_displayChunk.m_terrainGeometry[i][j].position.y;
+		}
+	}
+}
+
+void Game::RefreshTerrainQuery()
+{
+	std::vector<float> heights;
+	GetTerrainHeights(heights);
+
+	const XMFLOAT3 & origin = m_displayChunk.m_terrainGeometry[0][0].position;
+	float spacing = m_displayChunk.m_terrainGeometry[0][1].position.x - origin.x;
+	m_terrainQuery.Build(heights.data(), TERRAINRESOLUTION, origin.x, origin.z, spacing);
+}
+
+void Game::SnapToGround()
+{
+	RefreshTerrainQuery();
+
+	//only roots - a child's position is relative to its parent, not to the terrain
+	std::vector<int> indices;
+	std::vector<float> x, z;
+	for (int i = 0; i < (int)m_displayList.size(); i++)
+	{
+		if (m_displayList[i].m_snapToGround && m_displayList[i].m_parentID == 0)
+		{
+			indices.push_back(i);
+			x.push_back(m_displayList[i].m_position.x);
+			z.push_back(m_displayList[i].m_position.z);
+		}
+	}
+
+	std::vector<float> heights(indices.size());
+	ParallelFor((int)indices.size(), 4096, [&](int begin, int end)
+	{
+		m_terrainQuery.GetHeights(&x[begin], &z[begin], &heights[begin], end - begin);
+	});
+
+	//only the objects the sculpt actually moved become scene changes
+	for (size_t k = 0; k < indices.size(); k++)
+	{
+		DisplayObject & displayObject = m_displayList[indices[k]];
+		if (displayObject.m_position.y != heights[k])
+		{
+			displayObject.m_position.y = heights[k];
+			MarkTransformDirty(indices[k]);
+			PushTransformChange(indices[k]);
+		}
+	}
+}
+
+void Game::MouseRay(XMVECTOR & origin, XMVECTOR & direction)
+{
+	//setup near and far planes of frustum with mouse X and mouse y passed down from Toolmain.
+	const XMVECTOR nearSource = XMVectorSet(m_InputCommands.mouse_X, m_InputCommands.mouse_Y, 0.0f, 1.0f);
+	const XMVECTOR farSource = XMVectorSet(m_InputCommands.mouse_X, m_InputCommands.mouse_Y, 1.0f, 1.0f);
+
+	//convert to wordspace points
+	XMVECTOR nearPoint = XMVector3Unproject(nearSource, 0.0f, 0.0f, m_ScreenDimensions.right, m_ScreenDimensions.bottom, m_deviceResources->GetScreenViewport().MinDepth, m_deviceResources->GetScreenViewport().MaxDepth, m_projection, m_view, m_world);
+	XMVECTOR farPoint = XMVector3Unproject(farSource, 0.0f, 0.0f, m_ScreenDimensions.right, m_ScreenDimensions.bottom, m_deviceResources->GetScreenViewport().MinDepth, m_deviceResources->GetScreenViewport().MaxDepth, m_projection, m_view, m_world);
+
+	origin = nearPoint;
+	direction = XMVector3Normalize(farPoint - nearPoint);
+}
+
+bool Game::SurfaceRaycast(FXMVECTOR origin, FXMVECTOR direction, int ignoreFromID, Vector3 & point, Vector3 & normal)
+{
+	const float maxDistance = 1000.0f;		//the far plane
+	float nearest = maxDistance;
+	bool hit = false;
+
+	XMFLOAT3 rayOrigin, rayDirection;
+	XMStoreFloat3(&rayOrigin, origin);
+	XMStoreFloat3(&rayDirection, direction);
+	float distance;
+	if (m_terrainQuery.Raycast(rayOrigin, rayDirection, maxDistance, distance))
+	{
+		nearest = distance;
+		point = origin + direction * distance;
+		normal = m_terrainQuery.GetNormal(point.x, point.z);
+		hit = true;
+	}
+
+	UpdateTransforms();
+	for (int i = 0; i < (int)m_displayList.size(); i++)
+	{
+		if (m_displayList[i].m_ID >= ignoreFromID)
+			continue;
+
+		XMVECTOR objectNormal;
+		if (RaycastObject(i, origin, direction, nearest, distance, objectNormal))
+		{
+			nearest = distance;
+			point = origin + direction * distance;
+			normal = objectNormal;
+			hit = true;
+		}
+	}
+
+	return hit;
+}
+
+bool Game::RaycastObject(int index, FXMVECTOR origin, FXMVECTOR direction, float maxDistance, float & distance, XMVECTOR & normal)
+{
+	//in the object's own space, so the boxes stay axis aligned and the triangles need no transforming
+	const DisplayObject & object = m_displayList[index];
+	XMMATRIX world = m_world * m_hierarchy.GetWorld(index);
+	XMMATRIX inverse = XMMatrixInverse(nullptr, world);
+	XMVECTOR localOrigin = XMVector3TransformCoord(origin, inverse);
+	XMVECTOR localDirection = XMVector3TransformNormal(direction, inverse);
+	float localScale = XMVectorGetX(XMVector3Length(localDirection));	//local distance per unit of world distance
+	XMVECTOR unitDirection = localDirection / localScale;
+
+	//the boxes first, most objects are nowhere near the ray
+	const BoundingBox * nearestBox = NULL;
+	float boxDistance = maxDistance;
+	for (size_t y = 0; y < object.m_model->meshes.size(); y++)
+	{
+		const BoundingBox & box = object.m_model->meshes[y]->boundingBox;
+		float localDistance;
+		if (box.Intersects(localOrigin, unitDirection, localDistance) && localDistance > 0.0f && localDistance / localScale < boxDistance)
+		{
+			boxDistance = localDistance / localScale;
+			nearestBox = &box;
+		}
+	}
+	bool inside = false;		//a ray starting in a box can still hit the triangles around it
+	for (size_t y = 0; y < object.m_model->meshes.size() && !nearestBox && !inside; y++)
+	{
+		inside = object.m_model->meshes[y]->boundingBox.Contains(localOrigin) != DISJOINT;
+	}
+	if (!nearestBox && !inside)
+		return false;
+
+	//then the triangles. the direction is left at world length so the distance comes back in world units
+	std::shared_ptr<const MeshBvh> bvh = m_assetCache.GetBvh(object.m_model_path);
+	if (bvh && !bvh->IsEmpty())
+	{
+		XMFLOAT3 rayOrigin, rayDirection;
+		XMStoreFloat3(&rayOrigin, localOrigin);
+		XMStoreFloat3(&rayDirection, localDirection);
+		int triangle;
+		if (!bvh->Raycast(rayOrigin, rayDirection, maxDistance, distance, triangle))
+			return false;
+		XMFLOAT3 localNormal = bvh->GetNormal(triangle);
+		normal = XMVector3TransformNormal(XMLoadFloat3(&localNormal), XMMatrixTranspose(inverse));
+		normal = XMVector3Normalize(normal * (XMVectorGetX(XMVector3Dot(normal, direction)) > 0.0f ? -1.0f : 1.0f));	//facing back along the ray
+		return true;
+	}
+	if (!nearestBox)
+		return false;
+
+	//the face that was hit is the axis the point is furthest out along, relative to the box size
+	distance = boxDistance;
+	XMFLOAT3 offset;
+	XMStoreFloat3(&offset, (localOrigin + unitDirection * boxDistance * localScale - XMLoadFloat3(&nearestBox->Center)) / XMLoadFloat3(&nearestBox->Extents));
+	XMVECTOR localNormal;
+	if (fabsf(offset.x) >= fabsf(offset.y) && fabsf(offset.x) >= fabsf(offset.z))
+		localNormal = XMVectorSet(offset.x < 0 ? -1.0f : 1.0f, 0.0f, 0.0f, 0.0f);
+	else if (fabsf(offset.y) >= fabsf(offset.z))
+		localNormal = XMVectorSet(0.0f, offset.y < 0 ? -1.0f : 1.0f, 0.0f, 0.0f);
+	else
+		localNormal = XMVectorSet(0.0f, 0.0f, offset.z < 0 ? -1.0f : 1.0f, 0.0f);
+	normal = XMVector3Normalize(XMVector3TransformNormal(localNormal, XMMatrixTranspose(inverse)));
+	return true;
+}
+
 void Game::ResetTexture(int id)
 {
-    if (id != -1) {
+    int index = m_displayIndex.Find(id);
+    if (index != -1) {
+        SetDisplayTexture(index, StringTable::AssetPaths().Intern("database/data/placeholder.dds"));
+    }
+}
+
+void Game::SetDisplayTexture(int index, StringHandle path)
+{
+    LoadDisplayTexture(m_displayList[index], path);
 
-        CreateDDSTextureFromFile(m_deviceResources->GetD3DDevice(), L"database/data/placeholder.dds", nullptr, &m_displayList[id].m_texture_diffuse);
+    SceneChange change(SCENE_OBJECT_RETEXTURED, m_displayList[index].m_ID);
+    change.object.tex_diffuse_path = path;
+    PushSceneChange(change);
+}
+
+void Game::LoadDisplayTexture(DisplayObject & displayObject, StringHandle path)
+{
+    //the texture is part of the model's effects, so a new texture means the shared model that already has it
+    displayObject.m_texture_diffuse = m_assetCache.GetTexture(path);
+    displayObject.m_model = m_assetCache.GetModel(displayObject.m_model_path, path);
+    displayObject.m_lods = m_assetCache.GetLods(displayObject.m_model_path, path);
+    displayObject.m_tex_diffuse_path = path;
+}
+
+Model & Game::LodModel(int index, FXMMATRIX world)
+{
+    DisplayObject & object = m_displayList[index];
+    object.m_lod = 0;
+    if (!object.m_lods || object.m_lods->models.empty() || object.m_model->meshes.empty())
+    {
+        return *object.m_model;
+    }
 
+    //how many pixels a unit of the model covers at the near side of its bounding sphere, all its meshes merged
+    BoundingSphere sphere = object.m_model->meshes[0]->boundingSphere;
+    for (size_t m = 1; m < object.m_model->meshes.size(); m++)
+    {
+        BoundingSphere merged;
+        BoundingSphere::CreateMerged(merged, sphere, object.m_model->meshes[m]->boundingSphere);
+        sphere = merged;
+    }
+    XMVECTOR centre = XMVector3Transform(XMLoadFloat3(&sphere.Center), world);
+    float scale = sqrtf(std::max(std::max(XMVectorGetX(XMVector3LengthSq(world.r[0])), XMVectorGetX(XMVector3LengthSq(world.r[1]))),
+        XMVectorGetX(XMVector3LengthSq(world.r[2]))));
+    float distance = XMVectorGetX(XMVector3Length(centre - XMLoadFloat3(&camera.m_camPosition))) - sphere.Radius * scale;
+    float pixels = m_projection._22 * 0.5f * m_deviceResources->GetOutputSize().bottom * scale / std::max(distance, 0.01f);
+
+    //the levels get coarser, so the first one that shows is the end
+    const ModelLods & lods = *object.m_lods;
+    while (object.m_lod < (int)lods.models.size() && lods.errors[object.m_lod] * pixels <= LOD_PIXEL_ERROR)
+    {
+        object.m_lod++;
+    }
+    return object.m_lod == 0 ? *object.m_model : *lods.models[object.m_lod - 1];
+}
 
-        //apply new texture to models effect
-        m_displayList[id].m_model->UpdateEffects([&](IEffect* effect)
+void Game::QueueDisplayList()
+{
+    m_renderQueue.Clear();
+    m_renderItems.clear();
+    XMVECTOR eye = XMLoadFloat3(&camera.m_camPosition);
+    XMVECTOR forward = XMVector3Normalize(XMLoadFloat3(&camera.m_camLookDirection));
+    for (int i = 0; i < (int)m_displayList.size(); i++)
+    {
+        XMMATRIX world = m_world * m_hierarchy.GetWorld(i);
+        const Model & model = LodModel(i, world);
+        float depth = XMVectorGetX(XMVector3Dot(world.r[3] - eye, forward));
+        uint32_t texture = m_renderQueue.StateID(RENDER_STATE_TEXTURE, m_displayList[i].m_texture_diffuse);
+        for (const auto & mesh : model.meshes)
+        {
+            for (const auto & part : mesh->meshParts)
             {
-                auto lights = dynamic_cast<BasicEffect*>(effect);
-                if (lights)
+                //the shader is the effect's class, along with the raster state the mesh wants
+                int pass = part->isAlpha ? RENDER_PASS_ALPHA : RENDER_PASS_OPAQUE;
+                uint32_t shader = m_renderQueue.StateID(RENDER_STATE_SHADER, &typeid(*part->effect)) << 2 | (wireframeMode ? 2 : mesh->ccw ? 0 : 1);
+                uint32_t meshID = m_renderQueue.StateID(RENDER_STATE_MESH, part->vertexBuffer.Get());
+                m_renderQueue.Add(RenderQueue::MakeKey(pass, RenderQueue::DepthBucket(depth, pass == RENDER_PASS_ALPHA), shader, texture, meshID),
+                    (uint32_t)m_renderItems.size());
+                RenderItem item = { mesh.get(), part.get(), i };
+                m_renderItems.push_back(item);
+            }
+        }
+    }
+}
+
+void Game::SubmitRenderQueue()
+{
+    m_renderChanges = DrawRenderQueue(false);
+    m_renderQueue.Sort();
+    m_renderChangesSorted = DrawRenderQueue(true);
+}
+
+RenderStateChanges Game::DrawRenderQueue(bool draw)
+{
+    //what ModelMesh::PrepareForRendering and ModelMeshPart::Draw would set for every part, set here only when it changes.
+    //a BasicEffect is applied once for a run of packets drawn with it, which binds its shaders, texture, material and
+    //lights, and ObjectVS takes the place of its vertex shader so that only the object's matrices change inside the run.
+    //any other effect carries the matrices in its own constants, and is applied for every packet
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    RenderStateChanges changes = { 0, 0, 0, 0 };
+    int states = -1;
+    const IEffect * effect = nullptr;
+    BasicEffect * basic = nullptr;
+    const ID3D11ShaderResourceView * texture = nullptr;
+    ID3D11InputLayout * layout = nullptr;
+    ID3D11Buffer * vertices = nullptr;
+    ID3D11Buffer * indices = nullptr;
+    D3D11_PRIMITIVE_TOPOLOGY topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+    for (const RenderPacket & packet : m_renderQueue.Packets())
+    {
+        const RenderItem & item = m_renderItems[packet.item];
+        const ModelMeshPart & part = *item.part;
+        bool alpha = RenderQueue::KeyPass(packet.key) == RENDER_PASS_ALPHA;
+        int raster = wireframeMode ? 2 : item.mesh->ccw ? 0 : 1;
+        int packetStates = (alpha ? (item.mesh->pmalpha ? 1 : 2) : 0) * 3 + raster;
+        if (packetStates != states)
+        {
+            changes.passes++;
+            if (draw)
+            {
+                if (states == -1)
                 {
-                    lights->SetTexture(m_displayList[id].m_texture_diffuse);
+                    ID3D11SamplerState * samplers[] = { m_states->LinearWrap(), m_states->LinearWrap() };
+                    context->PSSetSamplers(0, 2, samplers);
                 }
-            });
+                ID3D11BlendState * blend = !alpha ? m_states->Opaque() : item.mesh->pmalpha ? m_states->AlphaBlend() : m_states->NonPremultiplied();
+                context->OMSetBlendState(blend, nullptr, 0xFFFFFFFF);
+                context->OMSetDepthStencilState(alpha ? m_states->DepthRead() : m_states->DepthDefault(), 0);
+                context->RSSetState(raster == 2 ? m_states->Wireframe() : raster == 0 ? m_states->CullCounterClockwise() : m_states->CullClockwise());
+            }
+            states = packetStates;
+        }
+
+        XMMATRIX world = m_world * m_hierarchy.GetWorld(item.object);
+        if (part.effect.get() != effect || !basic)
+        {
+            //the effect binds the texture it was given, the display object's
+            effect = part.effect.get();
+            basic = dynamic_cast<BasicEffect *>(part.effect.get());
+            changes.shaders++;
+            changes.textures += m_displayList[item.object].m_texture_diffuse != texture;
+            texture = m_displayList[item.object].m_texture_diffuse;
+            if (draw)
+            {
+                IEffectMatrices * matrices = dynamic_cast<IEffectMatrices *>(part.effect.get());
+                if (matrices)
+                {
+                    matrices->SetMatrices(world, m_view, m_projection);
+                }
+                part.effect->Apply(context);
+                if (basic)
+                {
+                    context->VSSetShader(m_objectShader.Get(), nullptr, 0);
+                    context->VSSetConstantBuffers(1, 1, m_objectMatrices.GetAddressOf());
+                }
+            }
+        }
+        if (draw && basic)
+        {
+            D3D11_MAPPED_SUBRESOURCE mapped;
+            DX::ThrowIfFailed(context->Map(m_objectMatrices.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+            ObjectMatrices * constants = static_cast<ObjectMatrices *>(mapped.pData);
+            XMMATRIX worldInverse = XMMatrixInverse(nullptr, world);
+            constants->world = XMMatrixTranspose(world);
+            constants->worldInverseTranspose[0] = worldInverse.r[0];
+            constants->worldInverseTranspose[1] = worldInverse.r[1];
+            constants->worldInverseTranspose[2] = worldInverse.r[2];
+            constants->worldViewProj = XMMatrixTranspose(world * m_view * m_projection);
+            context->Unmap(m_objectMatrices.Get(), 0);
+        }
+
+        if (part.inputLayout.Get() != layout)
+        {
+            layout = part.inputLayout.Get();
+            if (draw)
+            {
+                context->IASetInputLayout(layout);
+            }
+        }
+        if (part.vertexBuffer.Get() != vertices)
+        {
+            vertices = part.vertexBuffer.Get();
+            changes.meshes++;
+            if (draw)
+            {
+                UINT stride = part.vertexStride, offset = 0;
+                context->IASetVertexBuffers(0, 1, &vertices, &stride, &offset);
+            }
+        }
+        if (part.indexBuffer.Get() != indices)
+        {
+            indices = part.indexBuffer.Get();
+            if (draw)
+            {
+                context->IASetIndexBuffer(indices, part.indexFormat, 0);
+            }
+        }
+        if (part.primitiveType != topology)
+        {
+            topology = part.primitiveType;
+            if (draw)
+            {
+                context->IASetPrimitiveTopology(topology);
+            }
+        }
+        if (draw)
+        {
+            context->DrawIndexed(part.indexCount, part.startIndex, part.vertexOffset);
+        }
     }
+    return changes;
 }
 
 // Helper method to clear the back buffers.
@@ -645,6 +1345,101 @@ void Game::Clear()
     m_deviceResources->PIXEndEvent();
 }
 
+void Game::DrawMarquee()
+{
+    m_deviceResources->PIXBeginEvent(L"Draw marquee");
+
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    context->OMSetBlendState(m_states->Opaque(), nullptr, 0xFFFFFFFF);
+    context->OMSetDepthStencilState(m_states->DepthNone(), 0);
+    context->RSSetState(m_states->CullNone());
+
+    //drawn straight in normalised device coordinates, the effect goes back to the camera after
+    m_batchEffect->SetView(Matrix::Identity);
+    m_batchEffect->SetProjection(Matrix::Identity);
+    m_batchEffect->Apply(context);
+    context->IASetInputLayout(m_batchInputLayout.Get());
+
+    float width = (float)m_ScreenDimensions.right, height = (float)m_ScreenDimensions.bottom;
+    float left = 2.0f * m_marquee.left / width - 1.0f, right = 2.0f * m_marquee.right / width - 1.0f;
+    float top = 1.0f - 2.0f * m_marquee.top / height, bottom = 1.0f - 2.0f * m_marquee.bottom / height;
+    VertexPositionColor corners[4] = {
+        VertexPositionColor(Vector3(left, top, 0.0f), Colors::Yellow), VertexPositionColor(Vector3(right, top, 0.0f), Colors::Yellow),
+        VertexPositionColor(Vector3(right, bottom, 0.0f), Colors::Yellow), VertexPositionColor(Vector3(left, bottom, 0.0f), Colors::Yellow) };
+
+    m_batch->Begin();
+    for (int i = 0; i < 4; i++)
+    {
+        m_batch->DrawLine(corners[i], corners[(i + 1) % 4]);
+    }
+    m_batch->End();
+
+    m_batchEffect->SetView(m_view);
+    m_batchEffect->SetProjection(m_projection);
+
+    m_deviceResources->PIXEndEvent();
+}
+
+void Game::DrawGizmo()
+{
+    m_deviceResources->PIXBeginEvent(L"Draw gizmo");
+
+    auto context = m_deviceResources->GetD3DDeviceContext();
+    context->OMSetBlendState(m_states->Opaque(), nullptr, 0xFFFFFFFF);
+    context->OMSetDepthStencilState(m_states->DepthNone(), 0);
+    context->RSSetState(m_states->CullNone());
+
+    m_batchEffect->Apply(context);
+    context->IASetInputLayout(m_batchInputLayout.Get());
+
+    // the handle being dragged, or else the one under the cursor, is drawn yellow
+    GizmoHandle highlighted = m_gizmo.GetDragging();
+    if (highlighted == GIZMO_NONE) {
+        XMVECTOR origin, direction;
+        MouseRay(origin, direction);
+        XMFLOAT3 rayOrigin, rayDirection;
+        XMStoreFloat3(&rayOrigin, origin);
+        XMStoreFloat3(&rayDirection, direction);
+        float distance;
+        highlighted = m_gizmo.Pick(rayOrigin, rayDirection, distance);
+    }
+
+    const Vector3 axes[3] = { Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ };
+    const XMVECTORF32 colours[3] = { Colors::Red, Colors::Lime, Colors::Blue };
+    const int ARROW_SIDES = 8;
+    float scale = m_gizmo.GetScale();
+
+    m_batch->Begin();
+    for (int axis = 0; axis < 3; axis++)
+    {
+        XMVECTOR colour = highlighted == GIZMO_X + axis ? Colors::Yellow : colours[axis];
+        XMFLOAT3 start, end;
+        m_gizmo.GetAxis(axis, start, end);
+        m_batch->DrawLine(VertexPositionColor(Vector3(start), colour), VertexPositionColor(Vector3(end), colour));
+
+        // a cone on the end of the shaft
+        Vector3 tip(end), u = axes[(axis + 1) % 3] * scale * 0.05f, v = axes[(axis + 2) % 3] * scale * 0.05f;
+        Vector3 base = tip - axes[axis] * scale * 0.2f;
+        for (int side = 0; side < ARROW_SIDES; side++)
+        {
+            float a0 = XM_2PI * side / ARROW_SIDES, a1 = XM_2PI * (side + 1) / ARROW_SIDES;
+            m_batch->DrawTriangle(VertexPositionColor(tip, colour),
+                VertexPositionColor(base + u * cosf(a0) + v * sinf(a0), colour),
+                VertexPositionColor(base + u * cosf(a1) + v * sinf(a1), colour));
+        }
+
+        // the plane handle that keeps this axis still, in its colour
+        colour = highlighted == GIZMO_YZ + axis ? Colors::Yellow : colours[axis];
+        XMFLOAT3 corners[4];
+        m_gizmo.GetPlane(axis, corners);
+        m_batch->DrawQuad(VertexPositionColor(Vector3(corners[0]), colour), VertexPositionColor(Vector3(corners[1]), colour),
+            VertexPositionColor(Vector3(corners[2]), colour), VertexPositionColor(Vector3(corners[3]), colour));
+    }
+    m_batch->End();
+
+    m_deviceResources->PIXEndEvent();
+}
+
 void XM_CALLCONV Game::DrawGrid(FXMVECTOR xAxis, FXMVECTOR yAxis, FXMVECTOR origin, size_t xdivs, size_t ydivs, GXMVECTOR color)
 {
     m_deviceResources->PIXBeginEvent(L"Draw grid");
@@ -727,179 +1522,245 @@ void Game::OnWindowSizeChanged(int width, int height)
     CreateWindowSizeDependentResources();
 }
 
-void Game::BuildDisplayList(std::vector<SceneObject> * SceneGraph)
+void Game::BuildDisplayList(const Scene & SceneGraph)
 {
-	auto device = m_deviceResources->GetD3DDevice();
-	auto devicecontext = m_deviceResources->GetD3DDeviceContext();
-
 	if (!m_displayList.empty())		//is the vector empty
 	{
 		m_displayList.clear();		//if not, empty it
 	}
 
-    // add 3 objects at the front of the displayList for the gizmo
-    for (int i = 0; i < 3; i++) {
-        //create a temp display object that we will populate then append to the display list.
-        DisplayObject newDisplayObject;
-        HRESULT rs;
-        
+	//for every item in the scenegraph
+	int numObjects = SceneGraph.Size();
+	m_nextObjectID = 1;
+	for (int i = 0; i < numObjects; i++)
+	{
+		m_displayList.push_back(CreateDisplayObject(SceneGraph.GetRow(i)));
+		m_nextObjectID = std::max(m_nextObjectID, SceneGraph.GetID(i) + 1);
+	}
 
-        if (i == 0) {
-            //load model - the first model in the scene is the gizmo
-            newDisplayObject.m_model = Model::CreateFromCMO(device, L"forward.cmo", *m_fxFactory, true);	//get DXSDK to load model "False" for LH coordinate system (maya)
+	RebuildDisplayIndex();
+	m_sceneChanges.clear();
+}
 
-            //Load Texture
-            //rs = CreateDDSTextureFromFile(device, L"gizmo.dds", nullptr, &newDisplayObject.m_texture_diffuse);	//load tex into Shader resource
+DisplayObject Game::CreateDisplayObject(const SceneObject & object)
+{
+	//create a temp display object that we will populate then append to the display list.
+	DisplayObject newDisplayObject;
+	newDisplayObject.m_ID = object.ID;
+	newDisplayObject.m_parentID = object.parent_id;
+
+	//model and texture come from the cache, only the first object to use a pair loads it from disk
+	newDisplayObject.m_model_path = object.model_path;
+	LoadDisplayTexture(newDisplayObject, object.tex_diffuse_path);
+
+	//set position
+	newDisplayObject.m_position.x = object.posX;
+	newDisplayObject.m_position.y = object.posY;
+	newDisplayObject.m_position.z = object.posZ;
+	
+	//setorientation
+	newDisplayObject.m_orientation.x = object.rotX;
+	newDisplayObject.m_orientation.y = object.rotY;
+	newDisplayObject.m_orientation.z = object.rotZ;
+
+	//set scale
+	newDisplayObject.m_scale.x = object.scaX;
+	newDisplayObject.m_scale.y = object.scaY;
+	newDisplayObject.m_scale.z = object.scaZ;
+
+	//set wireframe / render flags
+	newDisplayObject.m_render		= object.editor_render;
+	newDisplayObject.m_wireframe	= object.editor_wireframe;
+	newDisplayObject.m_snapToGround	= object.snapToGround;
+
+	newDisplayObject.m_light_type		= object.light_type;
+	newDisplayObject.m_light_diffuse_r	= object.light_diffuse_r;
+	newDisplayObject.m_light_diffuse_g	= object.light_diffuse_g;
+	newDisplayObject.m_light_diffuse_b	= object.light_diffuse_b;
+	newDisplayObject.m_light_specular_r = object.light_specular_r;
+	newDisplayObject.m_light_specular_g = object.light_specular_g;
+	newDisplayObject.m_light_specular_b = object.light_specular_b;
+	newDisplayObject.m_light_spot_cutoff = object.light_spot_cutoff;
+	newDisplayObject.m_light_constant	= object.light_constant;
+	newDisplayObject.m_light_linear		= object.light_linear;
+	newDisplayObject.m_light_quadratic	= object.light_quadratic;
+
+	return newDisplayObject;
+}
 
-        }
-        else if (i == 1) {
-            //load model - the first model in the scene is the gizmo
-            newDisplayObject.m_model = Model::CreateFromCMO(device, L"right.cmo", *m_fxFactory, true);	//get DXSDK to load model "False" for LH coordinate system (maya)
+void Game::TakeSceneChanges(std::vector<SceneChange>& changes)
+{
+	changes.swap(m_sceneChanges);
+	m_sceneChanges.clear();
+}
 
-            //Load Texture
-            //rs = CreateDDSTextureFromFile(device, L"gizmo.dds", nullptr, &newDisplayObject.m_texture_diffuse);	//load tex into Shader resource
-        }
-        else if (i == 2) {
-            //load model - the first model in the scene is the gizmo
-            newDisplayObject.m_model = Model::CreateFromCMO(device, L"up.cmo", *m_fxFactory, true);	//get DXSDK to load model "False" for LH coordinate system (maya)
+void Game::ApplySceneChange(const SceneChange & change)
+{
+	if (change.type == SCENE_OBJECT_ADDED)
+	{
+		AddDisplayObject(CreateDisplayObject(change.object));
+		m_nextObjectID = std::max(m_nextObjectID, change.object.ID + 1);
+		return;
+	}
 
-            //Load Texture
-            //rs = CreateDDSTextureFromFile(device, L"gizmo.dds", nullptr, &newDisplayObject.m_texture_diffuse);	//load tex into Shader resource
-        }
+	if (change.type == SCENE_OBJECTS_ADDED)
+	{
+		const std::vector<TransformComponent> & transforms = *change.transforms;
+		DisplayObject displayObject = CreateDisplayObject(change.object);
+		m_displayList.reserve(m_displayList.size() + transforms.size());
+		for (size_t k = 0; k < transforms.size(); k++)
+		{
+			const TransformComponent & transform = transforms[k];
+			displayObject.m_ID = change.object.ID + (int)k;
+			displayObject.m_position = Vector3(transform.posX, transform.posY, transform.posZ);
+			displayObject.m_orientation = Vector3(transform.rotX, transform.rotY, transform.rotZ);
+			displayObject.m_scale = Vector3(transform.scaX, transform.scaY, transform.scaZ);
+			AddDisplayObject(displayObject);
+		}
+		m_nextObjectID = std::max(m_nextObjectID, change.object.ID + (int)transforms.size());
+		return;
+	}
 
-        rs = CreateDDSTextureFromFile(device, L"gizmo.dds", nullptr, &newDisplayObject.m_texture_diffuse);
+	if (change.type == SCENE_OBJECTS_TRANSFORMED)
+	{
+		for (size_t k = 0; k < change.IDs->size(); k++)
+		{
+			int index = m_displayIndex.Find((*change.IDs)[k]);
+			if (index != -1)
+			{
+				const TransformComponent & transform = (*change.transforms)[k];
+				m_displayList[index].m_position = Vector3(transform.posX, transform.posY, transform.posZ);
+				m_displayList[index].m_orientation = Vector3(transform.rotX, transform.rotY, transform.rotZ);
+				m_displayList[index].m_scale = Vector3(transform.scaX, transform.scaY, transform.scaZ);
+				MarkTransformDirty(index);
+			}
+		}
+		return;
+	}
 
-        //if texture fails.  load error default
-        if (rs)
-        {
-            CreateDDSTextureFromFile(device, L"database/data/Error.dds", nullptr, &newDisplayObject.m_texture_diffuse);	//load tex into Shader resource
-        }
+	int index = m_displayIndex.Find(change.object.ID);
+	if (index == -1)
+	{
+		return;
+	}
+	DisplayObject & displayObject = m_displayList[index];
 
-        //apply new texture to models effect
-        newDisplayObject.m_model->UpdateEffects([&](IEffect* effect) //This uses a Lambda function,  if you dont understand it: Look it up.
-            {
-                auto lights = dynamic_cast<BasicEffect*>(effect);
-                if (lights)
-                {
-                    lights->SetTexture(newDisplayObject.m_texture_diffuse);
-                }
-            });
+	switch (change.type)
+	{
+	case SCENE_OBJECT_REMOVED:
+		RemoveDisplayObject(change.object.ID);
+		break;
+
+	case SCENE_OBJECT_TRANSFORMED:
+		displayObject.m_position = Vector3(change.object.posX, change.object.posY, change.object.posZ);
+		displayObject.m_orientation = Vector3(change.object.rotX, change.object.rotY, change.object.rotZ);
+		displayObject.m_scale = Vector3(change.object.scaX, change.object.scaY, change.object.scaZ);
+		MarkTransformDirty(index);
+		break;
+
+	case SCENE_OBJECT_RETEXTURED:
+		LoadDisplayTexture(displayObject, change.object.tex_diffuse_path);
+		break;
+	}
+}
 
-        //setorientation
-        newDisplayObject.m_orientation.x = SceneGraph->at(i).rotX;
-        newDisplayObject.m_orientation.y = SceneGraph->at(i).rotY;
-        newDisplayObject.m_orientation.z = SceneGraph->at(i).rotZ;
+int Game::GetObjectID(int index)
+{
+	if (index < 0 || index >= (int)m_displayList.size())
+	{
+		return -1;
+	}
+	return m_displayList[index].m_ID;
+}
 
-        //set scale
-        newDisplayObject.m_scale.x = SceneGraph->at(i).scaX;
-        newDisplayObject.m_scale.y = SceneGraph->at(i).scaY;
-        newDisplayObject.m_scale.z = SceneGraph->at(i).scaZ;
+void Game::CopyTransform(const DisplayObject & displayObject, SceneObject & object)
+{
+	object.posX = displayObject.m_position.x;
+	object.posY = displayObject.m_position.y;
+	object.posZ = displayObject.m_position.z;
+	object.rotX = displayObject.m_orientation.x;
+	object.rotY = displayObject.m_orientation.y;
+	object.rotZ = displayObject.m_orientation.z;
+	object.scaX = displayObject.m_scale.x;
+	object.scaY = displayObject.m_scale.y;
+	object.scaZ = displayObject.m_scale.z;
+}
 
-        if (i == 0 || i == 1 || i == 2) {
-            newDisplayObject.m_position.x = 100;
-            newDisplayObject.m_position.y = 100;
-            newDisplayObject.m_position.z = 100;
-            newDisplayObject.m_scale *= 3;
+void Game::PushSceneChange(const SceneChange & change)
+{
+	//a drag moves the same object every frame, only the latest transform is worth sending
+	if (change.type == SCENE_OBJECT_TRANSFORMED && !m_sceneChanges.empty())
+	{
+		SceneChange & last = m_sceneChanges.back();
+		if (last.type == SCENE_OBJECT_TRANSFORMED && last.object.ID == change.object.ID)
+		{
+			last = change;
+			return;
+		}
+	}
+	if (change.type == SCENE_OBJECTS_TRANSFORMED && !m_sceneChanges.empty())
+	{
+		SceneChange & last = m_sceneChanges.back();
+		if (last.type == SCENE_OBJECTS_TRANSFORMED && *last.IDs == *change.IDs)
+		{
+			last = change;
+			return;
+		}
+	}
 
-        }
+	m_sceneChanges.push_back(change);
+}
 
-        //set wireframe / render flags
-        newDisplayObject.m_render = SceneGraph->at(i).editor_render;
-        newDisplayObject.m_wireframe = SceneGraph->at(i).editor_wireframe;
-
-        newDisplayObject.m_light_type = SceneGraph->at(i).light_type;
-        newDisplayObject.m_light_diffuse_r = SceneGraph->at(i).light_diffuse_r;
-        newDisplayObject.m_light_diffuse_g = SceneGraph->at(i).light_diffuse_g;
-        newDisplayObject.m_light_diffuse_b = SceneGraph->at(i).light_diffuse_b;
-        newDisplayObject.m_light_specular_r = SceneGraph->at(i).light_specular_r;
-        newDisplayObject.m_light_specular_g = SceneGraph->at(i).light_specular_g;
-        newDisplayObject.m_light_specular_b = SceneGraph->at(i).light_specular_b;
-        newDisplayObject.m_light_spot_cutoff = SceneGraph->at(i).light_spot_cutoff;
-        newDisplayObject.m_light_constant = SceneGraph->at(i).light_constant;
-        newDisplayObject.m_light_linear = SceneGraph->at(i).light_linear;
-        newDisplayObject.m_light_quadratic = SceneGraph->at(i).light_quadratic;
-
-        m_displayList.push_back(newDisplayObject);
-    }
+void Game::PushTransformChange(int index)
+{
+	SceneChange change(SCENE_OBJECT_TRANSFORMED, m_displayList[index].m_ID);
+	CopyTransform(m_displayList[index], change.object);
+	PushSceneChange(change);
+}
 
-    
+void Game::RebuildDisplayIndex()
+{
+	m_displayIndex.Clear();
+	for (int i = 0; i < (int)m_displayList.size(); i++)
+	{
+		m_displayIndex.Insert(m_displayList[i].m_ID, i);
+	}
+	m_hierarchyStale = true;
+}
 
-	//for every item in the scenegraph
-	int numObjects = SceneGraph->size();
-	for (int i = 0; i < numObjects; i++)
+static XMMATRIX DisplayObjectLocal(const DisplayObject & displayObject)
+{
+	return TransformHierarchy::LocalMatrix(displayObject.m_position, displayObject.m_orientation, displayObject.m_scale);
+}
+
+void Game::MarkTransformDirty(int index)
+{
+	//a stale hierarchy reads every local transform when it is rebuilt anyway
+	if (!m_hierarchyStale)
 	{
-		
-		//create a temp display object that we will populate then append to the display list.
-		DisplayObject newDisplayObject;
-        HRESULT rs;		
-        rs = CreateDDSTextureFromFile(device, L"gizmo.dds", nullptr, &newDisplayObject.m_texture_diffuse);
-		
-        
-        
-        {
-            //load model
-            std::wstring modelwstr = StringToWCHART(SceneGraph->at(i).model_path);							//convect string to Wchar
-            newDisplayObject.m_model = Model::CreateFromCMO(device, modelwstr.c_str(), *m_fxFactory, true);	//get DXSDK to load model "False" for LH coordinate system (maya)
-
-            //Load Texture
-            std::wstring texturewstr = StringToWCHART(SceneGraph->at(i).tex_diffuse_path);								//convect string to Wchar
-            HRESULT rs;
-            rs = CreateDDSTextureFromFile(device, texturewstr.c_str(), nullptr, &newDisplayObject.m_texture_diffuse);	//load tex into Shader resource
-        }
+		m_hierarchy.SetLocal(index, DisplayObjectLocal(m_displayList[index]));
+	}
+}
 
-		//if texture fails.  load error default
-		if (rs)
+void Game::UpdateTransforms()
+{
+	if (m_hierarchyStale)
+	{
+		int numObjects = m_displayList.size();
+		std::vector<int> IDs(numObjects);
+		std::vector<int> parentIDs(numObjects);
+		std::vector<XMFLOAT4X4> locals(numObjects);
+		for (int i = 0; i < numObjects; i++)
 		{
-			CreateDDSTextureFromFile(device, L"database/data/Error.dds", nullptr, &newDisplayObject.m_texture_diffuse);	//load tex into Shader resource
+			IDs[i] = m_displayList[i].m_ID;
+			parentIDs[i] = m_displayList[i].m_parentID;
+			XMStoreFloat4x4(&locals[i], DisplayObjectLocal(m_displayList[i]));
 		}
-
-		//apply new texture to models effect
-		newDisplayObject.m_model->UpdateEffects([&](IEffect* effect) //This uses a Lambda function,  if you dont understand it: Look it up.
-		{	
-			auto lights = dynamic_cast<BasicEffect*>(effect);
-			if (lights)
-			{
-				lights->SetTexture(newDisplayObject.m_texture_diffuse);			
-			}
-		});
-
-		//set position
-		newDisplayObject.m_position.x = SceneGraph->at(i).posX;
-		newDisplayObject.m_position.y = SceneGraph->at(i).posY;
-		newDisplayObject.m_position.z = SceneGraph->at(i).posZ;
-		
-		//setorientation
-		newDisplayObject.m_orientation.x = SceneGraph->at(i).rotX;
-		newDisplayObject.m_orientation.y = SceneGraph->at(i).rotY;
-		newDisplayObject.m_orientation.z = SceneGraph->at(i).rotZ;
-
-		//set scale
-		newDisplayObject.m_scale.x = SceneGraph->at(i).scaX;
-		newDisplayObject.m_scale.y = SceneGraph->at(i).scaY;
-		newDisplayObject.m_scale.z = SceneGraph->at(i).scaZ;
-
-		//set wireframe / render flags
-		newDisplayObject.m_render		= SceneGraph->at(i).editor_render;
-		newDisplayObject.m_wireframe	= SceneGraph->at(i).editor_wireframe;
-
-		newDisplayObject.m_light_type		= SceneGraph->at(i).light_type;
-		newDisplayObject.m_light_diffuse_r	= SceneGraph->at(i).light_diffuse_r;
-		newDisplayObject.m_light_diffuse_g	= SceneGraph->at(i).light_diffuse_g;
-		newDisplayObject.m_light_diffuse_b	= SceneGraph->at(i).light_diffuse_b;
-		newDisplayObject.m_light_specular_r = SceneGraph->at(i).light_specular_r;
-		newDisplayObject.m_light_specular_g = SceneGraph->at(i).light_specular_g;
-		newDisplayObject.m_light_specular_b = SceneGraph->at(i).light_specular_b;
-		newDisplayObject.m_light_spot_cutoff = SceneGraph->at(i).light_spot_cutoff;
-		newDisplayObject.m_light_constant	= SceneGraph->at(i).light_constant;
-		newDisplayObject.m_light_linear		= SceneGraph->at(i).light_linear;
-		newDisplayObject.m_light_quadratic	= SceneGraph->at(i).light_quadratic;
-		
-		m_displayList.push_back(newDisplayObject);
-		
+		m_hierarchy.Build(IDs, parentIDs, locals);
+		m_hierarchyStale = false;
 	}
-		
-		
-		
+
+	m_hierarchy.Update();
 }
 
 void Game::BuildDisplayChunk(ChunkObject * SceneChunk)
@@ -907,14 +1768,25 @@ void Game::BuildDisplayChunk(ChunkObject * SceneChunk)
 	//populate our local DISPLAYCHUNK with all the chunk info we need from the object stored in toolmain
 	//which, to be honest, is almost all of it. Its mostly rendering related info so...
 	m_displayChunk.PopulateChunkData(SceneChunk);		//migrate chunk data
-	m_displayChunk.LoadHeightMap(m_deviceResources);
+	m_displayChunk.LoadHeightMap(m_deviceResources, m_levelPack);
 	m_displayChunk.m_terrainEffect->SetProjection(m_projection);
 	m_displayChunk.InitialiseBatch();
+	RefreshTerrainQuery();
+
+	m_erosion.Stop();
+	std::vector<float> heights;
+	GetTerrainHeights(heights);
+	m_terrainHistory.Reset(heights.data(), TERRAINRESOLUTION, TERRAIN_HISTORY_TILE);
 }
 
-void Game::SaveDisplayChunk(ChunkObject * SceneChunk)
+bool Game::SaveDisplayChunk(ChunkObject * SceneChunk)
 {
-	m_displayChunk.SaveHeightMap();			//save heightmap to file.
+	if (!m_displayChunk.SaveHeightMap())	//save heightmap to file.
+	{
+		return false;
+	}
+	SceneChunk->heightmap_path = m_displayChunk.GetHeightmapPath();
+	return true;
 }
 
 #ifdef DXTK_AUDIO
@@ -944,6 +1816,7 @@ void Game::CreateDeviceDependentResources()
     m_fxFactory = std::make_unique<EffectFactory>(device);
 	m_fxFactory->SetDirectory(L"database/data/"); //fx Factory will look in the database directory
 	m_fxFactory->SetSharing(false);	//we must set this to false otherwise it will share effects based on the initial tex loaded (When the model loads) rather than what we will change them to.
+	m_assetCache.Initialise(device, m_fxFactory.get());
 
     m_sprites = std::make_unique<SpriteBatch>(context);
 
@@ -966,6 +1839,17 @@ void Game::CreateDeviceDependentResources()
         );
     }
 
+    //the render queue's vertex shader for BasicEffect parts, and the buffer it reads each object's matrices from
+    DX::ThrowIfFailed(
+        device->CreateVertexShader(g_ObjectVS, sizeof(g_ObjectVS), nullptr, m_objectShader.ReleaseAndGetAddressOf())
+    );
+    {
+        CD3D11_BUFFER_DESC desc(sizeof(ObjectMatrices), D3D11_BIND_CONSTANT_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+        DX::ThrowIfFailed(
+            device->CreateBuffer(&desc, nullptr, m_objectMatrices.ReleaseAndGetAddressOf())
+        );
+    }
+
     m_font = std::make_unique<SpriteFont>(device, L"SegoeUI_18.spritefont");
 
     //m_shape = GeometricPrimitive::CreateTeapot(context, 4.f, 8);
@@ -1014,6 +1898,7 @@ void Game::CreateWindowSizeDependentResources()
 void Game::OnDeviceLost()
 {
     m_states.reset();
+    m_assetCache.Clear();
     m_fxFactory.reset();
     m_sprites.reset();
     m_batch.reset();
@@ -1024,6 +1909,8 @@ void Game::OnDeviceLost()
     m_texture1.Reset();
     m_texture2.Reset();
     m_batchInputLayout.Reset();
+    m_objectShader.Reset();
+    m_objectMatrices.Reset();
 }
 
 void Game::OnDeviceRestored()
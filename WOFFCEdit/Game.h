@@ -6,11 +6,23 @@
 
 #include "DeviceResources.h"
 #include "StepTimer.h"
-#include "SceneObject.h"
+#include "Scene.h"
 #include "DisplayObject.h"
 #include "DisplayChunk.h"
 #include "ChunkObject.h"
 #include "InputCommands.h"
+#include "SceneChange.h"
+#include "TransformHierarchy.h"
+#include "ObjectIndex.h"
+#include "TerrainQuery.h"
+#include "AssetCache.h"
+#include "Scatter.h"
+#include "Erosion.h"
+#include "TerrainHistory.h"
+#include "FrustumQuery.h"
+#include "SelectionSet.h"
+#include "Gizmo.h"
+#include "RenderQueue.h"
 #include <vector>
 #include "Camera.h"
 #include <cmath>
@@ -32,20 +44,40 @@ public:
 	// Basic game loop
 	void Tick(InputCommands * Input);
 	void Render();
-	int	 MousePicking(bool ignoreGizmo);
+	int	 MousePicking();	//returns the database ID of the picked object, -1 for none
+	void MarqueeSelect(int x0, int y0, int x1, int y1, std::vector<int> & IDs);	//database IDs of the objects under a screen rectangle, ascending
+	void SetMarquee(bool show, int x0, int y0, int x1, int y1) { m_marqueeShown = show; m_marquee = { x0, y0, x1, y1 }; }	//outline drawn over the scene
+	//object edits take the database ID of the object, not its position in the display list
 	void Copy(int id);
 	void Paste(int id);
 	void Delete(int id);
 	void Cut(int id);
 	void StopErasing() { erasing = false;}
 	void StopPasting() { pasting = false; }
-	void ResetSelectedAxis() { selectedAxis = 'a'; };
-	char GetSelectedAxis() { return selectedAxis; };
-	void MoveObject(int moveX, int moveY, int id, char axis);
-	void WidgetGeneration(int id);
-	void ObjectPlacement();
-	void ObjectGeneration(DirectX::SimpleMath::Vector3 pos);
+	void MoveObject(int moveX, int moveY, const SelectionSet & selection);	//drags every selected object with the mouse
+	void TransformObjects(const SelectionSet & selection, const SelectionTransform & transform);	//one pass over the selection, one change for all of it
+	bool SelectionPivot(const SelectionSet & selection, DirectX::XMFLOAT3 & pivot);	//centre of the box around the selected objects' world positions, false if none are left
+	void PlaceGizmo(const SelectionSet & selection);	//on the centre of the selection every tick, hidden when there is nothing selected
+	bool BeginGizmoDrag();		//grabs the gizmo handle under the cursor, false if there isn't one
+	void GizmoDrag(const SelectionSet & selection);	//every tick the handle is held, moves the selection with the cursor
+	void EndGizmoDrag() { m_gizmo.EndDrag(); }
+	bool IsGizmoDragging() const { return m_gizmo.GetDragging() != GIZMO_NONE; }
+	void BeginPlacement();		//mouse down in placement mode, starts a new painting stroke
+	void ObjectPlacement();		//call every tick the mouse is held, places a new object on the surface under the cursor once it has moved far enough
+	void ObjectGeneration(DirectX::SimpleMath::Vector3 pos, DirectX::SimpleMath::Vector3 orientation);
+	void SetAlignToSurface(bool b) { m_alignToSurface = b; }
+	bool GetAlignToSurface() { return m_alignToSurface; }
+	void ScatterObjects(float centreX, float centreZ, float radius);	//fills a circle of the terrain with new objects, or all of it when radius is 0
+	void SetScatterBrush(bool b) { m_scatterBrush = b; }
+	void SetPlacementModel(StringHandle model) { m_placementModel = model; }
+	bool GetScatterBrush() { return m_scatterBrush; }
 	void TerrainEdit();
+	void GenerateTerrain();		//replaces the terrain with a procedural one, a new seed each time
+	void ErodeTerrain();		//starts eroding the terrain, one iteration a frame until it is done
+	void EndTerrainStroke();	//call when a sculpt ends, records the tiles it changed for undo. also stops erosion, keeping what it did
+	void UndoTerrain();			//steps the terrain history, for the scene journal - objects that snapped are its business
+	void RedoTerrain();
+	std::string TerrainReport() const { return m_terrainHistory.Report(); }	//what the last stroke, undo or redo cost
 	
 	void Wireframe(bool b) { wireframeMode = b; };
 	DirectX::SimpleMath::Vector3 TerrainInfo();
@@ -57,6 +89,7 @@ public:
 	}
 
 	void RecalcuateTerrainNormals();
+	void SnapToGround();		//drops every snap to ground object onto the terrain, call once a sculpt is finished
 
 	void ResetTexture(int id);
 
@@ -75,11 +108,18 @@ public:
 	void OnWindowSizeChanged(int width, int height);
 
 	//tool specific
-	void BuildDisplayList(std::vector<SceneObject> * SceneGraph); //note vector passed by reference 
+	void SetLevelPack(const LevelPack * pack) { m_levelPack = pack; m_assetCache.SetPack(pack); }	//for the builds that follow, NULL to go back to loose files
+	void BuildDisplayList(const Scene & SceneGraph);
 	void BuildDisplayChunk(ChunkObject *SceneChunk);
-	void SaveDisplayChunk(ChunkObject *SceneChunk);	//saves geometry et al
+	bool SaveDisplayChunk(ChunkObject *SceneChunk);	//saves geometry et al, and points the chunk at the file the heights went to
 	void ClearDisplayList();
 
+	//scene sync
+	void TakeSceneChanges(std::vector<SceneChange> & changes);	//hands over every edit made in the renderer since the last call
+	void ApplySceneChange(const SceneChange & change);			//applies a scene model edit to the one display object it touches
+	int  GetObjectID(int index);									//database ID of a display list entry, -1 if there is no such entry
+	void TakeAssetWarnings(std::vector<std::string> & warnings) { m_assetCache.TakeWarnings(warnings); }
+
 #ifdef DXTK_AUDIO
 	void NewAudioDevice();
 #endif
@@ -93,9 +133,47 @@ private:
 
 	void XM_CALLCONV DrawGrid(DirectX::FXMVECTOR xAxis, DirectX::FXMVECTOR yAxis, DirectX::FXMVECTOR origin, size_t xdivs, size_t ydivs, DirectX::GXMVECTOR color);
 
+	DisplayObject CreateDisplayObject(const SceneObject & object);	//loads the model and texture for one scene object
+	void SetDisplayTexture(int index, StringHandle path);	//swaps the diffuse texture of a display object and records the change
+	void LoadDisplayTexture(DisplayObject & displayObject, StringHandle path);
+	void CopyTransform(const DisplayObject & displayObject, SceneObject & object);
+	void PushSceneChange(const SceneChange & change);
+	void PushTransformChange(int index);
+	void AddDisplayObject(const DisplayObject & displayObject);
+	void RemoveDisplayObject(int id);
+	void RebuildDisplayIndex();
+	void MarkTransformDirty(int index);		//call after changing the position, orientation or scale of a display object
+	void UpdateTransforms();				//brings every world matrix up to date, rebuilding the hierarchy if objects came or went
+	void RefreshTerrainQuery();				//copies the current terrain heights into m_terrainQuery
+	void GetTerrainHeights(std::vector<float> & heights);	//terrain heights row by row, TERRAINRESOLUTION square
+	void StepErosion();						//runs one erosion iteration and copies the result into the terrain
+	void StopErosion();						//keeps what the iterations so far did, the next EndTerrainStroke records it
+	void ApplyTerrainHistory(const std::vector<float> & heights);	//copies the tiles an undo or redo changed into the terrain
+	void MouseRay(DirectX::XMVECTOR & origin, DirectX::XMVECTOR & direction);		//world space ray under the cursor, direction normalised
+	DirectX::Model & LodModel(int index, DirectX::FXMMATRIX world);		//the level of detail of a display object to draw this frame
+	void DrawMarquee();		//outline of the marquee being dragged, over everything else
+	void DrawGizmo();		//the gizmo handles over the scene, the one under the cursor highlighted
+	void QueueDisplayList();	//a packet for every mesh part of the display list, keyed by the state it draws with
+	void SubmitRenderQueue();	//sorts the packets and draws them, binding only what differs from the packet before
+	RenderStateChanges DrawRenderQueue(bool draw);	//the binds the packets need in the order they are in, issued as well when draw is set
+	//distance along a world ray to a display object - its triangles when it has any on the cpu, its mesh bounds otherwise
+	bool RaycastObject(int index, DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, float & distance, DirectX::XMVECTOR & normal);
+	//nearest hit on the terrain or on any object, ignoring objects with IDs from ignoreFromID up
+	bool SurfaceRaycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, int ignoreFromID, DirectX::SimpleMath::Vector3 & point, DirectX::SimpleMath::Vector3 & normal);
+
 	//tool specific
 	std::vector<DisplayObject>			m_displayList;
+	ObjectIndex							m_displayIndex;		//database ID -> position in m_displayList
+	std::vector<SceneChange>			m_sceneChanges;		//edits made here that the scene model has not picked up yet
+	int									m_nextObjectID;		//ID handed to objects created in the renderer
+	TransformHierarchy					m_hierarchy;		//world matrix per display list entry, same indices
+	bool								m_hierarchyStale;	//display list changed shape since the hierarchy was built
+	AssetCache							m_assetCache;		//models and textures shared by the display objects
+	const LevelPack *					m_levelPack;		//the cooked level being loaded from, NULL for loose files
 	DisplayChunk						m_displayChunk;
+	TerrainQuery						m_terrainQuery;		//heights of m_displayChunk as of the last RefreshTerrainQuery
+	Erosion								m_erosion;			//running between ErodeTerrain and its last iteration
+	TerrainHistory						m_terrainHistory;	//terrain undo and redo
 	InputCommands						m_InputCommands;
 
 	// reference to the camera
@@ -106,13 +184,43 @@ private:
 	bool pasting = false;
 	bool cutting = false;
 	bool wireframeMode = false;
-	char selectedAxis = 'w';
+	Gizmo m_gizmo;
 
 	bool red = false;
 	bool green = false;
 	bool blue = false;
 
 	std::vector<std::pair<int, int>> points;
+
+	//marquee selection
+	FrustumBounds m_selectionBounds;		//world bounds of the display list, refilled for each marquee
+	RECT m_marquee;							//corners in pixels, as dragged
+	bool m_marqueeShown = false;
+	std::vector<int> m_transformIndices;	//display list positions of the objects a TransformObjects is moving
+
+	//state sorted drawing
+	struct RenderItem
+	{
+		const DirectX::ModelMesh *		mesh;
+		const DirectX::ModelMeshPart *	part;
+		int								object;		//display list position
+	};
+	RenderQueue m_renderQueue;
+	std::vector<RenderItem> m_renderItems;		//what each packet of m_renderQueue draws
+	RenderStateChanges m_renderChanges = {};	//last frame's binds had it been drawn in the order it was queued
+	RenderStateChanges m_renderChangesSorted = {};	//and those issued drawing it sorted
+
+	//placement
+	StringHandle m_placementModel;			//what new objects are created with
+	StringHandle m_placementTexture;
+	bool m_alignToSurface = false;			//new objects are rotated so their up axis follows the surface normal
+	int m_strokeFirstID = 0;				//objects placed by the current stroke, which it must not land on
+	bool m_strokePlaced = false;
+	DirectX::SimpleMath::Vector3 m_lastPlacement;
+	bool m_scatterBrush = false;			//placement scatters a circle of objects instead of placing one
+	ScatterSettings m_scatterSettings;
+	HeightmapSettings m_heightmapSettings;
+	ErosionSettings m_erosionSettings;
 	//bool gizmoSelected = true;
 
 	//control variables
@@ -149,6 +257,8 @@ private:
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texture1;
     Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>                        m_texture2;
     Microsoft::WRL::ComPtr<ID3D11InputLayout>                               m_batchInputLayout;
+    Microsoft::WRL::ComPtr<ID3D11VertexShader>                              m_objectShader;		//ObjectVS.hlsl, for the parts drawn with a BasicEffect
+    Microsoft::WRL::ComPtr<ID3D11Buffer>                                    m_objectMatrices;		//its per object constants
 
 #ifdef DXTK_AUDIO
     uint32_t                                                                m_audioEvent;
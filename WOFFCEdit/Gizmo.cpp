@@ -0,0 +1,355 @@
+#include "Gizmo.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const float HANDLE_PIXELS = 110.0f;		//screen length of an axis handle
+	const float HANDLE_RADIUS = 0.07f;		//capsule round a shaft, as a fraction of the handle length. wider than it is drawn
+	const float PLANE_INNER = 0.2f;			//plane handle squares, from and to along both their axes
+	const float PLANE_OUTER = 0.45f;
+	const float MIN_DEPTH = 0.01f;
+
+	XMFLOAT3 Add(const XMFLOAT3 & a, const XMFLOAT3 & b)	{ return XMFLOAT3(a.x + b.x, a.y + b.y, a.z + b.z); }
+	XMFLOAT3 Sub(const XMFLOAT3 & a, const XMFLOAT3 & b)	{ return XMFLOAT3(a.x - b.x, a.y - b.y, a.z - b.z); }
+	XMFLOAT3 Mul(const XMFLOAT3 & a, float s)				{ return XMFLOAT3(a.x * s, a.y * s, a.z * s); }
+	float Dot(const XMFLOAT3 & a, const XMFLOAT3 & b)		{ return a.x * b.x + a.y * b.y + a.z * b.z; }
+	float Get(const XMFLOAT3 & a, int axis)					{ return axis == 0 ? a.x : axis == 1 ? a.y : a.z; }
+
+	XMFLOAT3 Axis(int axis)
+	{
+		return XMFLOAT3(axis == 0 ? 1.0f : 0.0f, axis == 1 ? 1.0f : 0.0f, axis == 2 ? 1.0f : 0.0f);
+	}
+
+	//first point where a ray, direction normalised, enters the capsule round a to b. the round body is a quadratic in the
+	//distance along the ray, and if that lands past either end the sphere on that end decides it
+	bool RayCapsule(const XMFLOAT3 & origin, const XMFLOAT3 & direction, const XMFLOAT3 & a, const XMFLOAT3 & b, float radius, float & distance)
+	{
+		XMFLOAT3 ba = Sub(b, a), oa = Sub(origin, a);
+		float baba = Dot(ba, ba), bard = Dot(ba, direction), baoa = Dot(ba, oa), rdoa = Dot(direction, oa), oaoa = Dot(oa, oa);
+		float qa = baba - bard * bard;
+		float qb = baba * rdoa - baoa * bard;
+		float qc = baba * oaoa - baoa * baoa - radius * radius * baba;
+		float h = qb * qb - qa * qc;
+		float along = baoa;		//where the body is entered along the shaft, times its length squared
+		if (qa > 1e-8f * baba)
+		{
+			if (h < 0.0f)
+			{
+				return false;
+			}
+			float t = (-qb - sqrtf(h)) / qa;
+			along = baoa + t * bard;
+			if (along > 0.0f && along < baba)
+			{
+				distance = t;
+				return t >= 0.0f;
+			}
+		}
+		else
+		{
+			//running along the shaft, only the ends can be met first
+			along = bard > 0.0f ? -1.0f : baba + 1.0f;
+		}
+		XMFLOAT3 oc = along <= 0.0f ? oa : Sub(origin, b);
+		float cb = Dot(direction, oc), cc = Dot(oc, oc) - radius * radius;
+		float ch = cb * cb - cc;
+		if (ch < 0.0f)
+		{
+			return false;
+		}
+		distance = -cb - sqrtf(ch);
+		return distance >= 0.0f;
+	}
+}
+
+Gizmo::Gizmo()
+{
+	m_position = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	m_scale = 1.0f;
+	m_visible = false;
+	m_dragging = GIZMO_NONE;
+	m_dragNormal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+	m_dragPoint = m_position;
+}
+
+Gizmo::~Gizmo()
+{
+}
+
+void Gizmo::Place(const XMFLOAT3 & position)
+{
+	m_position = position;
+	m_visible = true;
+}
+
+void Gizmo::Hide()
+{
+	m_visible = false;
+	m_dragging = GIZMO_NONE;
+}
+
+void Gizmo::FitToScreen(const XMFLOAT3 & cameraPosition, const XMFLOAT3 & cameraForward, float projectionYScale, float viewportHeight)
+{
+	//a world unit at view depth z covers projectionYScale * viewportHeight / (2z) pixels
+	float length = sqrtf(Dot(cameraForward, cameraForward));
+	float depth = std::max(Dot(Sub(m_position, cameraPosition), cameraForward) / std::max(length, 1e-6f), MIN_DEPTH);
+	m_scale = HANDLE_PIXELS * 2.0f * depth / (projectionYScale * std::max(viewportHeight, 1.0f));
+}
+
+void Gizmo::GetAxis(int axis, XMFLOAT3 & start, XMFLOAT3 & end) const
+{
+	start = m_position;
+	end = Add(m_position, Mul(Axis(axis), m_scale));
+}
+
+void Gizmo::GetPlane(int stillAxis, XMFLOAT3 corners[4]) const
+{
+	XMFLOAT3 u = Mul(Axis((stillAxis + 1) % 3), m_scale), v = Mul(Axis((stillAxis + 2) % 3), m_scale);
+	corners[0] = Add(m_position, Add(Mul(u, PLANE_INNER), Mul(v, PLANE_INNER)));
+	corners[1] = Add(m_position, Add(Mul(u, PLANE_OUTER), Mul(v, PLANE_INNER)));
+	corners[2] = Add(m_position, Add(Mul(u, PLANE_OUTER), Mul(v, PLANE_OUTER)));
+	corners[3] = Add(m_position, Add(Mul(u, PLANE_INNER), Mul(v, PLANE_OUTER)));
+}
+
+bool Gizmo::PlaneHit(const XMFLOAT3 & origin, const XMFLOAT3 & direction, int stillAxis, float & distance) const
+{
+	float facing = Get(direction, stillAxis);
+	if (fabsf(facing) < 1e-6f)
+	{
+		return false;
+	}
+	distance = (Get(m_position, stillAxis) - Get(origin, stillAxis)) / facing;
+	if (distance < 0.0f)
+	{
+		return false;
+	}
+	XMFLOAT3 local = Mul(Sub(Add(origin, Mul(direction, distance)), m_position), 1.0f / m_scale);
+	float u = Get(local, (stillAxis + 1) % 3), v = Get(local, (stillAxis + 2) % 3);
+	return u >= PLANE_INNER && u <= PLANE_OUTER && v >= PLANE_INNER && v <= PLANE_OUTER;
+}
+
+GizmoHandle Gizmo::Pick(const XMFLOAT3 & origin, const XMFLOAT3 & direction, float & distance) const
+{
+	GizmoHandle picked = GIZMO_NONE;
+	if (!m_visible)
+	{
+		return picked;
+	}
+	distance = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		XMFLOAT3 start, end;
+		GetAxis(axis, start, end);
+		float hit;
+		if (RayCapsule(origin, direction, start, end, HANDLE_RADIUS * m_scale, hit) && hit < distance)
+		{
+			distance = hit;
+			picked = (GizmoHandle)(GIZMO_X + axis);
+		}
+		if (PlaneHit(origin, direction, axis, hit) && hit < distance)
+		{
+			distance = hit;
+			picked = (GizmoHandle)(GIZMO_YZ + axis);
+		}
+	}
+	return picked;
+}
+
+bool Gizmo::BeginDrag(GizmoHandle handle, const XMFLOAT3 & origin, const XMFLOAT3 & direction)
+{
+	if (handle == GIZMO_NONE || !m_visible)
+	{
+		return false;
+	}
+	if (handle >= GIZMO_YZ)
+	{
+		m_dragNormal = Axis(handle - GIZMO_YZ);
+	}
+	else
+	{
+		//the ray with its run along the axis taken out is the plane's normal, so the plane turns to face the camera
+		XMFLOAT3 axis = Axis(handle - GIZMO_X);
+		XMFLOAT3 normal = Sub(direction, Mul(axis, Dot(direction, axis)));
+		float length = sqrtf(Dot(normal, normal));
+		if (length < 1e-4f)
+		{
+			return false;
+		}
+		m_dragNormal = Mul(normal, 1.0f / length);
+	}
+
+	float facing = Dot(direction, m_dragNormal);
+	if (fabsf(facing) < 1e-6f)
+	{
+		return false;
+	}
+	float distance = Dot(Sub(m_position, origin), m_dragNormal) / facing;
+	if (distance < 0.0f)
+	{
+		return false;
+	}
+	m_dragPoint = Add(origin, Mul(direction, distance));
+	m_dragging = handle;
+	return true;
+}
+
+bool Gizmo::Drag(const XMFLOAT3 & origin, const XMFLOAT3 & direction, XMFLOAT3 & translation)
+{
+	translation = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	if (m_dragging == GIZMO_NONE)
+	{
+		return false;
+	}
+	float facing = Dot(direction, m_dragNormal);
+	if (fabsf(facing) < 1e-6f)
+	{
+		return false;
+	}
+	float distance = Dot(Sub(m_dragPoint, origin), m_dragNormal) / facing;
+	if (distance < 0.0f)
+	{
+		return false;
+	}
+	XMFLOAT3 move = Sub(Add(origin, Mul(direction, distance)), m_dragPoint);
+	if (m_dragging < GIZMO_YZ)
+	{
+		XMFLOAT3 axis = Axis(m_dragging - GIZMO_X);
+		move = Mul(axis, Dot(move, axis));
+	}
+	else
+	{
+		int still = m_dragging - GIZMO_YZ;
+		move.x = still == 0 ? 0.0f : move.x;
+		move.y = still == 1 ? 0.0f : move.y;
+		move.z = still == 2 ? 0.0f : move.z;
+	}
+
+	//the point moves with the handle, so the plane stays the one the drag started on
+	m_dragPoint = Add(m_dragPoint, move);
+	m_position = Add(m_position, move);
+	translation = move;
+	return true;
+}
+
+//a gizmo out in a level, rays from the camera at points all round it. the answers are checked against walking each ray
+//through the handles in small steps, and drags along an axis and across a plane against where the cursor was put
+std::string Gizmo::Benchmark(int rays)
+{
+	const float projectionYScale = 1.0f / tanf(0.5f * 70.0f * XM_PI / 180.0f), height = 720.0f;
+	XMFLOAT3 camera(0.0f, 4.0f, 0.0f);
+	Gizmo gizmo;
+	gizmo.Place(XMFLOAT3(12.0f, 1.0f, 40.0f));
+	XMFLOAT3 forward = Sub(gizmo.GetPosition(), camera);
+	forward = Mul(forward, 1.0f / sqrtf(Dot(forward, forward)));
+	gizmo.FitToScreen(camera, forward, projectionYScale, height);
+
+	//the same size on screen from ten times as far away
+	Gizmo distant = gizmo;
+	distant.Place(Add(camera, Mul(Sub(gizmo.GetPosition(), camera), 10.0f)));
+	distant.FitToScreen(camera, forward, projectionYScale, height);
+	float depth = Dot(Sub(gizmo.GetPosition(), camera), forward), farDepth = Dot(Sub(distant.GetPosition(), camera), forward);
+	float pixels = gizmo.GetScale() * projectionYScale * height / (2.0f * depth);
+	float farPixels = distant.GetScale() * projectionYScale * height / (2.0f * farDepth);
+	bool correct = fabsf(pixels - HANDLE_PIXELS) < 0.01f && fabsf(farPixels - HANDLE_PIXELS) < 0.01f;
+
+	std::mt19937 random(5);
+	std::uniform_real_distribution<float> around(-0.3f, 1.1f);
+	std::vector<XMFLOAT3> directions(rays);
+	for (int i = 0; i < rays; i++)
+	{
+		XMFLOAT3 target = Add(gizmo.GetPosition(), Mul(XMFLOAT3(around(random), around(random), around(random)), gizmo.GetScale()));
+		XMFLOAT3 direction = Sub(target, camera);
+		directions[i] = Mul(direction, 1.0f / sqrtf(Dot(direction, direction)));
+	}
+
+	int hits = 0;
+	auto pickStart = std::chrono::high_resolution_clock::now();
+	std::vector<GizmoHandle> picked(rays);
+	std::vector<float> pickedDistance(rays);
+	for (int i = 0; i < rays; i++)
+	{
+		picked[i] = gizmo.Pick(camera, directions[i], pickedDistance[i]);
+		hits += picked[i] != GIZMO_NONE;
+	}
+	auto pickEnd = std::chrono::high_resolution_clock::now();
+
+	//marching: the first step inside a capsule, or across a plane square. where the two disagree on the handle they must
+	//at least agree on the distance, which happens where handles meet
+	float step = gizmo.GetScale() * 0.0005f;
+	int disagree = 0;
+	for (int i = 0; i < rays; i++)
+	{
+		GizmoHandle expected = GIZMO_NONE;
+		float expectedDistance = 0.0f;
+		for (float t = depth - 2.0f * gizmo.GetScale(); t < depth + 4.0f * gizmo.GetScale() && expected == GIZMO_NONE; t += step)
+		{
+			XMFLOAT3 point = Add(camera, Mul(directions[i], t));
+			XMFLOAT3 local = Mul(Sub(point, gizmo.GetPosition()), 1.0f / gizmo.GetScale());
+			for (int axis = 0; axis < 3 && expected == GIZMO_NONE; axis++)
+			{
+				float along = std::min(std::max(Get(local, axis), 0.0f), 1.0f);
+				XMFLOAT3 off = Sub(local, Mul(Axis(axis), along));
+				if (Dot(off, off) <= HANDLE_RADIUS * HANDLE_RADIUS)
+				{
+					expected = (GizmoHandle)(GIZMO_X + axis);
+				}
+				float u = Get(local, (axis + 1) % 3), v = Get(local, (axis + 2) % 3);
+				float next = Get(Mul(Sub(Add(point, Mul(directions[i], step)), gizmo.GetPosition()), 1.0f / gizmo.GetScale()), axis);
+				if ((Get(local, axis) <= 0.0f) != (next <= 0.0f) && u >= PLANE_INNER && u <= PLANE_OUTER && v >= PLANE_INNER && v <= PLANE_OUTER)
+				{
+					expected = (GizmoHandle)(GIZMO_YZ + axis);
+				}
+			}
+			expectedDistance = t;
+		}
+		if (expected != picked[i] && (expected == GIZMO_NONE || picked[i] == GIZMO_NONE || fabsf(expectedDistance - pickedDistance[i]) > 4.0f * step))
+		{
+			disagree++;
+		}
+	}
+
+	//drags: put the cursor where the handle should end up, across the plane the drag follows
+	auto dragTo = [&](Gizmo & dragged, GizmoHandle handle, const XMFLOAT3 & grab, const XMFLOAT3 & move, XMFLOAT3 & moved)
+	{
+		XMFLOAT3 direction = Sub(grab, camera);
+		direction = Mul(direction, 1.0f / sqrtf(Dot(direction, direction)));
+		if (!dragged.BeginDrag(handle, camera, direction))
+		{
+			return false;
+		}
+		//only the part of the move in the drag plane can be reached with the cursor
+		XMFLOAT3 inPlane = Sub(move, Mul(dragged.m_dragNormal, Dot(move, dragged.m_dragNormal)));
+		direction = Sub(Add(dragged.m_dragPoint, inPlane), camera);
+		direction = Mul(direction, 1.0f / sqrtf(Dot(direction, direction)));
+		return dragged.Drag(camera, direction, moved);
+	};
+	Gizmo dragged = gizmo;
+	XMFLOAT3 start, end, moved;
+	gizmo.GetAxis(0, start, end);
+	auto dragStart = std::chrono::high_resolution_clock::now();
+	bool dragged0 = dragTo(dragged, GIZMO_X, Mul(Add(start, end), 0.5f), XMFLOAT3(1.3f, 0.4f, -0.2f), moved);
+	auto dragEnd = std::chrono::high_resolution_clock::now();
+	correct = correct && dragged0 && fabsf(moved.x - 1.3f) < 1e-3f && moved.y == 0.0f && moved.z == 0.0f
+		&& fabsf(dragged.GetPosition().x - gizmo.GetPosition().x - 1.3f) < 1e-3f;
+
+	XMFLOAT3 corners[4];
+	dragged = gizmo;
+	gizmo.GetPlane(1, corners);
+	bool dragged1 = dragTo(dragged, GIZMO_XZ, Mul(Add(corners[0], corners[2]), 0.5f), XMFLOAT3(0.7f, 0.0f, -0.4f), moved);
+	correct = correct && dragged1 && fabsf(moved.x - 0.7f) < 1e-3f && moved.y == 0.0f && fabsf(moved.z + 0.4f) < 1e-3f;
+	correct = correct && disagree == 0 && hits > 0 && hits < rays;
+
+	std::ostringstream report;
+	report << "Gizmo, " << rays << " rays, " << hits << " on a handle: " << std::chrono::duration<double, std::nano>(pickEnd - pickStart).count() / std::max(rays, 1)
+		<< " ns a pick, " << std::chrono::duration<double, std::nano>(dragEnd - dragStart).count() << " ns to start and move a drag, "
+		<< pixels << " / " << farPixels << " pixels near / far" << (correct ? "" : " (GIZMO WRONG)") << "\n";
+	return report.str();
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+
+//the translate gizmo, kept out of the display list and worked out analytically. three axis handles, each picked as a
+//capsule round its shaft, and three plane handles, squares near the centre that move along two axes at once. its size
+//is set from the camera every frame, so the handles cover the same number of pixels however far away they are, and
+//picking them is six ray tests whatever is in the scene. handles follow the world axes. Game draws them in an overlay
+//pass after everything else.
+
+enum GizmoHandle
+{
+	GIZMO_NONE = -1,
+	GIZMO_X,			//axis handles, in axis order
+	GIZMO_Y,
+	GIZMO_Z,
+	GIZMO_YZ,			//plane handles, in the order of the axis they keep still
+	GIZMO_XZ,
+	GIZMO_XY,
+	GIZMO_HANDLES
+};
+
+class Gizmo
+{
+public:
+	Gizmo();
+	~Gizmo();
+
+	void	Place(const DirectX::XMFLOAT3 & position);
+	void	Hide();
+	bool	IsVisible() const { return m_visible; }
+	const DirectX::XMFLOAT3 & GetPosition() const { return m_position; }
+
+	//sizes the handles to the same number of pixels wherever the gizmo is. projectionYScale is _22 of the projection matrix
+	void	FitToScreen(const DirectX::XMFLOAT3 & cameraPosition, const DirectX::XMFLOAT3 & cameraForward, float projectionYScale, float viewportHeight);
+	float	GetScale() const { return m_scale; }		//world length of an axis handle
+
+	//nearest handle along a ray, direction normalised. GIZMO_NONE when the ray misses them all or the gizmo is hidden
+	GizmoHandle	Pick(const DirectX::XMFLOAT3 & origin, const DirectX::XMFLOAT3 & direction, float & distance) const;
+
+	//the ray is followed across a plane through the handle - its own plane, or for an axis the plane along the axis that
+	//faces the ray most - and the movement is kept to the handle's axes. Drag gives the movement since the last call and
+	//takes the gizmo with it, false when the ray runs parallel to the plane
+	bool	BeginDrag(GizmoHandle handle, const DirectX::XMFLOAT3 & origin, const DirectX::XMFLOAT3 & direction);
+	bool	Drag(const DirectX::XMFLOAT3 & origin, const DirectX::XMFLOAT3 & direction, DirectX::XMFLOAT3 & translation);
+	void	EndDrag() { m_dragging = GIZMO_NONE; }
+	GizmoHandle	GetDragging() const { return m_dragging; }
+
+	//the shapes, in world space, for drawing
+	void	GetAxis(int axis, DirectX::XMFLOAT3 & start, DirectX::XMFLOAT3 & end) const;
+	void	GetPlane(int stillAxis, DirectX::XMFLOAT3 corners[4]) const;
+
+	static std::string Benchmark(int rays);		//pick and drag latency, against marching the rays through the handles
+
+private:
+	bool	PlaneHit(const DirectX::XMFLOAT3 & origin, const DirectX::XMFLOAT3 & direction, int stillAxis, float & distance) const;
+
+	DirectX::XMFLOAT3	m_position;
+	float				m_scale;
+	bool				m_visible;
+
+	GizmoHandle			m_dragging;
+	DirectX::XMFLOAT3	m_dragNormal;		//of the plane the ray is followed across
+	DirectX::XMFLOAT3	m_dragPoint;		//where the ray last crossed it, moved along with the gizmo
+};
@@ -0,0 +1,623 @@
+#include "HeightmapFile.h"
+#include "HeightmapGenerator.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+
+namespace
+{
+	const char		MAGIC[4] = { 'W', 'H', 'M', 'P' };
+	const char		EXTENSION[] = ".whm";
+	const uint32_t	VERSION = 1;
+	const uint32_t	COMPRESSION_NONE = 0;
+	const uint32_t	COMPRESSION_DELTA = 1;		//zigzag varints of the difference from the sample to the left, or above for the first in a row
+
+	struct FileHeader
+	{
+		char		magic[4];
+		uint32_t	version;
+		uint32_t	width, height;
+		uint32_t	tileSize;
+		uint32_t	format;
+		float		minHeight, maxHeight;
+		uint64_t	tableOffset;
+		uint32_t	reserved[6];
+	};
+
+	struct TileEntry
+	{
+		uint64_t	offset;
+		uint32_t	size;
+		uint32_t	capacity;
+		uint32_t	compression;
+		uint32_t	reserved;
+	};
+
+	static_assert(sizeof(FileHeader) == 64, "heightmap header layout");
+	static_assert(sizeof(TileEntry) == 24, "heightmap tile table layout");
+
+	uint32_t FloatBits(float f)
+	{
+		uint32_t bits;
+		memcpy(&bits, &f, 4);
+		return bits;
+	}
+
+	float BitsFloat(uint32_t bits)
+	{
+		float f;
+		memcpy(&f, &bits, 4);
+		return f;
+	}
+}
+
+HeightmapFile::HeightmapFile()
+{
+	m_width = m_height = 0;
+	m_tileSize = 64;
+	m_tilesX = m_tilesZ = 0;
+	m_format = HEIGHTMAP_SAMPLES_UINT16;
+	m_minHeight = 0.0f;
+	m_maxHeight = 1.0f;
+}
+
+HeightmapFile::~HeightmapFile()
+{
+	Close();
+}
+
+void HeightmapFile::Create(int width, int height, int tileSize, HeightmapSampleFormat format, float minHeight, float maxHeight)
+{
+	Close();
+	m_width = width;
+	m_height = height;
+	m_tileSize = std::max(tileSize, 1);
+	m_tilesX = (width + m_tileSize - 1) / m_tileSize;
+	m_tilesZ = (height + m_tileSize - 1) / m_tileSize;
+	m_format = format;
+	m_minHeight = minHeight;
+	m_maxHeight = maxHeight > minHeight ? maxHeight : minHeight + 1.0f;
+	m_tiles.resize(m_tilesX * m_tilesZ);
+	for (int i = 0; i < (int)m_tiles.size(); i++)
+	{
+		Tile & tile = m_tiles[i];
+		tile.offset = 0;
+		tile.size = tile.capacity = 0;
+		tile.compression = COMPRESSION_NONE;
+		tile.dirty = true;
+		tile.samples.assign(TileWidth(i % m_tilesX) * TileDepth(i / m_tilesX), minHeight);
+	}
+}
+
+bool HeightmapFile::Open(const std::string & path, int legacyResolution, float legacyScale)
+{
+	Close();
+	if (!m_mapped.Open(path))
+	{
+		return false;
+	}
+
+	FileHeader header;
+	if (m_mapped.Size() < sizeof(FileHeader) || memcmp(m_mapped.Data(), MAGIC, 4) != 0)
+	{
+		//no header - the old 8 bit .raw, read whole and kept in memory until it is saved in the new format
+		if (m_mapped.Size() != (uint64_t)legacyResolution * legacyResolution)
+		{
+			m_mapped.Close();
+			return false;
+		}
+		const uint8_t * bytes = m_mapped.Data();
+		std::vector<float> heights(m_mapped.Size());
+		for (size_t i = 0; i < heights.size(); i++)
+		{
+			heights[i] = bytes[i] * legacyScale;
+		}
+		m_mapped.Close();
+		Create(legacyResolution, legacyResolution, 64, HEIGHTMAP_SAMPLES_UINT16, 0.0f, 256.0f * legacyScale);
+		Write(0, 0, legacyResolution, legacyResolution, heights.data());
+		return true;
+	}
+
+	memcpy(&header, m_mapped.Data(), sizeof(FileHeader));
+	bool valid = header.version == VERSION && header.tileSize > 0 && header.width > 0 && header.height > 0
+		&& (header.format == HEIGHTMAP_SAMPLES_UINT16 || header.format == HEIGHTMAP_SAMPLES_FLOAT);
+	uint64_t tiles = valid ? (uint64_t)((header.width + header.tileSize - 1) / header.tileSize) * ((header.height + header.tileSize - 1) / header.tileSize) : 0;
+	if (!valid || header.tableOffset + tiles * sizeof(TileEntry) > m_mapped.Size())
+	{
+		m_mapped.Close();
+		return false;
+	}
+
+	m_width = header.width;
+	m_height = header.height;
+	m_tileSize = header.tileSize;
+	m_tilesX = (m_width + m_tileSize - 1) / m_tileSize;
+	m_tilesZ = (m_height + m_tileSize - 1) / m_tileSize;
+	m_format = (HeightmapSampleFormat)header.format;
+	m_minHeight = header.minHeight;
+	m_maxHeight = header.maxHeight;
+	m_tiles.resize(m_tilesX * m_tilesZ);
+	for (int i = 0; i < (int)m_tiles.size(); i++)
+	{
+		TileEntry entry;
+		memcpy(&entry, m_mapped.Data() + header.tableOffset + i * sizeof(TileEntry), sizeof(TileEntry));
+		Tile & tile = m_tiles[i];
+		tile.offset = entry.offset;
+		tile.size = entry.size;
+		tile.capacity = entry.capacity;
+		tile.compression = entry.compression;
+		tile.dirty = false;
+		tile.samples.clear();
+		if (entry.offset + entry.size > m_mapped.Size())
+		{
+			tile.offset = 0;		//cut off - reads back flat, and is written again on the next save
+			tile.dirty = true;
+		}
+	}
+	m_path = path;
+	return true;
+}
+
+void HeightmapFile::Close()
+{
+	m_mapped.Close();
+	m_tiles.clear();
+	m_path.clear();
+	m_width = m_height = 0;
+	m_tilesX = m_tilesZ = 0;
+}
+
+std::string HeightmapFile::ContainerPath(const std::string & path)
+{
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+	{
+		dot = path.size();
+	}
+	return path.substr(0, dot) + EXTENSION;
+}
+
+int HeightmapFile::DirtyTiles() const
+{
+	int dirty = 0;
+	for (size_t i = 0; i < m_tiles.size(); i++)
+	{
+		dirty += m_tiles[i].dirty ? 1 : 0;
+	}
+	return dirty;
+}
+
+int HeightmapFile::TileWidth(int tileX) const
+{
+	return std::min(m_tileSize, m_width - tileX * m_tileSize);
+}
+
+int HeightmapFile::TileDepth(int tileZ) const
+{
+	return std::min(m_tileSize, m_height - tileZ * m_tileSize);
+}
+
+uint32_t HeightmapFile::Quantise(float height) const
+{
+	if (m_format == HEIGHTMAP_SAMPLES_FLOAT)
+	{
+		return FloatBits(height);
+	}
+	float scaled = (height - m_minHeight) / (m_maxHeight - m_minHeight) * 65535.0f + 0.5f;
+	return (uint32_t)std::min(std::max(scaled, 0.0f), 65535.0f);
+}
+
+float HeightmapFile::Dequantise(uint32_t sample) const
+{
+	if (m_format == HEIGHTMAP_SAMPLES_FLOAT)
+	{
+		return BitsFloat(sample);
+	}
+	return m_minHeight + sample * ((m_maxHeight - m_minHeight) / 65535.0f);
+}
+
+HeightmapFile::Tile & HeightmapFile::GetTile(int tileX, int tileZ)
+{
+	int index = tileZ * m_tilesX + tileX;
+	if (m_tiles[index].samples.empty())
+	{
+		DecodeTile(index);
+	}
+	return m_tiles[index];
+}
+
+void HeightmapFile::DecodeTile(int index)
+{
+	Tile & tile = m_tiles[index];
+	int width = TileWidth(index % m_tilesX);
+	int depth = TileDepth(index / m_tilesX);
+	tile.samples.assign(width * depth, m_minHeight);
+	if (tile.offset == 0 || !m_mapped.IsOpen())
+	{
+		return;
+	}
+
+	const uint8_t * read = m_mapped.Data() + tile.offset;
+	const uint8_t * end = read + tile.size;
+	int bytesPerSample = m_format == HEIGHTMAP_SAMPLES_FLOAT ? 4 : 2;
+	if (tile.compression == COMPRESSION_NONE)
+	{
+		for (int i = 0; i < width * depth && read + bytesPerSample <= end; i++, read += bytesPerSample)
+		{
+			uint32_t sample = 0;
+			memcpy(&sample, read, bytesPerSample);
+			tile.samples[i] = Dequantise(sample);
+		}
+		return;
+	}
+
+	std::vector<uint32_t> samples(width * depth, 0);
+	for (int i = 0; i < width * depth && read < end; i++)
+	{
+		uint32_t zigzag = 0;
+		for (int shift = 0; read < end && shift < 35; shift += 7)
+		{
+			uint8_t byte = *read++;
+			zigzag |= (uint32_t)(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+			{
+				break;
+			}
+		}
+		uint32_t difference = (zigzag >> 1) ^ (0u - (zigzag & 1));
+		uint32_t predicted = i % width ? samples[i - 1] : (i >= width ? samples[i - width] : 0);
+		samples[i] = predicted + difference;
+	}
+	for (int i = 0; i < width * depth; i++)
+	{
+		tile.samples[i] = Dequantise(samples[i]);
+	}
+}
+
+void HeightmapFile::EncodeTile(int index, std::vector<uint8_t> & bytes, uint32_t & compression) const
+{
+	const Tile & tile = m_tiles[index];
+	int width = TileWidth(index % m_tilesX);
+	int count = (int)tile.samples.size();
+	int bytesPerSample = m_format == HEIGHTMAP_SAMPLES_FLOAT ? 4 : 2;
+
+	std::vector<uint32_t> samples(count);
+	for (int i = 0; i < count; i++)
+	{
+		samples[i] = Quantise(tile.samples[i]);
+	}
+
+	bytes.clear();
+	for (int i = 0; i < count; i++)
+	{
+		uint32_t predicted = i % width ? samples[i - 1] : (i >= width ? samples[i - width] : 0);
+		int32_t difference = (int32_t)(samples[i] - predicted);
+		uint32_t zigzag = ((uint32_t)difference << 1) ^ (uint32_t)(difference >> 31);
+		while (zigzag >= 0x80)
+		{
+			bytes.push_back((uint8_t)(zigzag | 0x80));
+			zigzag >>= 7;
+		}
+		bytes.push_back((uint8_t)zigzag);
+	}
+	compression = COMPRESSION_DELTA;
+
+	if ((int)bytes.size() >= count * bytesPerSample)
+	{
+		bytes.resize(count * bytesPerSample);
+		for (int i = 0; i < count; i++)
+		{
+			memcpy(&bytes[i * bytesPerSample], &samples[i], bytesPerSample);
+		}
+		compression = COMPRESSION_NONE;
+	}
+}
+
+void HeightmapFile::Read(int x, int z, int countX, int countZ, float * heights)
+{
+	for (int row = 0; row < countZ; row++)
+	{
+		int sampleZ = z + row;
+		for (int column = 0; column < countX; )
+		{
+			int sampleX = x + column;
+			int tileX = sampleX / m_tileSize;
+			int tileZ = sampleZ / m_tileSize;
+			int inTileX = sampleX - tileX * m_tileSize;
+			int run = std::min(countX - column, TileWidth(tileX) - inTileX);
+			const Tile & tile = GetTile(tileX, tileZ);
+			memcpy(heights + (size_t)row * countX + column, &tile.samples[(sampleZ - tileZ * m_tileSize) * TileWidth(tileX) + inTileX], run * sizeof(float));
+			column += run;
+		}
+	}
+}
+
+void HeightmapFile::Write(int x, int z, int countX, int countZ, const float * heights)
+{
+	for (int row = 0; row < countZ; row++)
+	{
+		int sampleZ = z + row;
+		for (int column = 0; column < countX; )
+		{
+			int sampleX = x + column;
+			int tileX = sampleX / m_tileSize;
+			int tileZ = sampleZ / m_tileSize;
+			int inTileX = sampleX - tileX * m_tileSize;
+			int run = std::min(countX - column, TileWidth(tileX) - inTileX);
+			Tile & tile = GetTile(tileX, tileZ);
+			float * samples = &tile.samples[(sampleZ - tileZ * m_tileSize) * TileWidth(tileX) + inTileX];
+			const float * source = heights + (size_t)row * countX + column;
+			for (int i = 0; i < run; i++)
+			{
+				//only a change that survives quantising makes the tile dirty
+				if (!tile.dirty && Quantise(source[i]) != Quantise(samples[i]))
+				{
+					tile.dirty = true;
+				}
+				samples[i] = source[i];
+			}
+			column += run;
+		}
+	}
+}
+
+void HeightmapFile::LoadAllTiles()
+{
+	ParallelFor((int)m_tiles.size(), 4, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			if (m_tiles[i].samples.empty())
+			{
+				DecodeTile(i);
+			}
+		}
+	});
+}
+
+bool HeightmapFile::Save(const std::string & path)
+{
+	if (m_tiles.empty())
+	{
+		return false;
+	}
+	bool saved = !m_path.empty() && path == m_path ? WriteDirty() : WriteAll(path);
+	if (!saved)
+	{
+		return false;
+	}
+	m_path = path;
+
+	//remapped to take in tiles that moved to the end. if that fails the old view still holds every undecoded tile,
+	//as a save never moves or overwrites one
+	MappedFile remapped;
+	if (remapped.Open(path))
+	{
+		m_mapped.Swap(remapped);
+	}
+	return true;
+}
+
+bool HeightmapFile::WriteAll(const std::string & path)
+{
+	//every tile is in memory from here on, so the mapping can go - it has to when path is the mapped file itself
+	LoadAllTiles();
+	if (path == m_path)
+	{
+		m_mapped.Close();
+		m_path.clear();		//the old file is gone, so until this save succeeds the next one has to write everything
+	}
+
+	FILE * file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, 4);
+	header.version = VERSION;
+	header.width = m_width;
+	header.height = m_height;
+	header.tileSize = m_tileSize;
+	header.format = m_format;
+	header.minHeight = m_minHeight;
+	header.maxHeight = m_maxHeight;
+	header.tableOffset = sizeof(FileHeader);
+
+	//the tiles are independent, so they are encoded in parallel and written in order
+	std::vector<std::vector<uint8_t>> encoded(m_tiles.size());
+	std::vector<uint32_t> compression(m_tiles.size());
+	ParallelFor((int)m_tiles.size(), 4, [&](int begin, int end)
+	{
+		for (int i = begin; i < end; i++)
+		{
+			EncodeTile(i, encoded[i], compression[i]);
+		}
+	});
+
+	std::vector<TileEntry> table(m_tiles.size());
+	uint64_t offset = header.tableOffset + table.size() * sizeof(TileEntry);
+	for (size_t i = 0; i < m_tiles.size(); i++)
+	{
+		memset(&table[i], 0, sizeof(TileEntry));
+		table[i].offset = offset;
+		table[i].size = table[i].capacity = (uint32_t)encoded[i].size();
+		table[i].compression = compression[i];
+		offset += encoded[i].size();
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	ok = ok && fwrite(table.data(), sizeof(TileEntry), table.size(), file) == table.size();
+	for (size_t i = 0; ok && i < m_tiles.size(); i++)
+	{
+		ok = fwrite(encoded[i].data(), 1, encoded[i].size(), file) == encoded[i].size();
+	}
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < m_tiles.size(); i++)
+	{
+		m_tiles[i].offset = table[i].offset;
+		m_tiles[i].size = table[i].size;
+		m_tiles[i].capacity = table[i].capacity;
+		m_tiles[i].compression = table[i].compression;
+		m_tiles[i].dirty = false;
+	}
+	return true;
+}
+
+bool HeightmapFile::WriteDirty()
+{
+	//opened while the mapping is still held, so a save that fails leaves the tiles not yet read decodable
+	FILE * file = fopen(m_path.c_str(), "r+b");
+	if (!file)
+	{
+		return false;
+	}
+	bool ok = _fseeki64(file, 0, SEEK_END) == 0;
+	int64_t fileEnd = _ftelli64(file);
+	ok = ok && fileEnd >= (int64_t)sizeof(FileHeader);
+
+	//the new slots go into a copy of the table, the tiles only take them once everything is on disk
+	std::vector<TileEntry> table(m_tiles.size());
+	for (size_t i = 0; i < m_tiles.size(); i++)
+	{
+		memset(&table[i], 0, sizeof(TileEntry));
+		table[i].offset = m_tiles[i].offset;
+		table[i].size = m_tiles[i].size;
+		table[i].capacity = m_tiles[i].capacity;
+		table[i].compression = m_tiles[i].compression;
+	}
+
+	std::vector<uint8_t> bytes;
+	for (size_t i = 0; ok && i < m_tiles.size(); i++)
+	{
+		if (!m_tiles[i].dirty)
+		{
+			continue;
+		}
+		if (m_tiles[i].samples.empty())
+		{
+			DecodeTile((int)i);		//cut off in the file it was opened from, so flat
+		}
+		TileEntry & entry = table[i];
+		EncodeTile((int)i, bytes, entry.compression);
+		if (entry.offset == 0 || bytes.size() > entry.capacity)
+		{
+			//outgrew its slot, so it moves to the end and the old slot is left unused
+			entry.offset = fileEnd;
+			entry.capacity = (uint32_t)bytes.size();
+			fileEnd += bytes.size();
+		}
+		entry.size = (uint32_t)bytes.size();
+		ok = _fseeki64(file, (int64_t)entry.offset, SEEK_SET) == 0 && fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+	}
+	ok = ok && _fseeki64(file, sizeof(FileHeader), SEEK_SET) == 0 && fwrite(table.data(), sizeof(TileEntry), table.size(), file) == table.size();
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < m_tiles.size(); i++)
+	{
+		m_tiles[i].offset = table[i].offset;
+		m_tiles[i].size = table[i].size;
+		m_tiles[i].capacity = table[i].capacity;
+		m_tiles[i].compression = table[i].compression;
+		m_tiles[i].dirty = false;
+	}
+	return true;
+}
+
+std::string HeightmapFile::Benchmark(int resolution)
+{
+	const char * path = "heightmap_benchmark.whm";
+	std::vector<float> heights((size_t)resolution * resolution);
+	HeightmapGenerator::Generate(HeightmapSettings(), resolution, heights.data());
+	for (size_t i = 0; i < heights.size(); i++)
+	{
+		heights[i] *= 64.0f;
+	}
+
+	HeightmapFile map;
+	map.Create(resolution, resolution, 64, HEIGHTMAP_SAMPLES_UINT16, 0.0f, 64.0f);
+	map.Write(0, 0, resolution, resolution, heights.data());
+	auto saveStart = std::chrono::high_resolution_clock::now();
+	bool ok = map.Save(path);
+	auto saveEnd = std::chrono::high_resolution_clock::now();
+	map.Close();
+
+	//open only maps, the tiles are decoded when read
+	HeightmapFile loaded;
+	auto openStart = std::chrono::high_resolution_clock::now();
+	ok = ok && loaded.Open(path, 0, 0.0f);
+	auto openEnd = std::chrono::high_resolution_clock::now();
+	uint64_t fileSize = loaded.m_mapped.Size();
+	std::vector<float> readBack(heights.size());
+	auto readStart = std::chrono::high_resolution_clock::now();
+	if (ok)
+	{
+		loaded.LoadAllTiles();
+		loaded.Read(0, 0, resolution, resolution, readBack.data());
+	}
+	auto readEnd = std::chrono::high_resolution_clock::now();
+
+	float worst = 0.0f;
+	for (size_t i = 0; i < heights.size(); i++)
+	{
+		worst = std::max(worst, fabsf(readBack[i] - heights[i]));
+	}
+
+	//a sculpt sized edit, then a save that only writes what it touched
+	const int brush = std::min(100, resolution);
+	std::vector<float> edit(brush * brush);
+	int editX = (resolution - brush) / 2;
+	loaded.Read(editX, editX, brush, brush, edit.data());
+	for (size_t i = 0; i < edit.size(); i++)
+	{
+		edit[i] = std::min(edit[i] + 1.0f, 64.0f);
+	}
+	loaded.Write(editX, editX, brush, brush, edit.data());
+	int dirty = loaded.DirtyTiles();
+	auto dirtyStart = std::chrono::high_resolution_clock::now();
+	ok = ok && loaded.Save(path);
+	auto dirtyEnd = std::chrono::high_resolution_clock::now();
+	loaded.Close();
+
+	HeightmapFile check;
+	ok = ok && check.Open(path, 0, 0.0f);
+	std::vector<float> checkEdit(edit.size());
+	if (ok)
+	{
+		check.Read(editX, editX, brush, brush, checkEdit.data());
+	}
+	for (size_t i = 0; i < edit.size(); i++)
+	{
+		worst = std::max(worst, fabsf(checkEdit[i] - edit[i]));
+	}
+	check.Close();
+	remove(path);
+
+	auto ms = [](std::chrono::high_resolution_clock::time_point a, std::chrono::high_resolution_clock::time_point b)
+	{
+		return std::chrono::duration<double, std::milli>(b - a).count();
+	};
+	std::ostringstream report;
+	report << "Heightmap file, " << resolution << " x " << resolution << " 16 bit in 64 sample tiles: " << fileSize / 1024 << " KB ("
+		<< fileSize * 100.0 / (heights.size() * 2.0) << "% of raw), save " << ms(saveStart, saveEnd) << " ms, open "
+		<< ms(openStart, openEnd) << " ms, decode all " << ms(readStart, readEnd) << " ms, save after editing " << dirty
+		<< " tiles " << ms(dirtyStart, dirtyEnd) << " ms" << (ok && worst <= 0.5f * 64.0f / 65535.0f + 1e-5f ? "" : " (ROUND TRIP BROKEN)") << "\n";
+	return report.str();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//the terrain heightmap on disk - a versioned container of fixed size square tiles, each stored either as plain samples
+//or delta coded when that is smaller. samples are 16 bit heights over a range given in the header, or plain floats.
+//the file is memory mapped and a tile is only decoded the first time it is read. saving back to the file it came from
+//writes just the tiles that changed, in their old slot when they still fit and at the end of the file otherwise.
+//a headerless 8 bit .raw, the old format, opens as well. it is never written over - older builds and other tools still
+//read it - so an imported map is saved to the container beside it, at ContainerPath.
+//
+//layout, little endian:
+//	header		64 bytes, see FileHeader in the .cpp
+//	tile table	one 24 byte entry per tile, row by row: offset, stored size, slot size, compression
+//	tile data	the tiles, each tileSize x tileSize samples row by row, less along the far edges
+
+enum HeightmapSampleFormat
+{
+	HEIGHTMAP_SAMPLES_UINT16 = 1,
+	HEIGHTMAP_SAMPLES_FLOAT = 2
+};
+
+class HeightmapFile
+{
+public:
+	HeightmapFile();
+	~HeightmapFile();
+
+	//a new, flat heightmap. 16 bit samples cover minHeight to maxHeight, float samples ignore them
+	void Create(int width, int height, int tileSize, HeightmapSampleFormat format, float minHeight, float maxHeight);
+	//maps a heightmap file. an old headerless .raw of legacyResolution squared bytes is imported, each byte times legacyScale
+	bool Open(const std::string & path, int legacyResolution, float legacyScale);
+	bool Save(const std::string & path);	//only the dirty tiles when path is the file that was opened, everything otherwise
+	void Close();
+	static std::string ContainerPath(const std::string & path);		//path with its extension swapped for .whm
+
+	int Width() const		{ return m_width; }
+	int Height() const		{ return m_height; }
+	int TileSize() const	{ return m_tileSize; }
+	int DirtyTiles() const;
+
+	//copy a rectangle of heights out of or into the map, row by row, count wide. writing only dirties the tiles it changes
+	void Read(int x, int z, int countX, int countZ, float * heights);
+	void Write(int x, int z, int countX, int countZ, const float * heights);
+	void LoadAllTiles();		//decodes every tile not yet read, spread over the ParallelFor workers
+
+	static std::string Benchmark(int resolution);
+
+private:
+	struct Tile
+	{
+		uint64_t			offset;			//in the file, 0 for a tile that has never been written
+		uint32_t			size;			//bytes stored
+		uint32_t			capacity;		//bytes the slot can hold
+		uint32_t			compression;
+		bool				dirty;
+		std::vector<float>	samples;		//decoded, empty until first read
+	};
+
+	Tile & GetTile(int tileX, int tileZ);		//decoded
+	void DecodeTile(int index);
+	void EncodeTile(int index, std::vector<uint8_t> & bytes, uint32_t & compression) const;
+	int TileWidth(int tileX) const;
+	int TileDepth(int tileZ) const;
+	uint32_t Quantise(float height) const;
+	float Dequantise(uint32_t sample) const;
+	bool WriteAll(const std::string & path);
+	bool WriteDirty();
+
+	int						m_width, m_height, m_tileSize;
+	int						m_tilesX, m_tilesZ;
+	HeightmapSampleFormat	m_format;
+	float					m_minHeight, m_maxHeight;
+	std::vector<Tile>		m_tiles;
+	std::string				m_path;			//the container file the tiles came from, empty for new or imported maps
+
+	MappedFile				m_mapped;		//m_path, the undecoded tiles are read from it in place
+};
@@ -0,0 +1,272 @@
+#include "HeightmapGenerator.h"
+#include "ParallelFor.h"
+#include "SeedHash.h"
+#include <DirectXMath.h>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <vector>
+
+using namespace DirectX;
+
+
+HeightmapSettings::HeightmapSettings()
+{
+	seed = 1;
+	noise = HEIGHTMAP_FBM;
+	octaves = 6;
+	frequency = 4.0f;
+	lacunarity = 2.0f;
+	gain = 0.5f;
+	warpStrength = 0.5f;
+	warpFrequency = 2.0f;
+	warpOctaves = 3;
+}
+
+namespace
+{
+	const int	MAX_OCTAVES = 16;
+	const int	ROWS_PER_TASK = 8;
+
+	//frequency, weight and lattice offset of every octave of one fbm, worked out once per field.
+	//the seed only moves each octave to a different part of the lattice, so the noise itself needs no seed
+	struct Octaves
+	{
+		int		count;
+		float	frequency[MAX_OCTAVES];
+		float	amplitude[MAX_OCTAVES];		//adds up to 1
+		float	offsetX[MAX_OCTAVES];
+		float	offsetZ[MAX_OCTAVES];
+
+		Octaves(unsigned int seed, unsigned int layer, int octaves, float frequency0, float lacunarity, float gain)
+		{
+			count = std::max(1, std::min(octaves, MAX_OCTAVES));
+			float total = 0.0f;
+			float octaveFrequency = frequency0;
+			float octaveAmplitude = 1.0f;
+			for (int octave = 0; octave < count; octave++)
+			{
+				unsigned int h = Hash(seed, layer, octave);
+				frequency[octave] = octaveFrequency;
+				amplitude[octave] = octaveAmplitude;
+				offsetX[octave] = (float)(h & 1023);			//whole numbers, so they shift the lattice without blurring it
+				offsetZ[octave] = (float)((h >> 10) & 1023);
+				total += octaveAmplitude;
+				octaveFrequency *= lacunarity;
+				octaveAmplitude *= gain;
+			}
+			for (int octave = 0; octave < count; octave++)
+			{
+				amplitude[octave] /= total;
+			}
+		}
+	};
+
+	//a pseudo random gradient for each lattice point, -1 to 1 on both axes, from an integer hash of its coordinates a
+	//lane at a time. the coordinates are whole numbers well inside float precision and the gradients are 16 bit steps
+	//scaled by a power of two, so both convert exactly
+	inline void XM_CALLCONV LatticeGradient(FXMVECTOR latticeX, FXMVECTOR latticeZ, XMVECTOR & gradientX, XMVECTOR & gradientZ)
+	{
+		XMFLOAT4 x, z, gx, gz;
+		XMStoreFloat4(&x, latticeX);
+		XMStoreFloat4(&z, latticeZ);
+		const float * x4 = &x.x, * z4 = &z.x;
+		float * gx4 = &gx.x, * gz4 = &gz.x;
+		for (int lane = 0; lane < 4; lane++)
+		{
+			unsigned int h = Hash((unsigned int)(int)x4[lane], (unsigned int)(int)z4[lane], 0);
+			gx4[lane] = (float)((int)(h & 0xFFFF) - 32768) * (1.0f / 32768.0f);
+			gz4[lane] = (float)((int)(h >> 16) - 32768) * (1.0f / 32768.0f);
+		}
+		gradientX = XMLoadFloat4(&gx);
+		gradientZ = XMLoadFloat4(&gz);
+	}
+
+	//2d gradient noise, roughly -1 to 1, four samples at once
+	XMVECTOR XM_CALLCONV GradientNoise(FXMVECTOR x, FXMVECTOR z)
+	{
+		const XMVECTOR one = XMVectorReplicate(1.0f);
+		XMVECTOR latticeX = XMVectorFloor(x);
+		XMVECTOR latticeZ = XMVectorFloor(z);
+		XMVECTOR fx = x - latticeX;
+		XMVECTOR fz = z - latticeZ;
+		XMVECTOR latticeX1 = latticeX + one;
+		XMVECTOR latticeZ1 = latticeZ + one;
+		XMVECTOR fx1 = fx - one;
+		XMVECTOR fz1 = fz - one;
+
+		XMVECTOR gx, gz;
+		LatticeGradient(latticeX, latticeZ, gx, gz);
+		XMVECTOR d00 = gx * fx + gz * fz;
+		LatticeGradient(latticeX1, latticeZ, gx, gz);
+		XMVECTOR d10 = gx * fx1 + gz * fz;
+		LatticeGradient(latticeX, latticeZ1, gx, gz);
+		XMVECTOR d01 = gx * fx + gz * fz1;
+		LatticeGradient(latticeX1, latticeZ1, gx, gz);
+		XMVECTOR d11 = gx * fx1 + gz * fz1;
+
+		//quintic fade, 6t^5 - 15t^4 + 10t^3, so the surface is smooth across lattice lines
+		const XMVECTOR six = XMVectorReplicate(6.0f);
+		const XMVECTOR fifteen = XMVectorReplicate(15.0f);
+		const XMVECTOR ten = XMVectorReplicate(10.0f);
+		XMVECTOR ux = fx * fx * fx * (fx * (fx * six - fifteen) + ten);
+		XMVECTOR uz = fz * fz * fz * (fz * (fz * six - fifteen) + ten);
+
+		XMVECTOR nearRow = (d10 - d00) * ux + d00;
+		XMVECTOR farRow = (d11 - d01) * ux + d01;
+		return (farRow - nearRow) * uz + nearRow;
+	}
+
+	XMVECTOR XM_CALLCONV Fbm(FXMVECTOR x, FXMVECTOR z, const Octaves & octaves)
+	{
+		XMVECTOR sum = XMVectorZero();
+		for (int octave = 0; octave < octaves.count; octave++)
+		{
+			XMVECTOR px = x * XMVectorReplicate(octaves.frequency[octave]) + XMVectorReplicate(octaves.offsetX[octave]);
+			XMVECTOR pz = z * XMVectorReplicate(octaves.frequency[octave]) + XMVectorReplicate(octaves.offsetZ[octave]);
+			sum = GradientNoise(px, pz) * XMVectorReplicate(octaves.amplitude[octave]) + sum;
+		}
+		return sum;
+	}
+
+	//musgrave's ridged multifractal - each octave is folded into sharp ridges, and only shows up strongly where the
+	//octaves above it were already high, so the detail gathers along the crests and the valleys stay smooth
+	XMVECTOR XM_CALLCONV Ridged(FXMVECTOR x, FXMVECTOR z, const Octaves & octaves)
+	{
+		const XMVECTOR one = XMVectorReplicate(1.0f);
+		const XMVECTOR two = XMVectorReplicate(2.0f);
+		XMVECTOR sum = XMVectorZero();
+		XMVECTOR weight = one;
+		for (int octave = 0; octave < octaves.count; octave++)
+		{
+			XMVECTOR px = x * XMVectorReplicate(octaves.frequency[octave]) + XMVectorReplicate(octaves.offsetX[octave]);
+			XMVECTOR pz = z * XMVectorReplicate(octaves.frequency[octave]) + XMVectorReplicate(octaves.offsetZ[octave]);
+			XMVECTOR signal = one - XMVectorAbs(GradientNoise(px, pz));
+			signal = signal * signal * weight;
+			weight = XMVectorSaturate(signal * two);
+			sum = signal * XMVectorReplicate(octaves.amplitude[octave]) + sum;
+		}
+		return sum;
+	}
+}
+
+void HeightmapGenerator::Generate(const HeightmapSettings & settings, int resolution, float * heights)
+{
+	if (resolution < 2)
+	{
+		std::fill(heights, heights + std::max(resolution, 0) * std::max(resolution, 0), 0.5f);
+		return;
+	}
+
+	const Octaves shape(settings.seed, 0, settings.octaves, settings.frequency, settings.lacunarity, settings.gain);
+	const Octaves warpX(settings.seed, 1, settings.warpOctaves, settings.warpFrequency, 2.0f, 0.5f);
+	const Octaves warpZ(settings.seed, 2, settings.warpOctaves, settings.warpFrequency, 2.0f, 0.5f);
+	const bool warped = settings.warpStrength > 0.0f && settings.frequency > 0.0f;
+	const bool ridged = settings.noise == HEIGHTMAP_RIDGED;
+	const float step = 1.0f / (resolution - 1);
+
+	ParallelFor(resolution, ROWS_PER_TASK, [&](int begin, int end)
+	{
+		const XMVECTOR step4 = XMVectorReplicate(step);
+		const XMVECTOR warp4 = XMVectorReplicate(settings.warpStrength / std::max(settings.frequency, 1e-6f));	//first octave cycles to map units
+		const XMVECTOR half4 = XMVectorReplicate(0.5f);
+		for (int row = begin; row < end; row++)
+		{
+			const XMVECTOR z = XMVectorReplicate((float)row) * step4;
+			float * out = heights + (size_t)row * resolution;
+			for (int column = 0; column < resolution; column += 4)
+			{
+				XMVECTOR x = XMVectorSet((float)column, (float)(column + 1), (float)(column + 2), (float)(column + 3)) * step4;
+				XMVECTOR sampleX = x;
+				XMVECTOR sampleZ = z;
+				if (warped)
+				{
+					sampleX = Fbm(x, z, warpX) * warp4 + x;
+					sampleZ = Fbm(x, z, warpZ) * warp4 + z;
+				}
+				XMVECTOR height = ridged ? Ridged(sampleX, sampleZ, shape) : Fbm(sampleX, sampleZ, shape) + half4;
+				height = XMVectorSaturate(height);
+
+				if (column + 4 <= resolution)
+				{
+					XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(out + column), height);
+				}
+				else
+				{
+					XMFLOAT4 tail;
+					XMStoreFloat4(&tail, height);
+					const float * tail4 = &tail.x;
+					for (int lane = 0; column + lane < resolution; lane++)
+					{
+						out[column + lane] = tail4[lane];
+					}
+				}
+			}
+		}
+	});
+}
+
+unsigned int HeightmapGenerator::Checksum(const float * heights, int count)
+{
+	unsigned int h = 2166136261u;
+	for (int i = 0; i < count; i++)
+	{
+		unsigned int quantised = (unsigned int)(std::min(std::max(heights[i], 0.0f), 1.0f) * 65535.0f + 0.5f);
+		h = (h ^ (quantised & 0xFF)) * 16777619u;
+		h = (h ^ (quantised >> 8)) * 16777619u;
+	}
+	return h;
+}
+
+std::string HeightmapGenerator::Benchmark(int resolution)
+{
+	//256 x 256 fields of the default settings, plain and ridged, for seeds 1 to 3. a change here means every saved
+	//generator seed now builds a different terrain, so it should only happen on purpose. they hold for SSE, AVX and
+	//plain float builds alike, as long as the compiler isn't told to fuse multiplies and adds itself (/fp:contract)
+	const int checkResolution = 256;
+	const unsigned int golden[3][2] =
+	{
+		{ 0x69b4d9acu, 0x22b0caf2u },
+		{ 0x525815a6u, 0x789b99f7u },
+		{ 0xb38b559du, 0xd7b6d555u },
+	};
+	std::vector<float> heights(checkResolution * checkResolution);
+	int matching = 0;
+	std::ostringstream checksums;
+	for (int seed = 1; seed <= 3; seed++)
+	{
+		for (int ridged = 0; ridged < 2; ridged++)
+		{
+			HeightmapSettings settings;
+			settings.seed = seed;
+			settings.noise = ridged ? HEIGHTMAP_RIDGED : HEIGHTMAP_FBM;
+			Generate(settings, checkResolution, heights.data());
+			unsigned int checksum = Checksum(heights.data(), (int)heights.size());
+			checksums << std::hex << " 0x" << checksum << std::dec;
+			if (checksum == golden[seed - 1][ridged])
+			{
+				matching++;
+			}
+		}
+	}
+
+	heights.assign((size_t)resolution * resolution, 0.0f);
+	HeightmapSettings settings;
+	auto fbmStart = std::chrono::high_resolution_clock::now();
+	Generate(settings, resolution, heights.data());
+	auto fbmEnd = std::chrono::high_resolution_clock::now();
+	settings.noise = HEIGHTMAP_RIDGED;
+	Generate(settings, resolution, heights.data());
+	auto ridgedEnd = std::chrono::high_resolution_clock::now();
+
+	double fbmMs = std::chrono::duration<double, std::milli>(fbmEnd - fbmStart).count();
+	double ridgedMs = std::chrono::duration<double, std::milli>(ridgedEnd - fbmEnd).count();
+	double samples = (double)resolution * resolution;
+
+	std::ostringstream report;
+	report << "Heightmap generator, " << resolution << " x " << resolution << ", " << settings.octaves << " octaves warped by "
+		<< settings.warpOctaves << " on " << ParallelWorkerCount() << " threads: fbm " << fbmMs << " ms ("
+		<< samples / (fbmMs * 1000.0) << " M samples/s), ridged " << ridgedMs << " ms. checksums" << checksums.str()
+		<< (matching == 6 ? "" : " (CHECKSUM MISMATCH)") << "\n";
+	return report.str();
+}
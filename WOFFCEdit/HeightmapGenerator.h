@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+//procedural terrain - fractal gradient noise, summed over octaves as plain fbm or as a ridged multifractal, with the
+//sample position optionally warped by a second, coarser fbm first.
+//noise is evaluated four samples at a time, and rows are handed out to the ParallelFor workers. the lattice is hashed
+//with integer arithmetic, and the noise is separate multiplies and adds that are never fused into one, so every step
+//rounds the same with or without FMA and a seed gives the same heights on every machine and thread count.
+
+enum HeightmapNoise
+{
+	HEIGHTMAP_FBM,
+	HEIGHTMAP_RIDGED
+};
+
+struct HeightmapSettings
+{
+	unsigned int	seed;
+	HeightmapNoise	noise;
+	int				octaves;
+	float			frequency;			//noise cycles across the whole map for the first octave
+	float			lacunarity;			//frequency multiplier per octave
+	float			gain;				//amplitude multiplier per octave
+	float			warpStrength;		//how far the domain is pushed, in first octave cycles. 0 turns warping off
+	float			warpFrequency;		//cycles across the map of the warping fbm
+	int				warpOctaves;
+
+	HeightmapSettings();
+};
+
+class HeightmapGenerator
+{
+public:
+	//fills a resolution x resolution field, row by row, with heights from 0 to 1
+	static void Generate(const HeightmapSettings & settings, int resolution, float * heights);
+
+	static unsigned int Checksum(const float * heights, int count);	//fnv-1a over the heights quantised to 16 bits
+
+	static std::string Benchmark(int resolution);	//times one field of this size, and checks the small fields against known checksums
+};
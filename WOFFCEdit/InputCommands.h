@@ -21,7 +21,14 @@ struct InputCommands
 	bool key_v;
 	bool key_x;
 	bool key_r;
+	bool key_z;
+	bool key_y;
+	bool key_lbracket;	//[ and ] turn the selection, - and = scale it
+	bool key_rbracket;
+	bool key_minus;
+	bool key_plus;
 	bool control;
+	bool shift;
 
 	float terrainDirection;
 
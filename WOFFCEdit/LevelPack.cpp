@@ -0,0 +1,1083 @@
+#include "LevelPack.h"
+#include "DatabaseMigration.h"
+#include "HeightmapFile.h"
+#include "objToCmo.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <sys/stat.h>
+
+namespace
+{
+	const char		MAGIC[4] = { 'W', 'P', 'A', 'K' };
+	const uint32_t	VERSION = 2;
+	const uint64_t	ALIGNMENT = 64;
+
+	//what the pack remembers of a file it was cooked from
+	struct FileStamp
+	{
+		uint64_t	size;
+		int64_t		modified;
+	};
+
+	struct PackHeader
+	{
+		char		magic[4];
+		uint32_t	version;
+		uint32_t	entryCount;
+		uint32_t	reserved;
+		uint64_t	contentsOffset;
+		uint64_t	stringsOffset;
+		uint64_t	stringsSize;
+		FileStamp	database;
+		FileStamp	heightmap;
+		uint8_t		padding[56];
+	};
+
+	struct PackedString
+	{
+		uint32_t	offset, length;
+	};
+
+	struct PackEntry
+	{
+		uint32_t		type;
+		uint32_t		reserved;
+		PackedString	name;
+		uint64_t		offset;
+		uint64_t		size;
+	};
+
+	//a SceneObject with fixed size fields and its strings moved out
+	struct PackedObject
+	{
+		int32_t			ID, chunk_ID, parent_id, health_amount, min_dist, max_dist, light_type;
+		uint32_t		flags;				//the bools, in the order of OBJECT_FLAGS
+		float			values[25];			//the floats, in the order of OBJECT_VALUES
+		PackedString	model_path, tex_diffuse_path, collision_mesh, audio_path, name;
+	};
+
+	struct PackedChunk
+	{
+		int32_t			ID, chunk_x_size_metres, chunk_y_size_metres, chunk_base_resolution;
+		int32_t			tex_diffuse_tiling, tex_splat_1_tiling, tex_splat_2_tiling, tex_splat_3_tiling, tex_splat_4_tiling;
+		uint32_t		flags;				//1 render_wireframe, 2 render_normals
+		int32_t			heightResolution;
+		PackedString	name, heightmap_path, tex_diffuse_path, tex_splat_alpha_path;
+		PackedString	tex_splat_1_path, tex_splat_2_path, tex_splat_3_path, tex_splat_4_path;
+	};
+
+	//a level of a PACK_LOD entry, its CMO at offset from the start of the entry
+	struct PackedLod
+	{
+		float			error;
+		uint32_t		size;
+		uint64_t		offset;
+	};
+
+	static_assert(sizeof(PackHeader) == 128, "pack header size incorrect");
+	static_assert(sizeof(PackEntry) == 32, "pack entry size incorrect");
+	static_assert(sizeof(PackedLod) == 16, "packed lod size incorrect");
+
+	bool SceneObject::* const OBJECT_FLAGS[] = { &SceneObject::render, &SceneObject::collision, &SceneObject::collectable,
+		&SceneObject::destructable, &SceneObject::editor_render, &SceneObject::editor_texture_vis, &SceneObject::editor_normals_vis,
+		&SceneObject::editor_collision_vis, &SceneObject::editor_pivot_vis, &SceneObject::snapToGround, &SceneObject::AINode,
+		&SceneObject::one_shot, &SceneObject::play_on_init, &SceneObject::play_in_editor, &SceneObject::camera, &SceneObject::path_node,
+		&SceneObject::path_node_start, &SceneObject::path_node_end, &SceneObject::editor_wireframe };
+
+	float SceneObject::* const OBJECT_VALUES[] = { &SceneObject::posX, &SceneObject::posY, &SceneObject::posZ,
+		&SceneObject::rotX, &SceneObject::rotY, &SceneObject::rotZ, &SceneObject::scaX, &SceneObject::scaY, &SceneObject::scaZ,
+		&SceneObject::pivotX, &SceneObject::pivotY, &SceneObject::pivotZ, &SceneObject::volume, &SceneObject::pitch, &SceneObject::pan,
+		&SceneObject::light_diffuse_r, &SceneObject::light_diffuse_g, &SceneObject::light_diffuse_b,
+		&SceneObject::light_specular_r, &SceneObject::light_specular_g, &SceneObject::light_specular_b,
+		&SceneObject::light_spot_cutoff, &SceneObject::light_constant, &SceneObject::light_linear, &SceneObject::light_quadratic };
+
+	static_assert(sizeof(OBJECT_VALUES) / sizeof(OBJECT_VALUES[0]) == sizeof(PackedObject::values) / sizeof(float), "object values out of step");
+	static_assert(sizeof(OBJECT_FLAGS) / sizeof(OBJECT_FLAGS[0]) <= 32, "too many object flags");
+
+	//the strings of the pack, each stored once however often it is used
+	class StringWriter
+	{
+	public:
+		PackedString Add(const std::string & text)
+		{
+			auto found = m_offsets.find(text);
+			PackedString packed;
+			packed.length = (uint32_t)text.size();
+			if (found != m_offsets.end())
+			{
+				packed.offset = found->second;
+				return packed;
+			}
+			packed.offset = (uint32_t)m_blob.size();
+			m_offsets[text] = packed.offset;
+			m_blob.insert(m_blob.end(), text.begin(), text.end());
+			return packed;
+		}
+		PackedString Add(StringHandle path)
+		{
+			return Add(StringTable::AssetPaths().Lookup(path));
+		}
+		const std::vector<char> & Blob() const	{ return m_blob; }
+
+	private:
+		std::vector<char>						m_blob;
+		std::unordered_map<std::string, uint32_t>	m_offsets;
+	};
+
+	void PackObject(const SceneObject & object, StringWriter & strings, PackedObject & packed)
+	{
+		packed.ID = object.ID;
+		packed.chunk_ID = object.chunk_ID;
+		packed.parent_id = object.parent_id;
+		packed.health_amount = object.health_amount;
+		packed.min_dist = object.min_dist;
+		packed.max_dist = object.max_dist;
+		packed.light_type = object.light_type;
+		packed.flags = 0;
+		for (size_t i = 0; i < sizeof(OBJECT_FLAGS) / sizeof(OBJECT_FLAGS[0]); i++)
+		{
+			packed.flags |= (object.*OBJECT_FLAGS[i] ? 1u : 0u) << i;
+		}
+		for (size_t i = 0; i < sizeof(OBJECT_VALUES) / sizeof(OBJECT_VALUES[0]); i++)
+		{
+			packed.values[i] = object.*OBJECT_VALUES[i];
+		}
+		packed.model_path = strings.Add(object.model_path);
+		packed.tex_diffuse_path = strings.Add(object.tex_diffuse_path);
+		packed.collision_mesh = strings.Add(object.collision_mesh);
+		packed.audio_path = strings.Add(object.audio_path);
+		packed.name = strings.Add(object.name);
+	}
+
+	StringHandle UnpackPath(const char * strings, const PackedString & packed)
+	{
+		return StringTable::AssetPaths().Intern(strings + packed.offset, packed.length);
+	}
+
+	std::string UnpackString(const char * strings, const PackedString & packed)
+	{
+		return std::string(strings + packed.offset, packed.length);
+	}
+
+	void UnpackObject(const PackedObject & packed, const char * strings, SceneObject & object)
+	{
+		object.ID = packed.ID;
+		object.chunk_ID = packed.chunk_ID;
+		object.parent_id = packed.parent_id;
+		object.health_amount = packed.health_amount;
+		object.min_dist = packed.min_dist;
+		object.max_dist = packed.max_dist;
+		object.light_type = packed.light_type;
+		for (size_t i = 0; i < sizeof(OBJECT_FLAGS) / sizeof(OBJECT_FLAGS[0]); i++)
+		{
+			object.*OBJECT_FLAGS[i] = (packed.flags >> i & 1) != 0;
+		}
+		for (size_t i = 0; i < sizeof(OBJECT_VALUES) / sizeof(OBJECT_VALUES[0]); i++)
+		{
+			object.*OBJECT_VALUES[i] = packed.values[i];
+		}
+		object.model_path = UnpackPath(strings, packed.model_path);
+		object.tex_diffuse_path = UnpackPath(strings, packed.tex_diffuse_path);
+		object.collision_mesh = UnpackPath(strings, packed.collision_mesh);
+		object.audio_path = UnpackPath(strings, packed.audio_path);
+		object.name = UnpackString(strings, packed.name);
+	}
+
+	bool Stamp(const std::string & path, FileStamp & stamp)
+	{
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+		{
+			return false;
+		}
+		stamp.size = (uint64_t)info.st_size;
+		stamp.modified = (int64_t)info.st_mtime;
+		return true;
+	}
+
+	bool ReadFile(const std::string & path, std::vector<uint8_t> & data)
+	{
+		FILE * file = fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		data.resize(size > 0 ? size : 0);
+		bool read = size > 0 && fread(data.data(), 1, data.size(), file) == data.size();
+		fclose(file);
+		return read;
+	}
+
+	//writes payloads one after another at aligned offsets, and keeps their entries
+	class PackWriter
+	{
+	public:
+		PackWriter(FILE * file) : m_file(file), m_offset(0), m_failed(false) {}
+
+		void Write(const void * data, size_t bytes)
+		{
+			m_failed |= bytes && fwrite(data, 1, bytes, m_file) != bytes;
+			m_offset += bytes;
+		}
+		void Align()
+		{
+			static const uint8_t zeros[ALIGNMENT] = {};
+			Write(zeros, (size_t)((ALIGNMENT - m_offset % ALIGNMENT) % ALIGNMENT));
+		}
+		void Payload(PackEntryType type, PackedString name, const void * data, size_t bytes)
+		{
+			Align();
+			PackEntry entry;
+			entry.type = type;
+			entry.reserved = 0;
+			entry.name = name;
+			entry.offset = m_offset;
+			entry.size = bytes;
+			m_entries.push_back(entry);
+			Write(data, bytes);
+		}
+
+		uint64_t						Offset() const		{ return m_offset; }
+		bool							Failed() const		{ return m_failed; }
+		const std::vector<PackEntry> &	Entries() const		{ return m_entries; }
+
+	private:
+		FILE *					m_file;
+		uint64_t				m_offset;
+		bool					m_failed;
+		std::vector<PackEntry>	m_entries;
+	};
+
+	//interns a text column straight from sqlite's buffer, so a path already in the table costs no allocation
+	StringHandle ColumnPath(sqlite3_stmt * statement, int column)
+	{
+		const char * text = reinterpret_cast<const char*>(sqlite3_column_text(statement, column));
+		return StringTable::AssetPaths().Intern(text, sqlite3_column_bytes(statement, column));
+	}
+
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+LevelPack::LevelPack()
+{
+	m_objects = m_chunk = m_heights = -1;
+}
+
+LevelPack::~LevelPack()
+{
+	Close();
+}
+
+void LevelPack::ReadDatabase(sqlite3 * database, Scene & scene, ChunkObject & chunk)
+{
+	sqlite3_stmt *pResults;								//results of the query
+	sqlite3_stmt *pResultsChunk;
+
+	//OBJECTS IN THE WORLD
+	//prepare SQL Text
+	const char * sqlCommand = "SELECT " OBJECT_COLUMNS " from Objects";	//sql command which will return all records from the objects table. columns named so the ordinals below match
+	//Send Command and fill result object
+	sqlite3_prepare_v2(database, sqlCommand, -1, &pResults, 0);
+
+	//loop for each row in results until there are no more rows.  ie for every row in the results. We create and object
+	while (sqlite3_step(pResults) == SQLITE_ROW)
+	{
+		SceneObject newSceneObject;
+		newSceneObject.ID = sqlite3_column_int(pResults, 0);
+		newSceneObject.chunk_ID = sqlite3_column_int(pResults, 1);
+		newSceneObject.model_path		= ColumnPath(pResults, 2);
+		newSceneObject.tex_diffuse_path = ColumnPath(pResults, 3);
+		newSceneObject.posX = sqlite3_column_double(pResults, 4);
+		newSceneObject.posY = sqlite3_column_double(pResults, 5);
+		newSceneObject.posZ = sqlite3_column_double(pResults, 6);
+		newSceneObject.rotX = sqlite3_column_double(pResults, 7);
+		newSceneObject.rotY = sqlite3_column_double(pResults, 8);
+		newSceneObject.rotZ = sqlite3_column_double(pResults, 9);
+		newSceneObject.scaX = sqlite3_column_double(pResults, 10);
+		newSceneObject.scaY = sqlite3_column_double(pResults, 11);
+		newSceneObject.scaZ = sqlite3_column_double(pResults, 12);
+		newSceneObject.render = sqlite3_column_int(pResults, 13);
+		newSceneObject.collision = sqlite3_column_int(pResults, 14);
+		newSceneObject.collision_mesh = ColumnPath(pResults, 15);
+		newSceneObject.collectable = sqlite3_column_int(pResults, 16);
+		newSceneObject.destructable = sqlite3_column_int(pResults, 17);
+		newSceneObject.health_amount = sqlite3_column_int(pResults, 18);
+		newSceneObject.editor_render = sqlite3_column_int(pResults, 19);
+		newSceneObject.editor_texture_vis = sqlite3_column_int(pResults, 20);
+		newSceneObject.editor_normals_vis = sqlite3_column_int(pResults, 21);
+		newSceneObject.editor_collision_vis = sqlite3_column_int(pResults, 22);
+		newSceneObject.editor_pivot_vis = sqlite3_column_int(pResults, 23);
+		newSceneObject.pivotX = sqlite3_column_double(pResults, 24);
+		newSceneObject.pivotY = sqlite3_column_double(pResults, 25);
+		newSceneObject.pivotZ = sqlite3_column_double(pResults, 26);
+		newSceneObject.snapToGround = sqlite3_column_int(pResults, 27);
+		newSceneObject.AINode = sqlite3_column_int(pResults, 28);
+		newSceneObject.audio_path = ColumnPath(pResults, 29);
+		newSceneObject.volume = sqlite3_column_double(pResults, 30);
+		newSceneObject.pitch = sqlite3_column_double(pResults, 31);
+		newSceneObject.pan = sqlite3_column_int(pResults, 32);
+		newSceneObject.one_shot = sqlite3_column_int(pResults, 33);
+		newSceneObject.play_on_init = sqlite3_column_int(pResults, 34);
+		newSceneObject.play_in_editor = sqlite3_column_int(pResults, 35);
+		newSceneObject.min_dist = sqlite3_column_double(pResults, 36);
+		newSceneObject.max_dist = sqlite3_column_double(pResults, 37);
+		newSceneObject.camera = sqlite3_column_int(pResults, 38);
+		newSceneObject.path_node = sqlite3_column_int(pResults, 39);
+		newSceneObject.path_node_start = sqlite3_column_int(pResults, 40);
+		newSceneObject.path_node_end = sqlite3_column_int(pResults, 41);
+		newSceneObject.parent_id = sqlite3_column_int(pResults, 42);
+		newSceneObject.editor_wireframe = sqlite3_column_int(pResults, 43);
+		newSceneObject.name = reinterpret_cast<const char*>(sqlite3_column_text(pResults, 44));
+
+		newSceneObject.light_type = sqlite3_column_int(pResults, 45);
+		newSceneObject.light_diffuse_r = sqlite3_column_double(pResults, 46);
+		newSceneObject.light_diffuse_g = sqlite3_column_double(pResults, 47);
+		newSceneObject.light_diffuse_b = sqlite3_column_double(pResults, 48);
+		newSceneObject.light_specular_r = sqlite3_column_double(pResults, 49);
+		newSceneObject.light_specular_g = sqlite3_column_double(pResults, 50);
+		newSceneObject.light_specular_b = sqlite3_column_double(pResults, 51);
+		newSceneObject.light_spot_cutoff = sqlite3_column_double(pResults, 52);
+		newSceneObject.light_constant = sqlite3_column_double(pResults, 53);
+		newSceneObject.light_linear = sqlite3_column_double(pResults, 54);
+		newSceneObject.light_quadratic = sqlite3_column_double(pResults, 55);
+
+
+		//send completed object to scenegraph
+		scene.Add(newSceneObject);
+	}
+	sqlite3_finalize(pResults);
+
+	//THE WORLD CHUNK
+	//prepare SQL Text
+	sqlCommand = "SELECT " CHUNK_COLUMNS " from Chunks";	//sql command which will return all records from  chunks table. There is only one tho.
+														//Send Command and fill result object
+	sqlite3_prepare_v2(database, sqlCommand, -1, &pResultsChunk, 0);
+
+
+	sqlite3_step(pResultsChunk);
+	chunk.ID = sqlite3_column_int(pResultsChunk, 0);
+	chunk.name = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 1));
+	chunk.chunk_x_size_metres = sqlite3_column_int(pResultsChunk, 2);
+	chunk.chunk_y_size_metres = sqlite3_column_int(pResultsChunk, 3);
+	chunk.chunk_base_resolution = sqlite3_column_int(pResultsChunk, 4);
+	chunk.heightmap_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 5));
+	chunk.tex_diffuse_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 6));
+	chunk.tex_splat_alpha_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 7));
+	chunk.tex_splat_1_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 8));
+	chunk.tex_splat_2_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 9));
+	chunk.tex_splat_3_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 10));
+	chunk.tex_splat_4_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 11));
+	chunk.render_wireframe = sqlite3_column_int(pResultsChunk, 12);
+	chunk.render_normals = sqlite3_column_int(pResultsChunk, 13);
+	chunk.tex_diffuse_tiling = sqlite3_column_int(pResultsChunk, 14);
+	chunk.tex_splat_1_tiling = sqlite3_column_int(pResultsChunk, 15);
+	chunk.tex_splat_2_tiling = sqlite3_column_int(pResultsChunk, 16);
+	chunk.tex_splat_3_tiling = sqlite3_column_int(pResultsChunk, 17);
+	chunk.tex_splat_4_tiling = sqlite3_column_int(pResultsChunk, 18);
+	sqlite3_finalize(pResultsChunk);
+}
+
+bool LevelPack::WriteDatabase(sqlite3 * database, const Scene & scene)
+{
+	if (sqlite3_exec(database, "BEGIN", NULL, NULL, NULL) != SQLITE_OK)
+		return false;
+
+	sqlite3_stmt * erase = NULL;
+	bool ok = sqlite3_prepare_v2(database, "DELETE FROM Objects", -1, &erase, NULL) == SQLITE_OK
+		&& sqlite3_step(erase) == SQLITE_DONE;
+	sqlite3_finalize(erase);
+
+	//one statement for every row, only the bound values change
+	std::string insertSql = "INSERT INTO Objects (" OBJECT_COLUMNS ") VALUES (?";
+	for (int column = 1; column < 56; column++)
+	{
+		insertSql += ", ?";
+	}
+	insertSql += ")";
+
+	sqlite3_stmt * insert = NULL;
+	ok = ok && sqlite3_prepare_v2(database, insertSql.c_str(), -1, &insert, NULL) == SQLITE_OK;
+
+	//the paths and names are bound in place - the tables outlive the statement
+	const StringTable & assetPaths = StringTable::AssetPaths();
+	SceneObject object;
+	for (int i = 0; ok && i < scene.Size(); i++)
+	{
+		scene.GetRow(i, object);
+		const std::string & name = scene.GetName(i);
+
+		sqlite3_bind_int(insert, 1, object.ID);
+		sqlite3_bind_int(insert, 2, object.chunk_ID);
+		sqlite3_bind_text(insert, 3, assetPaths.Lookup(object.model_path).c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_text(insert, 4, assetPaths.Lookup(object.tex_diffuse_path).c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_double(insert, 5, object.posX);
+		sqlite3_bind_double(insert, 6, object.posY);
+		sqlite3_bind_double(insert, 7, object.posZ);
+		sqlite3_bind_double(insert, 8, object.rotX);
+		sqlite3_bind_double(insert, 9, object.rotY);
+		sqlite3_bind_double(insert, 10, object.rotZ);
+		sqlite3_bind_double(insert, 11, object.scaX);
+		sqlite3_bind_double(insert, 12, object.scaY);
+		sqlite3_bind_double(insert, 13, object.scaZ);
+		sqlite3_bind_int(insert, 14, object.render);
+		sqlite3_bind_int(insert, 15, object.collision);
+		sqlite3_bind_text(insert, 16, assetPaths.Lookup(object.collision_mesh).c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_int(insert, 17, object.collectable);
+		sqlite3_bind_int(insert, 18, object.destructable);
+		sqlite3_bind_int(insert, 19, object.health_amount);
+		sqlite3_bind_int(insert, 20, object.editor_render);
+		sqlite3_bind_int(insert, 21, object.editor_texture_vis);
+		sqlite3_bind_int(insert, 22, object.editor_normals_vis);
+		sqlite3_bind_int(insert, 23, object.editor_collision_vis);
+		sqlite3_bind_int(insert, 24, object.editor_pivot_vis);
+		sqlite3_bind_double(insert, 25, object.pivotX);
+		sqlite3_bind_double(insert, 26, object.pivotY);
+		sqlite3_bind_double(insert, 27, object.pivotZ);
+		sqlite3_bind_int(insert, 28, object.snapToGround);
+		sqlite3_bind_int(insert, 29, object.AINode);
+		sqlite3_bind_text(insert, 30, assetPaths.Lookup(object.audio_path).c_str(), -1, SQLITE_STATIC);
+		sqlite3_bind_double(insert, 31, object.volume);
+		sqlite3_bind_double(insert, 32, object.pitch);
+		sqlite3_bind_double(insert, 33, object.pan);
+		sqlite3_bind_int(insert, 34, object.one_shot);
+		sqlite3_bind_int(insert, 35, object.play_on_init);
+		sqlite3_bind_int(insert, 36, object.play_in_editor);
+		sqlite3_bind_int(insert, 37, object.min_dist);
+		sqlite3_bind_int(insert, 38, object.max_dist);
+		sqlite3_bind_int(insert, 39, object.camera);
+		sqlite3_bind_int(insert, 40, object.path_node);
+		sqlite3_bind_int(insert, 41, object.path_node_start);
+		sqlite3_bind_int(insert, 42, object.path_node_end);
+		sqlite3_bind_int(insert, 43, object.parent_id);
+		sqlite3_bind_int(insert, 44, object.editor_wireframe);
+		sqlite3_bind_text(insert, 45, name.c_str(), (int)name.size(), SQLITE_STATIC);
+		sqlite3_bind_int(insert, 46, object.light_type);
+		sqlite3_bind_double(insert, 47, object.light_diffuse_r);
+		sqlite3_bind_double(insert, 48, object.light_diffuse_g);
+		sqlite3_bind_double(insert, 49, object.light_diffuse_b);
+		sqlite3_bind_double(insert, 50, object.light_specular_r);
+		sqlite3_bind_double(insert, 51, object.light_specular_g);
+		sqlite3_bind_double(insert, 52, object.light_specular_b);
+		sqlite3_bind_double(insert, 53, object.light_spot_cutoff);
+		sqlite3_bind_double(insert, 54, object.light_constant);
+		sqlite3_bind_double(insert, 55, object.light_linear);
+		sqlite3_bind_double(insert, 56, object.light_quadratic);
+
+		ok = sqlite3_step(insert) == SQLITE_DONE;
+		sqlite3_reset(insert);
+	}
+	sqlite3_finalize(insert);
+
+	return sqlite3_exec(database, ok ? "COMMIT" : "ROLLBACK", NULL, NULL, NULL) == SQLITE_OK && ok;
+}
+
+bool LevelPack::Cook(const std::string & path, sqlite3 * database, const std::string & databasePath, int resolution, float legacyScale, std::string & error)
+{
+	PackHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.version = VERSION;
+
+	//stamped first, so a save that lands while cooking leaves the pack looking stale rather than current
+	Scene scene;
+	ChunkObject chunk;
+	if (!Stamp(databasePath, header.database))
+	{
+		error = "can't find " + databasePath;
+		return false;
+	}
+	ReadDatabase(database, scene, chunk);
+
+	//as the editor does, the container beside an old .raw holds the newer heights when there is one
+	FileStamp container;
+	if (Stamp(HeightmapFile::ContainerPath(chunk.heightmap_path), container))
+	{
+		chunk.heightmap_path = HeightmapFile::ContainerPath(chunk.heightmap_path);
+	}
+	HeightmapFile heightmap;
+	if (!Stamp(chunk.heightmap_path, header.heightmap) || !heightmap.Open(chunk.heightmap_path, resolution, legacyScale)
+		|| heightmap.Width() != resolution || heightmap.Height() != resolution)
+	{
+		error = "can't read the heightmap " + chunk.heightmap_path;
+		return false;
+	}
+	std::vector<float> heights((size_t)resolution * resolution);
+	heightmap.Read(0, 0, resolution, resolution, heights.data());
+	heightmap.Close();
+
+	FILE * file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		error = "can't write " + path;
+		return false;
+	}
+	PackWriter writer(file);
+	StringWriter strings;
+	writer.Write(&header, sizeof(header));
+
+	std::vector<PackedObject> objects(scene.Size());
+	std::vector<StringHandle> models, textures;
+	for (int row = 0; row < scene.Size(); row++)
+	{
+		SceneObject object = scene.GetRow(row);
+		PackObject(object, strings, objects[row]);
+		models.push_back(object.model_path);
+		textures.push_back(object.tex_diffuse_path);
+	}
+	writer.Payload(PACK_OBJECTS, strings.Add(""), objects.data(), objects.size() * sizeof(PackedObject));
+
+	PackedChunk packedChunk;
+	packedChunk.ID = chunk.ID;
+	packedChunk.chunk_x_size_metres = chunk.chunk_x_size_metres;
+	packedChunk.chunk_y_size_metres = chunk.chunk_y_size_metres;
+	packedChunk.chunk_base_resolution = chunk.chunk_base_resolution;
+	packedChunk.tex_diffuse_tiling = chunk.tex_diffuse_tiling;
+	packedChunk.tex_splat_1_tiling = chunk.tex_splat_1_tiling;
+	packedChunk.tex_splat_2_tiling = chunk.tex_splat_2_tiling;
+	packedChunk.tex_splat_3_tiling = chunk.tex_splat_3_tiling;
+	packedChunk.tex_splat_4_tiling = chunk.tex_splat_4_tiling;
+	packedChunk.flags = (chunk.render_wireframe ? 1 : 0) | (chunk.render_normals ? 2 : 0);
+	packedChunk.heightResolution = resolution;
+	packedChunk.name = strings.Add(chunk.name);
+	packedChunk.heightmap_path = strings.Add(chunk.heightmap_path);
+	packedChunk.tex_diffuse_path = strings.Add(chunk.tex_diffuse_path);
+	packedChunk.tex_splat_alpha_path = strings.Add(chunk.tex_splat_alpha_path);
+	packedChunk.tex_splat_1_path = strings.Add(chunk.tex_splat_1_path);
+	packedChunk.tex_splat_2_path = strings.Add(chunk.tex_splat_2_path);
+	packedChunk.tex_splat_3_path = strings.Add(chunk.tex_splat_3_path);
+	packedChunk.tex_splat_4_path = strings.Add(chunk.tex_splat_4_path);
+	writer.Payload(PACK_CHUNK, strings.Add(""), &packedChunk, sizeof(packedChunk));
+	writer.Payload(PACK_HEIGHTS, strings.Add(chunk.heightmap_path), heights.data(), heights.size() * sizeof(float));
+
+	//each asset once. one that is missing is left out, and loading it falls back to the loose file as it always did
+	textures.push_back(StringTable::AssetPaths().Intern(chunk.tex_diffuse_path));
+	std::sort(models.begin(), models.end());
+	models.erase(std::unique(models.begin(), models.end()), models.end());
+	std::sort(textures.begin(), textures.end());
+	textures.erase(std::unique(textures.begin(), textures.end()), textures.end());
+	std::vector<uint8_t> data;
+	for (int kind = 0; kind < 2; kind++)
+	{
+		const std::vector<StringHandle> & paths = kind == 0 ? models : textures;
+		for (size_t i = 0; i < paths.size(); i++)
+		{
+			if (ReadFile(StringTable::AssetPaths().Lookup(paths[i]), data))
+			{
+				writer.Payload(kind == 0 ? PACK_MODEL : PACK_TEXTURE, strings.Add(paths[i]), data.data(), data.size());
+			}
+		}
+	}
+
+	//each model's levels of detail as the editor would load them, so a packed level never builds or reads a .lod.
+	//a model without any is left out and falls back to its .lod file
+	std::vector<LodLevel> levels;
+	std::string lodError;
+	for (size_t i = 0; i < models.size(); i++)
+	{
+		if (!MeshSimplifier::CachedLods(StringTable::AssetPaths().Lookup(models[i]), levels, lodError))
+		{
+			continue;
+		}
+		std::vector<PackedLod> table(levels.size());
+		uint64_t offset = table.size() * sizeof(PackedLod);
+		for (size_t level = 0; level < levels.size(); level++)
+		{
+			table[level].error = levels[level].error;
+			table[level].size = (uint32_t)levels[level].cmo.size();
+			table[level].offset = offset;
+			offset += levels[level].cmo.size();
+		}
+		data.assign(reinterpret_cast<const uint8_t*>(table.data()), reinterpret_cast<const uint8_t*>(table.data() + table.size()));
+		for (size_t level = 0; level < levels.size(); level++)
+		{
+			data.insert(data.end(), levels[level].cmo.begin(), levels[level].cmo.end());
+		}
+		writer.Payload(PACK_LOD, strings.Add(models[i]), data.data(), data.size());
+	}
+
+	writer.Align();
+	header.stringsOffset = writer.Offset();
+	header.stringsSize = strings.Blob().size();
+	writer.Write(strings.Blob().data(), strings.Blob().size());
+	writer.Align();
+	header.contentsOffset = writer.Offset();
+	header.entryCount = (uint32_t)writer.Entries().size();
+	writer.Write(writer.Entries().data(), writer.Entries().size() * sizeof(PackEntry));
+
+	bool written = !writer.Failed() && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+	written &= fclose(file) == 0;
+	if (!written)
+	{
+		remove(path.c_str());
+		error = "can't write " + path;
+		return false;
+	}
+	return true;
+}
+
+bool LevelPack::Open(const std::string & path)
+{
+	Close();
+	if (!m_mapped.Open(path))
+	{
+		return false;
+	}
+
+	PackHeader header;
+	bool valid = m_mapped.Size() >= sizeof(header);
+	if (valid)
+	{
+		memcpy(&header, m_mapped.Data(), sizeof(header));
+		valid = memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION
+			&& header.stringsOffset + header.stringsSize <= m_mapped.Size()
+			&& header.contentsOffset + (uint64_t)header.entryCount * sizeof(PackEntry) <= m_mapped.Size();
+	}
+	for (uint32_t i = 0; valid && i < header.entryCount; i++)
+	{
+		const PackEntry & entry = reinterpret_cast<const PackEntry*>(m_mapped.Data() + header.contentsOffset)[i];
+		valid = entry.offset + entry.size <= m_mapped.Size() && (uint64_t)entry.name.offset + entry.name.length <= header.stringsSize;
+		if (!valid)
+		{
+			break;
+		}
+		switch (entry.type)
+		{
+		case PACK_OBJECTS:	m_objects = i;		break;
+		case PACK_CHUNK:	m_chunk = i;		break;
+		case PACK_HEIGHTS:	m_heights = i;		break;
+		case PACK_MODEL:
+		case PACK_TEXTURE:
+		case PACK_LOD:
+			{
+				StringHandle name = UnpackPath(reinterpret_cast<const char*>(m_mapped.Data() + header.stringsOffset), entry.name);
+				m_assets[((uint64_t)entry.type << 32) | name] = i;
+			}
+			break;
+		}
+	}
+	size_t objectsSize = 0, chunkSize = 0;
+	if (valid && m_objects >= 0 && m_chunk >= 0)
+	{
+		Entry(m_objects, objectsSize);
+		Entry(m_chunk, chunkSize);
+	}
+	valid = valid && chunkSize == sizeof(PackedChunk) && objectsSize % sizeof(PackedObject) == 0;
+	if (!valid)
+	{
+		Close();
+	}
+	return valid;
+}
+
+void LevelPack::Close()
+{
+	m_mapped.Close();
+	m_objects = m_chunk = m_heights = -1;
+	m_assets.clear();
+}
+
+const uint8_t * LevelPack::Entry(int index, size_t & size) const
+{
+	if (index < 0)
+	{
+		size = 0;
+		return NULL;
+	}
+	const PackHeader * header = reinterpret_cast<const PackHeader*>(m_mapped.Data());
+	const PackEntry & entry = reinterpret_cast<const PackEntry*>(m_mapped.Data() + header->contentsOffset)[index];
+	size = (size_t)entry.size;
+	return m_mapped.Data() + entry.offset;
+}
+
+bool LevelPack::IsCurrent(const std::string & databasePath) const
+{
+	if (!IsOpen())
+	{
+		return false;
+	}
+	const PackHeader * header = reinterpret_cast<const PackHeader*>(m_mapped.Data());
+	size_t size;
+	const PackedChunk * chunk = reinterpret_cast<const PackedChunk*>(Entry(m_chunk, size));
+	std::string heightmapPath = UnpackString(reinterpret_cast<const char*>(m_mapped.Data() + header->stringsOffset), chunk->heightmap_path);
+	FileStamp database, heightmap;
+	return Stamp(databasePath, database) && Stamp(heightmapPath, heightmap)
+		&& database.size == header->database.size && database.modified == header->database.modified
+		&& heightmap.size == header->heightmap.size && heightmap.modified == header->heightmap.modified;
+}
+
+void LevelPack::ReadScene(Scene & scene, ChunkObject & chunk) const
+{
+	const PackHeader * header = reinterpret_cast<const PackHeader*>(m_mapped.Data());
+	const char * strings = reinterpret_cast<const char*>(m_mapped.Data() + header->stringsOffset);
+	size_t size;
+	const PackedObject * objects = reinterpret_cast<const PackedObject*>(Entry(m_objects, size));
+	int count = (int)(size / sizeof(PackedObject));
+	scene.Reserve(scene.Size() + count);
+	SceneObject object;
+	for (int i = 0; i < count; i++)
+	{
+		UnpackObject(objects[i], strings, object);
+		scene.Add(object);
+	}
+
+	const PackedChunk & packed = *reinterpret_cast<const PackedChunk*>(Entry(m_chunk, size));
+	chunk.ID = packed.ID;
+	chunk.name = UnpackString(strings, packed.name);
+	chunk.chunk_x_size_metres = packed.chunk_x_size_metres;
+	chunk.chunk_y_size_metres = packed.chunk_y_size_metres;
+	chunk.chunk_base_resolution = packed.chunk_base_resolution;
+	chunk.heightmap_path = UnpackString(strings, packed.heightmap_path);
+	chunk.tex_diffuse_path = UnpackString(strings, packed.tex_diffuse_path);
+	chunk.tex_splat_alpha_path = UnpackString(strings, packed.tex_splat_alpha_path);
+	chunk.tex_splat_1_path = UnpackString(strings, packed.tex_splat_1_path);
+	chunk.tex_splat_2_path = UnpackString(strings, packed.tex_splat_2_path);
+	chunk.tex_splat_3_path = UnpackString(strings, packed.tex_splat_3_path);
+	chunk.tex_splat_4_path = UnpackString(strings, packed.tex_splat_4_path);
+	chunk.render_wireframe = (packed.flags & 1) != 0;
+	chunk.render_normals = (packed.flags & 2) != 0;
+	chunk.tex_diffuse_tiling = packed.tex_diffuse_tiling;
+	chunk.tex_splat_1_tiling = packed.tex_splat_1_tiling;
+	chunk.tex_splat_2_tiling = packed.tex_splat_2_tiling;
+	chunk.tex_splat_3_tiling = packed.tex_splat_3_tiling;
+	chunk.tex_splat_4_tiling = packed.tex_splat_4_tiling;
+}
+
+const float * LevelPack::Heights(int & resolution) const
+{
+	size_t size, chunkSize;
+	const uint8_t * heights = Entry(m_heights, size);
+	const PackedChunk * chunk = reinterpret_cast<const PackedChunk*>(Entry(m_chunk, chunkSize));
+	if (!heights || (size_t)chunk->heightResolution * chunk->heightResolution * sizeof(float) != size)
+	{
+		resolution = 0;
+		return NULL;
+	}
+	resolution = chunk->heightResolution;
+	return reinterpret_cast<const float*>(heights);
+}
+
+bool LevelPack::Find(PackEntryType type, StringHandle path, const uint8_t * & data, size_t & size) const
+{
+	auto found = m_assets.find(((uint64_t)type << 32) | path);
+	if (found == m_assets.end())
+	{
+		return false;
+	}
+	data = Entry(found->second, size);
+	return true;
+}
+
+bool LevelPack::FindLods(StringHandle modelPath, std::vector<PackLod> & levels) const
+{
+	levels.clear();
+	const uint8_t * data;
+	size_t size;
+	if (!Find(PACK_LOD, modelPath, data, size))
+	{
+		return false;
+	}
+
+	//the table runs up to the first CMO, and every level has to lie inside the entry
+	const PackedLod * table = reinterpret_cast<const PackedLod*>(data);
+	size_t count = size >= sizeof(PackedLod) ? (size_t)table[0].offset / sizeof(PackedLod) : 0;
+	if (count * sizeof(PackedLod) > size)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < count; i++)
+	{
+		if (table[i].offset > size || table[i].size > size - table[i].offset)
+		{
+			levels.clear();
+			return false;
+		}
+		PackLod level;
+		level.error = table[i].error;
+		level.cmo = data + table[i].offset;
+		level.size = table[i].size;
+		levels.push_back(level);
+	}
+	return true;
+}
+
+std::string LevelPack::Benchmark(int objects)
+{
+	//a level on disk the way the editor keeps one - the database, a heightmap and a folder of models and textures -
+	//then loaded both ways. every row, height and mesh has to come out the same
+	const int MODELS = 64, TEXTURES = 64, RESOLUTION = 512, GRID = 32;
+	const std::string prefix = "levelpack_benchmark";
+	const std::string databasePath = prefix + ".db", heightmapPath = prefix + ".whm", packPath = prefix + ".pack";
+	bool ok = true;
+	remove(databasePath.c_str());
+
+	std::vector<std::string> modelPaths, texturePaths;
+	for (int m = 0; m < MODELS; m++)
+	{
+		ImportedMesh mesh;
+		for (int z = 0; z <= GRID; z++)
+		{
+			for (int x = 0; x <= GRID; x++)
+			{
+				CmoVertex vertex;
+				memset(&vertex, 0, sizeof(vertex));
+				vertex.position[0] = (float)x;
+				vertex.position[1] = sinf(x * 0.3f + m) * cosf(z * 0.2f);
+				vertex.position[2] = (float)z;
+				vertex.normal[1] = 1.0f;
+				vertex.tangent[0] = vertex.tangent[3] = 1.0f;
+				vertex.color = 0xffffffff;
+				vertex.uv[0] = (float)x / GRID;
+				vertex.uv[1] = (float)z / GRID;
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (int z = 0; z < GRID; z++)
+		{
+			for (int x = 0; x < GRID; x++)
+			{
+				uint32_t a = z * (GRID + 1) + x, b = a + 1, c = a + GRID + 2, d = a + GRID + 1;
+				uint32_t quad[6] = { a, c, b, a, d, c };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+		modelPaths.push_back(prefix + "_model" + std::to_string(m) + ".cmo");
+		ok = ok && ObjToCmo::Write(mesh, "benchmark", modelPaths.back());
+	}
+
+	//textures only need to look like a DDS, nothing here decodes them
+	std::vector<uint8_t> texture(64 * 1024);
+	for (size_t i = 0; i < texture.size(); i++)
+	{
+		texture[i] = (uint8_t)(i * 31);
+	}
+	memcpy(texture.data(), "DDS ", 4);
+	for (int t = 0; t < TEXTURES; t++)
+	{
+		texturePaths.push_back(prefix + "_texture" + std::to_string(t) + ".dds");
+		FILE * file = fopen(texturePaths.back().c_str(), "wb");
+		ok = ok && file && fwrite(texture.data(), 1, texture.size(), file) == texture.size();
+		if (file)
+		{
+			fclose(file);
+		}
+	}
+
+	std::vector<float> heights((size_t)RESOLUTION * RESOLUTION);
+	for (int z = 0; z < RESOLUTION; z++)
+	{
+		for (int x = 0; x < RESOLUTION; x++)
+		{
+			heights[(size_t)z * RESOLUTION + x] = 32.0f + sinf(x * 0.02f) * cosf(z * 0.03f) * 30.0f;
+		}
+	}
+	HeightmapFile heightmap;
+	heightmap.Create(RESOLUTION, RESOLUTION, 64, HEIGHTMAP_SAMPLES_UINT16, 0.0f, 64.0f);
+	heightmap.Write(0, 0, RESOLUTION, RESOLUTION, heights.data());
+	ok = ok && heightmap.Save(heightmapPath);
+	heightmap.Close();
+
+	//the rows, each column of the type the editor reads it as
+	sqlite3 * database = NULL;
+	ok = ok && sqlite3_open(databasePath.c_str(), &database) == SQLITE_OK;
+	ok = ok && sqlite3_exec(database, "CREATE TABLE Objects (" OBJECT_COLUMNS ");"
+		"CREATE TABLE Chunks (" CHUNK_COLUMNS ");", NULL, NULL, NULL) == SQLITE_OK;
+	std::string chunkInsert = "INSERT INTO Chunks (" CHUNK_COLUMNS ") VALUES (0, 'benchmark', 512, 512, 128, '" + heightmapPath
+		+ "', '" + texturePaths[0] + "', '', '', '', '', '', 0, 0, 1, 1, 1, 1, 1)";
+	ok = ok && sqlite3_exec(database, chunkInsert.c_str(), NULL, NULL, NULL) == SQLITE_OK;
+	const int TEXT_COLUMNS[] = { 2, 3, 15, 29, 44 };
+	const int REAL_COLUMNS[] = { 4, 5, 6, 7, 8, 9, 10, 11, 12, 24, 25, 26, 30, 31, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55 };
+	sqlite3_stmt * insert = NULL;
+	std::string insertSql = "INSERT INTO Objects (" OBJECT_COLUMNS ") VALUES (?";
+	for (int column = 1; column < 56; column++)
+	{
+		insertSql += ", ?";
+	}
+	insertSql += ")";
+	ok = ok && sqlite3_exec(database, "BEGIN", NULL, NULL, NULL) == SQLITE_OK
+		&& sqlite3_prepare_v2(database, insertSql.c_str(), -1, &insert, NULL) == SQLITE_OK;
+	for (int row = 0; ok && row < objects; row++)
+	{
+		for (int column = 0; column < 56; column++)
+		{
+			const int * text = std::find(TEXT_COLUMNS, TEXT_COLUMNS + 5, column);
+			const int * real = std::find(REAL_COLUMNS, REAL_COLUMNS + 24, column);
+			if (text != TEXT_COLUMNS + 5)
+			{
+				std::string value = column == 2 ? modelPaths[row % MODELS] : column == 3 ? texturePaths[row % TEXTURES]
+					: column == 44 ? "object " + std::to_string(row) : std::string();
+				sqlite3_bind_text(insert, column + 1, value.c_str(), (int)value.size(), SQLITE_TRANSIENT);
+			}
+			else if (real != REAL_COLUMNS + 24)
+			{
+				sqlite3_bind_double(insert, column + 1, ((row * 37 + column * 11) % 1000) * 0.25);
+			}
+			else
+			{
+				sqlite3_bind_int(insert, column + 1, column == 0 ? row + 1 : column == 42 ? row / 2 : (row + column) % 2);
+			}
+		}
+		ok = sqlite3_step(insert) == SQLITE_DONE && sqlite3_reset(insert) == SQLITE_OK;
+	}
+	sqlite3_finalize(insert);
+	ok = ok && sqlite3_exec(database, "COMMIT", NULL, NULL, NULL) == SQLITE_OK;
+
+	std::string error;
+	auto cookStart = std::chrono::high_resolution_clock::now();
+	ok = ok && Cook(packPath, database, databasePath, RESOLUTION, 0.25f, error);
+	double cookMs = MillisecondsSince(cookStart);
+	sqlite3_close(database);
+
+	//what each path hands the renderer: the rows, the heights, and every model, level of detail and texture parsed or checked
+	struct Loaded
+	{
+		Scene					scene;
+		ChunkObject				chunk;
+		std::vector<float>		heights;
+		std::vector<ImportedMesh>	meshes;
+		std::vector<ImportedMesh>	lods;		//every model's levels, one after another
+		std::vector<float>		lodErrors;
+		int						textures;
+	};
+
+	//loose - open the database and query it, open the heightmap, and open, read and parse each asset file
+	Loaded loose;
+	loose.textures = 0;
+	auto looseStart = std::chrono::high_resolution_clock::now();
+	database = NULL;
+	ok = ok && sqlite3_open_v2(databasePath.c_str(), &database, SQLITE_OPEN_READONLY, NULL) == SQLITE_OK;
+	if (ok)
+	{
+		ReadDatabase(database, loose.scene, loose.chunk);
+	}
+	sqlite3_close(database);
+	HeightmapFile looseHeightmap;
+	ok = ok && looseHeightmap.Open(loose.chunk.heightmap_path, RESOLUTION, 0.25f);
+	loose.heights.resize(heights.size());
+	if (ok)
+	{
+		looseHeightmap.Read(0, 0, RESOLUTION, RESOLUTION, loose.heights.data());
+	}
+	looseHeightmap.Close();
+	std::vector<uint8_t> data;
+	loose.meshes.resize(MODELS);
+	for (int m = 0; m < MODELS; m++)
+	{
+		ok = ok && ReadFile(modelPaths[m], data) && ObjToCmo::Read(data.data(), data.size(), loose.meshes[m], error);
+	}
+	std::vector<LodLevel> levels;
+	for (int m = 0; m < MODELS; m++)
+	{
+		ok = ok && MeshSimplifier::CachedLods(modelPaths[m], levels, error);
+		for (size_t i = 0; ok && i < levels.size(); i++)
+		{
+			loose.lods.push_back(ImportedMesh());
+			loose.lodErrors.push_back(levels[i].error);
+			ok = ObjToCmo::Read(levels[i].cmo.data(), levels[i].cmo.size(), loose.lods.back(), error);
+		}
+	}
+	for (int t = 0; t < TEXTURES; t++)
+	{
+		loose.textures += ReadFile(texturePaths[t], data) && memcmp(data.data(), "DDS ", 4) == 0;
+	}
+	double looseMs = MillisecondsSince(looseStart);
+
+	//packed - map one file and read everything from the mapping
+	Loaded packed;
+	packed.textures = 0;
+	auto packStart = std::chrono::high_resolution_clock::now();
+	LevelPack pack;
+	ok = ok && pack.Open(packPath) && pack.IsCurrent(databasePath);
+	int resolution = 0;
+	if (ok)
+	{
+		pack.ReadScene(packed.scene, packed.chunk);
+		const float * packedHeights = pack.Heights(resolution);
+		ok = packedHeights && resolution == RESOLUTION;
+		if (ok)
+		{
+			packed.heights.assign(packedHeights, packedHeights + heights.size());
+		}
+	}
+	packed.meshes.resize(MODELS);
+	const uint8_t * bytes = NULL;
+	size_t size = 0;
+	for (int m = 0; m < MODELS; m++)
+	{
+		ok = ok && pack.Find(PACK_MODEL, StringTable::AssetPaths().Intern(modelPaths[m]), bytes, size)
+			&& ObjToCmo::Read(bytes, size, packed.meshes[m], error);
+	}
+	std::vector<PackLod> packedLevels;
+	for (int m = 0; m < MODELS; m++)
+	{
+		ok = ok && pack.FindLods(StringTable::AssetPaths().Intern(modelPaths[m]), packedLevels);
+		for (size_t i = 0; ok && i < packedLevels.size(); i++)
+		{
+			packed.lods.push_back(ImportedMesh());
+			packed.lodErrors.push_back(packedLevels[i].error);
+			ok = ObjToCmo::Read(packedLevels[i].cmo, packedLevels[i].size, packed.lods.back(), error);
+		}
+	}
+	for (int t = 0; t < TEXTURES; t++)
+	{
+		packed.textures += pack.Find(PACK_TEXTURE, StringTable::AssetPaths().Intern(texturePaths[t]), bytes, size) && size >= 4 && memcmp(bytes, "DDS ", 4) == 0;
+	}
+	double packMs = MillisecondsSince(packStart);
+	uint64_t packSize = pack.m_mapped.Size();
+	pack.Close();
+
+	//the two loads side by side. rows are compared packed, the same rows giving the same bytes
+	bool same = ok && loose.scene.Size() == objects && packed.scene.Size() == objects && loose.heights == packed.heights
+		&& loose.textures == TEXTURES && packed.textures == TEXTURES
+		&& loose.chunk.heightmap_path == packed.chunk.heightmap_path && loose.chunk.tex_diffuse_path == packed.chunk.tex_diffuse_path
+		&& loose.chunk.chunk_base_resolution == packed.chunk.chunk_base_resolution && loose.chunk.tex_diffuse_tiling == packed.chunk.tex_diffuse_tiling;
+	StringWriter looseStrings, packedStrings;
+	for (int row = 0; same && row < objects; row++)
+	{
+		PackedObject a, b;
+		PackObject(loose.scene.GetRow(row), looseStrings, a);
+		PackObject(packed.scene.GetRow(row), packedStrings, b);
+		same = memcmp(&a, &b, sizeof(a)) == 0;
+	}
+	for (int m = 0; same && m < MODELS; m++)
+	{
+		same = loose.meshes[m].indices == packed.meshes[m].indices && loose.meshes[m].vertices.size() == packed.meshes[m].vertices.size()
+			&& memcmp(loose.meshes[m].vertices.data(), packed.meshes[m].vertices.data(), loose.meshes[m].vertices.size() * sizeof(CmoVertex)) == 0;
+	}
+	same = same && !loose.lods.empty() && loose.lods.size() == packed.lods.size() && loose.lodErrors == packed.lodErrors;
+	for (size_t i = 0; same && i < loose.lods.size(); i++)
+	{
+		same = loose.lods[i].indices == packed.lods[i].indices && loose.lods[i].vertices.size() == packed.lods[i].vertices.size()
+			&& memcmp(loose.lods[i].vertices.data(), packed.lods[i].vertices.data(), loose.lods[i].vertices.size() * sizeof(CmoVertex)) == 0;
+	}
+
+	remove(databasePath.c_str());
+	remove(heightmapPath.c_str());
+	remove(packPath.c_str());
+	for (int m = 0; m < MODELS; m++)
+	{
+		remove(modelPaths[m].c_str());
+		remove((modelPaths[m].substr(0, modelPaths[m].find_last_of('.')) + ".lod").c_str());
+	}
+	for (int t = 0; t < TEXTURES; t++)
+	{
+		remove(texturePaths[t].c_str());
+	}
+
+	std::ostringstream report;
+	report << "Level pack, " << objects << " objects, " << RESOLUTION << " x " << RESOLUTION << " heights, " << MODELS << " models with "
+		<< loose.lods.size() << " levels of detail, " << TEXTURES << " textures: cook " << cookMs << " ms to " << packSize / 1024 << " KB, load from database and loose files "
+		<< looseMs << " ms, from the pack " << packMs << " ms (" << looseMs / std::max(packMs, 1e-3) << "x), file cache warm"
+		<< (same ? "" : " (PACK DIFFERS)") << "\n";
+	return report.str();
+}
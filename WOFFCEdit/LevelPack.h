@@ -0,0 +1,78 @@
+#pragma once
+
+#include "sqlite3.h"
+#include "Scene.h"
+#include "ChunkObject.h"
+#include "StringTable.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//the level cooked into one file for a fast start. the object table, the chunk, the terrain heights and every model, its
+//levels of detail and texture the level refers to are laid end to end, each aligned to 64 bytes, with a table of contents at the end.
+//the file is memory mapped, and models and textures are made straight from the mapped bytes - no opening a file per
+//asset and no copying them into a buffer first. the pack remembers the size and time of the database and heightmap
+//it was cooked from, and is ignored once either has been saved since. assets are not tracked, cook again after
+//changing one in place.
+//
+//layout, little endian:
+//	header		128 bytes, see PackHeader in the .cpp
+//	payloads	objects, chunk, heights, models, levels of detail, textures
+//	strings		every path and name, the payloads refer to them by offset and length
+//	contents	one 32 byte entry per payload
+
+enum PackEntryType
+{
+	PACK_OBJECTS = 1,		//PackedObject per row, in scene order
+	PACK_CHUNK = 2,			//one PackedChunk
+	PACK_HEIGHTS = 3,		//floats, resolution x resolution row by row
+	PACK_MODEL = 4,			//a CMO, named by its asset path
+	PACK_TEXTURE = 5,		//a DDS, named by its asset path
+	PACK_LOD = 6			//the levels of detail of a model, named by its asset path - a table of PackedLod, then their CMOs
+};
+
+//one level of detail of a packed model, its CMO in the mapping
+struct PackLod
+{
+	float			error;
+	const uint8_t *	cmo;
+	size_t			size;
+};
+
+class LevelPack
+{
+public:
+	LevelPack();
+	~LevelPack();
+
+	//the level as it is saved - the database's tables and the heightmap file - into a pack at path
+	static bool Cook(const std::string & path, sqlite3 * database, const std::string & databasePath, int resolution, float legacyScale, std::string & error);
+	//the loose path, the objects and chunk from the database
+	static void ReadDatabase(sqlite3 * database, Scene & scene, ChunkObject & chunk);
+	//replaces the Objects table with the scene in one transaction, false and the table as it was when any row fails
+	static bool WriteDatabase(sqlite3 * database, const Scene & scene);
+
+	bool Open(const std::string & path);
+	void Close();
+	bool IsOpen() const		{ return m_mapped.IsOpen(); }
+	bool IsCurrent(const std::string & databasePath) const;		//cooked from the database and heightmap as they are on disk now
+
+	void ReadScene(Scene & scene, ChunkObject & chunk) const;
+	const float * Heights(int & resolution) const;				//in the mapping, NULL when the pack has none
+	//an asset's bytes in the mapping, false when it wasn't packed
+	bool Find(PackEntryType type, StringHandle path, const uint8_t * & data, size_t & size) const;
+	//a model's levels of detail, coarsest last, false when they weren't packed. an empty list is fine
+	bool FindLods(StringHandle modelPath, std::vector<PackLod> & levels) const;
+
+	static std::string Benchmark(int objects);
+
+private:
+	const uint8_t * Entry(int index, size_t & size) const;
+
+	MappedFile			m_mapped;
+
+	int					m_objects, m_chunk, m_heights;		//entries, -1 when missing
+	std::unordered_map<uint64_t, int>	m_assets;			//type in the high 32 bits, path handle in the low -> entry
+};
@@ -5,7 +5,17 @@
 BEGIN_MESSAGE_MAP(MFCMain, CWinApp)
 	ON_COMMAND(ID_FILE_QUIT,	&MFCMain::MenuFileQuit)
 	ON_COMMAND(ID_FILE_SAVETERRAIN, &MFCMain::MenuFileSaveTerrain)
+	ON_COMMAND(ID_EDIT_UNDO, &MFCMain::MenuEditUndo)
+	ON_COMMAND(ID_EDIT_REDO, &MFCMain::MenuEditRedo)
 	ON_COMMAND(ID_EDIT_SELECT, &MFCMain::MenuEditSelect)
+	ON_COMMAND(ID_TOOLS_BENCHMARK, &MFCMain::MenuToolsBenchmark)
+	ON_COMMAND(ID_TOOLS_ALIGNTOSURFACE, &MFCMain::MenuToolsAlignToSurface)
+	ON_COMMAND(ID_TOOLS_SCATTER, &MFCMain::MenuToolsScatter)
+	ON_COMMAND(ID_TOOLS_SCATTERBRUSH, &MFCMain::MenuToolsScatterBrush)
+	ON_COMMAND(ID_TOOLS_GENERATETERRAIN, &MFCMain::MenuToolsGenerateTerrain)
+	ON_COMMAND(ID_TOOLS_ERODETERRAIN, &MFCMain::MenuToolsErodeTerrain)
+	ON_COMMAND(ID_TOOLS_IMPORTOBJ, &MFCMain::MenuToolsImportObj)
+	ON_COMMAND(ID_TOOLS_COOKPACK, &MFCMain::MenuToolsCookPack)
 	ON_COMMAND(ID_BUTTON40001,	&MFCMain::ToolBarButton1)
 	ON_COMMAND(ID_BUTTON40005, &MFCMain::ToolBarButton2)
 	ON_COMMAND(ID_BUTTON40007, &MFCMain::ToolBarButton3)
@@ -117,6 +127,16 @@ void MFCMain::MenuFileSaveTerrain()
 	m_ToolSystem.onActionSaveTerrain();
 }
 
+void MFCMain::MenuEditUndo()
+{
+	m_ToolSystem.onActionUndo();
+}
+
+void MFCMain::MenuEditRedo()
+{
+	m_ToolSystem.onActionRedo();
+}
+
 void MFCMain::MenuEditSelect()
 {
 	//SelectDialogue m_ToolSelectDialogue(NULL, &m_ToolSystem.m_sceneGraph);		//create our dialoguebox //modal constructor
@@ -128,6 +148,54 @@ void MFCMain::MenuEditSelect()
 	m_ToolSelectDialogue.SetObjectData(&m_ToolSystem.m_sceneGraph, &m_ToolSystem.m_selectedObject);
 }
 
+void MFCMain::MenuToolsBenchmark()
+{
+	m_ToolSystem.onActionBenchmark();
+}
+
+void MFCMain::MenuToolsAlignToSurface()
+{
+	bool align = !m_ToolSystem.GetAlignToSurface();
+	m_ToolSystem.SetAlignToSurface(align);
+	m_frame->GetMenu()->CheckMenuItem(ID_TOOLS_ALIGNTOSURFACE, align ? MF_CHECKED : MF_UNCHECKED);
+}
+
+void MFCMain::MenuToolsScatter()
+{
+	m_ToolSystem.onActionScatter();
+}
+
+void MFCMain::MenuToolsScatterBrush()
+{
+	bool brush = !m_ToolSystem.GetScatterBrush();
+	m_ToolSystem.SetScatterBrush(brush);
+	m_frame->GetMenu()->CheckMenuItem(ID_TOOLS_SCATTERBRUSH, brush ? MF_CHECKED : MF_UNCHECKED);
+}
+
+void MFCMain::MenuToolsGenerateTerrain()
+{
+	m_ToolSystem.onActionGenerateTerrain();
+}
+
+void MFCMain::MenuToolsErodeTerrain()
+{
+	m_ToolSystem.onActionErodeTerrain();
+}
+
+void MFCMain::MenuToolsImportObj()
+{
+	CFileDialog dialog(TRUE, L"obj", NULL, OFN_FILEMUSTEXIST, L"Wavefront OBJ (*.obj)|*.obj||");
+	if (dialog.DoModal() == IDOK)
+	{
+		m_ToolSystem.onActionImportObj(std::string(CT2A(dialog.GetPathName())));
+	}
+}
+
+void MFCMain::MenuToolsCookPack()
+{
+	m_ToolSystem.onActionCookPack();
+}
+
 void MFCMain::ToolBarButton1()
 {
 	
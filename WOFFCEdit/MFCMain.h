@@ -33,7 +33,17 @@ private:
 	//Interface funtions for menu and toolbar etc requires
 	afx_msg void MenuFileQuit();
 	afx_msg void MenuFileSaveTerrain();
+	afx_msg void MenuEditUndo();
+	afx_msg void MenuEditRedo();
 	afx_msg void MenuEditSelect();
+	afx_msg void MenuToolsBenchmark();
+	afx_msg void MenuToolsAlignToSurface();
+	afx_msg void MenuToolsScatter();
+	afx_msg void MenuToolsScatterBrush();
+	afx_msg void MenuToolsGenerateTerrain();
+	afx_msg void MenuToolsErodeTerrain();
+	afx_msg void MenuToolsImportObj();
+	afx_msg void MenuToolsCookPack();
 	afx_msg	void ToolBarButton1();
 	afx_msg	void ToolBarButton2();
 	afx_msg	void ToolBarButton3();
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+//a whole file mapped read only into memory, for the formats that are read in place - the heightmap container and the
+//level pack. the bytes stay valid until Close, or until the MappedFile goes away.
+//the file is shared for writing, so an owner can save into the file it is reading from - the view sees the writes,
+//but not any growth of the file past the size it had when it was mapped.
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool	Open(const std::string & path);		//false when the file is missing, empty or can't be mapped
+	void	Close();
+	void	Swap(MappedFile & other);
+	bool	IsOpen() const { return m_data != NULL; }
+
+	const uint8_t *	Data() const { return m_data; }
+	uint64_t		Size() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile &);				//owns the handles, so not copyable
+	MappedFile & operator=(const MappedFile &);
+
+	const uint8_t *	m_data;
+	uint64_t		m_size;
+	void *			m_file;
+	void *			m_mapping;
+};
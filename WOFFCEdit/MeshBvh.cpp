@@ -0,0 +1,451 @@
+#include "MeshBvh.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace
+{
+	const int		BINS = 12;				//split candidates per node along its longest axis
+	const uint32_t	MIN_LEAF = 4;			//triangles a node always stops at
+	const uint32_t	MAX_LEAF = 16;			//beyond this a node is split even when the heuristic says not to
+	const float		TRAVERSAL_COST = 1.0f;	//cost of visiting a node, in triangle tests
+	const int		STACK_SIZE = 64;
+
+	struct Bounds
+	{
+		float	low[3], high[3];
+
+		Bounds()
+		{
+			low[0] = low[1] = low[2] = FLT_MAX;
+			high[0] = high[1] = high[2] = -FLT_MAX;
+		}
+		void Grow(const float * point)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				low[axis] = std::min(low[axis], point[axis]);
+				high[axis] = std::max(high[axis], point[axis]);
+			}
+		}
+		void Grow(const Bounds & other)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				low[axis] = std::min(low[axis], other.low[axis]);
+				high[axis] = std::max(high[axis], other.high[axis]);
+			}
+		}
+		float Area() const
+		{
+			if (low[0] > high[0])
+			{
+				return 0.0f;
+			}
+			float x = high[0] - low[0], y = high[1] - low[1], z = high[2] - low[2];
+			return x * y + y * z + z * x;
+		}
+	};
+
+	//what the build needs of each triangle, kept apart from the corners so partitioning moves little
+	struct BuildTriangle
+	{
+		Bounds		bounds;
+		float		centre[3];
+		uint32_t	index;
+	};
+
+	struct Builder
+	{
+		std::vector<BuildTriangle> &	triangles;
+		std::vector<uint32_t>			nodeStart;
+		std::vector<uint32_t>			nodeCount;
+		std::vector<Bounds>				nodeBounds;
+
+		Builder(std::vector<BuildTriangle> & triangles) : triangles(triangles) {}
+
+		//returns the node made for triangles [first, first + count), its children follow it depth first
+		uint32_t Build(uint32_t first, uint32_t count)
+		{
+			uint32_t node = (uint32_t)nodeStart.size();
+			Bounds bounds, centres;
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				bounds.Grow(triangles[i].bounds);
+				centres.Grow(triangles[i].centre);
+			}
+			nodeBounds.push_back(bounds);
+			nodeStart.push_back(first);
+			nodeCount.push_back(count);
+
+			int axis = 0;
+			for (int a = 1; a < 3; a++)
+			{
+				if (centres.high[a] - centres.low[a] > centres.high[axis] - centres.low[axis])
+				{
+					axis = a;
+				}
+			}
+			float extent = centres.high[axis] - centres.low[axis];
+			if (count <= MIN_LEAF || extent <= 0.0f)
+			{
+				return node;
+			}
+
+			//bin the centres, then sweep both ways for the area and count on each side of every boundary
+			Bounds binBounds[BINS];
+			uint32_t binCounts[BINS] = {};
+			float binScale = BINS / extent;
+			auto binOf = [&](const BuildTriangle & triangle)
+			{
+				return std::min(BINS - 1, (int)((triangle.centre[axis] - centres.low[axis]) * binScale));
+			};
+			for (uint32_t i = first; i < first + count; i++)
+			{
+				int bin = binOf(triangles[i]);
+				binBounds[bin].Grow(triangles[i].bounds);
+				binCounts[bin]++;
+			}
+			float rightArea[BINS];
+			uint32_t rightCount[BINS];
+			Bounds sweep;
+			uint32_t swept = 0;
+			for (int bin = BINS - 1; bin > 0; bin--)
+			{
+				sweep.Grow(binBounds[bin]);
+				swept += binCounts[bin];
+				rightArea[bin] = sweep.Area();
+				rightCount[bin] = swept;
+			}
+			float bestCost = FLT_MAX;
+			int bestSplit = -1;
+			sweep = Bounds();
+			swept = 0;
+			for (int split = 1; split < BINS; split++)
+			{
+				sweep.Grow(binBounds[split - 1]);
+				swept += binCounts[split - 1];
+				if (swept == 0 || rightCount[split] == 0)
+				{
+					continue;
+				}
+				float cost = sweep.Area() * swept + rightArea[split] * rightCount[split];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestSplit = split;
+				}
+			}
+
+			float leafCost = bounds.Area() * count;
+			bestCost = TRAVERSAL_COST * bounds.Area() + bestCost;
+			uint32_t middle;
+			if (bestSplit >= 0 && (bestCost < leafCost || count > MAX_LEAF))
+			{
+				middle = (uint32_t)(std::partition(triangles.begin() + first, triangles.begin() + first + count,
+					[&](const BuildTriangle & triangle) { return binOf(triangle) < bestSplit; }) - triangles.begin());
+			}
+			else if (count > MAX_LEAF)
+			{
+				//everything in one bin, halve by position instead
+				middle = first + count / 2;
+				std::nth_element(triangles.begin() + first, triangles.begin() + middle, triangles.begin() + first + count,
+					[axis](const BuildTriangle & a, const BuildTriangle & b) { return a.centre[axis] < b.centre[axis]; });
+			}
+			else
+			{
+				return node;
+			}
+
+			nodeCount[node] = 0;
+			Build(first, middle - first);
+			uint32_t second = Build(middle, first + count - middle);
+			nodeStart[node] = second;		//not in one statement, the vector may have moved by the time the call returns
+			return node;
+		}
+	};
+
+	//distance to where the ray enters the box, or FLT_MAX when it misses it or only gets there beyond maxDistance
+	inline float EnterBox(const float * bounds, const float * origin, const float * inverse, float maxDistance)
+	{
+		float enter = 0.0f, leave = maxDistance;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float a = (bounds[axis] - origin[axis]) * inverse[axis];
+			float b = (bounds[axis + 3] - origin[axis]) * inverse[axis];
+			enter = std::max(enter, std::min(a, b));
+			leave = std::min(leave, std::max(a, b));
+		}
+		return enter <= leave ? enter : FLT_MAX;
+	}
+
+	//Moller Trumbore, either side
+	inline bool HitTriangle(const XMFLOAT3 * corners, const XMFLOAT3 & origin, const XMFLOAT3 & direction, float & distance)
+	{
+		float e1[3] = { corners[1].x - corners[0].x, corners[1].y - corners[0].y, corners[1].z - corners[0].z };
+		float e2[3] = { corners[2].x - corners[0].x, corners[2].y - corners[0].y, corners[2].z - corners[0].z };
+		float p[3] = { direction.y * e2[2] - direction.z * e2[1], direction.z * e2[0] - direction.x * e2[2], direction.x * e2[1] - direction.y * e2[0] };
+		float determinant = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (fabsf(determinant) < 1e-12f)
+		{
+			return false;
+		}
+		float inverse = 1.0f / determinant;
+		float s[3] = { origin.x - corners[0].x, origin.y - corners[0].y, origin.z - corners[0].z };
+		float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+		if (u < 0.0f || u > 1.0f)
+		{
+			return false;
+		}
+		float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+		float v = (direction.x * q[0] + direction.y * q[1] + direction.z * q[2]) * inverse;
+		if (v < 0.0f || u + v > 1.0f)
+		{
+			return false;
+		}
+		distance = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+		return distance >= 0.0f;
+	}
+}
+
+MeshBvh::MeshBvh()
+{
+}
+
+MeshBvh::~MeshBvh()
+{
+}
+
+size_t MeshBvh::MemoryUsage() const
+{
+	return m_nodes.capacity() * sizeof(Node) + m_corners.capacity() * sizeof(XMFLOAT3);
+}
+
+void MeshBvh::Build(const ImportedMesh & mesh)
+{
+	m_nodes.clear();
+	m_corners.clear();
+	size_t triangleCount = mesh.indices.size() / 3;
+	if (!triangleCount)
+	{
+		return;
+	}
+
+	std::vector<BuildTriangle> triangles(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		BuildTriangle & triangle = triangles[t];
+		triangle.index = (uint32_t)t;
+		for (int corner = 0; corner < 3; corner++)
+		{
+			triangle.bounds.Grow(mesh.vertices[mesh.indices[t * 3 + corner]].position);
+		}
+		for (int axis = 0; axis < 3; axis++)
+		{
+			triangle.centre[axis] = (triangle.bounds.low[axis] + triangle.bounds.high[axis]) * 0.5f;
+		}
+	}
+
+	Builder builder(triangles);
+	builder.Build(0, (uint32_t)triangleCount);
+
+	m_nodes.resize(builder.nodeStart.size());
+	for (size_t i = 0; i < m_nodes.size(); i++)
+	{
+		Node & node = m_nodes[i];
+		memcpy(node.bounds, builder.nodeBounds[i].low, sizeof(float) * 3);
+		memcpy(node.bounds + 3, builder.nodeBounds[i].high, sizeof(float) * 3);
+		node.start = builder.nodeStart[i];
+		node.count = builder.nodeCount[i];
+	}
+	m_corners.resize(triangleCount * 3);
+	for (size_t t = 0; t < triangleCount; t++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const float * position = mesh.vertices[mesh.indices[triangles[t].index * 3 + corner]].position;
+			m_corners[t * 3 + corner] = XMFLOAT3(position[0], position[1], position[2]);
+		}
+	}
+}
+
+bool MeshBvh::Raycast(const XMFLOAT3 & origin, const XMFLOAT3 & direction, float maxDistance, float & distance, int & triangle) const
+{
+	if (IsEmpty())
+	{
+		return false;
+	}
+
+	//a zero component divides to infinity, which the slab test copes with as long as it isn't multiplied by zero
+	const float rayOrigin[3] = { origin.x, origin.y, origin.z };
+	const float inverse[3] = { 1.0f / (direction.x != 0.0f ? direction.x : 1e-30f), 1.0f / (direction.y != 0.0f ? direction.y : 1e-30f),
+		1.0f / (direction.z != 0.0f ? direction.z : 1e-30f) };
+
+	float nearest = maxDistance;
+	triangle = -1;
+	uint32_t stack[STACK_SIZE];
+	int depth = 0;
+	if (EnterBox(m_nodes[0].bounds, rayOrigin, inverse, nearest) == FLT_MAX)
+	{
+		return false;
+	}
+	stack[depth++] = 0;
+	while (depth)
+	{
+		const Node & node = m_nodes[stack[--depth]];
+		if (node.count)
+		{
+			for (uint32_t t = node.start; t < node.start + node.count; t++)
+			{
+				float hit;
+				if (HitTriangle(&m_corners[t * 3], origin, direction, hit) && hit < nearest)
+				{
+					nearest = hit;
+					triangle = (int)t;
+				}
+			}
+			continue;
+		}
+
+		//nearer child on top so it is searched first, and the other one likely culled by what it finds
+		uint32_t first = (uint32_t)(&node - m_nodes.data()) + 1, second = node.start;
+		float firstEnter = EnterBox(m_nodes[first].bounds, rayOrigin, inverse, nearest);
+		float secondEnter = EnterBox(m_nodes[second].bounds, rayOrigin, inverse, nearest);
+		if (secondEnter < firstEnter)
+		{
+			std::swap(first, second);
+			std::swap(firstEnter, secondEnter);
+		}
+		if (secondEnter != FLT_MAX && depth < STACK_SIZE)
+		{
+			stack[depth++] = second;
+		}
+		if (firstEnter != FLT_MAX && depth < STACK_SIZE)
+		{
+			stack[depth++] = first;
+		}
+	}
+
+	distance = nearest;
+	return triangle != -1;
+}
+
+XMFLOAT3 MeshBvh::GetNormal(int triangle) const
+{
+	XMVECTOR a = XMLoadFloat3(&m_corners[triangle * 3]);
+	XMVECTOR b = XMLoadFloat3(&m_corners[triangle * 3 + 1]);
+	XMVECTOR c = XMLoadFloat3(&m_corners[triangle * 3 + 2]);
+	XMFLOAT3 normal;
+	XMStoreFloat3(&normal, XMVector3Normalize(XMVector3Cross(b - a, c - a)));
+	return normal;
+}
+
+std::string MeshBvh::Benchmark(int gridResolution)
+{
+	//a lumpy sphere, so rays graze it, pass through its dents and miss it entirely
+	int n = gridResolution;
+	ImportedMesh mesh;
+	const float PI = 3.14159265f;
+	for (int ring = 0; ring <= n; ring++)
+	{
+		for (int segment = 0; segment <= n; segment++)
+		{
+			float theta = PI * ring / n, phi = 2.0f * PI * segment / n;
+			float radius = 10.0f + sinf(theta * 9.0f) * cosf(phi * 7.0f) * 2.0f + sinf(theta * 37.0f + phi * 23.0f) * 0.3f;
+			CmoVertex vertex;
+			memset(&vertex, 0, sizeof(vertex));
+			vertex.position[0] = radius * sinf(theta) * cosf(phi);
+			vertex.position[1] = radius * cosf(theta);
+			vertex.position[2] = radius * sinf(theta) * sinf(phi);
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	for (int ring = 0; ring < n; ring++)
+	{
+		for (int segment = 0; segment < n; segment++)
+		{
+			uint32_t a = ring * (n + 1) + segment, b = a + 1, c = a + n + 2, d = a + n + 1;
+			uint32_t quad[6] = { a, c, b, a, d, c };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+
+	MeshBvh bvh;
+	auto buildStart = std::chrono::high_resolution_clock::now();
+	bvh.Build(mesh);
+	auto buildEnd = std::chrono::high_resolution_clock::now();
+
+	//picks from all around, aimed somewhere inside the bounds
+	const int PICKS = 100000, CHECKED = 200;
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	std::vector<XMFLOAT3> origins(PICKS), directions(PICKS);
+	for (int i = 0; i < PICKS; i++)
+	{
+		XMVECTOR from = XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random), 0.0f)) * 40.0f;
+		XMVECTOR to = XMVectorSet(unit(random), unit(random), unit(random), 0.0f) * 12.0f;
+		XMStoreFloat3(&origins[i], from);
+		XMStoreFloat3(&directions[i], XMVector3Normalize(to - from));
+	}
+
+	int hits = 0;
+	double distanceSum = 0.0;
+	auto pickStart = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < PICKS; i++)
+	{
+		float distance;
+		int triangle;
+		if (bvh.Raycast(origins[i], directions[i], 1000.0f, distance, triangle))
+		{
+			hits++;
+			distanceSum += distance;
+		}
+	}
+	auto pickEnd = std::chrono::high_resolution_clock::now();
+
+	//every triangle, for the first few picks, has to find the same nearest hit
+	bool correct = true;
+	auto bruteStart = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < CHECKED; i++)
+	{
+		float nearest = 1000.0f;
+		bool hit = false;
+		for (size_t t = 0; t < mesh.indices.size(); t += 3)
+		{
+			XMFLOAT3 corners[3];
+			for (int corner = 0; corner < 3; corner++)
+			{
+				const float * position = mesh.vertices[mesh.indices[t + corner]].position;
+				corners[corner] = XMFLOAT3(position[0], position[1], position[2]);
+			}
+			float distance;
+			if (HitTriangle(corners, origins[i], directions[i], distance) && distance < nearest)
+			{
+				nearest = distance;
+				hit = true;
+			}
+		}
+		float distance;
+		int triangle;
+		bool bvhHit = bvh.Raycast(origins[i], directions[i], 1000.0f, distance, triangle);
+		correct &= bvhHit == hit && (!hit || fabsf(distance - nearest) <= 1e-4f * nearest);
+	}
+	auto bruteEnd = std::chrono::high_resolution_clock::now();
+
+	auto us = [](std::chrono::high_resolution_clock::time_point a, std::chrono::high_resolution_clock::time_point b)
+	{
+		return std::chrono::duration<double, std::micro>(b - a).count();
+	};
+	std::ostringstream report;
+	report << "Mesh BVH, " << bvh.TriangleCount() << " triangles in " << bvh.m_nodes.size() << " nodes, " << bvh.MemoryUsage() / 1024
+		<< " KB: build " << us(buildStart, buildEnd) / 1000.0 << " ms, " << us(pickStart, pickEnd) / PICKS << " us a pick ("
+		<< hits * 100 / PICKS << "% hit), every triangle " << us(bruteStart, bruteEnd) / CHECKED << " us a pick"
+		<< (correct ? "" : " (BVH DISAGREES)") << "\n";
+	return report.str();
+}
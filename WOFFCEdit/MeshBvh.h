@@ -0,0 +1,43 @@
+#pragma once
+
+#include "objToCmo.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//a bounding volume hierarchy over the triangles of a model, for picking what was really clicked rather than the box
+//around it. built top down, each node split where the surface area heuristic says over a handful of bins along its
+//longest axis, and flattened depth first so a node's first child is the next one along. the leaves own a copy of
+//their triangles' corners, three positions each in node order, so a ray never goes back to the index buffer.
+//built once per model and read only after, safe to raycast from several threads at once.
+
+class MeshBvh
+{
+public:
+	MeshBvh();
+	~MeshBvh();
+
+	void	Build(const ImportedMesh & mesh);
+	bool	IsEmpty() const { return m_nodes.empty(); }
+	size_t	TriangleCount() const { return m_corners.size() / 3; }
+	size_t	MemoryUsage() const;
+
+	//nearest triangle along the ray within maxDistance, in the model's own space. direction need not be normalised,
+	//distance is in multiples of it. both sides of a triangle are hit, as picking something from inside it should work
+	bool	Raycast(const DirectX::XMFLOAT3 & origin, const DirectX::XMFLOAT3 & direction, float maxDistance, float & distance, int & triangle) const;
+	DirectX::XMFLOAT3	GetNormal(int triangle) const;		//normalised, from the winding of the triangle
+
+	static std::string Benchmark(int gridResolution);		//build time and per pick latency on a high poly mesh, against testing every triangle
+
+private:
+	struct Node
+	{
+		float		bounds[6];		//min xyz, max xyz
+		uint32_t	start;			//first corner / 3 for a leaf, second child for an inner node
+		uint32_t	count;			//triangles in a leaf, 0 for an inner node
+	};
+
+	std::vector<Node>				m_nodes;
+	std::vector<DirectX::XMFLOAT3>	m_corners;		//three per triangle, in leaf order
+};
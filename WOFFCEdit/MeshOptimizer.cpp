@@ -0,0 +1,471 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+namespace
+{
+	//Forsyth's scoring. the cache modelled is bigger than any real one so the order suits every size reasonably
+	const int	CACHE_SIZE = 32;
+	const int	VALENCE_TABLE_SIZE = 64;
+	const float	LAST_TRIANGLE_SCORE = 0.75f;
+	const float	CACHE_DECAY_POWER = 1.5f;
+	const float	VALENCE_BOOST_SCALE = 2.0f;
+	const float	VALENCE_BOOST_POWER = 0.5f;
+
+	struct ScoreTables
+	{
+		float	cache[CACHE_SIZE];
+		float	valence[VALENCE_TABLE_SIZE];
+
+		ScoreTables()
+		{
+			for (int i = 0; i < CACHE_SIZE; i++)
+			{
+				//the three just used score the same whatever order they went in, so a strip isn't favoured over a fan
+				cache[i] = i < 3 ? LAST_TRIANGLE_SCORE : powf(1.0f - (i - 3) / (float)(CACHE_SIZE - 3), CACHE_DECAY_POWER);
+			}
+			valence[0] = 0.0f;
+			for (int i = 1; i < VALENCE_TABLE_SIZE; i++)
+			{
+				valence[i] = VALENCE_BOOST_SCALE * powf((float)i, -VALENCE_BOOST_POWER);
+			}
+		}
+	};
+
+	const ScoreTables & Scores()
+	{
+		static const ScoreTables tables;
+		return tables;
+	}
+
+	//vertices with few triangles left are boosted so they get finished off rather than left stranded
+	float VertexScore(int cachePosition, uint32_t remaining)
+	{
+		if (remaining == 0)
+		{
+			return -1.0f;
+		}
+		const ScoreTables & tables = Scores();
+		float score = cachePosition >= 0 ? tables.cache[cachePosition] : 0.0f;
+		score += remaining < VALENCE_TABLE_SIZE ? tables.valence[remaining] : VALENCE_BOOST_SCALE * powf((float)remaining, -VALENCE_BOOST_POWER);
+		return score;
+	}
+
+	uint32_t HashVertex(const CmoVertex & vertex)
+	{
+		const uint32_t * words = reinterpret_cast<const uint32_t*>(&vertex);
+		uint32_t h = 2166136261u;
+		for (size_t i = 0; i < sizeof(CmoVertex) / sizeof(uint32_t); i++)
+		{
+			h = (h ^ words[i]) * 16777619u;
+		}
+		return h ^ (h >> 16);
+	}
+
+	uint16_t QuantizeUnorm(float value, float offset, float scale)
+	{
+		float t = scale > 0.0f ? (value - offset) / scale : 0.0f;
+		return (uint16_t)(std::min(std::max(t, 0.0f), 1.0f) * 65535.0f + 0.5f);
+	}
+
+	int8_t QuantizeSnorm(float value)
+	{
+		float t = std::min(std::max(value, -1.0f), 1.0f) * 127.0f;
+		return (int8_t)(t < 0.0f ? t - 0.5f : t + 0.5f);
+	}
+
+	double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	//the triangles as full vertices, each turned to start at its smallest vertex so the winding is kept, then sorted.
+	//two meshes with the same triangles in any order and any numbering come out the same
+	std::vector<CmoVertex> CanonicalTriangles(const ImportedMesh & mesh)
+	{
+		size_t triangles = mesh.indices.size() / 3;
+		std::vector<CmoVertex> corners(triangles * 3);
+		for (size_t t = 0; t < triangles; t++)
+		{
+			const CmoVertex * v[3] = { &mesh.vertices[mesh.indices[t * 3]], &mesh.vertices[mesh.indices[t * 3 + 1]], &mesh.vertices[mesh.indices[t * 3 + 2]] };
+			int first = 0;
+			for (int k = 1; k < 3; k++)
+			{
+				if (memcmp(v[k], v[first], sizeof(CmoVertex)) < 0)
+				{
+					first = k;
+				}
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				corners[t * 3 + k] = *v[(first + k) % 3];
+			}
+		}
+		std::vector<size_t> order(triangles);
+		for (size_t t = 0; t < triangles; t++)
+		{
+			order[t] = t;
+		}
+		std::sort(order.begin(), order.end(), [&](size_t a, size_t b)
+		{
+			return memcmp(&corners[a * 3], &corners[b * 3], sizeof(CmoVertex) * 3) < 0;
+		});
+		std::vector<CmoVertex> sorted(corners.size());
+		for (size_t t = 0; t < triangles; t++)
+		{
+			memcpy(&sorted[t * 3], &corners[order[t] * 3], sizeof(CmoVertex) * 3);
+		}
+		return sorted;
+	}
+
+	//a CMO holds 16 bit indices, anything bigger is split into parts
+	size_t IndexBytes(const ImportedMesh & mesh)
+	{
+		return mesh.indices.size() * sizeof(uint16_t);
+	}
+}
+
+void MeshOptimizer::Optimize(ImportedMesh & mesh)
+{
+	RemoveDuplicateVertices(mesh);
+	OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	OptimizeVertexFetch(mesh);
+}
+
+size_t MeshOptimizer::RemoveDuplicateVertices(ImportedMesh & mesh)
+{
+	size_t count = mesh.vertices.size();
+	size_t tableSize = 1;
+	while (tableSize < count * 2)
+	{
+		tableSize <<= 1;
+	}
+	std::vector<uint32_t> table(tableSize, UINT32_MAX);
+	std::vector<uint32_t> remap(count);
+	std::vector<CmoVertex> unique;
+	unique.reserve(count);
+	for (size_t v = 0; v < count; v++)
+	{
+		const CmoVertex & vertex = mesh.vertices[v];
+		size_t slot = HashVertex(vertex) & (tableSize - 1);
+		while (true)
+		{
+			uint32_t existing = table[slot];
+			if (existing == UINT32_MAX)
+			{
+				table[slot] = (uint32_t)unique.size();
+				remap[v] = (uint32_t)unique.size();
+				unique.push_back(vertex);
+				break;
+			}
+			if (memcmp(&unique[existing], &vertex, sizeof(CmoVertex)) == 0)
+			{
+				remap[v] = existing;
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		mesh.indices[i] = remap[mesh.indices[i]];
+	}
+	size_t removed = count - unique.size();
+	mesh.vertices.swap(unique);
+	return removed;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32_t> & indices, size_t vertexCount)
+{
+	size_t triangles = indices.size() / 3;
+	if (triangles == 0)
+	{
+		return;
+	}
+
+	//the triangles of each vertex, packed. the first remaining[v] of a vertex's run are the ones not yet emitted
+	std::vector<uint32_t> remaining(vertexCount, 0), offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangles * 3; i++)
+	{
+		remaining[indices[i]]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		offsets[v + 1] = offsets[v] + remaining[v];
+	}
+	std::vector<uint32_t> adjacency(triangles * 3), fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangles * 3; i++)
+	{
+		adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+	}
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		vertexScore[v] = VertexScore(-1, remaining[v]);
+	}
+	std::vector<float> triangleScore(triangles);
+	std::vector<char> emitted(triangles, 0);
+	int best = -1;
+	float bestScore = -1.0f;
+	for (size_t t = 0; t < triangles; t++)
+	{
+		triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+		if (triangleScore[t] > bestScore)
+		{
+			bestScore = triangleScore[t];
+			best = (int)t;
+		}
+	}
+
+	std::vector<uint32_t> output;
+	output.reserve(triangles * 3);
+	uint32_t cache[CACHE_SIZE + 3];
+	int cacheCount = 0;
+	size_t scan = 0;
+	for (size_t done = 0; done < triangles; done++)
+	{
+		if (best < 0)
+		{
+			//nothing in the cache has triangles left, carry on from the next unused one
+			while (emitted[scan])
+			{
+				scan++;
+			}
+			best = (int)scan;
+		}
+		const uint32_t * corners = &indices[(size_t)best * 3];
+		output.insert(output.end(), corners, corners + 3);
+		emitted[best] = 1;
+
+		//the triangle's vertices go to the front of the cache, the rest move back
+		uint32_t next[CACHE_SIZE + 3];
+		int nextCount = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t v = corners[k];
+			uint32_t * run = &adjacency[offsets[v]];
+			uint32_t * found = std::find(run, run + remaining[v], (uint32_t)best);
+			*found = run[remaining[v] - 1];
+			remaining[v]--;
+			if (std::find(next, next + nextCount, v) == next + nextCount)
+			{
+				next[nextCount++] = v;
+			}
+		}
+		int front = nextCount;
+		for (int i = 0; i < cacheCount; i++)
+		{
+			if (std::find(next, next + front, cache[i]) == next + front)
+			{
+				next[nextCount++] = cache[i];
+			}
+		}
+
+		//rescore what is in, or just fell out of, the cache, and pick the best triangle touching it
+		for (int i = 0; i < nextCount; i++)
+		{
+			uint32_t v = next[i];
+			cachePosition[v] = i < CACHE_SIZE ? i : -1;
+			vertexScore[v] = VertexScore(cachePosition[v], remaining[v]);
+		}
+		best = -1;
+		bestScore = -1.0f;
+		for (int i = 0; i < nextCount; i++)
+		{
+			uint32_t v = next[i];
+			const uint32_t * run = &adjacency[offsets[v]];
+			for (uint32_t j = 0; j < remaining[v]; j++)
+			{
+				uint32_t t = run[j];
+				const uint32_t * c = &indices[(size_t)t * 3];
+				triangleScore[t] = vertexScore[c[0]] + vertexScore[c[1]] + vertexScore[c[2]];
+				if (triangleScore[t] > bestScore)
+				{
+					bestScore = triangleScore[t];
+					best = (int)t;
+				}
+			}
+		}
+		cacheCount = std::min(nextCount, CACHE_SIZE);
+		memcpy(cache, next, cacheCount * sizeof(uint32_t));
+	}
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(ImportedMesh & mesh)
+{
+	std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+	std::vector<CmoVertex> ordered;
+	ordered.reserve(mesh.vertices.size());
+	for (size_t i = 0; i < mesh.indices.size(); i++)
+	{
+		uint32_t & index = mesh.indices[i];
+		if (remap[index] == UINT32_MAX)
+		{
+			remap[index] = (uint32_t)ordered.size();
+			ordered.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.vertices.swap(ordered);
+}
+
+float MeshOptimizer::AverageCacheMissRatio(const std::vector<uint32_t> & indices, size_t vertexCount, int cacheSize)
+{
+	//the time each vertex went in, a vertex is in the FIFO if fewer than cacheSize have gone in since
+	std::vector<size_t> entered(vertexCount, 0);
+	size_t misses = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		size_t & time = entered[indices[i]];
+		if (time == 0 || misses + 1 - time > (size_t)cacheSize)
+		{
+			misses++;
+			time = misses;
+		}
+	}
+	return indices.size() >= 3 ? misses / (float)(indices.size() / 3) : 0.0f;
+}
+
+float MeshOptimizer::Quantize(const ImportedMesh & mesh, QuantizedMesh & quantized)
+{
+	float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	float uvMinimum[2] = { FLT_MAX, FLT_MAX }, uvMaximum[2] = { -FLT_MAX, -FLT_MAX };
+	for (size_t v = 0; v < mesh.vertices.size(); v++)
+	{
+		const CmoVertex & vertex = mesh.vertices[v];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			minimum[axis] = std::min(minimum[axis], vertex.position[axis]);
+			maximum[axis] = std::max(maximum[axis], vertex.position[axis]);
+		}
+		for (int axis = 0; axis < 2; axis++)
+		{
+			uvMinimum[axis] = std::min(uvMinimum[axis], vertex.uv[axis]);
+			uvMaximum[axis] = std::max(uvMaximum[axis], vertex.uv[axis]);
+		}
+	}
+	for (int axis = 0; axis < 3; axis++)
+	{
+		quantized.positionOffset[axis] = mesh.vertices.empty() ? 0.0f : minimum[axis];
+		quantized.positionScale[axis] = mesh.vertices.empty() ? 0.0f : maximum[axis] - minimum[axis];
+	}
+	for (int axis = 0; axis < 2; axis++)
+	{
+		quantized.uvOffset[axis] = mesh.vertices.empty() ? 0.0f : uvMinimum[axis];
+		quantized.uvScale[axis] = mesh.vertices.empty() ? 0.0f : uvMaximum[axis] - uvMinimum[axis];
+	}
+
+	float worst = 0.0f;
+	quantized.indices = mesh.indices;
+	quantized.vertices.resize(mesh.vertices.size());
+	for (size_t v = 0; v < mesh.vertices.size(); v++)
+	{
+		const CmoVertex & vertex = mesh.vertices[v];
+		QuantizedVertex & packed = quantized.vertices[v];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			packed.position[axis] = QuantizeUnorm(vertex.position[axis], quantized.positionOffset[axis], quantized.positionScale[axis]);
+			packed.normal[axis] = QuantizeSnorm(vertex.normal[axis]);
+			packed.tangent[axis] = QuantizeSnorm(vertex.tangent[axis]);
+			float restored = quantized.positionOffset[axis] + packed.position[axis] / 65535.0f * quantized.positionScale[axis];
+			worst = std::max(worst, fabsf(restored - vertex.position[axis]));
+		}
+		packed.position[3] = 0;
+		packed.normal[3] = 0;
+		packed.tangent[3] = vertex.tangent[3] < 0.0f ? -127 : 127;
+		packed.color = vertex.color;
+		packed.uv[0] = QuantizeUnorm(vertex.uv[0], quantized.uvOffset[0], quantized.uvScale[0]);
+		packed.uv[1] = QuantizeUnorm(vertex.uv[1], quantized.uvOffset[1], quantized.uvScale[1]);
+	}
+	return worst;
+}
+
+//a grid exported the way a lot of tools write meshes - every quad with its own four vertices and the triangles in no
+//useful order - optimized, and checked to still be the same triangles
+std::string MeshOptimizer::Benchmark(int gridResolution)
+{
+	int n = gridResolution;
+	ImportedMesh mesh;
+	mesh.vertices.reserve((size_t)n * n * 4);
+	mesh.indices.reserve((size_t)n * n * 6);
+	for (int z = 0; z < n; z++)
+	{
+		for (int x = 0; x < n; x++)
+		{
+			uint32_t base = (uint32_t)mesh.vertices.size();
+			const int corners[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+			for (int k = 0; k < 4; k++)
+			{
+				float cx = (float)(x + corners[k][0]), cz = (float)(z + corners[k][1]);
+				CmoVertex vertex;
+				vertex.position[0] = cx;
+				vertex.position[1] = sinf(cx * 0.1f) * cosf(cz * 0.13f) * 4.0f;
+				vertex.position[2] = cz;
+				vertex.normal[0] = 0.0f;	vertex.normal[1] = 1.0f;	vertex.normal[2] = 0.0f;
+				vertex.tangent[0] = 1.0f;	vertex.tangent[1] = 0.0f;	vertex.tangent[2] = 0.0f;	vertex.tangent[3] = 1.0f;
+				vertex.color = 0xffffffff;
+				vertex.uv[0] = cx / n;
+				vertex.uv[1] = cz / n;
+				mesh.vertices.push_back(vertex);
+			}
+			const uint32_t quad[6] = { 0, 2, 1, 0, 3, 2 };
+			for (int k = 0; k < 6; k++)
+			{
+				mesh.indices.push_back(base + quad[k]);
+			}
+		}
+	}
+	size_t triangles = mesh.indices.size() / 3;
+	std::vector<uint32_t> order(triangles);
+	for (size_t t = 0; t < triangles; t++)
+	{
+		order[t] = (uint32_t)t;
+	}
+	std::shuffle(order.begin(), order.end(), std::mt19937(1));
+	std::vector<uint32_t> shuffled(mesh.indices.size());
+	for (size_t t = 0; t < triangles; t++)
+	{
+		memcpy(&shuffled[t * 3], &mesh.indices[(size_t)order[t] * 3], sizeof(uint32_t) * 3);
+	}
+	mesh.indices.swap(shuffled);
+
+	std::vector<CmoVertex> before = CanonicalTriangles(mesh);
+	size_t verticesBefore = mesh.vertices.size();
+	size_t bytesBefore = mesh.vertices.size() * sizeof(CmoVertex) + IndexBytes(mesh);
+	float acmrBefore = AverageCacheMissRatio(mesh.indices, mesh.vertices.size(), 16);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t removed = RemoveDuplicateVertices(mesh);
+	double dedupMs = MillisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+	OptimizeVertexCache(mesh.indices, mesh.vertices.size());
+	double cacheMs = MillisecondsSince(start);
+	start = std::chrono::high_resolution_clock::now();
+	OptimizeVertexFetch(mesh);
+	double fetchMs = MillisecondsSince(start);
+
+	float acmrAfter = AverageCacheMissRatio(mesh.indices, mesh.vertices.size(), 16);
+	float acmrAfter32 = AverageCacheMissRatio(mesh.indices, mesh.vertices.size(), 32);
+	size_t bytesAfter = mesh.vertices.size() * sizeof(CmoVertex) + IndexBytes(mesh);
+	QuantizedMesh quantized;
+	float error = Quantize(mesh, quantized);
+	size_t bytesQuantized = quantized.vertices.size() * sizeof(QuantizedVertex) + IndexBytes(mesh);
+	std::vector<CmoVertex> after = CanonicalTriangles(mesh);
+	bool same = after.size() == before.size() && memcmp(after.data(), before.data(), after.size() * sizeof(CmoVertex)) == 0;
+
+	std::ostringstream report;
+	report << "Mesh optimizer, " << triangles << " triangles: " << verticesBefore << " vertices to " << mesh.vertices.size()
+		<< " (" << removed << " duplicates) in " << dedupMs << " ms, cache order " << cacheMs << " ms, fetch order " << fetchMs
+		<< " ms. ACMR at 16 " << acmrBefore << " to " << acmrAfter << " (" << acmrAfter32 << " at 32), "
+		<< bytesBefore / 1024 << " KB to " << bytesAfter / 1024 << " KB, " << bytesQuantized / 1024 << " KB quantized with "
+		<< error << " worst position error" << (same ? "" : " (MESH CHANGED)") << "\n";
+	return report.str();
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "objToCmo.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//the import time pass that gets a mesh ready for the GPU. bitwise duplicate vertices are merged, triangles are reordered
+//for the post transform vertex cache (Forsyth's linear speed algorithm), and vertices are then renumbered in the order
+//the triangles first use them so fetching walks the vertex buffer forwards. it runs on the CPU before anything is
+//written, so the CMO the model is loaded from, and the buffers made from it, are already in this order.
+//quantization packs the vertex into 24 bytes for data that doesn't have to go through a CMO.
+
+//positions as 16 bit fractions of the mesh bounds, normal and tangent as signed bytes, uv as 16 bit fractions of the uv bounds
+struct QuantizedVertex
+{
+	uint16_t	position[4];	//w unused, keeps the stride aligned
+	int8_t		normal[4];		//w unused
+	int8_t		tangent[4];		//w is the handedness
+	uint32_t	color;
+	uint16_t	uv[2];
+};
+
+struct QuantizedMesh
+{
+	std::vector<QuantizedVertex>	vertices;
+	std::vector<uint32_t>			indices;
+	float							positionOffset[3], positionScale[3];	//position = offset + stored / 65535 * scale
+	float							uvOffset[2], uvScale[2];
+};
+
+class MeshOptimizer
+{
+public:
+	//everything below in order, the usual thing to call
+	static void Optimize(ImportedMesh & mesh);
+
+	static size_t RemoveDuplicateVertices(ImportedMesh & mesh);		//returns how many went
+	static void OptimizeVertexCache(std::vector<uint32_t> & indices, size_t vertexCount);
+	static void OptimizeVertexFetch(ImportedMesh & mesh);			//also drops vertices no triangle uses
+
+	//average cache miss ratio, misses per triangle through a FIFO cache of cacheSize. 0.5 is the best a grid can do, 3 the worst
+	static float AverageCacheMissRatio(const std::vector<uint32_t> & indices, size_t vertexCount, int cacheSize);
+
+	//returns the largest position error it introduced
+	static float Quantize(const ImportedMesh & mesh, QuantizedMesh & quantized);
+
+	static std::string Benchmark(int gridResolution);
+};
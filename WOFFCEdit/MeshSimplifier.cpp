@@ -0,0 +1,605 @@
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <sys/stat.h>
+#include <unordered_map>
+
+namespace
+{
+	const uint32_t	LOD_MAGIC = 0x444f4c57;		//"WLOD"
+	const uint32_t	LOD_VERSION = 2;
+	const int		LOD_LEVELS = 4;
+	const float		LOD_MAX_ERROR = 0.1f;		//of the model's radius, for the coarsest level
+	const double	BORDER_WEIGHT = 10.0;		//of the planes that hold an open border in place, against a triangle's own
+
+	//symmetric 4x4, the upper triangle row by row
+	struct Quadric
+	{
+		double	m[10];
+
+		void Clear()
+		{
+			memset(m, 0, sizeof(m));
+		}
+		void AddPlane(double a, double b, double c, double d)
+		{
+			m[0] += a * a;	m[1] += a * b;	m[2] += a * c;	m[3] += a * d;
+			m[4] += b * b;	m[5] += b * c;	m[6] += b * d;
+			m[7] += c * c;	m[8] += c * d;
+			m[9] += d * d;
+		}
+		void Add(const Quadric & other)
+		{
+			for (int i = 0; i < 10; i++)
+			{
+				m[i] += other.m[i];
+			}
+		}
+		double Error(const float * p) const
+		{
+			double x = p[0], y = p[1], z = p[2];
+			double error = m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+				+ m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+				+ m[7] * z * z + 2.0 * m[8] * z
+				+ m[9];
+			return std::max(error, 0.0);
+		}
+	};
+
+	struct Collapse
+	{
+		uint32_t	from, to;
+		double		cost;
+	};
+
+	void TriangleNormal(const float * a, const float * b, const float * c, float * normal)
+	{
+		float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float ac[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+		normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+		normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+	}
+
+	uint64_t EdgeKey(uint32_t a, uint32_t b)
+	{
+		return ((uint64_t)a << 32) | b;
+	}
+
+	float Radius(const ImportedMesh & mesh)
+	{
+		float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				minimum[axis] = std::min(minimum[axis], mesh.vertices[v].position[axis]);
+				maximum[axis] = std::max(maximum[axis], mesh.vertices[v].position[axis]);
+			}
+		}
+		float size[3] = { maximum[0] - minimum[0], maximum[1] - minimum[1], maximum[2] - minimum[2] };
+		return mesh.vertices.empty() ? 0.0f : 0.5f * sqrtf(size[0] * size[0] + size[1] * size[1] + size[2] * size[2]);
+	}
+
+	bool ReadFile(const std::string & path, std::vector<uint8_t> & data)
+	{
+		FILE * file = fopen(path.c_str(), "rb");
+		if (!file)
+		{
+			return false;
+		}
+		fseek(file, 0, SEEK_END);
+		long size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		data.resize(size > 0 ? size : 0);
+		bool read = size > 0 && fread(data.data(), 1, data.size(), file) == data.size();
+		fclose(file);
+		return read;
+	}
+
+	//what the .lod file remembers of the model it was built from
+	struct LodSource
+	{
+		uint64_t	size;
+		int64_t		modified;
+	};
+
+	bool SourceOf(const std::string & path, LodSource & source)
+	{
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+		{
+			return false;
+		}
+		source.size = (uint64_t)info.st_size;
+		source.modified = (int64_t)info.st_mtime;
+		return true;
+	}
+}
+
+float MeshSimplifier::Simplify(const ImportedMesh & mesh, size_t targetTriangles, float maxError, ImportedMesh & simplified)
+{
+	size_t vertexCount = mesh.vertices.size();
+	std::vector<uint32_t> indices = mesh.indices;
+
+	//vertices that share a position are one point of the surface, and a point with more than one vertex is on a seam
+	std::vector<uint32_t> point(vertexCount);
+	std::vector<uint32_t> pointVertices(vertexCount, 0);
+	{
+		std::unordered_map<uint64_t, std::vector<uint32_t>> byBits;
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			const float * p = mesh.vertices[v].position;
+			uint32_t bits[3];
+			memcpy(bits, p, sizeof(bits));
+			uint64_t hash = ((uint64_t)bits[0] * 73856093u) ^ ((uint64_t)bits[1] * 19349663u << 21) ^ ((uint64_t)bits[2] * 83492791u << 42);
+			std::vector<uint32_t> & candidates = byBits[hash];
+			point[v] = v;
+			for (size_t i = 0; i < candidates.size(); i++)
+			{
+				if (memcmp(mesh.vertices[candidates[i]].position, p, sizeof(float) * 3) == 0)
+				{
+					point[v] = candidates[i];
+					break;
+				}
+			}
+			if (point[v] == v)
+			{
+				candidates.push_back(v);
+			}
+			pointVertices[point[v]]++;
+		}
+	}
+	std::vector<char> locked(vertexCount, 0);
+	for (uint32_t v = 0; v < vertexCount; v++)
+	{
+		locked[v] = pointVertices[point[v]] > 1;
+	}
+
+	//an edge between points that only one triangle goes along, either way round, is on a border, and its ends may
+	//only move along the border. an edge used more than once the same way round is not manifold, and its ends are locked
+	std::vector<char> border(vertexCount, 0);
+	std::unordered_map<uint64_t, int> edges;
+	{
+		edges.reserve(indices.size());
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				edges[EdgeKey(point[indices[i + k]], point[indices[i + (k + 1) % 3]])]++;
+			}
+		}
+		std::vector<char> lockedPoint(vertexCount, 0), borderPoint(vertexCount, 0);
+		for (auto edge = edges.begin(); edge != edges.end(); ++edge)
+		{
+			uint32_t a = (uint32_t)(edge->first >> 32), b = (uint32_t)edge->first;
+			auto reverse = edges.find(EdgeKey(b, a));
+			if (edge->second > 1 || (reverse != edges.end() && reverse->second > 1))
+			{
+				lockedPoint[a] = lockedPoint[b] = 1;
+			}
+			else if (reverse == edges.end())
+			{
+				borderPoint[a] = borderPoint[b] = 1;
+			}
+		}
+		for (uint32_t v = 0; v < vertexCount; v++)
+		{
+			locked[v] |= lockedPoint[point[v]];
+			border[v] = borderPoint[point[v]] && !locked[v];
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		quadrics[v].Clear();
+	}
+	for (size_t i = 0; i < indices.size(); i += 3)
+	{
+		const float * a = mesh.vertices[indices[i]].position;
+		float normal[3];
+		TriangleNormal(a, mesh.vertices[indices[i + 1]].position, mesh.vertices[indices[i + 2]].position, normal);
+		double length = sqrt((double)normal[0] * normal[0] + (double)normal[1] * normal[1] + (double)normal[2] * normal[2]);
+		if (length < 1e-20)
+		{
+			continue;
+		}
+		double nx = normal[0] / length, ny = normal[1] / length, nz = normal[2] / length;
+		double d = -(nx * a[0] + ny * a[1] + nz * a[2]);
+		for (int k = 0; k < 3; k++)
+		{
+			quadrics[indices[i + k]].AddPlane(nx, ny, nz, d);
+		}
+
+		//a border edge adds the plane through it at right angles to the triangle, so its ends pay for leaving the outline
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t from = indices[i + k], to = indices[i + (k + 1) % 3];
+			if ((!border[from] && !border[to]) || edges.count(EdgeKey(point[to], point[from])))
+			{
+				continue;
+			}
+			const float * p = mesh.vertices[from].position, * q = mesh.vertices[to].position;
+			double edge[3] = { (double)q[0] - p[0], (double)q[1] - p[1], (double)q[2] - p[2] };
+			double px = edge[1] * nz - edge[2] * ny, py = edge[2] * nx - edge[0] * nz, pz = edge[0] * ny - edge[1] * nx;
+			double planeLength = sqrt(px * px + py * py + pz * pz);
+			if (planeLength < 1e-20)
+			{
+				continue;
+			}
+			double weight = sqrt(BORDER_WEIGHT) / planeLength;
+			px *= weight;	py *= weight;	pz *= weight;
+			double pd = -(px * p[0] + py * p[1] + pz * p[2]);
+			quadrics[from].AddPlane(px, py, pz, pd);
+			quadrics[to].AddPlane(px, py, pz, pd);
+		}
+	}
+
+	double limit = (double)maxError * maxError;
+	float reached = 0.0f;
+	std::vector<uint32_t> offsets(vertexCount + 1), adjacency, remap(vertexCount);
+	std::vector<char> touched(vertexCount);
+	std::vector<uint32_t> mark(vertexCount, 0);
+	uint32_t stamp = 0;
+	std::vector<Collapse> collapses;
+	while (indices.size() / 3 > targetTriangles)
+	{
+		//the triangles around each vertex
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			offsets[indices[i] + 1]++;
+		}
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			offsets[v + 1] += offsets[v];
+		}
+		adjacency.resize(indices.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			adjacency[fill[indices[i]]++] = (uint32_t)(i / 3);
+		}
+
+		//an edge that only one triangle has is still on the border
+		auto onBorder = [&](uint32_t a, uint32_t b)
+		{
+			int triangles = 0;
+			for (uint32_t j = offsets[a]; j < offsets[a + 1]; j++)
+			{
+				const uint32_t * triangle = &indices[(size_t)adjacency[j] * 3];
+				triangles += triangle[0] == b || triangle[1] == b || triangle[2] == b;
+			}
+			return triangles == 1;
+		};
+
+		//every edge both ways round, as far as the end moving is free to - a border vertex only along the border. an
+		//edge inside the mesh is between two triangles, and is taken from the one that has it lower numbered end first
+		collapses.clear();
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+				bool borderEdge = border[a] && border[b] && onBorder(a, b);
+				if (a > b && !locked[a] && !locked[b] && !borderEdge)
+				{
+					continue;
+				}
+				for (int direction = 0; direction < 2; direction++, std::swap(a, b))
+				{
+					if (locked[a] || (border[a] && !borderEdge))
+					{
+						continue;
+					}
+					Quadric sum = quadrics[a];
+					sum.Add(quadrics[b]);
+					Collapse collapse = { a, b, sum.Error(mesh.vertices[b].position) };
+					if (collapse.cost <= limit)
+					{
+						collapses.push_back(collapse);
+					}
+				}
+			}
+		}
+		if (collapses.empty())
+		{
+			break;
+		}
+
+		//take the cheapest collapses whose neighbourhoods don't overlap, until enough triangles would go. a collapse
+		//mostly takes two triangles with it, and none much dearer than the one that would be needed last is made this pass,
+		//so a pass can't jump ahead of what cheaper collapses in later passes would do
+		for (size_t v = 0; v < vertexCount; v++)
+		{
+			remap[v] = (uint32_t)v;
+		}
+		std::fill(touched.begin(), touched.end(), 0);
+		size_t toRemove = indices.size() / 3 - targetTriangles, removed = 0;
+		auto cheaper = [](const Collapse & x, const Collapse & y) { return x.cost < y.cost; };
+		size_t needed = std::min(collapses.size() - 1, toRemove / 2);
+		std::nth_element(collapses.begin(), collapses.begin() + needed, collapses.end(), cheaper);
+		double passLimit = collapses[needed].cost * 1.5;
+		auto affordable = std::partition(collapses.begin(), collapses.end(), [&](const Collapse & x) { return x.cost <= passLimit; });
+		collapses.erase(affordable, collapses.end());
+		std::sort(collapses.begin(), collapses.end(), cheaper);
+		for (size_t c = 0; c < collapses.size() && removed < toRemove; c++)
+		{
+			const Collapse & collapse = collapses[c];
+			if (touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+			const float * to = mesh.vertices[collapse.to].position;
+			bool flips = false;
+			size_t shared = 0;
+			for (uint32_t j = offsets[collapse.from]; j < offsets[collapse.from + 1] && !flips; j++)
+			{
+				const uint32_t * triangle = &indices[(size_t)adjacency[j] * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					shared++;
+					continue;
+				}
+				const float * before[3], * after[3];
+				for (int k = 0; k < 3; k++)
+				{
+					before[k] = mesh.vertices[triangle[k]].position;
+					after[k] = triangle[k] == collapse.from ? to : before[k];
+				}
+				float normalBefore[3], normalAfter[3];
+				TriangleNormal(before[0], before[1], before[2], normalBefore);
+				TriangleNormal(after[0], after[1], after[2], normalAfter);
+				flips = normalBefore[0] * normalAfter[0] + normalBefore[1] * normalAfter[1] + normalBefore[2] * normalAfter[2] <= 0.0f;
+			}
+			if (flips)
+			{
+				continue;
+			}
+
+			//the ends may have no neighbours in common but the far corners of the triangles on the edge, or the
+			//collapse would pinch the surface together there
+			stamp += 2;
+			for (uint32_t j = offsets[collapse.from]; j < offsets[collapse.from + 1]; j++)
+			{
+				const uint32_t * triangle = &indices[(size_t)adjacency[j] * 3];
+				mark[triangle[0]] = mark[triangle[1]] = mark[triangle[2]] = stamp - 1;
+			}
+			size_t common = 0;
+			for (uint32_t j = offsets[collapse.to]; j < offsets[collapse.to + 1]; j++)
+			{
+				const uint32_t * triangle = &indices[(size_t)adjacency[j] * 3];
+				for (int k = 0; k < 3; k++)
+				{
+					uint32_t v = triangle[k];
+					if (v != collapse.from && v != collapse.to && mark[v] == stamp - 1)
+					{
+						mark[v] = stamp;
+						common++;
+					}
+				}
+			}
+			if (common != shared)
+			{
+				continue;
+			}
+
+			//everything around the vertex that moves is left alone for the rest of the pass, so the flip test stays true
+			for (uint32_t j = offsets[collapse.from]; j < offsets[collapse.from + 1]; j++)
+			{
+				const uint32_t * triangle = &indices[(size_t)adjacency[j] * 3];
+				touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = 1;
+			}
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to].Add(quadrics[collapse.from]);
+			reached = std::max(reached, (float)sqrt(collapse.cost));
+			removed += shared;
+		}
+		if (removed == 0)
+		{
+			break;
+		}
+
+		size_t kept = 0;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			uint32_t a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+			if (a != b && b != c && c != a)
+			{
+				indices[kept++] = a;
+				indices[kept++] = b;
+				indices[kept++] = c;
+			}
+		}
+		indices.resize(kept);
+	}
+
+	simplified.vertices = mesh.vertices;
+	simplified.indices.swap(indices);
+	MeshOptimizer::OptimizeVertexCache(simplified.indices, simplified.vertices.size());
+	MeshOptimizer::OptimizeVertexFetch(simplified);
+	return reached;
+}
+
+void MeshSimplifier::GenerateLods(const ImportedMesh & mesh, int levels, float maxError, std::vector<ImportedMesh> & lods, std::vector<float> & errors)
+{
+	lods.clear();
+	errors.clear();
+	size_t triangles = mesh.indices.size() / 3;
+	for (int level = 1; level <= levels; level++)
+	{
+		//each from the original, so error doesn't pile up level on level
+		ImportedMesh lod;
+		float error = Simplify(mesh, triangles / 2, maxError, lod);
+		if (lod.indices.size() / 3 > triangles * 3 / 4 || lod.indices.empty())
+		{
+			break;
+		}
+		triangles = lod.indices.size() / 3;
+		lods.push_back(ImportedMesh());
+		lods.back().vertices.swap(lod.vertices);
+		lods.back().indices.swap(lod.indices);
+		errors.push_back(error);
+	}
+}
+
+bool MeshSimplifier::CachedLods(const std::string & modelPath, std::vector<LodLevel> & levels, std::string & error)
+{
+	levels.clear();
+	LodSource source;
+	if (!SourceOf(modelPath, source))
+	{
+		error = "can't find " + modelPath;
+		return false;
+	}
+
+	//header, then each level as its error, size and CMO
+	std::string lodPath = modelPath.substr(0, modelPath.find_last_of('.')) + ".lod";
+	std::vector<uint8_t> cache;
+	if (ReadFile(lodPath, cache) && cache.size() >= 28)
+	{
+		uint32_t header[2];
+		LodSource cached;
+		uint32_t count;
+		memcpy(header, &cache[0], sizeof(header));
+		memcpy(&cached.size, &cache[8], sizeof(cached.size));
+		memcpy(&cached.modified, &cache[16], sizeof(cached.modified));
+		memcpy(&count, &cache[24], sizeof(count));
+		if (header[0] == LOD_MAGIC && header[1] == LOD_VERSION && cached.size == source.size && cached.modified == source.modified)
+		{
+			size_t used = 28;
+			for (uint32_t i = 0; i < count && used + 8 <= cache.size(); i++)
+			{
+				LodLevel level;
+				uint32_t bytes;
+				memcpy(&level.error, &cache[used], sizeof(float));
+				memcpy(&bytes, &cache[used + 4], sizeof(bytes));
+				used += 8;
+				if (bytes > cache.size() - used)
+				{
+					break;
+				}
+				level.cmo.assign(cache.begin() + used, cache.begin() + used + bytes);
+				used += bytes;
+				levels.push_back(level);
+			}
+			if (levels.size() == count)
+			{
+				return true;
+			}
+			levels.clear();
+		}
+	}
+
+	//missing or stale, build it again
+	std::vector<uint8_t> data;
+	ImportedMesh mesh;
+	if (!ReadFile(modelPath, data) || !ObjToCmo::Read(data.data(), data.size(), mesh, error))
+	{
+		error = "can't read " + modelPath + (error.empty() ? "" : ": " + error);
+		return false;
+	}
+	std::vector<ImportedMesh> lods;
+	std::vector<float> errors;
+	GenerateLods(mesh, LOD_LEVELS, Radius(mesh) * LOD_MAX_ERROR, lods, errors);
+
+	size_t slash = modelPath.find_last_of("/\\");
+	std::string name = modelPath.substr(slash == std::string::npos ? 0 : slash + 1);
+	name = name.substr(0, name.find_last_of('.'));
+	for (size_t i = 0; i < lods.size(); i++)
+	{
+		LodLevel level;
+		level.error = errors[i];
+		ObjToCmo::Serialise(lods[i], name + "_lod" + std::to_string(i + 1), level.cmo);
+		levels.push_back(level);
+	}
+
+	//a cache that can't be written only costs the next load the time to build it again
+	FILE * file = fopen(lodPath.c_str(), "wb");
+	if (file)
+	{
+		uint32_t header[2] = { LOD_MAGIC, LOD_VERSION };
+		uint32_t count = (uint32_t)levels.size();
+		fwrite(header, sizeof(header), 1, file);
+		fwrite(&source.size, sizeof(source.size), 1, file);
+		fwrite(&source.modified, sizeof(source.modified), 1, file);
+		fwrite(&count, sizeof(count), 1, file);
+		for (size_t i = 0; i < levels.size(); i++)
+		{
+			uint32_t bytes = (uint32_t)levels[i].cmo.size();
+			fwrite(&levels[i].error, sizeof(float), 1, file);
+			fwrite(&bytes, sizeof(bytes), 1, file);
+			fwrite(levels[i].cmo.data(), 1, bytes, file);
+		}
+		fclose(file);
+	}
+	return true;
+}
+
+//a rolling heightfield grid simplified to a run of triangle budgets, and to an error bound with no budget. that the
+//budgets are met and the bound kept is checked by the tests, on the same grid
+std::string MeshSimplifier::Benchmark(int gridResolution)
+{
+	int n = gridResolution;
+	ImportedMesh mesh;
+	for (int z = 0; z <= n; z++)
+	{
+		for (int x = 0; x <= n; x++)
+		{
+			CmoVertex vertex;
+			memset(&vertex, 0, sizeof(vertex));
+			vertex.position[0] = (float)x;
+			vertex.position[1] = sinf(x * 0.05f) * cosf(z * 0.07f) * 6.0f + sinf(x * 0.31f + z * 0.17f) * 0.5f;
+			vertex.position[2] = (float)z;
+			vertex.normal[1] = 1.0f;
+			vertex.tangent[0] = vertex.tangent[3] = 1.0f;
+			vertex.color = 0xffffffff;
+			vertex.uv[0] = (float)x / n;
+			vertex.uv[1] = (float)z / n;
+			mesh.vertices.push_back(vertex);
+		}
+	}
+	for (int z = 0; z < n; z++)
+	{
+		for (int x = 0; x < n; x++)
+		{
+			uint32_t a = z * (n + 1) + x, b = a + 1, c = a + n + 2, d = a + n + 1;
+			uint32_t quad[6] = { a, c, b, a, d, c };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+	size_t triangles = mesh.indices.size() / 3;
+
+	std::ostringstream report;
+	report << "Mesh simplifier, " << triangles << " triangles:";
+	double totalMs = 0.0;
+	size_t totalTriangles = 0;
+	const float fractions[] = { 0.5f, 0.25f, 0.1f, 0.05f };
+	for (int i = 0; i < 4; i++)
+	{
+		size_t target = (size_t)(triangles * fractions[i]);
+		ImportedMesh simplified;
+		auto start = std::chrono::high_resolution_clock::now();
+		float error = Simplify(mesh, target, FLT_MAX, simplified);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		totalMs += ms;
+		totalTriangles += triangles;
+		report << " " << simplified.indices.size() / 3 << " (error " << error << ") in " << ms << " ms,";
+	}
+
+	//no budget, only the bound
+	const float bound = 0.25f;
+	ImportedMesh bounded;
+	float boundedError = Simplify(mesh, 0, bound, bounded);
+
+	report << " " << totalTriangles / (totalMs / 1000.0) / 1e6 << " M triangles/s. bound " << bound << " kept "
+		<< bounded.indices.size() / 3 << " triangles (error " << boundedError << ")\n";
+	return report.str();
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "objToCmo.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//quadric error mesh simplification (Garland and Heckbert) for levels of detail. each vertex carries the sum of the
+//squared distances to the planes of its triangles, and edges are collapsed cheapest first, a vertex moving onto one of
+//its neighbours so every attribute stays one the model really had. collapses are made in passes of independent edges
+//and one that would flip a triangle or pinch the surface is skipped. a vertex on an open border only moves along the
+//border, with the plane at right angles to each border triangle added to its quadric, so the outline is kept as far as
+//the budget allows. vertices on a uv / normal seam don't move, which keeps the texture mapping of the model intact.
+//the levels of a model are cached on disk beside it, in a .lod file of CMOs that is rebuilt when the model changes.
+
+struct LodLevel
+{
+	float					error;		//world units, at the model's own scale
+	std::vector<uint8_t>	cmo;
+};
+
+class MeshSimplifier
+{
+public:
+	//collapses until mesh has targetTriangles or fewer, or the next collapse would be over maxError. a mesh cut up by
+	//seams can stop short of both, at about the triangles the seams need. returns the error reached, the square root
+	//of the largest quadric error of a collapse made
+	static float Simplify(const ImportedMesh & mesh, size_t targetTriangles, float maxError, ImportedMesh & simplified);
+
+	//up to levels meshes, each with half the triangles of the one before, within maxError of the original. stops early
+	//when a level can't get below three quarters of the one before
+	static void GenerateLods(const ImportedMesh & mesh, int levels, float maxError, std::vector<ImportedMesh> & lods, std::vector<float> & errors);
+
+	//the levels for the CMO at modelPath, from its .lod file, or built and written to it when that is missing or out
+	//of date. an empty list is fine, the model is too simple to have any
+	static bool CachedLods(const std::string & modelPath, std::vector<LodLevel> & levels, std::string & error);
+
+	static std::string Benchmark(int gridResolution);
+};
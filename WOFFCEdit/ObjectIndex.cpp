@@ -0,0 +1,45 @@
+#include "ObjectIndex.h"
+
+
+ObjectIndex::ObjectIndex()
+{
+}
+
+
+ObjectIndex::~ObjectIndex()
+{
+}
+
+void ObjectIndex::Clear()
+{
+	m_positions.clear();
+}
+
+void ObjectIndex::Insert(int ID, int position)
+{
+	m_positions[ID] = position;
+}
+
+bool ObjectIndex::Remove(int ID)
+{
+	return m_positions.erase(ID) != 0;
+}
+
+void ObjectIndex::Move(int ID, int position)
+{
+	auto found = m_positions.find(ID);
+	if (found != m_positions.end())
+	{
+		found->second = position;
+	}
+}
+
+int ObjectIndex::Find(int ID) const
+{
+	auto found = m_positions.find(ID);
+	if (found == m_positions.end())
+	{
+		return -1;
+	}
+	return found->second;
+}
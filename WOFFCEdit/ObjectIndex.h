@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+//maps a database ID to its position in a dense array (the scenegraph or the display list).
+//everything that refers to an object keeps its database ID, which stays the same across deletes, undos and saves,
+//and looks the position up here when it needs it - a deleted object simply is not found.
+//lookup, insert and remove are all O(1), which lets the arrays use swap-and-pop removal.
+
+class ObjectIndex
+{
+public:
+	ObjectIndex();
+	~ObjectIndex();
+
+	void	Clear();
+	void	Insert(int ID, int position);		//ID must not already be in the index
+	bool	Remove(int ID);						//returns false if the ID was not there
+	void	Move(int ID, int position);			//the object has been moved to a new position in the array
+	int		Find(int ID) const;					//position in the array, -1 if the ID is not there
+	int		Size() const { return (int)m_positions.size(); }
+
+private:
+	std::unordered_map<int, int>	m_positions;		//database ID -> position
+};
@@ -0,0 +1,158 @@
+#include "ObjectSearchIndex.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <sstream>
+
+
+ObjectSearchIndex::ObjectSearchIndex()
+{
+}
+
+
+ObjectSearchIndex::~ObjectSearchIndex()
+{
+}
+
+static std::string ToLower(const std::string & text)
+{
+	std::string lower = text;
+	for (size_t i = 0; i < lower.size(); i++)
+	{
+		lower[i] = (char)tolower((unsigned char)lower[i]);
+	}
+	return lower;
+}
+
+unsigned int ObjectSearchIndex::Trigram(const char * text)
+{
+	return ((unsigned char)text[0] << 16) | ((unsigned char)text[1] << 8) | (unsigned char)text[2];
+}
+
+void ObjectSearchIndex::Build(const Scene & sceneGraph)
+{
+	m_lines.clear();
+	m_trigrams.clear();
+	m_allRows.clear();
+	m_lastQuery.clear();
+
+	int numObjects = sceneGraph.Size();
+	m_lines.reserve(numObjects);
+	m_allRows.reserve(numObjects);
+
+	for (int i = 0; i < numObjects; i++)
+	{
+		//fields are separated by a newline, which can not be typed into the search box, so no match spans two fields
+		m_lines.push_back(ToLower(std::to_string(sceneGraph.GetID(i)) + "\n" + sceneGraph.GetName(i) + "\n" + StringTable::AssetPaths().Lookup(sceneGraph.GetRender(i).model_path)));
+		m_allRows.push_back(i);
+
+		const std::string & line = m_lines.back();
+		for (size_t c = 0; c + 3 <= line.size(); c++)
+		{
+			//rows go in ascending, so a repeat of this trigram in the same row is always at the back
+			std::vector<int> & rows = m_trigrams[Trigram(&line[c])];
+			if (rows.empty() || rows.back() != i)
+			{
+				rows.push_back(i);
+			}
+		}
+	}
+
+	m_results = m_allRows;
+}
+
+const std::vector<int> & ObjectSearchIndex::Query(const std::string & text)
+{
+	std::string query = ToLower(text);
+
+	if (query.empty())
+	{
+		m_results = m_allRows;
+	}
+	else if (!m_lastQuery.empty() && query.find(m_lastQuery) != std::string::npos)
+	{
+		//anything matching the longer query also matched the last one, so only the last results need checking
+		m_scratch.swap(m_results);
+		MatchCandidates(m_scratch, query);
+	}
+	else if (query.size() >= 3)
+	{
+		//every match contains every trigram of the query, so the shortest posting list holds all of them
+		const std::vector<int> * candidates = NULL;
+		for (size_t c = 0; c + 3 <= query.size(); c++)
+		{
+			auto found = m_trigrams.find(Trigram(&query[c]));
+			if (found == m_trigrams.end())
+			{
+				static const std::vector<int> noRows;
+				candidates = &noRows;
+				break;
+			}
+			if (candidates == NULL || found->second.size() < candidates->size())
+			{
+				candidates = &found->second;
+			}
+		}
+		MatchCandidates(*candidates, query);
+	}
+	else
+	{
+		MatchCandidates(m_allRows, query);
+	}
+
+	m_lastQuery = query;
+	return m_results;
+}
+
+void ObjectSearchIndex::MatchCandidates(const std::vector<int> & candidates, const std::string & query)
+{
+	m_results.clear();
+	for (size_t i = 0; i < candidates.size(); i++)
+	{
+		if (m_lines[candidates[i]].find(query) != std::string::npos)
+		{
+			m_results.push_back(candidates[i]);
+		}
+	}
+}
+
+std::string ObjectSearchIndex::Benchmark(int objects)
+{
+	const char * names[] = { "Tree", "Rock", "House", "Fence", "Lamp Post", "Crate" };
+	const char * models[] = { "tree", "rock", "house", "fence", "lamp", "crate" };
+	Scene sceneGraph;
+	sceneGraph.Reserve(objects);
+	for (int i = 0; i < objects; i++)
+	{
+		SceneObject object;
+		object.ID = i + 1;
+		object.name = std::string(names[i % 6]) + "_" + std::to_string(i % 97);
+		object.model_path = StringTable::AssetPaths().Intern("database/data/" + std::string(models[(i / 6) % 6]) + std::to_string(i % 13) + ".cmo");
+		sceneGraph.Add(object);
+	}
+
+	auto buildStart = std::chrono::high_resolution_clock::now();
+	ObjectSearchIndex index;
+	index.Build(sceneGraph);
+	double buildMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - buildStart).count();
+
+	//typed a character at a time, then some fresh searches - misses, mixed case, one and two characters, an ID
+	const char * queries[] = { "r", "ro", "roc", "rock", "rock_", "rock_4", "rock_42", "HOUSE", "lamp p", "fence_9", "data/crate1",
+		".cmo", "12", "4999", "7", "zzz", "" };
+	const int numQueries = sizeof(queries) / sizeof(queries[0]);
+
+	double worstMs = 0.0, totalMs = 0.0;
+	for (int q = 0; q < numQueries; q++)
+	{
+		auto queryStart = std::chrono::high_resolution_clock::now();
+		index.Query(queries[q]);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - queryStart).count();
+		worstMs = std::max(worstMs, ms);
+		totalMs += ms;
+	}
+
+	std::ostringstream report;
+	report << "Object search, " << objects << " objects: build " << buildMs << " ms, " << numQueries << " queries "
+		<< totalMs / numQueries << " ms average, " << worstMs << " ms worst\n";
+	return report.str();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "Scene.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+//search index behind the object browser. kept free of MFC so it can be driven from anywhere.
+//each object is reduced to one lower case line of "ID name model_path", and every three character run in that line
+//points back at the rows containing it. a query only has to check the rows listed under its rarest trigram,
+//and typing another character only re-checks the rows that matched the previous query.
+
+class ObjectSearchIndex
+{
+public:
+	ObjectSearchIndex();
+	~ObjectSearchIndex();
+
+	void	Build(const Scene & sceneGraph);
+	const std::vector<int> & Query(const std::string & text);	//rows of the scenegraph matching text, in scenegraph order. empty text matches everything
+	const std::vector<int> & GetResults() const { return m_results; }
+
+	static std::string Benchmark(int objects);	//build time and typed queries
+
+private:
+	static unsigned int Trigram(const char * text);
+	void	MatchCandidates(const std::vector<int> & candidates, const std::string & query);
+
+	std::vector<std::string>							m_lines;		//searchable text per scenegraph row
+	std::unordered_map<unsigned int, std::vector<int>>	m_trigrams;		//trigram -> rows that contain it, ascending
+	std::vector<int>									m_allRows;
+
+	std::string			m_lastQuery;
+	std::vector<int>	m_results;
+	std::vector<int>	m_scratch;
+};
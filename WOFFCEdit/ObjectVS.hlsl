@@ -0,0 +1,75 @@
+//the vertex shader BasicEffect picks for the effects EffectFactory makes from a CMO - three lights per vertex, a
+//texture and vertex colour, no fog - with the object's matrices moved out of the effect's constants into a buffer of
+//their own. the effect is applied once for a run of draws that share it, setting the pixel shader, texture, material
+//and lights, and only this small buffer changes between the objects of the run.
+//the output matches VSOutputTx, which is what the effect's pixel shader reads.
+
+cbuffer Parameters : register(b0)
+{
+	float4 DiffuseColor				: packoffset(c0);
+	float3 EmissiveColor			: packoffset(c1);
+	float3 SpecularColor			: packoffset(c2);
+	float  SpecularPower			: packoffset(c2.w);
+
+	float3 LightDirection[3]		: packoffset(c3);
+	float3 LightDiffuseColor[3]		: packoffset(c6);
+	float3 LightSpecularColor[3]	: packoffset(c9);
+
+	float3 EyePosition				: packoffset(c12);
+};
+
+cbuffer ObjectMatrices : register(b1)
+{
+	float4x4 World;
+	float3x3 WorldInverseTranspose;
+	float4x4 WorldViewProj;
+};
+
+struct VSInput
+{
+	float4 Position	: SV_Position;
+	float3 Normal	: NORMAL;
+	float2 TexCoord	: TEXCOORD0;
+	float4 Color	: COLOR;
+};
+
+struct VSOutput
+{
+	float4 Diffuse		: COLOR0;
+	float4 Specular		: COLOR1;		//w is the fog factor, always 0 here
+	float2 TexCoord		: TEXCOORD0;
+	float4 PositionPS	: SV_Position;
+};
+
+VSOutput main(VSInput vin)
+{
+	float4 worldPosition = mul(vin.Position, World);
+	float3 eyeVector = normalize(EyePosition - worldPosition.xyz);
+	float3 worldNormal = normalize(mul(vin.Normal, WorldInverseTranspose));
+
+	//as ComputeLights in the effect's Lighting.fxh
+	float3x3 lightDirections = 0;
+	float3x3 lightDiffuse = 0;
+	float3x3 lightSpecular = 0;
+	float3x3 halfVectors = 0;
+	[unroll]
+	for (int i = 0; i < 3; i++)
+	{
+		lightDirections[i] = LightDirection[i];
+		lightDiffuse[i] = LightDiffuseColor[i];
+		lightSpecular[i] = LightSpecularColor[i];
+		halfVectors[i] = normalize(eyeVector - lightDirections[i]);
+	}
+	float3 dotL = mul(-lightDirections, worldNormal);
+	float3 dotH = mul(halfVectors, worldNormal);
+	float3 zeroL = step(0, dotL);
+	float3 diffuse = zeroL * dotL;
+	float3 specular = pow(max(dotH, 0) * zeroL, SpecularPower) * dotL;
+
+	VSOutput vout;
+	vout.Diffuse = float4(mul(diffuse, lightDiffuse) * DiffuseColor.rgb + EmissiveColor, DiffuseColor.a) * vin.Color;
+	vout.Specular = float4(mul(specular, lightSpecular) * SpecularColor, 0);
+	vout.TexCoord = vin.TexCoord;
+	vout.PositionPS = mul(vin.Position, WorldViewProj);
+	return vout;
+}
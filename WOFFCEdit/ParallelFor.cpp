@@ -0,0 +1,155 @@
+#include "ParallelFor.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	//true on pool threads and on a caller while it is inside a ParallelFor, so nested calls run inline instead of deadlocking
+	thread_local bool t_insideParallelFor = false;
+
+	class WorkerPool
+	{
+	public:
+		WorkerPool()
+		{
+			m_stop = false;
+			m_generation = 0;
+			m_busyWorkers = 0;
+			m_body = NULL;
+			m_count = 0;
+			m_grain = 1;
+
+			int workers = std::max(1, (int)std::thread::hardware_concurrency()) - 1;
+			for (int i = 0; i < workers; i++)
+			{
+				m_threads.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+			}
+		}
+
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			for (size_t i = 0; i < m_threads.size(); i++)
+			{
+				m_threads[i].join();
+			}
+		}
+
+		int ThreadCount() const { return (int)m_threads.size() + 1; }
+
+		void Run(int count, int grain, const std::function<void(int, int)> & body)
+		{
+			//one job at a time, a second caller waits for the first to finish
+			std::lock_guard<std::mutex> runLock(m_runMutex);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_body = &body;
+				m_count = count;
+				m_grain = grain;
+				m_next = 0;
+				m_busyWorkers = (int)m_threads.size();
+				m_generation++;
+			}
+			m_wake.notify_all();
+
+			t_insideParallelFor = true;
+			DoChunks();
+			t_insideParallelFor = false;
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_done.wait(lock, [this] { return m_busyWorkers == 0; });
+			m_body = NULL;
+		}
+
+	private:
+		void WorkerLoop()
+		{
+			t_insideParallelFor = true;
+			unsigned int seenGeneration = 0;
+			while (true)
+			{
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					m_wake.wait(lock, [&] { return m_stop || m_generation != seenGeneration; });
+					if (m_stop)
+					{
+						return;
+					}
+					seenGeneration = m_generation;
+				}
+
+				DoChunks();
+
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_busyWorkers--;
+				}
+				m_done.notify_one();
+			}
+		}
+
+		void DoChunks()
+		{
+			while (true)
+			{
+				int begin = m_next.fetch_add(m_grain);
+				if (begin >= m_count)
+				{
+					return;
+				}
+				(*m_body)(begin, std::min(begin + m_grain, m_count));
+			}
+		}
+
+		std::vector<std::thread>	m_threads;
+		std::mutex					m_runMutex;
+		std::mutex					m_mutex;
+		std::condition_variable		m_wake;
+		std::condition_variable		m_done;
+		bool						m_stop;
+		unsigned int				m_generation;
+		int							m_busyWorkers;
+
+		const std::function<void(int, int)> *	m_body;
+		int					m_count;
+		int					m_grain;
+		std::atomic<int>	m_next;
+	};
+
+	WorkerPool & Pool()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+}
+
+void ParallelFor(int count, int grain, const std::function<void(int begin, int end)> & body)
+{
+	if (count <= 0)
+	{
+		return;
+	}
+	grain = std::max(1, grain);
+
+	if (count <= grain || t_insideParallelFor || Pool().ThreadCount() == 1)
+	{
+		body(0, count);
+		return;
+	}
+
+	Pool().Run(count, grain, body);
+}
+
+int ParallelWorkerCount()
+{
+	return Pool().ThreadCount();
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <functional>
+
+//runs body over [0, count) on a pool of worker threads that lives for the whole program, and returns when every index is done.
+//the range is handed out in chunks of grain indices, so body(begin, end) should do the whole chunk in one go.
+//the calling thread works too. small ranges, and calls made from inside a body, simply run on the calling thread.
+//body must be safe to run on several chunks at once - only write to data owned by the indices you were given.
+
+void ParallelFor(int count, int grain, const std::function<void(int begin, int end)> & body);
+
+int ParallelWorkerCount();		//threads that take part in a ParallelFor, including the caller
@@ -0,0 +1,171 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+namespace
+{
+	//field widths and where they sit in the key, pass at the top
+	const int	PASS_SHIFT = 60;
+	const int	DEPTH_SHIFT = 56;
+	const int	SHADER_SHIFT = 44;
+	const int	TEXTURE_SHIFT = 24;
+	const int	DEPTH_BUCKETS = 16;
+	const uint64_t	SHADER_MASK = (1ull << 12) - 1;
+	const uint64_t	TEXTURE_MASK = (1ull << 20) - 1;
+	const uint64_t	MESH_MASK = (1ull << 24) - 1;
+
+	const float	NEAREST_BUCKET = 1.0f;		//metres, everything nearer shares the first bucket
+}
+
+RenderQueue::RenderQueue()
+{
+}
+
+RenderQueue::~RenderQueue()
+{
+}
+
+void RenderQueue::Clear()
+{
+	m_packets.clear();
+	for (int kind = 0; kind < RENDER_STATE_KINDS; kind++)
+	{
+		m_stateIDs[kind].clear();
+	}
+}
+
+void RenderQueue::Add(uint64_t key, uint32_t item)
+{
+	RenderPacket packet;
+	packet.key = key;
+	packet.item = item;
+	m_packets.push_back(packet);
+}
+
+uint32_t RenderQueue::StateID(RenderStateKind kind, const void * state)
+{
+	std::unordered_map<const void *, uint32_t> & IDs = m_stateIDs[kind];
+	return IDs.insert(std::make_pair(state, (uint32_t)IDs.size())).first->second;
+}
+
+uint64_t RenderQueue::MakeKey(int pass, int depthBucket, uint32_t shader, uint32_t texture, uint32_t mesh)
+{
+	return (uint64_t)(pass & 0xF) << PASS_SHIFT | (uint64_t)(depthBucket & 0xF) << DEPTH_SHIFT | (shader & SHADER_MASK) << SHADER_SHIFT
+		| (texture & TEXTURE_MASK) << TEXTURE_SHIFT | (mesh & MESH_MASK);
+}
+
+int RenderQueue::DepthBucket(float viewDepth, bool farFirst)
+{
+	int bucket = 0;
+	if (viewDepth > NEAREST_BUCKET)
+	{
+		bucket = std::min((int)log2f(viewDepth / NEAREST_BUCKET) + 1, DEPTH_BUCKETS - 1);
+	}
+	return farFirst ? DEPTH_BUCKETS - 1 - bucket : bucket;
+}
+
+void RenderQueue::Sort()
+{
+	//every byte's histogram in one read of the keys
+	size_t count = m_packets.size();
+	size_t histograms[8][256] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		uint64_t key = m_packets[i].key;
+		for (int digit = 0; digit < 8; digit++)
+		{
+			histograms[digit][(key >> (digit * 8)) & 0xFF]++;
+		}
+	}
+
+	m_scratch.resize(count);
+	for (int digit = 0; digit < 8; digit++)
+	{
+		size_t * histogram = histograms[digit];
+		int shift = digit * 8;
+		if (count == 0 || histogram[(m_packets[0].key >> shift) & 0xFF] == count)
+		{
+			continue;
+		}
+		size_t offset = 0;
+		for (int value = 0; value < 256; value++)
+		{
+			size_t size = histogram[value];
+			histogram[value] = offset;
+			offset += size;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			m_scratch[histogram[(m_packets[i].key >> shift) & 0xFF]++] = m_packets[i];
+		}
+		m_packets.swap(m_scratch);
+	}
+}
+
+RenderStateChanges RenderQueue::CountChanges(const std::vector<RenderPacket> & packets)
+{
+	//the first packet sets everything
+	RenderStateChanges changes = { 0, 0, 0, 0 };
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		uint64_t key = packets[i].key, previous = i == 0 ? ~key : packets[i - 1].key;
+		changes.passes += (key >> PASS_SHIFT) != (previous >> PASS_SHIFT);
+		changes.shaders += ((key >> SHADER_SHIFT) & SHADER_MASK) != ((previous >> SHADER_SHIFT) & SHADER_MASK);
+		changes.textures += ((key >> TEXTURE_SHIFT) & TEXTURE_MASK) != ((previous >> TEXTURE_SHIFT) & TEXTURE_MASK);
+		changes.meshes += (key & MESH_MASK) != (previous & MESH_MASK);
+	}
+	return changes;
+}
+
+//a level of props as the display list holds them - a few hundred meshes, each seen with one of a couple of textures,
+//scattered at all distances, a few with alpha parts - recorded in display list order, then sorted
+std::string RenderQueue::Benchmark(int packets)
+{
+	const int meshes = 300, textures = 60, shaders = 2;
+	std::mt19937 random(17);
+	std::uniform_int_distribution<int> pickMesh(0, meshes - 1), pickVariant(0, 1), pickShader(0, shaders - 1), pickAlpha(0, 19);
+	std::uniform_real_distribution<float> pickDepth(0.5f, 800.0f);
+
+	//stand ins for the device objects, the queue only ever compares their addresses
+	std::vector<char> meshObjects(meshes), textureObjects(textures), shaderObjects(shaders);
+
+	auto buildStart = std::chrono::high_resolution_clock::now();
+	RenderQueue queue;
+	for (int i = 0; i < packets; i++)
+	{
+		int mesh = pickMesh(random);
+		int texture = (mesh * 7 + pickVariant(random)) % textures;
+		int pass = pickAlpha(random) == 0 ? RENDER_PASS_ALPHA : RENDER_PASS_OPAQUE;
+		uint32_t shaderID = queue.StateID(RENDER_STATE_SHADER, &shaderObjects[pickShader(random)]);
+		uint32_t textureID = queue.StateID(RENDER_STATE_TEXTURE, &textureObjects[texture]);
+		uint32_t meshID = queue.StateID(RENDER_STATE_MESH, &meshObjects[mesh]);
+		queue.Add(MakeKey(pass, DepthBucket(pickDepth(random), pass == RENDER_PASS_ALPHA), shaderID, textureID, meshID), i);
+	}
+	auto buildEnd = std::chrono::high_resolution_clock::now();
+
+	std::vector<RenderPacket> reference = queue.Packets();
+	RenderStateChanges unsorted = CountChanges(reference);
+
+	auto sortStart = std::chrono::high_resolution_clock::now();
+	queue.Sort();
+	auto sortEnd = std::chrono::high_resolution_clock::now();
+	RenderStateChanges sorted = CountChanges(queue.Packets());
+
+	auto referenceStart = std::chrono::high_resolution_clock::now();
+	std::stable_sort(reference.begin(), reference.end(), [](const RenderPacket & a, const RenderPacket & b) { return a.key < b.key; });
+	auto referenceEnd = std::chrono::high_resolution_clock::now();
+
+	auto ms = [](std::chrono::high_resolution_clock::duration time)
+	{
+		return std::chrono::duration<double, std::milli>(time).count();
+	};
+	std::ostringstream report;
+	report << "Render queue, " << packets << " draws: keys " << ms(buildEnd - buildStart) << " ms, radix sort " << ms(sortEnd - sortStart)
+		<< " ms against " << ms(referenceEnd - referenceStart) << " ms stable_sort. state changes " << unsorted.Total() << " in list order ("
+		<< unsorted.textures << " textures, " << unsorted.meshes << " meshes), " << sorted.Total() << " sorted (" << sorted.textures
+		<< " textures, " << sorted.meshes << " meshes)\n";
+	return report.str();
+}
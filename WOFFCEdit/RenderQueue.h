@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//draws for a frame, recorded in any order and sorted by a 64 bit key of the state each one needs, so that drawing them
+//in key order changes state as little as it can. from the top bit down the key is the pass, a coarse depth bucket, the
+//shader, the texture and the mesh - passes stay in order, near things go first within a pass (far first for alpha), and
+//inside a bucket draws sharing a shader, then a texture, then a mesh come together. the sort is a least significant
+//digit radix sort a byte at a time, skipping the bytes every key has the same, and it is stable so draws with equal
+//keys keep the order they were added in. states are given to the key as small IDs handed out by StateID.
+
+enum RenderPass
+{
+	RENDER_PASS_OPAQUE,
+	RENDER_PASS_ALPHA,
+	RENDER_PASSES
+};
+
+enum RenderStateKind
+{
+	RENDER_STATE_SHADER,
+	RENDER_STATE_TEXTURE,
+	RENDER_STATE_MESH,
+	RENDER_STATE_KINDS
+};
+
+struct RenderPacket
+{
+	uint64_t	key;
+	uint32_t	item;		//what to draw, an index into the caller's own list
+};
+
+//how many times a run of packets changes each part of the state, drawn in the order they are in
+struct RenderStateChanges
+{
+	int		passes;
+	int		shaders;
+	int		textures;
+	int		meshes;
+
+	int		Total() const { return passes + shaders + textures + meshes; }
+};
+
+class RenderQueue
+{
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	void	Clear();		//for a new frame, the state IDs are handed out again
+	void	Add(uint64_t key, uint32_t item);
+	void	Sort();
+	const std::vector<RenderPacket> & Packets() const { return m_packets; }
+
+	uint32_t	StateID(RenderStateKind kind, const void * state);		//the same state gets the same ID until the next Clear
+
+	//the key. IDs wider than their field wrap, which costs some grouping but never a wrong draw
+	static uint64_t	MakeKey(int pass, int depthBucket, uint32_t shader, uint32_t texture, uint32_t mesh);
+	static int		DepthBucket(float viewDepth, bool farFirst);		//doubling distances from a metre out
+	static int		KeyPass(uint64_t key) { return (int)(key >> 60); }
+
+	static RenderStateChanges	CountChanges(const std::vector<RenderPacket> & packets);
+	static std::string			Benchmark(int packets);		//sort time and state changes saved on a level's worth of draws
+
+private:
+	std::vector<RenderPacket>	m_packets;
+	std::vector<RenderPacket>	m_scratch;		//the other half of each radix pass
+	std::unordered_map<const void *, uint32_t>	m_stateIDs[RENDER_STATE_KINDS];
+};
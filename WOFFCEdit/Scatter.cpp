@@ -0,0 +1,420 @@
+#include "Scatter.h"
+#include "ParallelFor.h"
+#include "SeedHash.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+using namespace DirectX;
+
+
+ScatterSettings::ScatterSettings()
+{
+	spacing = 4.0f;
+	density = 1.0f;
+	maxSlope = 35.0f;
+	minHeight = -FLT_MAX;
+	maxHeight = FLT_MAX;
+	minScale = 0.8f;
+	maxScale = 1.2f;
+	seed = 1;
+}
+
+namespace
+{
+	const int	CELLS_PER_TILE = 16;	//a tile is about 11 spacings across
+	const int	CANDIDATES = 16;		//tries around an active point before it is retired
+	const float	EMPTY = FLT_MAX;
+
+	//the region being filled, and a grid over it small enough that a cell never holds more than one point
+	struct ScatterArea
+	{
+		float	minX, minZ, maxX, maxZ;
+		bool	circle;
+		float	centreX, centreZ, radiusSquared;
+		float	spacing, spacingSquared;
+		float	cellSize, invCellSize;
+		int		gridWidth, gridDepth;
+		std::vector<XMFLOAT2>	grid;			//x is EMPTY for an empty cell
+
+		//objects that were there already, bucketed into cells of size spacing with a one cell border
+		int		avoidWidth, avoidDepth;
+		std::vector<int>		avoidStart;		//avoidWidth * avoidDepth + 1 offsets into avoid
+		std::vector<XMFLOAT2>	avoid;
+
+		bool Inside(float x, float z) const
+		{
+			if (x < minX || x >= maxX || z < minZ || z >= maxZ)
+			{
+				return false;
+			}
+			float dx = x - centreX;
+			float dz = z - centreZ;
+			return !circle || dx * dx + dz * dz <= radiusSquared;
+		}
+
+		int AvoidCell(float x, float z) const
+		{
+			int ax = (int)floorf((x - minX) / spacing) + 1;
+			int az = (int)floorf((z - minZ) / spacing) + 1;
+			if (ax < 0 || ax >= avoidWidth || az < 0 || az >= avoidDepth)
+			{
+				return -1;
+			}
+			return az * avoidWidth + ax;
+		}
+
+		//nothing already placed, or already there, within spacing of x, z
+		bool Clear(float x, float z) const
+		{
+			int cx = (int)((x - minX) * invCellSize);
+			int cz = (int)((z - minZ) * invCellSize);
+			for (int gz = std::max(cz - 2, 0); gz <= std::min(cz + 2, gridDepth - 1); gz++)
+			{
+				for (int gx = std::max(cx - 2, 0); gx <= std::min(cx + 2, gridWidth - 1); gx++)
+				{
+					const XMFLOAT2 & other = grid[gz * gridWidth + gx];
+					if (other.x != EMPTY && (other.x - x) * (other.x - x) + (other.y - z) * (other.y - z) < spacingSquared)
+					{
+						return false;
+					}
+				}
+			}
+
+			if (!avoid.empty())
+			{
+				int ax = (int)floorf((x - minX) / spacing) + 1;
+				int az = (int)floorf((z - minZ) / spacing) + 1;
+				for (int bz = std::max(az - 1, 0); bz <= std::min(az + 1, avoidDepth - 1); bz++)
+				{
+					for (int bx = std::max(ax - 1, 0); bx <= std::min(ax + 1, avoidWidth - 1); bx++)
+					{
+						int bucket = bz * avoidWidth + bx;
+						for (int i = avoidStart[bucket]; i < avoidStart[bucket + 1]; i++)
+						{
+							if ((avoid[i].x - x) * (avoid[i].x - x) + (avoid[i].y - z) * (avoid[i].y - z) < spacingSquared)
+							{
+								return false;
+							}
+						}
+					}
+				}
+			}
+			return true;
+		}
+	};
+
+	//Bridson's method inside one tile. a point is only kept if its grid cell is in this tile, so a tile writes nothing
+	//but its own cells, and the cells it reads outside the tile belong to neighbours that are finished or not yet started
+	void FillTile(ScatterArea & area, int tileX, int tileZ, unsigned int seed, std::vector<XMFLOAT2> & points)
+	{
+		int cellX0 = tileX * CELLS_PER_TILE;
+		int cellZ0 = tileZ * CELLS_PER_TILE;
+		int cellX1 = std::min(cellX0 + CELLS_PER_TILE, area.gridWidth);
+		int cellZ1 = std::min(cellZ0 + CELLS_PER_TILE, area.gridDepth);
+		float x0 = area.minX + cellX0 * area.cellSize;
+		float z0 = area.minZ + cellZ0 * area.cellSize;
+		float x1 = std::min(area.minX + cellX1 * area.cellSize, area.maxX);
+		float z1 = std::min(area.minZ + cellZ1 * area.cellSize, area.maxZ);
+
+		//tiles wholly outside a brush circle have nothing to do
+		if (area.circle)
+		{
+			float nearestX = std::min(std::max(area.centreX, x0), x1);
+			float nearestZ = std::min(std::max(area.centreZ, z0), z1);
+			if ((nearestX - area.centreX) * (nearestX - area.centreX) + (nearestZ - area.centreZ) * (nearestZ - area.centreZ) > area.radiusSquared)
+			{
+				return;
+			}
+		}
+
+		XMFLOAT2 steps[CANDIDATES];
+		for (int candidate = 0; candidate < CANDIDATES; candidate++)
+		{
+			steps[candidate] = XMFLOAT2(cosf(candidate * XM_2PI / CANDIDATES), sinf(candidate * XM_2PI / CANDIDATES));
+		}
+
+		std::mt19937 random(Hash(seed, (unsigned int)tileX, (unsigned int)tileZ));
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<XMFLOAT2> active;
+
+		auto tryAdd = [&](float x, float z)
+		{
+			if (!area.Inside(x, z))
+			{
+				return false;
+			}
+			int cx = (int)((x - area.minX) * area.invCellSize);
+			int cz = (int)((z - area.minZ) * area.invCellSize);
+			if (cx < cellX0 || cx >= cellX1 || cz < cellZ0 || cz >= cellZ1 || !area.Clear(x, z))
+			{
+				return false;
+			}
+			area.grid[cz * area.gridWidth + cx] = XMFLOAT2(x, z);
+			points.push_back(XMFLOAT2(x, z));
+			active.push_back(XMFLOAT2(x, z));
+			return true;
+		};
+
+		for (int attempt = 0; attempt < CANDIDATES && active.empty(); attempt++)
+		{
+			tryAdd(x0 + unit(random) * (x1 - x0), z0 + unit(random) * (z1 - z0));
+		}
+
+		while (!active.empty())
+		{
+			int pick = std::uniform_int_distribution<int>(0, (int)active.size() - 1)(random);
+			XMFLOAT2 from = active[pick];
+
+			//candidates just outside the spacing at evenly stepped angles from a random start, which packs tighter
+			//and retires points sooner than Bridson's random distances out to twice the spacing
+			bool added = false;
+			float start = unit(random) * XM_2PI;
+			float startX = cosf(start) * area.spacing * 1.0001f;
+			float startZ = sinf(start) * area.spacing * 1.0001f;
+			for (int candidate = 0; candidate < CANDIDATES && !added; candidate++)
+			{
+				//the start direction turned by the candidate's step
+				float offsetX = startX * steps[candidate].x - startZ * steps[candidate].y;
+				float offsetZ = startX * steps[candidate].y + startZ * steps[candidate].x;
+				added = tryAdd(from.x + offsetX, from.y + offsetZ);
+			}
+
+			if (!added)
+			{
+				active[pick] = active.back();
+				active.pop_back();
+			}
+		}
+	}
+}
+
+void Scatter::Generate(const TerrainQuery & terrain, const ScatterSettings & settings, float centreX, float centreZ, float radius,
+	const std::vector<XMFLOAT3> & avoid, std::vector<ScatterInstance> & instances)
+{
+	instances.clear();
+	if (terrain.IsEmpty() || settings.spacing <= 0.0f)
+	{
+		return;
+	}
+
+	ScatterArea area;
+	area.minX = terrain.MinX();
+	area.minZ = terrain.MinZ();
+	area.maxX = terrain.MinX() + terrain.Size();
+	area.maxZ = terrain.MinZ() + terrain.Size();
+	area.circle = radius > 0.0f;
+	area.centreX = centreX;
+	area.centreZ = centreZ;
+	area.radiusSquared = radius * radius;
+	if (area.circle)
+	{
+		area.minX = std::max(area.minX, centreX - radius);
+		area.minZ = std::max(area.minZ, centreZ - radius);
+		area.maxX = std::min(area.maxX, centreX + radius);
+		area.maxZ = std::min(area.maxZ, centreZ + radius);
+	}
+	if (area.minX >= area.maxX || area.minZ >= area.maxZ)
+	{
+		return;
+	}
+
+	area.spacing = settings.spacing;
+	area.spacingSquared = settings.spacing * settings.spacing;
+	area.cellSize = settings.spacing / sqrtf(2.0f);
+	area.invCellSize = 1.0f / area.cellSize;
+	area.gridWidth = std::max(1, (int)ceilf((area.maxX - area.minX) * area.invCellSize));
+	area.gridDepth = std::max(1, (int)ceilf((area.maxZ - area.minZ) * area.invCellSize));
+	area.grid.assign(area.gridWidth * area.gridDepth, XMFLOAT2(EMPTY, EMPTY));
+
+	//bucket the objects near enough to matter, counting them into their cells then placing them
+	area.avoidWidth = (int)ceilf((area.maxX - area.minX) / area.spacing) + 2;
+	area.avoidDepth = (int)ceilf((area.maxZ - area.minZ) / area.spacing) + 2;
+	area.avoidStart.assign(area.avoidWidth * area.avoidDepth + 1, 0);
+	for (size_t i = 0; i < avoid.size(); i++)
+	{
+		int bucket = area.AvoidCell(avoid[i].x, avoid[i].z);
+		if (bucket != -1)
+		{
+			area.avoidStart[bucket + 1]++;
+		}
+	}
+	for (size_t bucket = 1; bucket < area.avoidStart.size(); bucket++)
+	{
+		area.avoidStart[bucket] += area.avoidStart[bucket - 1];
+	}
+	area.avoid.resize(area.avoidStart.back());
+	std::vector<int> fill(area.avoidStart.begin(), area.avoidStart.end() - 1);
+	for (size_t i = 0; i < avoid.size(); i++)
+	{
+		int bucket = area.AvoidCell(avoid[i].x, avoid[i].z);
+		if (bucket != -1)
+		{
+			area.avoid[fill[bucket]++] = XMFLOAT2(avoid[i].x, avoid[i].z);
+		}
+	}
+
+	//four chequerboard passes, the tiles of one pass are at least a tile apart so they never touch each other's cells
+	int tilesX = (area.gridWidth + CELLS_PER_TILE - 1) / CELLS_PER_TILE;
+	int tilesZ = (area.gridDepth + CELLS_PER_TILE - 1) / CELLS_PER_TILE;
+	std::vector<std::vector<XMFLOAT2>> tilePoints(tilesX * tilesZ);
+	std::vector<int> passTiles;
+	for (int pass = 0; pass < 4; pass++)
+	{
+		passTiles.clear();
+		for (int tileZ = pass >> 1; tileZ < tilesZ; tileZ += 2)
+		{
+			for (int tileX = pass & 1; tileX < tilesX; tileX += 2)
+			{
+				passTiles.push_back(tileZ * tilesX + tileX);
+			}
+		}
+
+		ParallelFor((int)passTiles.size(), 1, [&](int begin, int end)
+		{
+			for (int k = begin; k < end; k++)
+			{
+				int tile = passTiles[k];
+				FillTile(area, tile % tilesX, tile / tilesX, settings.seed, tilePoints[tile]);
+			}
+		});
+	}
+
+	std::vector<float> x, z;
+	for (size_t tile = 0; tile < tilePoints.size(); tile++)
+	{
+		for (size_t i = 0; i < tilePoints[tile].size(); i++)
+		{
+			x.push_back(tilePoints[tile][i].x);
+			z.push_back(tilePoints[tile][i].y);
+		}
+	}
+
+	//terrain under every point in SIMD batches, then the filters and the random yaw and scale
+	int count = (int)x.size();
+	std::vector<float> heights(count);
+	std::vector<XMFLOAT3> normals(count);
+	std::vector<unsigned char> keep(count);
+	std::vector<ScatterInstance> candidates(count);
+	float minNormalY = cosf(XMConvertToRadians(settings.maxSlope));
+	ParallelFor(count, 4096, [&](int begin, int end)
+	{
+		terrain.GetHeightsAndNormals(&x[begin], &z[begin], &heights[begin], &normals[begin], end - begin);
+		for (int i = begin; i < end; i++)
+		{
+			keep[i] = HashToUnit(Hash(settings.seed, (unsigned int)i, 1)) < settings.density
+				&& normals[i].y >= minNormalY
+				&& heights[i] >= settings.minHeight && heights[i] <= settings.maxHeight;
+
+			ScatterInstance & instance = candidates[i];
+			instance.position = XMFLOAT3(x[i], heights[i], z[i]);
+			instance.yaw = HashToUnit(Hash(settings.seed, (unsigned int)i, 2)) * 360.0f;
+			instance.scale = settings.minScale + (settings.maxScale - settings.minScale) * HashToUnit(Hash(settings.seed, (unsigned int)i, 3));
+		}
+	});
+
+	instances.reserve(count);
+	for (int i = 0; i < count; i++)
+	{
+		if (keep[i])
+		{
+			instances.push_back(candidates[i]);
+		}
+	}
+}
+
+//a square of rolling terrain sized so the packed points come to about the requested count. it is scattered twice to
+//check the result does not depend on how the tiles were shared out between threads
+std::string Scatter::Benchmark(int instances)
+{
+	const int resolution = 128;
+	const float packing = 0.83f;		//points per square spacing that the tiles reach
+	float side = sqrtf(instances / packing);
+	std::vector<float> heightfield(resolution * resolution);
+	for (int row = 0; row < resolution; row++)
+	{
+		for (int column = 0; column < resolution; column++)
+		{
+			heightfield[row * resolution + column] = 32.0f + 16.0f * sinf(column * 0.1f) * cosf(row * 0.13f);
+		}
+	}
+	TerrainQuery terrain;
+	terrain.Build(heightfield.data(), resolution, 0.0f, 0.0f, side / (resolution - 1));
+
+	ScatterSettings settings;
+	settings.spacing = 1.0f;
+	settings.maxSlope = 90.0f;
+	std::vector<XMFLOAT3> avoid;
+	std::vector<ScatterInstance> first, second;
+
+	auto scatterStart = std::chrono::high_resolution_clock::now();
+	Generate(terrain, settings, 0.0f, 0.0f, 0.0f, avoid, first);
+	auto scatterEnd = std::chrono::high_resolution_clock::now();
+
+	Generate(terrain, settings, 0.0f, 0.0f, 0.0f, avoid, second);
+	bool repeatable = first.size() == second.size();
+	for (size_t i = 0; repeatable && i < first.size(); i++)
+	{
+		repeatable = first[i].position.x == second[i].position.x && first[i].position.z == second[i].position.z
+			&& first[i].yaw == second[i].yaw && first[i].scale == second[i].scale;
+	}
+
+	//every pair checked for the spacing, through buckets a spacing wide so only neighbouring buckets need comparing
+	int buckets = (int)ceilf(side / settings.spacing) + 1;
+	std::vector<int> bucketStart(buckets * buckets + 1, 0);
+	auto bucketOf = [&](const XMFLOAT3 & position)
+	{
+		return std::min((int)(position.z / settings.spacing), buckets - 1) * buckets + std::min((int)(position.x / settings.spacing), buckets - 1);
+	};
+	for (size_t i = 0; i < first.size(); i++)
+	{
+		bucketStart[bucketOf(first[i].position) + 1]++;
+	}
+	for (size_t bucket = 1; bucket < bucketStart.size(); bucket++)
+	{
+		bucketStart[bucket] += bucketStart[bucket - 1];
+	}
+	std::vector<int> fill(bucketStart.begin(), bucketStart.end() - 1);
+	std::vector<XMFLOAT3> sorted(first.size());
+	for (size_t i = 0; i < first.size(); i++)
+	{
+		sorted[fill[bucketOf(first[i].position)]++] = first[i].position;
+	}
+
+	int tooClose = 0;
+	float limit = settings.spacing * settings.spacing * 0.999f;
+	for (int bucket = 0; bucket < buckets * buckets; bucket++)
+	{
+		int bx = bucket % buckets;
+		int bz = bucket / buckets;
+		for (int i = bucketStart[bucket]; i < bucketStart[bucket + 1]; i++)
+		{
+			for (int nz = std::max(bz - 1, 0); nz <= std::min(bz + 1, buckets - 1); nz++)
+			{
+				for (int nx = std::max(bx - 1, 0); nx <= std::min(bx + 1, buckets - 1); nx++)
+				{
+					int neighbour = nz * buckets + nx;
+					for (int j = bucketStart[neighbour]; j < bucketStart[neighbour + 1]; j++)
+					{
+						float dx = sorted[i].x - sorted[j].x;
+						float dz = sorted[i].z - sorted[j].z;
+						if (i != j && dx * dx + dz * dz < limit)
+						{
+							tooClose++;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	std::stringstream report;
+	report << "Scatter, " << first.size() << " instances over " << (int)side << "m square on " << ParallelWorkerCount() << " threads: "
+		<< std::chrono::duration<double, std::milli>(scatterEnd - scatterStart).count() << " ms, "
+		<< first.size() / std::max(std::chrono::duration<double>(scatterEnd - scatterStart).count(), 1e-9) / 1000000.0 << " M/s"
+		<< (repeatable ? "" : " (NOT REPEATABLE)") << (tooClose == 0 ? "" : " (SPACING BROKEN)") << "\n";
+	return report.str();
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "TerrainQuery.h"
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+//poisson disk scattering of props over the terrain - instances are packed as closely as spacing allows, with no two
+//closer than it, and no visible grid or clumping. the packed points are then thinned by density and by the slope and
+//height of the terrain under them.
+//the area is cut into square tiles that are filled in four passes, chequerboard fashion, so tiles filled at the same time
+//are never neighbours and can go to different threads. each tile draws from its own generator seeded from the settings
+//seed and the tile's coordinates, so the same settings give the same instances however many threads run them.
+
+struct ScatterSettings
+{
+	float			spacing;				//minimum distance between instances
+	float			density;				//0 - 1, fraction of the packed points kept
+	float			maxSlope;				//degrees from flat
+	float			minHeight, maxHeight;
+	float			minScale, maxScale;		//uniform scale, picked at random between the two
+	unsigned int	seed;
+
+	ScatterSettings();
+};
+
+struct ScatterInstance
+{
+	DirectX::XMFLOAT3	position;
+	float				yaw;		//degrees
+	float				scale;
+};
+
+class Scatter
+{
+public:
+	//fills the circle of radius around centreX, centreZ, or the whole terrain when radius is 0 or less.
+	//avoid holds the positions of objects already there, which new instances keep spacing away from
+	static void Generate(const TerrainQuery & terrain, const ScatterSettings & settings, float centreX, float centreZ, float radius,
+		const std::vector<DirectX::XMFLOAT3> & avoid, std::vector<ScatterInstance> & instances);
+
+	static std::string Benchmark(int instances);	//scattering roughly this many over a rolling terrain
+};
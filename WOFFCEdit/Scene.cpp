@@ -0,0 +1,490 @@
+#include "Scene.h"
+#include <chrono>
+#include <sstream>
+
+
+namespace
+{
+	LightComponent LightColumns(const SceneObject & object)
+	{
+		LightComponent light;
+		light.light_type = object.light_type;
+		light.light_diffuse_r = object.light_diffuse_r;		light.light_diffuse_g = object.light_diffuse_g;		light.light_diffuse_b = object.light_diffuse_b;
+		light.light_specular_r = object.light_specular_r;	light.light_specular_g = object.light_specular_g;	light.light_specular_b = object.light_specular_b;
+		light.light_spot_cutoff = object.light_spot_cutoff;
+		light.light_constant = object.light_constant;
+		light.light_linear = object.light_linear;
+		light.light_quadratic = object.light_quadratic;
+		return light;
+	}
+}
+
+
+Scene::Scene()
+{
+	Clear();
+}
+
+
+Scene::~Scene()
+{
+}
+
+void Scene::Clear()
+{
+	m_index.Clear();
+	m_IDs.clear();
+	m_chunkIDs.clear();
+	m_parentIDs.clear();
+	m_names.clear();
+	m_flags.clear();
+	m_transforms.clear();
+	m_renders.clear();
+	m_lightProfiles.clear();
+	m_lights.Clear();
+	m_audio.Clear();
+	m_pathNodes.Clear();
+	m_colliders.Clear();
+	m_gameplay.Clear();
+
+	m_lightProfileTable.clear();
+	m_lightProfileLookup.clear();
+	InternLightProfile(LightColumns(SceneObject()));		//handle 0
+}
+
+void Scene::Reserve(int objects)
+{
+	m_IDs.reserve(objects);
+	m_chunkIDs.reserve(objects);
+	m_parentIDs.reserve(objects);
+	m_names.reserve(objects);
+	m_flags.reserve(objects);
+	m_transforms.reserve(objects);
+	m_renders.reserve(objects);
+	m_lightProfiles.reserve(objects);
+}
+
+void Scene::Add(const SceneObject & object)
+{
+	if (m_index.Find(object.ID) != -1)
+	{
+		Set(object);
+		return;
+	}
+
+	int row = Size();
+	m_index.Insert(object.ID, row);
+	m_IDs.push_back(object.ID);
+	m_chunkIDs.push_back(0);
+	m_parentIDs.push_back(0);
+	m_names.push_back(0);
+	m_flags.push_back(0);
+	m_transforms.push_back(TransformComponent());
+	m_renders.push_back(RenderComponent());
+	m_lightProfiles.push_back(0);
+
+	SetComponents(row, object);
+}
+
+void Scene::AddInstances(const SceneObject & object, const std::vector<TransformComponent> & transforms)
+{
+	if (transforms.empty())
+	{
+		return;
+	}
+	Reserve(Size() + (int)transforms.size());
+
+	//the first goes in the usual way, the rest copy its entity row and whatever optional components it ended up with
+	SceneObject instance = object;
+	for (size_t i = 0; i < transforms.size(); i++)
+	{
+		const TransformComponent & transform = transforms[i];
+		instance.ID = object.ID + (int)i;
+		if (i == 0 || m_index.Find(instance.ID) != -1)
+		{
+			instance.posX = transform.posX;		instance.posY = transform.posY;		instance.posZ = transform.posZ;
+			instance.rotX = transform.rotX;		instance.rotY = transform.rotY;		instance.rotZ = transform.rotZ;
+			instance.scaX = transform.scaX;		instance.scaY = transform.scaY;		instance.scaZ = transform.scaZ;
+			instance.pivotX = transform.pivotX;	instance.pivotY = transform.pivotY;	instance.pivotZ = transform.pivotZ;
+			Add(instance);
+			continue;
+		}
+
+		int first = m_index.Find(object.ID);
+		int row = Size();
+		m_index.Insert(instance.ID, row);
+		m_IDs.push_back(instance.ID);
+		m_chunkIDs.push_back(m_chunkIDs[first]);
+		m_parentIDs.push_back(m_parentIDs[first]);
+		m_names.push_back(m_names[first]);
+		m_flags.push_back(m_flags[first]);
+		m_transforms.push_back(transform);
+		m_renders.push_back(m_renders[first]);
+		m_lightProfiles.push_back(m_lightProfiles[first]);
+
+		if (m_lights.Find(object.ID))		m_lights.Set(instance.ID, LightComponent(*m_lights.Find(object.ID)));
+		if (m_audio.Find(object.ID))		m_audio.Set(instance.ID, AudioComponent(*m_audio.Find(object.ID)));
+		if (m_pathNodes.Find(object.ID))	m_pathNodes.Set(instance.ID, PathNodeComponent(*m_pathNodes.Find(object.ID)));
+		if (m_colliders.Find(object.ID))	m_colliders.Set(instance.ID, CollisionComponent(*m_colliders.Find(object.ID)));
+		if (m_gameplay.Find(object.ID))		m_gameplay.Set(instance.ID, GameplayComponent(*m_gameplay.Find(object.ID)));
+	}
+}
+
+void Scene::Set(const SceneObject & object)
+{
+	int row = m_index.Find(object.ID);
+	if (row == -1)
+	{
+		return;
+	}
+	SetComponents(row, object);
+}
+
+bool Scene::Remove(int ID)
+{
+	int row = m_index.Find(ID);
+	if (row == -1)
+	{
+		return false;
+	}
+
+	RemoveOptionalComponents(ID);
+
+	int last = Size() - 1;
+	if (row != last)
+	{
+		m_IDs[row] = m_IDs[last];
+		m_chunkIDs[row] = m_chunkIDs[last];
+		m_parentIDs[row] = m_parentIDs[last];
+		m_names[row] = m_names[last];
+		m_flags[row] = m_flags[last];
+		m_transforms[row] = m_transforms[last];
+		m_renders[row] = m_renders[last];
+		m_lightProfiles[row] = m_lightProfiles[last];
+		m_index.Move(m_IDs[row], row);
+	}
+	m_IDs.pop_back();
+	m_chunkIDs.pop_back();
+	m_parentIDs.pop_back();
+	m_names.pop_back();
+	m_flags.pop_back();
+	m_transforms.pop_back();
+	m_renders.pop_back();
+	m_lightProfiles.pop_back();
+	m_index.Remove(ID);
+	return true;
+}
+
+void Scene::RemoveOptionalComponents(int ID)
+{
+	m_lights.Remove(ID);
+	m_audio.Remove(ID);
+	m_pathNodes.Remove(ID);
+	m_colliders.Remove(ID);
+	m_gameplay.Remove(ID);
+}
+
+void Scene::SetComponents(int row, const SceneObject & object)
+{
+	//anything left at the SceneObject defaults is not stored, GetRow puts the defaults back
+	static const SceneObject defaults;
+	int ID = object.ID;
+
+	m_chunkIDs[row] = object.chunk_ID;
+	m_parentIDs[row] = object.parent_id;
+	m_names[row] = m_nameTable.Intern(object.name);
+
+	unsigned int flags = 0;
+	if (object.render)					flags |= SCENE_FLAG_RENDER;
+	if (object.editor_render)			flags |= SCENE_FLAG_EDITOR_RENDER;
+	if (object.editor_texture_vis)		flags |= SCENE_FLAG_EDITOR_TEXTURE_VIS;
+	if (object.editor_normals_vis)		flags |= SCENE_FLAG_EDITOR_NORMALS_VIS;
+	if (object.editor_collision_vis)	flags |= SCENE_FLAG_EDITOR_COLLISION_VIS;
+	if (object.editor_pivot_vis)		flags |= SCENE_FLAG_EDITOR_PIVOT_VIS;
+	if (object.editor_wireframe)		flags |= SCENE_FLAG_EDITOR_WIREFRAME;
+	if (object.snapToGround)			flags |= SCENE_FLAG_SNAP_TO_GROUND;
+	if (object.AINode)					flags |= SCENE_FLAG_AI_NODE;
+	if (object.camera)					flags |= SCENE_FLAG_CAMERA;
+	m_flags[row] = flags;
+
+	TransformComponent & transform = m_transforms[row];
+	transform.posX = object.posX;		transform.posY = object.posY;		transform.posZ = object.posZ;
+	transform.rotX = object.rotX;		transform.rotY = object.rotY;		transform.rotZ = object.rotZ;
+	transform.scaX = object.scaX;		transform.scaY = object.scaY;		transform.scaZ = object.scaZ;
+	transform.pivotX = object.pivotX;	transform.pivotY = object.pivotY;	transform.pivotZ = object.pivotZ;
+
+	m_renders[row].model_path = object.model_path;
+	m_renders[row].tex_diffuse_path = object.tex_diffuse_path;
+
+	if (object.collision != defaults.collision || object.collision_mesh != defaults.collision_mesh)
+	{
+		CollisionComponent collider;
+		collider.collision = object.collision;
+		collider.collision_mesh = object.collision_mesh;
+		m_colliders.Set(ID, collider);
+	}
+	else
+	{
+		m_colliders.Remove(ID);
+	}
+
+	if (object.collectable != defaults.collectable || object.destructable != defaults.destructable || object.health_amount != defaults.health_amount)
+	{
+		GameplayComponent gameplay;
+		gameplay.collectable = object.collectable;
+		gameplay.destructable = object.destructable;
+		gameplay.health_amount = object.health_amount;
+		m_gameplay.Set(ID, gameplay);
+	}
+	else
+	{
+		m_gameplay.Remove(ID);
+	}
+
+	//the other light columns are filled in on every prop, only the type says whether there is a light
+	LightComponent light = LightColumns(object);
+	if (light.light_type != SCENE_LIGHT_NONE)
+	{
+		m_lights.Set(ID, light);
+		m_lightProfiles[row] = 0;
+	}
+	else
+	{
+		m_lights.Remove(ID);
+		m_lightProfiles[row] = InternLightProfile(light);
+	}
+
+	AudioComponent audio;
+	audio.audio_path = object.audio_path;
+	audio.volume = object.volume;
+	audio.pitch = object.pitch;
+	audio.pan = object.pan;
+	audio.one_shot = object.one_shot;
+	audio.play_on_init = object.play_on_init;
+	audio.play_in_editor = object.play_in_editor;
+	audio.min_dist = object.min_dist;
+	audio.max_dist = object.max_dist;
+	if (audio.audio_path != defaults.audio_path || audio.volume != defaults.volume || audio.pitch != defaults.pitch || audio.pan != defaults.pan
+		|| audio.one_shot != defaults.one_shot || audio.play_on_init != defaults.play_on_init || audio.play_in_editor != defaults.play_in_editor
+		|| audio.min_dist != defaults.min_dist || audio.max_dist != defaults.max_dist)
+	{
+		m_audio.Set(ID, audio);
+	}
+	else
+	{
+		m_audio.Remove(ID);
+	}
+
+	if (object.path_node != defaults.path_node || object.path_node_start != defaults.path_node_start || object.path_node_end != defaults.path_node_end)
+	{
+		PathNodeComponent pathNode;
+		pathNode.path_node = object.path_node;
+		pathNode.path_node_start = object.path_node_start;
+		pathNode.path_node_end = object.path_node_end;
+		m_pathNodes.Set(ID, pathNode);
+	}
+	else
+	{
+		m_pathNodes.Remove(ID);
+	}
+}
+
+unsigned int Scene::InternLightProfile(const LightComponent & columns)
+{
+	auto found = m_lightProfileLookup.find(columns);
+	if (found != m_lightProfileLookup.end())
+	{
+		return found->second;
+	}
+	unsigned int handle = (unsigned int)m_lightProfileTable.size();
+	m_lightProfileTable.push_back(columns);
+	m_lightProfileLookup[columns] = handle;
+	return handle;
+}
+
+SceneObject Scene::GetRow(int row) const
+{
+	SceneObject object;
+	GetRow(row, object);
+	return object;
+}
+
+void Scene::GetRow(int row, SceneObject & object) const
+{
+	//assigning keeps the name's buffer, so a row reused across a loop stops allocating once it has held the longest name
+	static const SceneObject defaults;
+	object = defaults;
+	int ID = m_IDs[row];
+
+	object.ID = ID;
+	object.chunk_ID = m_chunkIDs[row];
+	object.parent_id = m_parentIDs[row];
+	object.name = m_nameTable.Lookup(m_names[row]);
+
+	unsigned int flags = m_flags[row];
+	object.render				= (flags & SCENE_FLAG_RENDER) != 0;
+	object.editor_render		= (flags & SCENE_FLAG_EDITOR_RENDER) != 0;
+	object.editor_texture_vis	= (flags & SCENE_FLAG_EDITOR_TEXTURE_VIS) != 0;
+	object.editor_normals_vis	= (flags & SCENE_FLAG_EDITOR_NORMALS_VIS) != 0;
+	object.editor_collision_vis	= (flags & SCENE_FLAG_EDITOR_COLLISION_VIS) != 0;
+	object.editor_pivot_vis		= (flags & SCENE_FLAG_EDITOR_PIVOT_VIS) != 0;
+	object.editor_wireframe		= (flags & SCENE_FLAG_EDITOR_WIREFRAME) != 0;
+	object.snapToGround			= (flags & SCENE_FLAG_SNAP_TO_GROUND) != 0;
+	object.AINode				= (flags & SCENE_FLAG_AI_NODE) != 0;
+	object.camera				= (flags & SCENE_FLAG_CAMERA) != 0;
+
+	const TransformComponent & transform = m_transforms[row];
+	object.posX = transform.posX;		object.posY = transform.posY;		object.posZ = transform.posZ;
+	object.rotX = transform.rotX;		object.rotY = transform.rotY;		object.rotZ = transform.rotZ;
+	object.scaX = transform.scaX;		object.scaY = transform.scaY;		object.scaZ = transform.scaZ;
+	object.pivotX = transform.pivotX;	object.pivotY = transform.pivotY;	object.pivotZ = transform.pivotZ;
+
+	object.model_path = m_renders[row].model_path;
+	object.tex_diffuse_path = m_renders[row].tex_diffuse_path;
+
+	if (const CollisionComponent * collider = m_colliders.Find(ID))
+	{
+		object.collision = collider->collision;
+		object.collision_mesh = collider->collision_mesh;
+	}
+
+	if (const GameplayComponent * gameplay = m_gameplay.Find(ID))
+	{
+		object.collectable = gameplay->collectable;
+		object.destructable = gameplay->destructable;
+		object.health_amount = gameplay->health_amount;
+	}
+
+	const LightComponent * light = m_lights.Find(ID);
+	if (!light)
+	{
+		light = &m_lightProfileTable[m_lightProfiles[row]];
+	}
+	object.light_type = light->light_type;
+	object.light_diffuse_r = light->light_diffuse_r;	object.light_diffuse_g = light->light_diffuse_g;	object.light_diffuse_b = light->light_diffuse_b;
+	object.light_specular_r = light->light_specular_r;	object.light_specular_g = light->light_specular_g;	object.light_specular_b = light->light_specular_b;
+	object.light_spot_cutoff = light->light_spot_cutoff;
+	object.light_constant = light->light_constant;
+	object.light_linear = light->light_linear;
+	object.light_quadratic = light->light_quadratic;
+
+	if (const AudioComponent * audio = m_audio.Find(ID))
+	{
+		object.audio_path = audio->audio_path;
+		object.volume = audio->volume;
+		object.pitch = audio->pitch;
+		object.pan = audio->pan;
+		object.one_shot = audio->one_shot;
+		object.play_on_init = audio->play_on_init;
+		object.play_in_editor = audio->play_in_editor;
+		object.min_dist = audio->min_dist;
+		object.max_dist = audio->max_dist;
+	}
+
+	if (const PathNodeComponent * pathNode = m_pathNodes.Find(ID))
+	{
+		object.path_node = pathNode->path_node;
+		object.path_node_start = pathNode->path_node_start;
+		object.path_node_end = pathNode->path_node_end;
+	}
+}
+
+size_t Scene::MemoryUsage() const
+{
+	size_t bytes = m_IDs.capacity() * sizeof(int) + m_chunkIDs.capacity() * sizeof(int) + m_parentIDs.capacity() * sizeof(int)
+		+ m_names.capacity() * sizeof(StringHandle) + m_flags.capacity() * sizeof(unsigned int)
+		+ m_transforms.capacity() * sizeof(TransformComponent) + m_renders.capacity() * sizeof(RenderComponent)
+		+ m_lightProfiles.capacity() * sizeof(unsigned int) + m_lightProfileTable.capacity() * sizeof(LightComponent);
+	bytes += m_lights.MemoryUsage() + m_audio.MemoryUsage() + m_pathNodes.MemoryUsage() + m_colliders.MemoryUsage() + m_gameplay.MemoryUsage();
+	bytes += m_nameTable.MemoryUsage();
+	return bytes;
+}
+
+//a synthetic level of props shaped like the rows of test.db - placeholder values in every light column, light_type left
+//at none - with one real light in every hundred objects, held both as SceneObject rows and as components.
+//the ID index is left out of both sides, the editor needs one either way
+std::string Scene::Benchmark(int objects)
+{
+	std::vector<SceneObject> rows;
+	rows.reserve(objects);
+	Scene scene;
+	scene.Reserve(objects);
+	StringHandle model = StringTable::AssetPaths().Intern("database/data/placeholder.cmo");
+	StringHandle texture = StringTable::AssetPaths().Intern("database/data/placeholder.dds");
+
+	for (int i = 0; i < objects; i++)
+	{
+		SceneObject object;
+		object.ID = i + 1;
+		object.name = "Name";
+		object.model_path = model;
+		object.tex_diffuse_path = texture;
+		object.posX = (float)(i % 1000);
+		object.posZ = (float)(i / 1000);
+		object.scaX = object.scaY = object.scaZ = 1.0f;
+		object.light_diffuse_r = 2.0f;	object.light_diffuse_g = 3.0f;	object.light_diffuse_b = 4.0f;
+		object.light_specular_r = 5.0f;	object.light_specular_g = 6.0f;	object.light_specular_b = 7.0f;
+		object.light_spot_cutoff = 8.0f;
+		object.light_constant = 9.0f;
+		object.light_linear = 0.0f;
+		object.light_quadratic = 1.0f;
+		if (i % 50 == 25)
+		{
+			object.light_specular_g = 0.25f;	//a second set of placeholders, so props do not all share one profile
+		}
+		if (i % 100 == 0)
+		{
+			object.light_type = 2;
+			object.light_diffuse_r = 0.5f;
+		}
+		rows.push_back(object);
+		scene.Add(object);
+	}
+
+	size_t rowBytes = rows.capacity() * sizeof(SceneObject);
+	for (int i = 0; i < objects; i++)
+	{
+		if (rows[i].name.capacity() >= sizeof(std::string))
+		{
+			rowBytes += rows[i].name.capacity() + 1;
+		}
+	}
+	size_t sceneBytes = scene.MemoryUsage();
+
+	//every row comes back out of the components exactly as it went in, placeholder light columns and all
+	bool roundTrip = scene.Size() == objects;
+	for (int i = 0; roundTrip && i < objects; i++)
+	{
+		int row = scene.Find(rows[i].ID);
+		roundTrip = row != -1 && scene.GetRow(row) == rows[i];
+	}
+
+	//"every light" - test every row against scanning the light array
+	auto rowStart = std::chrono::high_resolution_clock::now();
+	float rowSum = 0.0f;
+	for (int i = 0; i < objects; i++)
+	{
+		if (rows[i].light_type != SCENE_LIGHT_NONE)
+		{
+			rowSum += rows[i].light_diffuse_r;
+		}
+	}
+	auto rowEnd = std::chrono::high_resolution_clock::now();
+
+	auto sceneStart = std::chrono::high_resolution_clock::now();
+	float sceneSum = 0.0f;
+	const ComponentArray<LightComponent> & lights = scene.GetLights();
+	for (int i = 0; i < lights.Size(); i++)
+	{
+		sceneSum += lights[i].light_diffuse_r;
+	}
+	auto sceneEnd = std::chrono::high_resolution_clock::now();
+
+	std::stringstream report;
+	report << "Scene storage, " << objects << " objects: rows " << rowBytes / objects << " bytes/object, components "
+		<< sceneBytes / objects << " bytes/object. All lights: rows "
+		<< std::chrono::duration<double, std::milli>(rowEnd - rowStart).count() << " ms, components "
+		<< std::chrono::duration<double, std::milli>(sceneEnd - sceneStart).count() << " ms"
+		<< (rowSum == sceneSum && lights.Size() == (objects + 99) / 100 ? "" : " (MISMATCH)") << (roundTrip ? "" : " (ROUND TRIP CHANGED A ROW)") << "\n";
+	return report.str();
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include "SceneObject.h"
+#include "ObjectIndex.h"
+#include "ComponentArray.h"
+#include "StringTable.h"
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+//the scene model. objects are split into components instead of one 56 field row each.
+//every object has an entity row (ID, chunk, parent, name, flags), a transform and render data, stored as parallel arrays.
+//lights, audio emitters, path nodes, collision and gameplay data are optional and live in their own dense arrays.
+//SceneObject is still the full row, used for loading, saving and passing whole objects around - GetRow gathers one
+//and Add / Set scatter one back. an optional component exists only when its columns differ from the SceneObject defaults,
+//so a row that goes in comes back out unchanged. lights are the exception, only light_type decides those - the level's
+//props carry placeholder values in the other light columns. a prop keeps them as a handle to a shared copy of each
+//distinct set, so they still come back out as they went in.
+
+enum SceneFlags
+{
+	SCENE_FLAG_RENDER				= 1 << 0,
+	SCENE_FLAG_EDITOR_RENDER		= 1 << 1,
+	SCENE_FLAG_EDITOR_TEXTURE_VIS	= 1 << 2,
+	SCENE_FLAG_EDITOR_NORMALS_VIS	= 1 << 3,
+	SCENE_FLAG_EDITOR_COLLISION_VIS	= 1 << 4,
+	SCENE_FLAG_EDITOR_PIVOT_VIS		= 1 << 5,
+	SCENE_FLAG_EDITOR_WIREFRAME		= 1 << 6,
+	SCENE_FLAG_SNAP_TO_GROUND		= 1 << 7,
+	SCENE_FLAG_AI_NODE				= 1 << 8,
+	SCENE_FLAG_CAMERA				= 1 << 9
+};
+
+//light_type of an object that is not a light, the SceneObject default
+const int SCENE_LIGHT_NONE = 1;
+
+struct TransformComponent
+{
+	float posX, posY, posZ;
+	float rotX, rotY, rotZ;
+	float scaX, scaY, scaZ;
+	float pivotX, pivotY, pivotZ;
+};
+
+struct RenderComponent
+{
+	StringHandle model_path;
+	StringHandle tex_diffuse_path;
+};
+
+struct CollisionComponent
+{
+	StringHandle collision_mesh;
+	bool collision;
+};
+
+struct GameplayComponent
+{
+	int health_amount;
+	bool collectable, destructable;
+};
+
+struct LightComponent
+{
+	int light_type;
+	float light_diffuse_r, light_diffuse_g, light_diffuse_b;
+	float light_specular_r, light_specular_g, light_specular_b;
+	float light_spot_cutoff;
+	float light_constant;
+	float light_linear;
+	float light_quadratic;
+};
+
+struct AudioComponent
+{
+	StringHandle audio_path;
+	float volume, pitch, pan;
+	int min_dist, max_dist;
+	bool one_shot, play_on_init, play_in_editor;
+};
+
+struct PathNodeComponent
+{
+	bool path_node, path_node_start, path_node_end;
+};
+
+class Scene
+{
+public:
+	Scene();
+	~Scene();
+
+	void	Clear();
+	void	Reserve(int objects);
+	int		Size() const { return (int)m_IDs.size(); }
+	int		Find(int ID) const { return m_index.Find(ID); }		//row of the object, -1 if it is not in the scene
+
+	void	Add(const SceneObject & object);
+	//many copies of one row in a single pass, object.ID + i taking transforms[i]. for scatters of thousands of props
+	void	AddInstances(const SceneObject & object, const std::vector<TransformComponent> & transforms);
+	void	Set(const SceneObject & object);					//overwrites every component of an object already in the scene
+	bool	Remove(int ID);										//swaps the last row into the hole, so rows are not stable either
+	SceneObject	GetRow(int row) const;							//gathers the full row back out of the components
+	void		GetRow(int row, SceneObject & object) const;	//the same into a row kept across calls
+
+	int					GetID(int row) const { return m_IDs[row]; }
+	int					GetParentID(int row) const { return m_parentIDs[row]; }
+	const std::string &	GetName(int row) const { return m_nameTable.Lookup(m_names[row]); }
+	unsigned int		GetFlags(int row) const { return m_flags[row]; }
+	TransformComponent &	GetTransform(int row) { return m_transforms[row]; }
+	const TransformComponent &	GetTransform(int row) const { return m_transforms[row]; }
+	RenderComponent &		GetRender(int row) { return m_renders[row]; }
+	const RenderComponent &	GetRender(int row) const { return m_renders[row]; }
+
+	const ComponentArray<LightComponent> &		GetLights() const { return m_lights; }
+	const ComponentArray<AudioComponent> &		GetAudioEmitters() const { return m_audio; }
+	const ComponentArray<PathNodeComponent> &	GetPathNodes() const { return m_pathNodes; }
+	const ComponentArray<CollisionComponent> &	GetColliders() const { return m_colliders; }
+	const ComponentArray<GameplayComponent> &	GetGameplay() const { return m_gameplay; }
+
+	size_t	MemoryUsage() const;
+	static std::string Benchmark(int objects);		//memory per plain prop and an all lights scan, against a vector of SceneObject
+
+private:
+	void	SetComponents(int row, const SceneObject & object);
+	void	RemoveOptionalComponents(int ID);
+	unsigned int	InternLightProfile(const LightComponent & columns);
+
+	//orders light columns by their bits, so profiles are only shared when they would come back out identical
+	struct LightProfileLess
+	{
+		bool operator()(const LightComponent & a, const LightComponent & b) const { return memcmp(&a, &b, sizeof(LightComponent)) < 0; }
+	};
+
+	ObjectIndex	m_index;		//database ID -> row
+
+	//entity rows, all parallel
+	std::vector<int>					m_IDs;
+	std::vector<int>					m_chunkIDs;
+	std::vector<int>					m_parentIDs;
+	std::vector<StringHandle>			m_names;		//handles into m_nameTable, most objects share a handful of names
+	std::vector<unsigned int>			m_flags;		//SceneFlags
+	std::vector<TransformComponent>		m_transforms;
+	std::vector<RenderComponent>		m_renders;
+	std::vector<unsigned int>			m_lightProfiles;	//light columns of an object that is not a light, 0 for the defaults
+
+	ComponentArray<LightComponent>		m_lights;
+	ComponentArray<AudioComponent>		m_audio;
+	ComponentArray<PathNodeComponent>	m_pathNodes;
+	ComponentArray<CollisionComponent>	m_colliders;
+	ComponentArray<GameplayComponent>	m_gameplay;
+
+	StringTable		m_nameTable;
+
+	std::vector<LightComponent>									m_lightProfileTable;	//handle -> columns
+	std::map<LightComponent, unsigned int, LightProfileLess>	m_lightProfileLookup;
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "SceneObject.h"
+#include "Scene.h"
+#include <memory>
+#include <vector>
+
+//object level deltas passed between the scene model (ToolMain::m_sceneGraph) and the renderer (Game::m_displayList).
+//one edit produces one change, so neither side ever has to rebuild the other from scratch.
+
+enum SceneChangeType
+{
+	SCENE_OBJECT_ADDED,			//object carries the full new row
+	SCENE_OBJECT_REMOVED,		//only ID is used
+	SCENE_OBJECT_TRANSFORMED,	//object carries position, rotation and scale
+	SCENE_OBJECT_RETEXTURED,	//object carries tex_diffuse_path
+	SCENE_OBJECTS_ADDED,		//a batch of copies of object, with IDs counting up from object.ID, one per entry in transforms
+	SCENE_OBJECTS_TRANSFORMED,	//every object in IDs takes the matching entry of transforms, ID is 0
+	SCENE_TERRAIN_CHANGED		//a terrain stroke went into the terrain history, ID is 0. there is no object to change
+};
+
+struct SceneChange
+{
+	SceneChangeType type;
+	int				sourceID;	//ADDED from a paste - the ID of the object that was copied, otherwise -1
+	SceneObject		object;		//object.ID is the database ID the change applies to
+	std::shared_ptr<const std::vector<TransformComponent>>	transforms;	//the batches only, shared so the change stays cheap to copy
+	std::shared_ptr<const std::vector<int>>					IDs;		//SCENE_OBJECTS_TRANSFORMED only
+
+	SceneChange(SceneChangeType changeType, int id)
+	{
+		type = changeType;
+		sourceID = -1;
+		object.ID = id;
+	}
+};
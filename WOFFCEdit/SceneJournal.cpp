@@ -0,0 +1,652 @@
+#include "SceneJournal.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+	const size_t	DEFAULT_BUDGET = 32 * 1024 * 1024;
+	const int		TRANSFORM_FIELDS = sizeof(TransformComponent) / sizeof(float);
+
+	double MicrosecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	void SetTransform(TransformComponent & transform, const SceneObject & object)
+	{
+		transform.posX = object.posX;	transform.posY = object.posY;	transform.posZ = object.posZ;
+		transform.rotX = object.rotX;	transform.rotY = object.rotY;	transform.rotZ = object.rotZ;
+		transform.scaX = object.scaX;	transform.scaY = object.scaY;	transform.scaZ = object.scaZ;
+	}
+
+	//the fields an edit moves, the pivot stays where it is
+	void SetTransform(TransformComponent & transform, const TransformComponent & from)
+	{
+		transform.posX = from.posX;	transform.posY = from.posY;	transform.posZ = from.posZ;
+		transform.rotX = from.rotX;	transform.rotY = from.rotY;	transform.rotZ = from.rotZ;
+		transform.scaX = from.scaX;	transform.scaY = from.scaY;	transform.scaZ = from.scaZ;
+	}
+
+	void SetObjectTransform(SceneObject & object, const TransformComponent & transform)
+	{
+		object.posX = transform.posX;	object.posY = transform.posY;	object.posZ = transform.posZ;
+		object.rotX = transform.rotX;	object.rotY = transform.rotY;	object.rotZ = transform.rotZ;
+		object.scaX = transform.scaX;	object.scaY = transform.scaY;	object.scaZ = transform.scaZ;
+	}
+
+	size_t RowBytes(const SceneObject & row)
+	{
+		return sizeof(SceneObject) + (row.name.capacity() >= sizeof(std::string) ? row.name.capacity() + 1 : 0);
+	}
+}
+
+SceneJournal::SceneJournal()
+{
+	m_position = 0;
+	m_bytes = 0;
+	m_budget = DEFAULT_BUDGET;
+	m_open.bytes = 0;
+	m_lastOperation = "nothing";
+	m_lastChanges = 0;
+	m_lastBytes = 0;
+	m_lastMicroseconds = 0.0;
+	m_evicted = 0;
+}
+
+SceneJournal::~SceneJournal()
+{
+}
+
+void SceneJournal::Clear()
+{
+	m_edits.clear();
+	m_position = 0;
+	m_bytes = 0;
+	m_open = Edit();
+	m_open.bytes = 0;
+	m_openTransforms.clear();
+	m_openTransformIndex.clear();
+	m_openAdds.clear();
+}
+
+void SceneJournal::Apply(const SceneChange & change, Scene & scene)
+{
+	int row = scene.Find(change.object.ID);
+
+	switch (change.type)
+	{
+	case SCENE_OBJECT_ADDED:
+		scene.Add(change.object);
+		break;
+
+	case SCENE_OBJECTS_ADDED:
+		scene.AddInstances(change.object, *change.transforms);
+		break;
+
+	case SCENE_OBJECT_REMOVED:
+		scene.Remove(change.object.ID);
+		break;
+
+	case SCENE_OBJECT_TRANSFORMED:
+		if (row != -1)
+		{
+			SetTransform(scene.GetTransform(row), change.object);
+		}
+		break;
+
+	case SCENE_OBJECTS_TRANSFORMED:
+		for (size_t i = 0; i < change.IDs->size(); i++)
+		{
+			int moved = scene.Find((*change.IDs)[i]);
+			if (moved != -1)
+			{
+				SetTransform(scene.GetTransform(moved), (*change.transforms)[i]);
+			}
+		}
+		break;
+
+	case SCENE_OBJECT_RETEXTURED:
+		if (row != -1)
+		{
+			scene.GetRender(row).tex_diffuse_path = change.object.tex_diffuse_path;
+		}
+		break;
+
+	case SCENE_TERRAIN_CHANGED:
+		break;
+	}
+}
+
+bool SceneJournal::AmendOpenAdd(int ID, const TransformComponent * transform, StringHandle texture)
+{
+	//an object added in this edit just gets added where it ended up, so there is no order between the two to keep
+	auto add = m_openAdds.find(ID);
+	if (add != m_openAdds.end())
+	{
+		Operation & operation = m_open.operations[add->second];
+		if (transform)
+		{
+			SetObjectTransform(*operation.row, *transform);
+		}
+		else
+		{
+			operation.row->tex_diffuse_path = texture;
+		}
+		return true;
+	}
+
+	if (!transform)
+	{
+		return false;
+	}
+	for (size_t i = 0; i < m_open.operations.size(); i++)
+	{
+		Operation & operation = m_open.operations[i];
+		if (operation.type == SCENE_OBJECTS_ADDED && ID >= operation.ID && ID < operation.ID + (int)operation.transforms->size())
+		{
+			//the batch is shared with the change that made it, so it is copied before it is written
+			std::shared_ptr<std::vector<TransformComponent>> transforms = std::make_shared<std::vector<TransformComponent>>(*operation.transforms);
+			SetTransform((*transforms)[ID - operation.ID], *transform);
+			operation.transforms = transforms;
+			return true;
+		}
+	}
+	return false;
+}
+
+void SceneJournal::Record(const SceneChange & change, const Scene & scene)
+{
+	int row = scene.Find(change.object.ID);
+	Operation operation;
+	operation.type = change.type;
+	operation.ID = change.object.ID;
+
+	switch (change.type)
+	{
+	case SCENE_OBJECT_ADDED:
+		operation.row = std::make_shared<SceneObject>(change.object);
+		m_openAdds[operation.ID] = (int)m_open.operations.size();
+		break;
+
+	case SCENE_OBJECTS_ADDED:
+		operation.row = std::make_shared<SceneObject>(change.object);
+		operation.transforms = change.transforms;
+		break;
+
+	case SCENE_OBJECT_REMOVED:
+		if (row == -1)
+		{
+			return;
+		}
+		operation.row = std::make_shared<SceneObject>(scene.GetRow(row));
+		m_openAdds.erase(operation.ID);
+		break;
+
+	case SCENE_OBJECT_TRANSFORMED:
+	{
+		TransformComponent after = row == -1 ? TransformComponent() : scene.GetTransform(row);
+		SetTransform(after, change.object);
+		RecordTransform(operation.ID, row, after, scene);
+		return;
+	}
+
+	case SCENE_OBJECTS_TRANSFORMED:
+		//coalesces per object exactly as if each had come on its own, so a batch and single moves can share an edit
+		m_openTransforms.reserve(m_openTransforms.size() + change.IDs->size());
+		m_openTransformIndex.reserve(m_openTransforms.size() + change.IDs->size());
+		for (size_t i = 0; i < change.IDs->size(); i++)
+		{
+			int ID = (*change.IDs)[i];
+			RecordTransform(ID, scene.Find(ID), (*change.transforms)[i], scene);
+		}
+		return;
+
+	case SCENE_OBJECT_RETEXTURED:
+		if (row == -1 || AmendOpenAdd(operation.ID, NULL, change.object.tex_diffuse_path))
+		{
+			return;
+		}
+		operation.before = scene.GetRender(row).tex_diffuse_path;
+		operation.after = change.object.tex_diffuse_path;
+		break;
+
+	case SCENE_TERRAIN_CHANGED:
+		break;
+	}
+
+	m_open.operations.push_back(operation);
+}
+
+void SceneJournal::RecordTransform(int ID, int row, const TransformComponent & after, const Scene & scene)
+{
+	if (row == -1 || AmendOpenAdd(ID, &after, StringHandle()))
+	{
+		return;
+	}
+	auto open = m_openTransformIndex.find(ID);
+	if (open == m_openTransformIndex.end())
+	{
+		OpenTransform transform;
+		transform.ID = ID;
+		transform.before = scene.GetTransform(row);
+		transform.after = transform.before;
+		open = m_openTransformIndex.insert(std::make_pair(ID, (int)m_openTransforms.size())).first;
+		m_openTransforms.push_back(transform);
+	}
+	SetTransform(m_openTransforms[open->second].after, after);
+}
+
+void SceneJournal::EndEdit()
+{
+	if (!IsOpen())
+	{
+		return;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//pack the coalesced transforms down to the fields that actually changed
+	for (size_t i = 0; i < m_openTransforms.size(); i++)
+	{
+		const float * before = &m_openTransforms[i].before.posX;
+		const float * after = &m_openTransforms[i].after.posX;
+		TransformDelta delta;
+		delta.ID = m_openTransforms[i].ID;
+		delta.fields = 0;
+		delta.value = (uint32_t)m_open.values.size();
+		for (int field = 0; field < TRANSFORM_FIELDS; field++)
+		{
+			if (memcmp(&before[field], &after[field], sizeof(float)) != 0)
+			{
+				delta.fields |= 1 << field;
+				m_open.values.push_back(before[field]);
+				m_open.values.push_back(after[field]);
+			}
+		}
+		if (delta.fields)
+		{
+			m_open.transforms.push_back(delta);
+		}
+	}
+	m_openTransforms.clear();
+	m_openTransformIndex.clear();
+	m_openAdds.clear();
+
+	Edit & edit = m_open;
+	edit.bytes = edit.operations.capacity() * sizeof(Operation) + edit.transforms.capacity() * sizeof(TransformDelta)
+		+ edit.values.capacity() * sizeof(float);
+	for (size_t i = 0; i < edit.operations.size(); i++)
+	{
+		const Operation & operation = edit.operations[i];
+		if (operation.row)
+		{
+			edit.bytes += RowBytes(*operation.row);
+		}
+		if (operation.transforms)
+		{
+			edit.bytes += operation.transforms->size() * sizeof(TransformComponent);
+		}
+	}
+
+	m_lastOperation = "edit";
+	m_lastChanges = edit.operations.size() + edit.transforms.size();
+	m_lastBytes = edit.bytes;
+	m_evicted = 0;
+	if (edit.operations.empty() && edit.transforms.empty())
+	{
+		m_open = Edit();
+		m_open.bytes = 0;
+		return;
+	}
+
+	//a new edit ends the redo
+	for (size_t i = m_position; i < m_edits.size(); i++)
+	{
+		m_bytes -= m_edits[i].bytes;
+	}
+	m_edits.resize(m_position);
+	m_bytes += edit.bytes;
+	m_edits.push_back(std::move(edit));
+	m_position++;
+	m_open = Edit();
+	m_open.bytes = 0;
+	Evict();
+	m_lastMicroseconds = MicrosecondsSince(start);
+}
+
+void SceneJournal::Evict()
+{
+	//the newest edit stays even over budget, so what was just done can always be undone
+	while (m_bytes > m_budget && m_edits.size() > 1 && m_position > 1)
+	{
+		m_bytes -= m_edits.front().bytes;
+		m_edits.pop_front();
+		m_position--;
+		m_evicted++;
+	}
+}
+
+void SceneJournal::ApplyTransform(Scene & scene, const Edit & edit, const TransformDelta & delta, bool forward, std::vector<SceneChange> & applied)
+{
+	int row = scene.Find(delta.ID);
+	if (row == -1)
+	{
+		return;
+	}
+	TransformComponent & transform = scene.GetTransform(row);
+	float * fields = &transform.posX;
+	const float * value = &edit.values[delta.value];
+	for (int field = 0; field < TRANSFORM_FIELDS; field++)
+	{
+		if (delta.fields & (1 << field))
+		{
+			fields[field] = forward ? value[1] : value[0];
+			value += 2;
+		}
+	}
+
+	SceneChange change(SCENE_OBJECT_TRANSFORMED, delta.ID);
+	SetObjectTransform(change.object, transform);
+	applied.push_back(change);
+}
+
+bool SceneJournal::Undo(Scene & scene, std::vector<SceneChange> & applied)
+{
+	EndEdit();
+	applied.clear();
+	if (m_position == 0)
+	{
+		return false;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	m_position--;
+	const Edit & edit = m_edits[m_position];
+
+	//the other way round to how they happened - a removed object comes back before its move is taken off
+	for (size_t i = edit.operations.size(); i-- > 0;)
+	{
+		const Operation & operation = edit.operations[i];
+		switch (operation.type)
+		{
+		case SCENE_OBJECT_ADDED:
+			scene.Remove(operation.ID);
+			applied.push_back(SceneChange(SCENE_OBJECT_REMOVED, operation.ID));
+			break;
+
+		case SCENE_OBJECTS_ADDED:
+			for (int k = 0; k < (int)operation.transforms->size(); k++)
+			{
+				scene.Remove(operation.ID + k);
+				applied.push_back(SceneChange(SCENE_OBJECT_REMOVED, operation.ID + k));
+			}
+			break;
+
+		case SCENE_OBJECT_REMOVED:
+		{
+			scene.Add(*operation.row);
+			SceneChange change(SCENE_OBJECT_ADDED, operation.ID);
+			change.object = *operation.row;
+			applied.push_back(change);
+			break;
+		}
+
+		case SCENE_OBJECT_RETEXTURED:
+		{
+			int row = scene.Find(operation.ID);
+			if (row != -1)
+			{
+				scene.GetRender(row).tex_diffuse_path = operation.before;
+				SceneChange change(SCENE_OBJECT_RETEXTURED, operation.ID);
+				change.object.tex_diffuse_path = operation.before;
+				applied.push_back(change);
+			}
+			break;
+		}
+
+		default:
+			applied.push_back(SceneChange(operation.type, operation.ID));
+			break;
+		}
+	}
+	for (size_t i = 0; i < edit.transforms.size(); i++)
+	{
+		ApplyTransform(scene, edit, edit.transforms[i], false, applied);
+	}
+
+	m_lastOperation = "undo";
+	m_lastChanges = applied.size();
+	m_lastBytes = 0;
+	m_evicted = 0;
+	m_lastMicroseconds = MicrosecondsSince(start);
+	return true;
+}
+
+bool SceneJournal::Redo(Scene & scene, std::vector<SceneChange> & applied)
+{
+	EndEdit();
+	applied.clear();
+	if (m_position == (int)m_edits.size())
+	{
+		return false;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	const Edit & edit = m_edits[m_position];
+	m_position++;
+
+	//moves first, so an object the edit went on to remove is moved while it is still there
+	for (size_t i = 0; i < edit.transforms.size(); i++)
+	{
+		ApplyTransform(scene, edit, edit.transforms[i], true, applied);
+	}
+	for (size_t i = 0; i < edit.operations.size(); i++)
+	{
+		const Operation & operation = edit.operations[i];
+		SceneChange change(operation.type, operation.ID);
+		switch (operation.type)
+		{
+		case SCENE_OBJECT_ADDED:
+			change.object = *operation.row;
+			break;
+
+		case SCENE_OBJECTS_ADDED:
+			change.object = *operation.row;
+			change.transforms = operation.transforms;
+			break;
+
+		case SCENE_OBJECT_RETEXTURED:
+			change.object.tex_diffuse_path = operation.after;
+			break;
+
+		default:
+			break;
+		}
+		Apply(change, scene);
+		applied.push_back(change);
+	}
+
+	m_lastOperation = "redo";
+	m_lastChanges = applied.size();
+	m_lastBytes = 0;
+	m_evicted = 0;
+	m_lastMicroseconds = MicrosecondsSince(start);
+	return true;
+}
+
+std::string SceneJournal::Report() const
+{
+	std::ostringstream report;
+	report << "Scene " << m_lastOperation << ": " << m_lastChanges << " changes";
+	if (m_lastBytes)
+	{
+		report << ", " << m_lastBytes << " bytes";
+	}
+	report << " in " << m_lastMicroseconds << " us. journal " << m_bytes / 1024.0 << " KB in " << m_edits.size()
+		<< " edits, " << m_position << " to undo";
+	if (m_evicted)
+	{
+		report << ", " << m_evicted << " oldest dropped for the budget";
+	}
+	report << "\n";
+	return report.str();
+}
+
+namespace
+{
+	//what undo and redo have to get right - which objects exist, where, and how they look
+	struct ObjectState
+	{
+		int					ID;
+		TransformComponent	transform;
+		StringHandle		model, texture;
+
+		bool operator<(const ObjectState & other) const	{ return ID < other.ID; }
+		bool operator==(const ObjectState & other) const
+		{
+			return ID == other.ID && memcmp(&transform, &other.transform, sizeof(transform)) == 0 && model == other.model && texture == other.texture;
+		}
+	};
+
+	std::vector<ObjectState> SceneState(const Scene & scene)
+	{
+		std::vector<ObjectState> state(scene.Size());
+		for (int row = 0; row < scene.Size(); row++)
+		{
+			state[row].ID = scene.GetID(row);
+			state[row].transform = scene.GetTransform(row);
+			state[row].model = scene.GetRender(row).model_path;
+			state[row].texture = scene.GetRender(row).tex_diffuse_path;
+		}
+		std::sort(state.begin(), state.end());
+		return state;
+	}
+}
+
+//a level of plain props put through the edits the tool makes - drags, pastes, deletes, retextures, scatters and the
+//snap to ground after a sculpt - then undone to the start and redone to the end
+std::string SceneJournal::Benchmark(int objects, int edits)
+{
+	Scene scene;
+	scene.Reserve(objects);
+	StringHandle model = StringTable::AssetPaths().Intern("database/data/placeholder.cmo");
+	StringHandle texture = StringTable::AssetPaths().Intern("database/data/placeholder.dds");
+	StringHandle otherTexture = StringTable::AssetPaths().Intern("database/data/rock.dds");
+	for (int i = 0; i < objects; i++)
+	{
+		SceneObject object;
+		object.ID = i + 1;
+		object.name = "Name";
+		object.model_path = model;
+		object.tex_diffuse_path = texture;
+		object.posX = (float)(i % 1000);
+		object.posZ = (float)(i / 1000);
+		object.scaX = object.scaY = object.scaZ = 1.0f;
+		scene.Add(object);
+	}
+	size_t snapshotBytes = scene.MemoryUsage();
+	std::vector<ObjectState> original = SceneState(scene);
+
+	SceneJournal journal;
+	journal.SetBudget((size_t)1 << 30);
+	int nextID = objects + 1;
+	unsigned random = 1;
+	auto pick = [&]() { random = random * 1664525u + 1013904223u; return scene.GetID((random >> 8) % scene.Size()); };
+	auto record = [&](const SceneChange & change) { journal.Record(change, scene); Apply(change, scene); };
+
+	double recordUs = 0.0;
+	for (int edit = 0; edit < edits; edit++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		switch (edit % 6)
+		{
+		case 0:		//a drag, one object moved a little every frame
+		{
+			int ID = pick();
+			SceneObject moved = scene.GetRow(scene.Find(ID));
+			for (int frame = 0; frame < 60; frame++)
+			{
+				moved.posX += 0.1f;
+				SceneChange change(SCENE_OBJECT_TRANSFORMED, ID);
+				change.object = moved;
+				record(change);
+			}
+			break;
+		}
+		case 1:		//paste
+		{
+			SceneChange change(SCENE_OBJECT_ADDED, nextID);
+			change.sourceID = pick();
+			change.object = scene.GetRow(scene.Find(change.sourceID));
+			change.object.ID = nextID++;
+			change.object.posY += 5.0f;
+			record(change);
+			break;
+		}
+		case 2:		//delete
+			record(SceneChange(SCENE_OBJECT_REMOVED, pick()));
+			break;
+		case 3:		//reset texture
+		{
+			SceneChange change(SCENE_OBJECT_RETEXTURED, pick());
+			change.object.tex_diffuse_path = edit % 12 == 3 ? otherTexture : texture;
+			record(change);
+			break;
+		}
+		case 4:		//scatter
+		{
+			SceneChange change(SCENE_OBJECTS_ADDED, nextID);
+			change.object.model_path = model;
+			change.object.tex_diffuse_path = texture;
+			std::shared_ptr<std::vector<TransformComponent>> transforms = std::make_shared<std::vector<TransformComponent>>(100);
+			for (int k = 0; k < 100; k++)
+			{
+				TransformComponent & transform = (*transforms)[k];
+				memset(&transform, 0, sizeof(transform));
+				transform.posX = (float)k;
+				transform.posZ = (float)edit;
+				transform.scaX = transform.scaY = transform.scaZ = 1.0f;
+			}
+			change.transforms = transforms;
+			nextID += 100;
+			record(change);
+			break;
+		}
+		case 5:		//sculpt, then a few hundred objects snap down onto it
+			record(SceneChange(SCENE_TERRAIN_CHANGED, 0));
+			for (int k = 0; k < 500; k++)
+			{
+				int ID = pick();
+				SceneObject snapped = scene.GetRow(scene.Find(ID));
+				snapped.posY = 0.25f * (float)(edit % 7);
+				SceneChange change(SCENE_OBJECT_TRANSFORMED, ID);
+				change.object = snapped;
+				record(change);
+			}
+			break;
+		}
+		journal.EndEdit();
+		recordUs += MicrosecondsSince(start);
+	}
+	std::vector<ObjectState> edited = SceneState(scene);
+	size_t journalBytes = journal.MemoryUsed();
+
+	std::vector<SceneChange> applied;
+	double undoUs = 0.0, worstUndoUs = 0.0;
+	while (journal.Undo(scene, applied))
+	{
+		undoUs += journal.m_lastMicroseconds;
+		worstUndoUs = std::max(worstUndoUs, journal.m_lastMicroseconds);
+	}
+	bool restored = SceneState(scene) == original;
+	while (journal.Redo(scene, applied))
+	{
+	}
+	bool replayed = SceneState(scene) == edited;
+
+	std::ostringstream report;
+	report << "Scene journal, " << edits << " edits on " << objects << " objects: " << journalBytes / 1024.0 << " KB, "
+		<< journalBytes / std::max(edits, 1) << " bytes an edit against " << snapshotBytes / 1024.0 << " KB a snapshot, "
+		<< recordUs / std::max(edits, 1) << " us to record, undo " << undoUs / std::max(edits, 1) << " us average, "
+		<< worstUndoUs << " us worst" << (restored && replayed ? "" : " (UNDO BROKEN)") << "\n";
+	return report.str();
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "SceneChange.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//undo and redo for the scene, built from the same SceneChange stream that keeps the scene model and the renderer in step.
+//each change is recorded as the smallest delta that reverses it - the transform fields that moved with their before
+//and after values, the row an add made or a remove took away, the texture before and after. changes are grouped into
+//edits, and a drag that moves the same object every frame coalesces into one delta per object until the edit ends.
+//the journal is a ring with a byte budget, the oldest edits are dropped first. undoing or redoing an edit touches
+//only what it changed.
+
+class SceneJournal
+{
+public:
+	SceneJournal();
+	~SceneJournal();
+
+	void SetBudget(size_t bytes)	{ m_budget = bytes; }
+	void Clear();
+
+	//call with each change before it is applied to scene, which is where the before state is read from.
+	//ADDED rows should be complete, as the scene model will store them
+	void Record(const SceneChange & change, const Scene & scene);
+	void EndEdit();		//closes the edit being recorded, the next change starts a new one
+
+	//apply the previous / next edit to scene, and hand back the changes made so the renderer can follow.
+	//SCENE_TERRAIN_CHANGED in the output means a terrain stroke is to be undone or redone along with them
+	bool Undo(Scene & scene, std::vector<SceneChange> & applied);
+	bool Redo(Scene & scene, std::vector<SceneChange> & applied);
+	bool CanUndo() const	{ return m_position > 0 || IsOpen(); }
+	bool CanRedo() const	{ return m_position < (int)m_edits.size() && !IsOpen(); }
+
+	size_t MemoryUsed() const	{ return m_bytes; }
+	std::string Report() const;		//cost of the last edit, undo or redo, and the memory held
+
+	static void Apply(const SceneChange & change, Scene & scene);	//makes change to the scene model
+	static std::string Benchmark(int objects, int edits);
+
+private:
+	//an add, remove, retexture or terrain stroke
+	struct Operation
+	{
+		SceneChangeType							type;
+		int										ID;
+		StringHandle							before, after;		//RETEXTURED
+		std::shared_ptr<SceneObject>			row;				//ADDED, REMOVED and the template of OBJECTS_ADDED
+		std::shared_ptr<const std::vector<TransformComponent>>	transforms;	//OBJECTS_ADDED
+	};
+
+	//the transform fields one object changed - fields is a mask of them, as floats of TransformComponent in order,
+	//and each set bit has a before and after pair in the edit's values from value on
+	struct TransformDelta
+	{
+		int			ID;
+		uint16_t	fields;
+		uint32_t	value;
+	};
+
+	struct Edit
+	{
+		std::vector<Operation>		operations;		//in the order they happened
+		std::vector<TransformDelta>	transforms;		//applied before the operations going forward, after them going back
+		std::vector<float>			values;
+		size_t						bytes;
+	};
+
+	//a transform still being coalesced
+	struct OpenTransform
+	{
+		int					ID;
+		TransformComponent	before, after;
+	};
+
+	bool IsOpen() const		{ return !m_open.operations.empty() || !m_openTransforms.empty(); }
+	bool AmendOpenAdd(int ID, const TransformComponent * transform, StringHandle texture);	//transform NULL for a retexture
+	void RecordTransform(int ID, int row, const TransformComponent & after, const Scene & scene);
+	void ApplyTransform(Scene & scene, const Edit & edit, const TransformDelta & delta, bool forward, std::vector<SceneChange> & applied);
+	void Evict();
+
+	std::deque<Edit>					m_edits;		//oldest first, the ones from m_position on are redo
+	int									m_position;
+	size_t								m_bytes;
+	size_t								m_budget;
+
+	//the edit being recorded
+	Edit								m_open;
+	std::vector<OpenTransform>			m_openTransforms;
+	std::unordered_map<int, int>		m_openTransformIndex;	//ID -> entry in m_openTransforms
+	std::unordered_map<int, int>		m_openAdds;				//ID -> ADDED operation in m_open
+
+	//instrumentation, for the last operation
+	const char *						m_lastOperation;
+	size_t								m_lastChanges;
+	size_t								m_lastBytes;
+	double								m_lastMicroseconds;
+	int									m_evicted;
+};
@@ -6,14 +6,14 @@ SceneObject::SceneObject()
 {
 	ID = 0;
 	chunk_ID =0 ;
-	model_path ="";
-	tex_diffuse_path = "";
+	model_path = 0;
+	tex_diffuse_path = 0;
 	posX = 0.0f;	posY = 0.0f;	posZ = 0.0f;
 	rotX = 0.0f;	rotY = 0.0f;	rotZ = 0.0f;
 	scaX = 0.0f;	scaY = 0.0f;	scaZ = 0.0f;
 	render = true;
 	collision = false;
-	collision_mesh ="";
+	collision_mesh = 0;
 	collectable = false;
 	destructable = false;
 	health_amount = 0;
@@ -25,7 +25,7 @@ SceneObject::SceneObject()
 	pivotX = 0.0f; pivotY = 0.0f; pivotZ = 0.0f;
 	snapToGround = false;
 	AINode = false;
-	audio_path = "";
+	audio_path = 0;
 	volume =0.0f;
 	pitch = 0.0f;
 	pan = 0.0f;
@@ -54,3 +54,27 @@ SceneObject::SceneObject()
 SceneObject::~SceneObject()
 {
 }
+
+bool SceneObject::operator==(const SceneObject & other) const
+{
+	return ID == other.ID && chunk_ID == other.chunk_ID && model_path == other.model_path && tex_diffuse_path == other.tex_diffuse_path
+		&& posX == other.posX && posY == other.posY && posZ == other.posZ
+		&& rotX == other.rotX && rotY == other.rotY && rotZ == other.rotZ
+		&& scaX == other.scaX && scaY == other.scaY && scaZ == other.scaZ
+		&& render == other.render && collision == other.collision && collision_mesh == other.collision_mesh
+		&& collectable == other.collectable && destructable == other.destructable && health_amount == other.health_amount
+		&& editor_render == other.editor_render && editor_texture_vis == other.editor_texture_vis
+		&& editor_normals_vis == other.editor_normals_vis && editor_collision_vis == other.editor_collision_vis && editor_pivot_vis == other.editor_pivot_vis
+		&& pivotX == other.pivotX && pivotY == other.pivotY && pivotZ == other.pivotZ
+		&& snapToGround == other.snapToGround && AINode == other.AINode
+		&& audio_path == other.audio_path && volume == other.volume && pitch == other.pitch && pan == other.pan
+		&& one_shot == other.one_shot && play_on_init == other.play_on_init && play_in_editor == other.play_in_editor
+		&& min_dist == other.min_dist && max_dist == other.max_dist
+		&& camera == other.camera && path_node == other.path_node && path_node_start == other.path_node_start && path_node_end == other.path_node_end
+		&& parent_id == other.parent_id && editor_wireframe == other.editor_wireframe && name == other.name
+		&& light_type == other.light_type
+		&& light_diffuse_r == other.light_diffuse_r && light_diffuse_g == other.light_diffuse_g && light_diffuse_b == other.light_diffuse_b
+		&& light_specular_r == other.light_specular_r && light_specular_g == other.light_specular_g && light_specular_b == other.light_specular_b
+		&& light_spot_cutoff == other.light_spot_cutoff && light_constant == other.light_constant
+		&& light_linear == other.light_linear && light_quadratic == other.light_quadratic;
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include "StringTable.h"
 
 
 //This object should accurately and totally reflect the information stored in the object table
@@ -12,15 +13,18 @@ public:
 	SceneObject();
 	~SceneObject();
 
+	bool operator==(const SceneObject & other) const;	//every column equal
+	bool operator!=(const SceneObject & other) const { return !(*this == other); }
+
 	int ID;
 	int chunk_ID;
-	std::string model_path;
-	std::string tex_diffuse_path;
+	StringHandle model_path;			//asset paths are handles into StringTable::AssetPaths()
+	StringHandle tex_diffuse_path;
 	float posX, posY, posZ;
 	float rotX, rotY, rotZ;
 	float scaX, scaY, scaZ;
 	bool render, collision;
-	std::string collision_mesh;
+	StringHandle collision_mesh;
 	bool collectable, destructable;
 	int health_amount;
 	bool editor_render, editor_texture_vis;
@@ -28,7 +32,7 @@ public:
 	float pivotX, pivotY, pivotZ;
 	bool snapToGround;
 	bool AINode;
-	std::string audio_path;
+	StringHandle audio_path;
 	float volume;
 	float pitch;
 	float pan;
@@ -0,0 +1,22 @@
+#pragma once
+
+//integer hashes for seeded randomness that doesn't depend on the order things are worked out in. the same inputs give
+//the same bits on every machine and thread count, so terrain, scatters and erosion rebuilt from a seed come out the same
+
+//mixes a seed and up to two coordinates into a well spread 32 bit value
+inline unsigned int Hash(unsigned int a, unsigned int b, unsigned int c)
+{
+	unsigned int h = a * 0x9E3779B1u ^ b * 0x85EBCA77u ^ c * 0xC2B2AE3Du;
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	h *= 0x846CA68Bu;
+	h ^= h >> 16;
+	return h;
+}
+
+//0 up to 1, from the top 24 bits
+inline float HashToUnit(unsigned int h)
+{
+	return (h >> 8) * (1.0f / 16777216.0f);
+}
@@ -12,11 +12,13 @@ IMPLEMENT_DYNAMIC(SelectDialogue, CDialogEx)
 BEGIN_MESSAGE_MAP(SelectDialogue, CDialogEx)
 	ON_COMMAND(IDOK, &SelectDialogue::End)					//ok button
 	ON_BN_CLICKED(IDOK, &SelectDialogue::OnBnClickedOk)		
-	ON_LBN_SELCHANGE(IDC_LIST1, &SelectDialogue::Select)	//listbox
+	ON_NOTIFY(LVN_ITEMCHANGED, IDC_LIST1, &SelectDialogue::Select)		//list
+	ON_NOTIFY(LVN_GETDISPINFO, IDC_LIST1, &SelectDialogue::GetItemText)
+	ON_EN_CHANGE(IDC_SEARCH, &SelectDialogue::Search)		//search box
 END_MESSAGE_MAP()
 
 
-SelectDialogue::SelectDialogue(CWnd* pParent, std::vector<SceneObject>* SceneGraph)		//constructor used in modal
+SelectDialogue::SelectDialogue(CWnd* pParent, Scene* SceneGraph)		//constructor used in modal
 	: CDialogEx(IDD_DIALOG1, pParent)
 {
 	m_sceneGraph = SceneGraph;
@@ -32,19 +34,14 @@ SelectDialogue::~SelectDialogue()
 }
 
 ///pass through pointers to the data in the tool we want to manipulate
-void SelectDialogue::SetObjectData(std::vector<SceneObject>* SceneGraph, int * selection)
+void SelectDialogue::SetObjectData(Scene* SceneGraph, int * selection)
 {
 	m_sceneGraph = SceneGraph;
 	m_currentSelection = selection;
 
-	//roll through all the objects in the scene graph and put an entry for each in the listbox
-	int numSceneObjects = m_sceneGraph->size();
-	for (int i = 0; i < numSceneObjects; i++)
-	{
-		//easily possible to make the data string presented more complex. showing other columns.
-		std::wstring listBoxEntry = std::to_wstring(m_sceneGraph->at(i).ID);
-		m_listBox.AddString(listBoxEntry.c_str());
-	}
+	//the list is virtual - it only stores a row count and asks for the text of whatever rows are on screen
+	m_searchIndex.Build(*m_sceneGraph);
+	m_listBox.SetItemCountEx((int)m_searchIndex.GetResults().size());
 }
 
 
@@ -52,6 +49,7 @@ void SelectDialogue::DoDataExchange(CDataExchange* pDX)
 {
 	CDialogEx::DoDataExchange(pDX);
 	DDX_Control(pDX, IDC_LIST1, m_listBox);
+	DDX_Control(pDX, IDC_SEARCH, m_searchBox);
 }
 
 void SelectDialogue::End()
@@ -59,28 +57,69 @@ void SelectDialogue::End()
 	DestroyWindow();	//destory the window properly.  INcluding the links and pointers created.  THis is so the dialogue can start again. 
 }
 
-void SelectDialogue::Select()
+void SelectDialogue::Select(NMHDR * pNMHDR, LRESULT * pResult)
 {
-	int index = m_listBox.GetCurSel();
-	CString currentSelectionValue;
-	
-	m_listBox.GetText(index, currentSelectionValue);
+	NMLISTVIEW * pListView = reinterpret_cast<NMLISTVIEW*>(pNMHDR);
+	*pResult = 0;
+
+	//only interested in rows becoming selected, not deselected
+	if (!(pListView->uChanged & LVIF_STATE) || !(pListView->uNewState & LVIS_SELECTED))
+		return;
+
+	const std::vector<int> & results = m_searchIndex.GetResults();
+	if (pListView->iItem < 0 || pListView->iItem >= (int)results.size() || results[pListView->iItem] >= m_sceneGraph->Size())
+		return;
+
+	*m_currentSelection = m_sceneGraph->GetID(results[pListView->iItem]);
+}
 
-	*m_currentSelection = _ttoi(currentSelectionValue);
+void SelectDialogue::GetItemText(NMHDR * pNMHDR, LRESULT * pResult)
+{
+	NMLVDISPINFO * pDispInfo = reinterpret_cast<NMLVDISPINFO*>(pNMHDR);
+	LVITEM & item = pDispInfo->item;
+	*pResult = 0;
+
+	const std::vector<int> & results = m_searchIndex.GetResults();
+	if (!(item.mask & LVIF_TEXT) || item.iItem < 0 || item.iItem >= (int)results.size() || results[item.iItem] >= m_sceneGraph->Size())
+		return;
 
+	int row = results[item.iItem];
+	CString text;
+	switch (item.iSubItem)
+	{
+	case 0:	text.Format(_T("%d"), m_sceneGraph->GetID(row));		break;
+	case 1:	text = CString(m_sceneGraph->GetName(row).c_str());		break;
+	case 2:	text = CString(StringTable::AssetPaths().Lookup(m_sceneGraph->GetRender(row).model_path).c_str());	break;
+	}
+	_tcsncpy_s(item.pszText, item.cchTextMax, text, _TRUNCATE);
+}
+
+void SelectDialogue::Search()
+{
+	CString query;
+	m_searchBox.GetWindowText(query);
+
+	m_searchIndex.Query(std::string(CStringA(query)));
+	m_listBox.SetItemCountEx((int)m_searchIndex.GetResults().size());
+	m_listBox.Invalidate();
 }
 
 BOOL SelectDialogue::OnInitDialog()
 {
 	CDialogEx::OnInitDialog();
 
+	m_listBox.SetExtendedStyle(LVS_EX_FULLROWSELECT);
+	m_listBox.InsertColumn(0, _T("ID"), LVCFMT_LEFT, 50);
+	m_listBox.InsertColumn(1, _T("Name"), LVCFMT_LEFT, 90);
+	m_listBox.InsertColumn(2, _T("Model"), LVCFMT_LEFT, 200);
+
 	//uncomment for modal only
 /*	//roll through all the objects in the scene graph and put an entry for each in the listbox
-	int numSceneObjects = m_sceneGraph->size();
+	int numSceneObjects = m_sceneGraph->Size();
 	for (size_t i = 0; i < numSceneObjects; i++)
 	{
 		//easily possible to make the data string presented more complex. showing other columns.
-		std::wstring listBoxEntry = std::to_wstring(m_sceneGraph->at(i).ID);
+		std::wstring listBoxEntry = std::to_wstring(m_sceneGraph->GetID(i));
 		m_listBox.AddString(listBoxEntry.c_str());
 	}*/
 	
@@ -2,7 +2,8 @@
 #include "afxdialogex.h"
 #include "resource.h"
 #include "afxwin.h"
-#include "SceneObject.h"
+#include "Scene.h"
+#include "ObjectSearchIndex.h"
 #include <vector>
 
 // SelectDialogue dialog
@@ -12,10 +13,10 @@ class SelectDialogue : public CDialogEx
 	DECLARE_DYNAMIC(SelectDialogue)
 
 public:
-	SelectDialogue(CWnd* pParent, std::vector<SceneObject>* SceneGraph);   // modal // takes in out scenegraph in the constructor
+	SelectDialogue(CWnd* pParent, Scene* SceneGraph);   // modal // takes in out scenegraph in the constructor
 	SelectDialogue(CWnd* pParent = NULL);
 	virtual ~SelectDialogue();
-	void SetObjectData(std::vector<SceneObject>* SceneGraph, int * Selection);	//passing in pointers to the data the class will operate on.
+	void SetObjectData(Scene* SceneGraph, int * Selection);	//passing in pointers to the data the class will operate on.
 	
 // Dialog Data
 #ifdef AFX_DESIGN_TIME
@@ -25,16 +26,20 @@ public:
 protected:
 	virtual void DoDataExchange(CDataExchange* pDX);    // DDX/DDV support
 	afx_msg void End();		//kill the dialogue
-	afx_msg void Select();	//Item has been selected
+	afx_msg void Select(NMHDR * pNMHDR, LRESULT * pResult);			//Item has been selected
+	afx_msg void GetItemText(NMHDR * pNMHDR, LRESULT * pResult);	//the list asking for the text of a visible row
+	afx_msg void Search();											//search box text has changed
 
-	std::vector<SceneObject> * m_sceneGraph;
+	Scene * m_sceneGraph;
 	int * m_currentSelection;
+	ObjectSearchIndex m_searchIndex;	//the list only ever shows the rows of the current search result
 	
 
 	DECLARE_MESSAGE_MAP()
 public:
-	// Control variable for more efficient access of the listbox
-	CListBox m_listBox;
+	// Control variable for more efficient access of the list. owner data, so it holds no strings of its own
+	CListCtrl m_listBox;
+	CEdit m_searchBox;
 	virtual BOOL OnInitDialog() override;
 	virtual void PostNcDestroy();
 	afx_msg void OnBnClickedOk();
@@ -0,0 +1,299 @@
+#include "SelectionSet.h"
+#include "SceneJournal.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <sstream>
+
+using namespace DirectX;
+
+namespace
+{
+	const int GRAIN = 4096;		//transforms per ParallelFor chunk
+}
+
+SelectionSet::SelectionSet()
+{
+}
+
+SelectionSet::~SelectionSet()
+{
+}
+
+void SelectionSet::SetBit(int ID, bool on)
+{
+	if (ID / 64 >= (int)m_bits.size())
+	{
+		if (!on)
+		{
+			return;
+		}
+		m_bits.resize(ID / 64 + 1, 0);
+	}
+	if (on)
+	{
+		m_bits[ID / 64] |= (uint64_t)1 << (ID % 64);
+	}
+	else
+	{
+		m_bits[ID / 64] &= ~((uint64_t)1 << (ID % 64));
+	}
+}
+
+void SelectionSet::Clear()
+{
+	//only the words that have bits in them, so clearing a small selection in a big level stays cheap
+	for (size_t i = 0; i < m_IDs.size(); i++)
+	{
+		m_bits[m_IDs[i] / 64] = 0;
+	}
+	m_IDs.clear();
+}
+
+void SelectionSet::Select(int ID)
+{
+	Clear();
+	Add(ID);
+}
+
+void SelectionSet::Add(int ID)
+{
+	if (ID < 0 || Contains(ID))
+	{
+		return;
+	}
+	SetBit(ID, true);
+	m_IDs.insert(std::lower_bound(m_IDs.begin(), m_IDs.end(), ID), ID);
+}
+
+void SelectionSet::Remove(int ID)
+{
+	if (!Contains(ID))
+	{
+		return;
+	}
+	SetBit(ID, false);
+	m_IDs.erase(std::lower_bound(m_IDs.begin(), m_IDs.end(), ID));
+}
+
+void SelectionSet::Toggle(int ID)
+{
+	if (Contains(ID))
+	{
+		Remove(ID);
+	}
+	else
+	{
+		Add(ID);
+	}
+}
+
+void SelectionSet::Assign(const std::vector<int> & IDs)
+{
+	//one sort for the lot rather than an insert each
+	Clear();
+	for (size_t i = 0; i < IDs.size(); i++)
+	{
+		if (IDs[i] >= 0 && !Contains(IDs[i]))
+		{
+			SetBit(IDs[i], true);
+			m_IDs.push_back(IDs[i]);
+		}
+	}
+	std::sort(m_IDs.begin(), m_IDs.end());
+}
+
+SelectionTransform SelectionTransform::Translate(const XMFLOAT3 & translation)
+{
+	SelectionTransform transform;
+	transform.kind = TRANSLATE;
+	transform.translation = translation;
+	transform.pivot = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	transform.yawDegrees = 0.0f;
+	transform.scale = 1.0f;
+	return transform;
+}
+
+SelectionTransform SelectionTransform::Rotate(const XMFLOAT3 & pivot, float yawDegrees)
+{
+	SelectionTransform transform = Translate(XMFLOAT3(0.0f, 0.0f, 0.0f));
+	transform.kind = ROTATE;
+	transform.pivot = pivot;
+	transform.yawDegrees = yawDegrees;
+	return transform;
+}
+
+SelectionTransform SelectionTransform::Scale(const XMFLOAT3 & pivot, float scale)
+{
+	SelectionTransform transform = Translate(XMFLOAT3(0.0f, 0.0f, 0.0f));
+	transform.kind = SCALE;
+	transform.pivot = pivot;
+	transform.scale = scale;
+	return transform;
+}
+
+void SelectionTransform::Apply(TransformComponent * transforms, int count) const
+{
+	//each kind is its own straight loop with nothing to decide per object
+	switch (kind)
+	{
+	case TRANSLATE:
+		for (int i = 0; i < count; i++)
+		{
+			transforms[i].posX += translation.x;
+			transforms[i].posY += translation.y;
+			transforms[i].posZ += translation.z;
+		}
+		break;
+
+	case ROTATE:
+	{
+		//yaw is applied last when objects are drawn, so turning about world y is adding to it. the offset from the
+		//pivot turns the same way the yaw does, x' = x cos + z sin, z' = z cos - x sin
+		float radians = XMConvertToRadians(yawDegrees);
+		float c = cosf(radians), s = sinf(radians);
+		for (int i = 0; i < count; i++)
+		{
+			float x = transforms[i].posX - pivot.x, z = transforms[i].posZ - pivot.z;
+			transforms[i].posX = pivot.x + x * c + z * s;
+			transforms[i].posZ = pivot.z + z * c - x * s;
+			transforms[i].rotY += yawDegrees;
+		}
+		break;
+	}
+
+	case SCALE:
+		for (int i = 0; i < count; i++)
+		{
+			transforms[i].posX = pivot.x + (transforms[i].posX - pivot.x) * scale;
+			transforms[i].posY = pivot.y + (transforms[i].posY - pivot.y) * scale;
+			transforms[i].posZ = pivot.z + (transforms[i].posZ - pivot.z) * scale;
+			transforms[i].scaX *= scale;
+			transforms[i].scaY *= scale;
+			transforms[i].scaZ *= scale;
+		}
+		break;
+	}
+}
+
+//half a level selected and moved, turned and scaled. once as the tool does it now - one pass over the selection and one
+//batched change per edit - and once an object and a change at a time, the way single object drags are journalled
+std::string SelectionSet::Benchmark(int objects, int selected)
+{
+	selected = std::min(selected, objects);
+	Scene batchedScene;
+	batchedScene.Reserve(objects);
+	StringHandle model = StringTable::AssetPaths().Intern("database/data/placeholder.cmo");
+	for (int i = 0; i < objects; i++)
+	{
+		SceneObject object;
+		object.ID = i + 1;
+		object.name = "Name";
+		object.model_path = model;
+		object.posX = (float)(i % 200);
+		object.posZ = (float)(i / 200);
+		object.scaX = object.scaY = object.scaZ = 1.0f;
+		batchedScene.Add(object);
+	}
+	Scene singleScene = batchedScene;
+	std::vector<TransformComponent> original(objects);
+	for (int row = 0; row < objects; row++)
+	{
+		original[row] = batchedScene.GetTransform(row);
+	}
+
+	//a marquee hands the IDs over in display list order
+	std::vector<int> picked(objects);
+	for (int i = 0; i < objects; i++)
+	{
+		picked[i] = i + 1;
+	}
+	std::mt19937 random(7);
+	std::shuffle(picked.begin(), picked.end(), random);
+	picked.resize(selected);
+
+	auto selectStart = std::chrono::high_resolution_clock::now();
+	SelectionSet selection;
+	selection.Assign(picked);
+	auto selectEnd = std::chrono::high_resolution_clock::now();
+	bool correct = selection.Size() == selected && std::is_sorted(selection.IDs().begin(), selection.IDs().end());
+	for (int ID = 0; ID <= objects + 64; ID++)
+	{
+		correct = correct && selection.Contains(ID) == std::binary_search(selection.IDs().begin(), selection.IDs().end(), ID);
+	}
+
+	SelectionTransform edits[3] = {
+		SelectionTransform::Translate(XMFLOAT3(3.0f, 0.5f, -2.0f)),
+		SelectionTransform::Rotate(XMFLOAT3(100.0f, 0.0f, 25.0f), 30.0f),
+		SelectionTransform::Scale(XMFLOAT3(100.0f, 0.0f, 25.0f), 1.5f) };
+
+	SceneJournal batchedJournal, singleJournal;
+	batchedJournal.SetBudget((size_t)1 << 30);
+	singleJournal.SetBudget((size_t)1 << 30);
+	double batchedMs = 0.0, singleMs = 0.0;
+	for (int e = 0; e < 3; e++)
+	{
+		auto batchedStart = std::chrono::high_resolution_clock::now();
+		std::shared_ptr<std::vector<int>> IDs = std::make_shared<std::vector<int>>(selection.IDs());
+		std::shared_ptr<std::vector<TransformComponent>> transforms = std::make_shared<std::vector<TransformComponent>>(selected);
+		ParallelFor(selected, GRAIN, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+			{
+				(*transforms)[i] = batchedScene.GetTransform(batchedScene.Find((*IDs)[i]));
+			}
+			edits[e].Apply(&(*transforms)[begin], end - begin);
+		});
+		SceneChange change(SCENE_OBJECTS_TRANSFORMED, 0);
+		change.IDs = IDs;
+		change.transforms = transforms;
+		batchedJournal.Record(change, batchedScene);
+		SceneJournal::Apply(change, batchedScene);
+		batchedJournal.EndEdit();
+		batchedMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - batchedStart).count();
+
+		auto singleStart = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < selected; i++)
+		{
+			int ID = selection.IDs()[i];
+			TransformComponent transform = singleScene.GetTransform(singleScene.Find(ID));
+			edits[e].Apply(&transform, 1);
+			SceneChange change(SCENE_OBJECT_TRANSFORMED, ID);
+			change.object.posX = transform.posX;	change.object.posY = transform.posY;	change.object.posZ = transform.posZ;
+			change.object.rotX = transform.rotX;	change.object.rotY = transform.rotY;	change.object.rotZ = transform.rotZ;
+			change.object.scaX = transform.scaX;	change.object.scaY = transform.scaY;	change.object.scaZ = transform.scaZ;
+			singleJournal.Record(change, singleScene);
+			SceneJournal::Apply(change, singleScene);
+		}
+		singleJournal.EndEdit();
+		singleMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - singleStart).count();
+	}
+
+	//both ways land in the same place, and three undos - one per edit - take the batched scene back to the start
+	for (int row = 0; row < objects; row++)
+	{
+		int other = singleScene.Find(batchedScene.GetID(row));
+		correct = correct && memcmp(&batchedScene.GetTransform(row), &singleScene.GetTransform(other), sizeof(TransformComponent)) == 0;
+	}
+	std::vector<SceneChange> applied;
+	int undos = 0;
+	while (batchedJournal.Undo(batchedScene, applied))
+	{
+		undos++;
+	}
+	for (int row = 0; row < objects; row++)
+	{
+		correct = correct && memcmp(&batchedScene.GetTransform(row), &original[row], sizeof(TransformComponent)) == 0;
+	}
+	correct = correct && undos == 3;
+
+	std::ostringstream report;
+	report << "Selection, " << selected << " of " << objects << " objects: select " << std::chrono::duration<double, std::milli>(selectEnd - selectStart).count()
+		<< " ms, move + turn + scale batched " << batchedMs / 3.0 << " ms an edit, an object at a time " << singleMs / 3.0 << " ms an edit"
+		<< (correct ? "" : " (BATCH WRONG)") << "\n";
+	return report.str();
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Scene.h"
+#include <DirectXMath.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//the objects selected in the editor, by database ID. the IDs are kept sorted, for walking the selection in a stable order,
+//and as a bitset indexed by ID, so asking whether one object is selected - which the hierarchy and picking do per object -
+//is a single bit test however big the selection is.
+
+class SelectionSet
+{
+public:
+	SelectionSet();
+	~SelectionSet();
+
+	void	Clear();
+	void	Select(int ID);				//just this object, -1 selects nothing
+	void	Add(int ID);
+	void	Remove(int ID);
+	void	Toggle(int ID);
+	void	Assign(const std::vector<int> & IDs);		//replaces the selection, any order, duplicates are fine
+
+	bool	Contains(int ID) const { return ID >= 0 && ID / 64 < (int)m_bits.size() && (m_bits[ID / 64] >> (ID % 64) & 1) != 0; }
+	bool	Empty() const { return m_IDs.empty(); }
+	int		Size() const { return (int)m_IDs.size(); }
+	int		Front() const { return m_IDs.empty() ? -1 : m_IDs.front(); }
+	const std::vector<int> & IDs() const { return m_IDs; }		//ascending
+
+	static std::string Benchmark(int objects, int selected);
+
+private:
+	void	SetBit(int ID, bool on);
+
+	std::vector<int>		m_IDs;
+	std::vector<uint64_t>	m_bits;
+};
+
+//one edit applied to every object in a selection - a move, or a turn about the world y axis or a uniform scale about a
+//pivot. positions, the pivot and the move are in world space
+struct SelectionTransform
+{
+	enum Kind
+	{
+		TRANSLATE,
+		ROTATE,
+		SCALE
+	};
+
+	Kind				kind;
+	DirectX::XMFLOAT3	translation;	//TRANSLATE
+	DirectX::XMFLOAT3	pivot;			//ROTATE and SCALE
+	float				yawDegrees;		//ROTATE
+	float				scale;			//SCALE
+
+	static SelectionTransform	Translate(const DirectX::XMFLOAT3 & translation);
+	static SelectionTransform	Rotate(const DirectX::XMFLOAT3 & pivot, float yawDegrees);
+	static SelectionTransform	Scale(const DirectX::XMFLOAT3 & pivot, float scale);
+
+	void	Apply(TransformComponent * transforms, int count) const;
+};
@@ -0,0 +1,165 @@
+#include "StringTable.h"
+#include <chrono>
+#include <cstring>
+#include <sstream>
+
+
+StringTable::StringTable()
+{
+	m_strings.push_back("");
+	m_buckets.resize(64, 0);
+}
+
+
+StringTable::~StringTable()
+{
+}
+
+StringTable & StringTable::AssetPaths()
+{
+	static StringTable assetPaths;
+	return assetPaths;
+}
+
+unsigned int StringTable::Hash(const char * text, size_t length)
+{
+	//FNV-1a
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < length; i++)
+	{
+		hash ^= (unsigned char)text[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+StringHandle StringTable::Intern(const char * text)
+{
+	if (text == NULL)
+	{
+		return 0;
+	}
+	return Intern(text, strlen(text));
+}
+
+StringHandle StringTable::Intern(const char * text, size_t length)
+{
+	if (length == 0)
+	{
+		return 0;
+	}
+
+	size_t mask = m_buckets.size() - 1;
+	size_t bucket = Hash(text, length) & mask;
+
+	//linear probe until we find the string or an empty bucket
+	while (m_buckets[bucket] != 0)
+	{
+		const std::string & candidate = m_strings[m_buckets[bucket]];
+		if (candidate.size() == length && memcmp(candidate.data(), text, length) == 0)
+		{
+			return m_buckets[bucket];
+		}
+		bucket = (bucket + 1) & mask;
+	}
+
+	StringHandle handle = (StringHandle)m_strings.size();
+	m_strings.push_back(std::string(text, length));
+	m_buckets[bucket] = handle;
+
+	//keep the table at most half full so probes stay short
+	if (m_strings.size() * 2 > m_buckets.size())
+	{
+		Grow();
+	}
+
+	return handle;
+}
+
+void StringTable::Grow()
+{
+	m_buckets.assign(m_buckets.size() * 2, 0);
+	size_t mask = m_buckets.size() - 1;
+
+	for (StringHandle handle = 1; handle < m_strings.size(); handle++)
+	{
+		size_t bucket = Hash(m_strings[handle].data(), m_strings[handle].size()) & mask;
+		while (m_buckets[bucket] != 0)
+		{
+			bucket = (bucket + 1) & mask;
+		}
+		m_buckets[bucket] = handle;
+	}
+}
+
+size_t StringTable::MemoryUsage() const
+{
+	size_t bytes = m_strings.capacity() * sizeof(std::string) + m_buckets.capacity() * sizeof(StringHandle);
+	for (size_t i = 0; i < m_strings.size(); i++)
+	{
+		bytes += m_strings[i].capacity() + 1;
+	}
+	return bytes;
+}
+
+//builds a synthetic level's worth of the four asset path columns, once as a std::string per field (how SceneObject
+//used to hold them) and once as handles into a table, and reports the time and memory of each
+std::string StringTable::Benchmark(int rows)
+{
+	const int distinctPaths = 40;
+	std::vector<std::string> source;
+	for (int i = 0; i < distinctPaths; i++)
+	{
+		source.push_back("database/data/props/prop_" + std::to_string(i) + ".cmo");
+	}
+
+	struct StringRow { std::string model, texture, collision, audio; };
+	struct HandleRow { StringHandle model, texture, collision, audio; };
+
+	auto stringStart = std::chrono::high_resolution_clock::now();
+	std::vector<StringRow> stringRows(rows);
+	for (int i = 0; i < rows; i++)
+	{
+		//constructing from the raw text, as a sqlite column read would
+		stringRows[i].model = source[i % distinctPaths].c_str();
+		stringRows[i].texture = source[(i * 7) % distinctPaths].c_str();
+		stringRows[i].collision = source[(i * 3) % distinctPaths].c_str();
+		stringRows[i].audio = source[(i * 11) % distinctPaths].c_str();
+	}
+	auto stringEnd = std::chrono::high_resolution_clock::now();
+
+	size_t stringBytes = stringRows.capacity() * sizeof(StringRow);
+	for (int i = 0; i < rows; i++)
+	{
+		const std::string * fields[4] = { &stringRows[i].model, &stringRows[i].texture, &stringRows[i].collision, &stringRows[i].audio };
+		for (int f = 0; f < 4; f++)
+		{
+			//short strings live inside the std::string itself, only longer ones cost a heap block
+			if (fields[f]->capacity() >= sizeof(std::string))
+			{
+				stringBytes += fields[f]->capacity() + 1;
+			}
+		}
+	}
+
+	auto handleStart = std::chrono::high_resolution_clock::now();
+	StringTable table;
+	std::vector<HandleRow> handleRows(rows);
+	for (int i = 0; i < rows; i++)
+	{
+		handleRows[i].model = table.Intern(source[i % distinctPaths].c_str());
+		handleRows[i].texture = table.Intern(source[(i * 7) % distinctPaths].c_str());
+		handleRows[i].collision = table.Intern(source[(i * 3) % distinctPaths].c_str());
+		handleRows[i].audio = table.Intern(source[(i * 11) % distinctPaths].c_str());
+	}
+	auto handleEnd = std::chrono::high_resolution_clock::now();
+
+	size_t handleBytes = handleRows.capacity() * sizeof(HandleRow) + table.MemoryUsage();
+
+	std::stringstream report;
+	report << "Asset paths, " << rows << " rows: strings " << stringBytes / 1024 << " KB "
+		<< std::chrono::duration<double, std::milli>(stringEnd - stringStart).count() << " ms, "
+		<< "interned " << handleBytes / 1024 << " KB "
+		<< std::chrono::duration<double, std::milli>(handleEnd - handleStart).count() << " ms\n";
+	return report.str();
+}
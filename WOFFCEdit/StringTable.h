@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+//interned strings.  asset paths repeat across thousands of objects, so each distinct path is stored once and
+//objects hold a 32 bit handle to it.  equal handles mean equal strings, so caches and comparisons can use the handle alone.
+//handle 0 is always the empty string.  not thread safe - intern on the main thread and hand handles out from there.
+
+typedef unsigned int StringHandle;
+
+class StringTable
+{
+public:
+	StringTable();
+	~StringTable();
+
+	StringHandle		Intern(const char * text, size_t length);	//does not allocate if the string is already in the table
+	StringHandle		Intern(const char * text);
+	StringHandle		Intern(const std::string & text) { return Intern(text.c_str(), text.size()); }
+	const std::string &	Lookup(StringHandle handle) const { return m_strings[handle]; }
+	size_t				Size() const { return m_strings.size(); }
+	size_t				MemoryUsage() const;
+
+	static StringTable &	AssetPaths();						//the table shared by every scene object and display object
+	static std::string		Benchmark(int rows);				//memory and load time of per-row strings against handles
+
+private:
+	static unsigned int Hash(const char * text, size_t length);
+	void	Grow();
+
+	std::vector<std::string>	m_strings;		//handle -> string
+	std::vector<StringHandle>	m_buckets;		//open addressed hash of the strings, 0 marks an empty bucket (the empty string is never hashed)
+};
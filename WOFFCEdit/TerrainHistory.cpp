@@ -0,0 +1,314 @@
+#include "TerrainHistory.h"
+#include "HeightmapGenerator.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+namespace
+{
+	const size_t	DEFAULT_BUDGET = 64 * 1024 * 1024;
+
+	double MicrosecondsSince(std::chrono::high_resolution_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+TerrainHistory::TerrainHistory()
+{
+	m_resolution = 0;
+	m_tileSize = 1;
+	m_tilesX = 0;
+	m_position = 0;
+	m_bytes = 0;
+	m_budget = DEFAULT_BUDGET;
+	m_lastOperation = "nothing";
+	m_lastBytes = 0;
+	m_lastMicroseconds = 0.0;
+	m_evicted = 0;
+}
+
+TerrainHistory::~TerrainHistory()
+{
+}
+
+void TerrainHistory::Reset(const float * heights, int resolution, int tileSize)
+{
+	m_resolution = resolution;
+	m_tileSize = std::max(tileSize, 1);
+	m_tilesX = (resolution + m_tileSize - 1) / m_tileSize;
+	m_current.resize(m_tilesX * m_tilesX);
+	for (int tile = 0; tile < (int)m_current.size(); tile++)
+	{
+		m_current[tile] = Snapshot(heights, tile);
+	}
+	m_touched.assign(m_current.size(), false);
+	m_touchedList.clear();
+	m_strokes.clear();
+	m_position = 0;
+	m_bytes = 0;
+	m_changed.clear();
+}
+
+void TerrainHistory::TileRect(int tile, int & x0, int & z0, int & x1, int & z1) const
+{
+	x0 = (tile % m_tilesX) * m_tileSize;
+	z0 = (tile / m_tilesX) * m_tileSize;
+	x1 = std::min(x0 + m_tileSize, m_resolution);
+	z1 = std::min(z0 + m_tileSize, m_resolution);
+}
+
+TerrainHistory::TileData TerrainHistory::Snapshot(const float * heights, int tile) const
+{
+	int x0, z0, x1, z1;
+	TileRect(tile, x0, z0, x1, z1);
+	std::shared_ptr<std::vector<float>> data = std::make_shared<std::vector<float>>((x1 - x0) * (z1 - z0));
+	for (int z = z0; z < z1; z++)
+	{
+		memcpy(&(*data)[(z - z0) * (x1 - x0)], heights + (size_t)z * m_resolution + x0, (x1 - x0) * sizeof(float));
+	}
+	return data;
+}
+
+bool TerrainHistory::Matches(const float * heights, int tile, const std::vector<float> & data) const
+{
+	int x0, z0, x1, z1;
+	TileRect(tile, x0, z0, x1, z1);
+	for (int z = z0; z < z1; z++)
+	{
+		if (memcmp(&data[(z - z0) * (x1 - x0)], heights + (size_t)z * m_resolution + x0, (x1 - x0) * sizeof(float)) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void TerrainHistory::Touch(int x0, int z0, int x1, int z1)
+{
+	if (IsEmpty())
+	{
+		return;
+	}
+	int tileX0 = std::max(x0, 0) / m_tileSize;
+	int tileZ0 = std::max(z0, 0) / m_tileSize;
+	int tileX1 = (std::min(x1, m_resolution) - 1) / m_tileSize;
+	int tileZ1 = (std::min(z1, m_resolution) - 1) / m_tileSize;
+	for (int tileZ = tileZ0; tileZ <= tileZ1; tileZ++)
+	{
+		for (int tileX = tileX0; tileX <= tileX1; tileX++)
+		{
+			int tile = tileZ * m_tilesX + tileX;
+			if (!m_touched[tile])
+			{
+				m_touched[tile] = true;
+				m_touchedList.push_back(tile);
+			}
+		}
+	}
+}
+
+void TerrainHistory::TouchAll()
+{
+	Touch(0, 0, m_resolution, m_resolution);
+}
+
+bool TerrainHistory::Commit(const float * heights)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	Stroke stroke;
+	stroke.bytes = 0;
+	m_changed.clear();
+
+	//tiles come out in index order, so undo and redo walk memory the same way whatever order the brush went in
+	std::sort(m_touchedList.begin(), m_touchedList.end());
+	for (size_t i = 0; i < m_touchedList.size(); i++)
+	{
+		int tile = m_touchedList[i];
+		m_touched[tile] = false;
+		if (Matches(heights, tile, *m_current[tile]))
+		{
+			continue;
+		}
+		TileChange change;
+		change.tile = tile;
+		change.before = m_current[tile];
+		change.after = Snapshot(heights, tile);
+		stroke.bytes += change.after->size() * sizeof(float);
+		m_current[tile] = change.after;
+		stroke.changes.push_back(change);
+		m_changed.push_back(tile);
+	}
+	m_touchedList.clear();
+
+	m_lastOperation = "stroke";
+	m_lastBytes = stroke.bytes;
+	m_evicted = 0;
+	if (stroke.changes.empty())
+	{
+		m_lastMicroseconds = MicrosecondsSince(start);
+		return false;
+	}
+
+	//a new stroke ends the redo
+	for (size_t i = m_position; i < m_strokes.size(); i++)
+	{
+		m_bytes -= m_strokes[i].bytes;
+	}
+	m_strokes.resize(m_position);
+	m_strokes.push_back(stroke);
+	m_position++;
+	m_bytes += stroke.bytes;
+	Evict();
+	m_lastMicroseconds = MicrosecondsSince(start);
+	return true;
+}
+
+void TerrainHistory::Evict()
+{
+	//the newest stroke stays even over budget, so the edit just made can always be undone
+	size_t oldest = 0;
+	while (m_bytes > m_budget && oldest + 1 < m_strokes.size() && (int)oldest + 1 < m_position)
+	{
+		m_bytes -= m_strokes[oldest].bytes;
+		oldest++;
+	}
+	if (oldest > 0)
+	{
+		m_strokes.erase(m_strokes.begin(), m_strokes.begin() + oldest);
+		m_position -= (int)oldest;
+		m_evicted = (int)oldest;
+	}
+}
+
+void TerrainHistory::Apply(const Stroke & stroke, bool forward, float * heights)
+{
+	m_changed.clear();
+	for (size_t i = 0; i < stroke.changes.size(); i++)
+	{
+		const TileChange & change = stroke.changes[i];
+		const TileData & data = forward ? change.after : change.before;
+		int x0, z0, x1, z1;
+		TileRect(change.tile, x0, z0, x1, z1);
+		for (int z = z0; z < z1; z++)
+		{
+			memcpy(heights + (size_t)z * m_resolution + x0, &(*data)[(z - z0) * (x1 - x0)], (x1 - x0) * sizeof(float));
+		}
+		m_current[change.tile] = data;
+		m_changed.push_back(change.tile);
+	}
+	m_lastBytes = 0;
+	m_evicted = 0;
+}
+
+bool TerrainHistory::Undo(float * heights)
+{
+	if (!CanUndo())
+	{
+		return false;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	m_position--;
+	Apply(m_strokes[m_position], false, heights);
+	m_lastOperation = "undo";
+	m_lastMicroseconds = MicrosecondsSince(start);
+	return true;
+}
+
+bool TerrainHistory::Redo(float * heights)
+{
+	if (!CanRedo())
+	{
+		return false;
+	}
+	auto start = std::chrono::high_resolution_clock::now();
+	Apply(m_strokes[m_position], true, heights);
+	m_position++;
+	m_lastOperation = "redo";
+	m_lastMicroseconds = MicrosecondsSince(start);
+	return true;
+}
+
+std::string TerrainHistory::Report() const
+{
+	std::ostringstream report;
+	report << "Terrain " << m_lastOperation << ": " << m_changed.size() << " tiles";
+	if (m_lastBytes)
+	{
+		report << ", " << m_lastBytes / 1024.0 << " KB";
+	}
+	report << " in " << m_lastMicroseconds << " us. history " << m_bytes / 1024.0 << " KB in " << m_strokes.size()
+		<< " strokes, " << m_position << " to undo";
+	if (m_evicted)
+	{
+		report << ", " << m_evicted << " oldest dropped for the budget";
+	}
+	report << "\n";
+	return report.str();
+}
+
+std::string TerrainHistory::Benchmark(int resolution, int strokes)
+{
+	std::vector<float> heights((size_t)resolution * resolution);
+	HeightmapGenerator::Generate(HeightmapSettings(), resolution, heights.data());
+	std::vector<float> original = heights;
+
+	TerrainHistory history;
+	history.SetBudget((size_t)1 << 30);
+	auto resetStart = std::chrono::high_resolution_clock::now();
+	history.Reset(heights.data(), resolution, 64);
+	double resetMs = MicrosecondsSince(resetStart) / 1000.0;
+
+	//round brushes dragged a short way, like a sculpting stroke
+	std::mt19937 random(1);
+	const int radius = 40;
+	double commitUs = 0.0;
+	size_t strokeBytes = 0;
+	for (int stroke = 0; stroke < strokes; stroke++)
+	{
+		int centreX = radius + (int)(random() % (unsigned)std::max(resolution - 2 * radius, 1));
+		int centreZ = radius + (int)(random() % (unsigned)std::max(resolution - 2 * radius, 1));
+		for (int dab = 0; dab < 10; dab++, centreX = std::min(centreX + 4, resolution - 1))
+		{
+			for (int z = std::max(centreZ - radius, 0); z < std::min(centreZ + radius, resolution); z++)
+			{
+				for (int x = std::max(centreX - radius, 0); x < std::min(centreX + radius, resolution); x++)
+				{
+					int dx = x - centreX, dz = z - centreZ;
+					if (dx * dx + dz * dz < radius * radius)
+					{
+						heights[(size_t)z * resolution + x] += 0.01f;
+					}
+				}
+			}
+			history.Touch(centreX - radius, centreZ - radius, centreX + radius, centreZ + radius);
+		}
+		history.Commit(heights.data());
+		commitUs += history.m_lastMicroseconds;
+		strokeBytes += history.m_lastBytes;
+	}
+	std::vector<float> edited = heights;
+	size_t held = history.m_bytes;
+
+	double undoUs = 0.0, worstUndoUs = 0.0;
+	while (history.Undo(heights.data()))
+	{
+		undoUs += history.m_lastMicroseconds;
+		worstUndoUs = std::max(worstUndoUs, history.m_lastMicroseconds);
+	}
+	bool restored = heights == original;
+	while (history.Redo(heights.data()))
+	{
+	}
+	bool replayed = heights == edited;
+
+	std::ostringstream report;
+	report << "Terrain history, " << resolution << " x " << resolution << " in 64 sample tiles: snapshot " << resetMs << " ms, "
+		<< strokes << " strokes averaging " << strokeBytes / 1024.0 / std::max(strokes, 1) << " KB and "
+		<< commitUs / std::max(strokes, 1) << " us to commit, undo " << undoUs / std::max(strokes, 1) << " us average, "
+		<< worstUndoUs << " us worst, " << held / (1024.0 * 1024.0) << " MB held"
+		<< (restored && replayed ? "" : " (UNDO BROKEN)") << "\n";
+	return report.str();
+}
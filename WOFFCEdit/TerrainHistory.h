@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+//undo and redo for the terrain heights. the field is cut into square tiles, and every version of a tile is an immutable
+//block shared by everything that refers to it - the current state, and the before and after of each stroke.
+//a stroke only copies the tiles it actually changed, the before side is just the block that was current, so memory
+//and undo time both go with the tiles changed, not the size of the terrain. past the memory budget the oldest strokes
+//are forgotten first.
+
+class TerrainHistory
+{
+public:
+	TerrainHistory();
+	~TerrainHistory();
+
+	//forgets all history and takes heights, resolution x resolution row by row, as the starting state
+	void Reset(const float * heights, int resolution, int tileSize);
+	void SetBudget(size_t bytes)	{ m_budget = bytes; }
+
+	//marks samples [x0, x1) x [z0, z1) as possibly changed by the stroke in progress
+	void Touch(int x0, int z0, int x1, int z1);
+	void TouchAll();
+	//ends the stroke, snapshotting the touched tiles that really changed. false when nothing did
+	bool Commit(const float * heights);
+
+	//write the tiles of the stroke being undone or redone into heights, false when there is nothing to do
+	bool Undo(float * heights);
+	bool Redo(float * heights);
+	bool CanUndo() const	{ return m_position > 0; }
+	bool CanRedo() const	{ return m_position < (int)m_strokes.size(); }
+
+	const std::vector<int> & Changed() const	{ return m_changed; }	//tiles changed by the last commit, undo or redo
+	void TileRect(int tile, int & x0, int & z0, int & x1, int & z1) const;
+	bool IsEmpty() const	{ return m_current.empty(); }
+
+	std::string Report() const;		//cost of the last commit, undo or redo, and the memory held
+	static std::string Benchmark(int resolution, int strokes);
+
+private:
+	typedef std::shared_ptr<const std::vector<float>> TileData;
+
+	struct TileChange
+	{
+		int			tile;
+		TileData	before, after;
+	};
+
+	struct Stroke
+	{
+		std::vector<TileChange>	changes;
+		size_t					bytes;		//the after blocks, which the stroke made
+	};
+
+	TileData Snapshot(const float * heights, int tile) const;
+	bool Matches(const float * heights, int tile, const std::vector<float> & data) const;
+	void Apply(const Stroke & stroke, bool forward, float * heights);
+	void Evict();
+
+	int						m_resolution;
+	int						m_tileSize;
+	int						m_tilesX;
+	std::vector<TileData>	m_current;		//per tile, the block matching the heights as of the last commit, undo or redo
+	std::vector<bool>		m_touched;
+	std::vector<int>		m_touchedList;
+	std::vector<Stroke>		m_strokes;		//oldest first, the ones from m_position on are redo
+	int						m_position;
+	size_t					m_bytes;		//held by the strokes
+	size_t					m_budget;
+	std::vector<int>		m_changed;
+
+	//instrumentation, for the last operation
+	const char *			m_lastOperation;
+	size_t					m_lastBytes;
+	double					m_lastMicroseconds;
+	int						m_evicted;
+};
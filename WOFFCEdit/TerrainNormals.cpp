@@ -0,0 +1,155 @@
+#include "TerrainNormals.h"
+#include "HeightmapGenerator.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const int	ROWS_PER_TASK = 32;
+
+	//one sample, the plain way - used for the edge columns, and as the reference the vector version is timed against
+	void ReferenceNormal(const float * heights, int resolution, float spacing, int x, int z, XMFLOAT3 & normal, XMFLOAT3 * tangent)
+	{
+		int left = std::max(x - 1, 0);
+		int right = std::min(x + 1, resolution - 1);
+		int down = std::max(z - 1, 0);
+		int up = std::min(z + 1, resolution - 1);
+		float slopeX = right > left ? (heights[z * resolution + right] - heights[z * resolution + left]) / ((right - left) * spacing) : 0.0f;
+		float slopeZ = up > down ? (heights[up * resolution + x] - heights[down * resolution + x]) / ((up - down) * spacing) : 0.0f;
+
+		float length = sqrtf(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+		normal = XMFLOAT3(-slopeX / length, 1.0f / length, -slopeZ / length);
+		if (tangent)
+		{
+			float tangentLength = sqrtf(1.0f + slopeX * slopeX);
+			*tangent = XMFLOAT3(1.0f / tangentLength, slopeX / tangentLength, 0.0f);
+		}
+	}
+
+	void GenerateRows(const float * heights, int resolution, float spacing, int begin, int end, XMFLOAT3 * normals, XMFLOAT3 * tangents)
+	{
+		const XMVECTOR one = XMVectorReplicate(1.0f);
+		const XMVECTOR inverseAcross = XMVectorReplicate(1.0f / (2.0f * spacing));
+		for (int z = begin; z < end; z++)
+		{
+			int up = std::min(z + 1, resolution - 1);
+			int down = std::max(z - 1, 0);
+			const float * row = heights + (size_t)z * resolution;
+			const float * upRow = heights + (size_t)up * resolution;
+			const float * downRow = heights + (size_t)down * resolution;
+			const XMVECTOR inverseAlong = XMVectorReplicate(up > down ? 1.0f / ((up - down) * spacing) : 0.0f);
+			XMFLOAT3 * normalRow = normals + (size_t)z * resolution;
+			XMFLOAT3 * tangentRow = tangents ? tangents + (size_t)z * resolution : NULL;
+
+			ReferenceNormal(heights, resolution, spacing, 0, z, normalRow[0], tangentRow);
+
+			//inner columns, where both neighbours exist, four at a time
+			int x = 1;
+			for (; x + 4 < resolution; x += 4)
+			{
+				XMVECTOR left = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x - 1));
+				XMVECTOR right = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(row + x + 1));
+				XMVECTOR above = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(upRow + x));
+				XMVECTOR below = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(downRow + x));
+				XMVECTOR slopeX = (right - left) * inverseAcross;
+				XMVECTOR slopeZ = (above - below) * inverseAlong;
+
+				XMVECTOR inverseLength = one / XMVectorSqrt(XMVectorMultiplyAdd(slopeX, slopeX, XMVectorMultiplyAdd(slopeZ, slopeZ, one)));
+				XMFLOAT4 normalX, normalY, normalZ;
+				XMStoreFloat4(&normalX, -slopeX * inverseLength);
+				XMStoreFloat4(&normalY, inverseLength);
+				XMStoreFloat4(&normalZ, -slopeZ * inverseLength);
+				normalRow[x] = XMFLOAT3(normalX.x, normalY.x, normalZ.x);
+				normalRow[x + 1] = XMFLOAT3(normalX.y, normalY.y, normalZ.y);
+				normalRow[x + 2] = XMFLOAT3(normalX.z, normalY.z, normalZ.z);
+				normalRow[x + 3] = XMFLOAT3(normalX.w, normalY.w, normalZ.w);
+
+				if (tangentRow)
+				{
+					XMVECTOR inverseTangentLength = one / XMVectorSqrt(XMVectorMultiplyAdd(slopeX, slopeX, one));
+					XMFLOAT4 tangentX, tangentY;
+					XMStoreFloat4(&tangentX, inverseTangentLength);
+					XMStoreFloat4(&tangentY, slopeX * inverseTangentLength);
+					tangentRow[x] = XMFLOAT3(tangentX.x, tangentY.x, 0.0f);
+					tangentRow[x + 1] = XMFLOAT3(tangentX.y, tangentY.y, 0.0f);
+					tangentRow[x + 2] = XMFLOAT3(tangentX.z, tangentY.z, 0.0f);
+					tangentRow[x + 3] = XMFLOAT3(tangentX.w, tangentY.w, 0.0f);
+				}
+			}
+			for (; x < resolution; x++)
+			{
+				ReferenceNormal(heights, resolution, spacing, x, z, normalRow[x], tangentRow ? tangentRow + x : NULL);
+			}
+		}
+	}
+}
+
+void TerrainNormals::Generate(const float * heights, int resolution, float spacing, XMFLOAT3 * normals, XMFLOAT3 * tangents)
+{
+	if (resolution < 1)
+	{
+		return;
+	}
+	ParallelFor(resolution, ROWS_PER_TASK, [&](int begin, int end)
+	{
+		GenerateRows(heights, resolution, spacing, begin, end, normals, tangents);
+	});
+}
+
+std::string TerrainNormals::Benchmark(int resolution)
+{
+	const float spacing = 4.0f;
+	size_t samples = (size_t)resolution * resolution;
+	std::vector<float> heights(samples);
+	HeightmapGenerator::Generate(HeightmapSettings(), resolution, heights.data());
+	for (size_t i = 0; i < samples; i++)
+	{
+		heights[i] *= 64.0f;
+	}
+	std::vector<XMFLOAT3> normals(samples), tangents(samples);
+
+	//best of a few, the first run also pays for faulting the outputs in
+	double bestMs = 1e30;
+	for (int run = 0; run < 5; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		Generate(heights.data(), resolution, spacing, normals.data(), tangents.data());
+		auto end = std::chrono::high_resolution_clock::now();
+		bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	std::vector<XMFLOAT3> referenceNormals(samples), referenceTangents(samples);
+	auto referenceStart = std::chrono::high_resolution_clock::now();
+	for (int z = 0; z < resolution; z++)
+	{
+		for (int x = 0; x < resolution; x++)
+		{
+			size_t i = (size_t)z * resolution + x;
+			ReferenceNormal(heights.data(), resolution, spacing, x, z, referenceNormals[i], &referenceTangents[i]);
+		}
+	}
+	auto referenceEnd = std::chrono::high_resolution_clock::now();
+	double referenceMs = std::chrono::duration<double, std::milli>(referenceEnd - referenceStart).count();
+
+	float worst = 0.0f;
+	for (size_t i = 0; i < samples; i++)
+	{
+		worst = std::max(worst, fabsf(normals[i].x - referenceNormals[i].x));
+		worst = std::max(worst, fabsf(normals[i].y - referenceNormals[i].y));
+		worst = std::max(worst, fabsf(normals[i].z - referenceNormals[i].z));
+		worst = std::max(worst, fabsf(tangents[i].x - referenceTangents[i].x));
+		worst = std::max(worst, fabsf(tangents[i].y - referenceTangents[i].y));
+		worst = std::max(worst, fabsf(tangents[i].z - referenceTangents[i].z));
+	}
+
+	std::ostringstream report;
+	report << "Terrain normals and tangents, " << resolution << " x " << resolution << " on " << ParallelWorkerCount()
+		<< " threads: " << bestMs << " ms, scalar reference " << referenceMs << " ms, largest difference " << worst << "\n";
+	return report.str();
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+
+//normals and tangents of a square heightfield, from central differences of the heights around each sample.
+//along the edges the missing neighbour is clamped to the sample itself, so every sample gets a normal, including the
+//first and last rows and columns. rows are split across the ParallelFor workers and the inner columns go four at a time.
+
+class TerrainNormals
+{
+public:
+	//heights row by row, resolution x resolution, spacing between samples. tangents point along +x and may be NULL
+	static void Generate(const float * heights, int resolution, float spacing, DirectX::XMFLOAT3 * normals, DirectX::XMFLOAT3 * tangents);
+
+	static std::string Benchmark(int resolution);	//times a field of this size against a plain scalar version
+};
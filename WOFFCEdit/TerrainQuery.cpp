@@ -0,0 +1,329 @@
+#include "TerrainQuery.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <sstream>
+
+using namespace DirectX;
+
+
+TerrainQuery::TerrainQuery()
+{
+	m_resolution = 0;
+	m_originX = 0.0f;
+	m_originZ = 0.0f;
+	m_invSpacing = 1.0f;
+}
+
+
+TerrainQuery::~TerrainQuery()
+{
+}
+
+void TerrainQuery::Build(const float * heights, int resolution, float originX, float originZ, float spacing)
+{
+	m_heights.assign(heights, heights + resolution * resolution);
+	m_resolution = resolution;
+	m_originX = originX;
+	m_originZ = originZ;
+	m_invSpacing = 1.0f / spacing;
+}
+
+void TerrainQuery::Locate(float x, float z, int & cell, float & fx, float & fz) const
+{
+	float last = (float)(m_resolution - 1);
+	float gx = std::min(std::max((x - m_originX) * m_invSpacing, 0.0f), last);
+	float gz = std::min(std::max((z - m_originZ) * m_invSpacing, 0.0f), last);
+
+	//the far edge belongs to the last cell, with a fraction of 1
+	int cx = std::min((int)gx, m_resolution - 2);
+	int cz = std::min((int)gz, m_resolution - 2);
+	fx = gx - cx;
+	fz = gz - cz;
+	cell = cz * m_resolution + cx;
+}
+
+float TerrainQuery::GetHeight(float x, float z) const
+{
+	if (IsEmpty())
+	{
+		return 0.0f;
+	}
+
+	int cell;
+	float fx, fz;
+	Locate(x, z, cell, fx, fz);
+
+	const float * row0 = &m_heights[cell];
+	const float * row1 = row0 + m_resolution;
+	float nearHeight = row0[0] + (row0[1] - row0[0]) * fx;
+	float farHeight = row1[0] + (row1[1] - row1[0]) * fx;
+	return nearHeight + (farHeight - nearHeight) * fz;
+}
+
+XMFLOAT3 TerrainQuery::GetNormal(float x, float z) const
+{
+	if (IsEmpty())
+	{
+		return XMFLOAT3(0.0f, 1.0f, 0.0f);
+	}
+
+	int cell;
+	float fx, fz;
+	Locate(x, z, cell, fx, fz);
+
+	//slope of the bilinear surface along each axis at this point
+	const float * row0 = &m_heights[cell];
+	const float * row1 = row0 + m_resolution;
+	float slopeX = ((row0[1] - row0[0]) + ((row1[1] - row1[0]) - (row0[1] - row0[0])) * fz) * m_invSpacing;
+	float slopeZ = ((row1[0] - row0[0]) + ((row1[1] - row0[1]) - (row1[0] - row0[0])) * fx) * m_invSpacing;
+
+	XMFLOAT3 normal;
+	XMStoreFloat3(&normal, XMVector3Normalize(XMVectorSet(-slopeX, 1.0f, -slopeZ, 0.0f)));
+	return normal;
+}
+
+bool TerrainQuery::Raycast(const XMFLOAT3 & origin, const XMFLOAT3 & direction, float maxDistance, float & distance) const
+{
+	if (IsEmpty())
+	{
+		return false;
+	}
+
+	//clip against the x and z extent of the terrain, outside it there is nothing to hit
+	float size = Size();
+	const float rayOrigin[2] = { origin.x, origin.z };
+	const float rayDirection[2] = { direction.x, direction.z };
+	const float low[2] = { m_originX, m_originZ };
+	float start = 0.0f;
+	float end = maxDistance;
+	for (int axis = 0; axis < 2; axis++)
+	{
+		if (fabsf(rayDirection[axis]) < 1e-8f)
+		{
+			if (rayOrigin[axis] < low[axis] || rayOrigin[axis] > low[axis] + size)
+			{
+				return false;
+			}
+			continue;
+		}
+
+		float enter = (low[axis] - rayOrigin[axis]) / rayDirection[axis];
+		float leave = (low[axis] + size - rayOrigin[axis]) / rayDirection[axis];
+		if (enter > leave)
+		{
+			std::swap(enter, leave);
+		}
+		start = std::max(start, enter);
+		end = std::min(end, leave);
+	}
+	if (start > end)
+	{
+		return false;
+	}
+
+	//height of the ray above the surface at distance t
+	auto clearance = [&](float t)
+	{
+		return origin.y + direction.y * t - GetHeight(origin.x + direction.x * t, origin.z + direction.z * t);
+	};
+
+	float step = 0.25f / m_invSpacing;
+	float previousT = start;
+	float previous = clearance(start);
+	while (previousT < end)
+	{
+		float t = std::min(previousT + step, end);
+		float current = clearance(t);
+		if (previous > 0.0f && current <= 0.0f)
+		{
+			float above = previousT;
+			float below = t;
+			for (int i = 0; i < 16; i++)
+			{
+				float middle = (above + below) * 0.5f;
+				if (clearance(middle) > 0.0f)
+				{
+					above = middle;
+				}
+				else
+				{
+					below = middle;
+				}
+			}
+			distance = below;
+			return true;
+		}
+		previousT = t;
+		previous = current;
+	}
+	return false;
+}
+
+void TerrainQuery::GetHeights(const float * x, const float * z, float * heights, int count) const
+{
+	GetBatch(x, z, heights, NULL, count);
+}
+
+void TerrainQuery::GetHeightsAndNormals(const float * x, const float * z, float * heights, XMFLOAT3 * normals, int count) const
+{
+	GetBatch(x, z, heights, normals, count);
+}
+
+void TerrainQuery::GetBatch(const float * x, const float * z, float * heights, XMFLOAT3 * normals, int count) const
+{
+	if (IsEmpty())
+	{
+		for (int i = 0; i < count; i++)
+		{
+			heights[i] = 0.0f;
+			if (normals)
+			{
+				normals[i] = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			}
+		}
+		return;
+	}
+
+	const XMVECTOR origin4X = XMVectorReplicate(m_originX);
+	const XMVECTOR origin4Z = XMVectorReplicate(m_originZ);
+	const XMVECTOR invSpacing4 = XMVectorReplicate(m_invSpacing);
+	const XMVECTOR zero4 = XMVectorZero();
+	const XMVECTOR last4 = XMVectorReplicate((float)(m_resolution - 1));
+	const XMVECTOR lastCell4 = XMVectorReplicate((float)(m_resolution - 2));
+	const XMVECTOR one4 = XMVectorReplicate(1.0f);
+
+	//four points per pass, the same maths as Locate / GetHeight / GetNormal with one point per lane
+	int i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		XMVECTOR gx = XMVectorClamp((XMVectorSet(x[i], x[i + 1], x[i + 2], x[i + 3]) - origin4X) * invSpacing4, zero4, last4);
+		XMVECTOR gz = XMVectorClamp((XMVectorSet(z[i], z[i + 1], z[i + 2], z[i + 3]) - origin4Z) * invSpacing4, zero4, last4);
+		XMVECTOR cx = XMVectorMin(XMVectorFloor(gx), lastCell4);
+		XMVECTOR cz = XMVectorMin(XMVectorFloor(gz), lastCell4);
+		XMVECTOR fx = gx - cx;
+		XMVECTOR fz = gz - cz;
+
+		//the samples are scattered through the heightfield, so they are fetched one lane at a time
+		XMFLOAT4 cellX, cellZ;
+		XMStoreFloat4(&cellX, cx);
+		XMStoreFloat4(&cellZ, cz);
+		const float * cellX4 = &cellX.x;
+		const float * cellZ4 = &cellZ.x;
+		float h00[4], h10[4], h01[4], h11[4];
+		for (int lane = 0; lane < 4; lane++)
+		{
+			const float * row0 = &m_heights[(int)cellZ4[lane] * m_resolution + (int)cellX4[lane]];
+			const float * row1 = row0 + m_resolution;
+			h00[lane] = row0[0];	h10[lane] = row0[1];
+			h01[lane] = row1[0];	h11[lane] = row1[1];
+		}
+		XMVECTOR v00 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(h00));
+		XMVECTOR v10 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(h10));
+		XMVECTOR v01 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(h01));
+		XMVECTOR v11 = XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(h11));
+
+		XMVECTOR alongNear = v10 - v00;
+		XMVECTOR alongFar = v11 - v01;
+		XMVECTOR nearHeight = XMVectorMultiplyAdd(alongNear, fx, v00);
+		XMVECTOR farHeight = XMVectorMultiplyAdd(alongFar, fx, v01);
+		XMVECTOR height = XMVectorMultiplyAdd(farHeight - nearHeight, fz, nearHeight);
+
+		XMFLOAT4 height4;
+		XMStoreFloat4(&height4, height);
+		heights[i] = height4.x;	heights[i + 1] = height4.y;	heights[i + 2] = height4.z;	heights[i + 3] = height4.w;
+
+		if (normals)
+		{
+			//normals are kept as three vectors of x, y and z so four of them normalise together
+			XMVECTOR slopeX = XMVectorMultiplyAdd(alongFar - alongNear, fz, alongNear) * invSpacing4;
+			XMVECTOR acrossNear = v01 - v00;
+			XMVECTOR acrossFar = v11 - v10;
+			XMVECTOR slopeZ = XMVectorMultiplyAdd(acrossFar - acrossNear, fx, acrossNear) * invSpacing4;
+
+			XMVECTOR inverseLength = XMVectorReciprocalSqrt(XMVectorMultiplyAdd(slopeX, slopeX, XMVectorMultiplyAdd(slopeZ, slopeZ, one4)));
+			XMFLOAT4 normalX, normalY, normalZ;
+			XMStoreFloat4(&normalX, -slopeX * inverseLength);
+			XMStoreFloat4(&normalY, inverseLength);
+			XMStoreFloat4(&normalZ, -slopeZ * inverseLength);
+			normals[i]		= XMFLOAT3(normalX.x, normalY.x, normalZ.x);
+			normals[i + 1]	= XMFLOAT3(normalX.y, normalY.y, normalZ.y);
+			normals[i + 2]	= XMFLOAT3(normalX.z, normalY.z, normalZ.z);
+			normals[i + 3]	= XMFLOAT3(normalX.w, normalY.w, normalZ.w);
+		}
+	}
+
+	for (; i < count; i++)
+	{
+		heights[i] = GetHeight(x[i], z[i]);
+		if (normals)
+		{
+			normals[i] = GetNormal(x[i], z[i]);
+		}
+	}
+}
+
+//a 128 square rolling heightfield the size of the editor's terrain, queried at random points
+std::string TerrainQuery::Benchmark(int queries)
+{
+	const int resolution = 128;
+	const float spacing = 4.0f;
+	std::vector<float> heightfield(resolution * resolution);
+	for (int row = 0; row < resolution; row++)
+	{
+		for (int column = 0; column < resolution; column++)
+		{
+			heightfield[row * resolution + column] = 32.0f + 16.0f * sinf(column * 0.1f) * cosf(row * 0.13f);
+		}
+	}
+
+	TerrainQuery query;
+	query.Build(heightfield.data(), resolution, -256.0f, -256.0f, spacing);
+
+	std::mt19937 random(1234);
+	std::uniform_real_distribution<float> position(-256.0f, 252.0f);
+	std::vector<float> x(queries), z(queries), heights(queries), single(queries);
+	std::vector<XMFLOAT3> normals(queries);
+	for (int i = 0; i < queries; i++)
+	{
+		x[i] = position(random);
+		z[i] = position(random);
+	}
+
+	auto singleStart = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < queries; i++)
+	{
+		single[i] = query.GetHeight(x[i], z[i]);
+	}
+	auto singleEnd = std::chrono::high_resolution_clock::now();
+
+	auto batchStart = std::chrono::high_resolution_clock::now();
+	query.GetHeights(x.data(), z.data(), heights.data(), queries);
+	auto batchEnd = std::chrono::high_resolution_clock::now();
+
+	auto parallelStart = std::chrono::high_resolution_clock::now();
+	ParallelFor(queries, 16384, [&](int begin, int end)
+	{
+		query.GetHeightsAndNormals(&x[begin], &z[begin], &heights[begin], &normals[begin], end - begin);
+	});
+	auto parallelEnd = std::chrono::high_resolution_clock::now();
+
+	float worstError = 0.0f;
+	for (int i = 0; i < queries; i++)
+	{
+		worstError = std::max(worstError, fabsf(heights[i] - single[i]));
+	}
+
+	auto rate = [queries](std::chrono::high_resolution_clock::duration time)
+	{
+		return queries / std::max(std::chrono::duration<double>(time).count(), 1e-9) / 1000000.0;
+	};
+
+	std::stringstream report;
+	report << "Terrain queries, " << queries << " points: single " << rate(singleEnd - singleStart) << " M/s, batched "
+		<< rate(batchEnd - batchStart) << " M/s, batched with normals on " << ParallelWorkerCount() << " threads "
+		<< rate(parallelEnd - parallelStart) << " M/s" << (worstError < 0.001f ? "" : " (MISMATCH)") << "\n";
+	return report.str();
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+//height and normal lookups at any XZ on the terrain, bilinear between the four surrounding heightfield samples.
+//holds its own copy of the heights so the renderer's vertex array can change underneath it - Build again after sculpting.
+//points off the edge of the terrain are clamped to the edge.
+//the batch calls work on four points at a time in SIMD registers, and are safe to call from several threads at once.
+
+class TerrainQuery
+{
+public:
+	TerrainQuery();
+	~TerrainQuery();
+
+	//heights[row * resolution + column], row runs along z and column along x, sample (0,0) at originX, originZ
+	void	Build(const float * heights, int resolution, float originX, float originZ, float spacing);
+	bool	IsEmpty() const { return m_resolution < 2; }
+	float	MinX() const { return m_originX; }
+	float	MinZ() const { return m_originZ; }
+	float	Size() const { return (m_resolution - 1) / m_invSpacing; }	//width and depth covered by the samples
+
+	float				GetHeight(float x, float z) const;
+	DirectX::XMFLOAT3	GetNormal(float x, float z) const;
+
+	//distance along the ray to where it first passes from above the surface to below it, within maxDistance.
+	//direction must be normalised. the ray is stepped a quarter of a cell at a time and the crossing refined by bisection
+	bool	Raycast(const DirectX::XMFLOAT3 & origin, const DirectX::XMFLOAT3 & direction, float maxDistance, float & distance) const;
+
+	void	GetHeights(const float * x, const float * z, float * heights, int count) const;
+	void	GetHeightsAndNormals(const float * x, const float * z, float * heights, DirectX::XMFLOAT3 * normals, int count) const;
+
+	static std::string Benchmark(int queries);		//queries per second one at a time, batched, and batched across the worker threads
+
+private:
+	//cell and position inside it for one point, shared by the single point calls
+	void	Locate(float x, float z, int & cell, float & fx, float & fz) const;
+	void	GetBatch(const float * x, const float * z, float * heights, DirectX::XMFLOAT3 * normals, int count) const;
+
+	std::vector<float>	m_heights;
+	int					m_resolution;
+	float				m_originX, m_originZ;
+	float				m_invSpacing;
+};
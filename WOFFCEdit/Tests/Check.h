@@ -0,0 +1,9 @@
+#pragma once
+
+//the checks of the test run. a check that fails prints where it is and what it tested, and the run carries on so one
+//failure doesn't hide the next. main returns 1 when any check failed, so a script or build step running the tests
+//sees the regression.
+
+#define CHECK(condition) CheckResult((condition), #condition, __FILE__, __LINE__)
+
+bool	CheckResult(bool passed, const char * condition, const char * file, int line);	//passed, after counting it
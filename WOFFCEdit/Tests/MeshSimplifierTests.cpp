@@ -0,0 +1,170 @@
+#include "Check.h"
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	//the rolling heightfield grid of MeshSimplifier::Benchmark, n x n quads a unit apart
+	void BuildGrid(int n, ImportedMesh & mesh)
+	{
+		for (int z = 0; z <= n; z++)
+		{
+			for (int x = 0; x <= n; x++)
+			{
+				CmoVertex vertex;
+				memset(&vertex, 0, sizeof(vertex));
+				vertex.position[0] = (float)x;
+				vertex.position[1] = sinf(x * 0.05f) * cosf(z * 0.07f) * 6.0f + sinf(x * 0.31f + z * 0.17f) * 0.5f;
+				vertex.position[2] = (float)z;
+				vertex.normal[1] = 1.0f;
+				vertex.tangent[0] = vertex.tangent[3] = 1.0f;
+				vertex.color = 0xffffffff;
+				vertex.uv[0] = (float)x / n;
+				vertex.uv[1] = (float)z / n;
+				mesh.vertices.push_back(vertex);
+			}
+		}
+		for (int z = 0; z < n; z++)
+		{
+			for (int x = 0; x < n; x++)
+			{
+				uint32_t a = z * (n + 1) + x, b = a + 1, c = a + n + 2, d = a + n + 1;
+				uint32_t quad[6] = { a, c, b, a, d, c };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+	}
+
+	//the heightfield under (x, z) of a mesh made from a grid, by brute force over a bucket grid
+	class HeightfieldSampler
+	{
+	public:
+		HeightfieldSampler(const ImportedMesh & mesh, float extent, int buckets) : m_mesh(mesh), m_extent(extent), m_buckets(buckets)
+		{
+			m_cells.resize((size_t)buckets * buckets);
+			for (size_t t = 0; t < mesh.indices.size() / 3; t++)
+			{
+				float minimum[2] = { FLT_MAX, FLT_MAX }, maximum[2] = { -FLT_MAX, -FLT_MAX };
+				for (int k = 0; k < 3; k++)
+				{
+					const float * p = mesh.vertices[mesh.indices[t * 3 + k]].position;
+					minimum[0] = std::min(minimum[0], p[0]);	maximum[0] = std::max(maximum[0], p[0]);
+					minimum[1] = std::min(minimum[1], p[2]);	maximum[1] = std::max(maximum[1], p[2]);
+				}
+				for (int z = Cell(minimum[1]); z <= Cell(maximum[1]); z++)
+				{
+					for (int x = Cell(minimum[0]); x <= Cell(maximum[0]); x++)
+					{
+						m_cells[(size_t)z * m_buckets + x].push_back((uint32_t)t);
+					}
+				}
+			}
+		}
+
+		bool Height(float x, float z, float & height) const
+		{
+			const std::vector<uint32_t> & cell = m_cells[(size_t)Cell(z) * m_buckets + Cell(x)];
+			for (size_t i = 0; i < cell.size(); i++)
+			{
+				const float * a = m_mesh.vertices[m_mesh.indices[cell[i] * 3]].position;
+				const float * b = m_mesh.vertices[m_mesh.indices[cell[i] * 3 + 1]].position;
+				const float * c = m_mesh.vertices[m_mesh.indices[cell[i] * 3 + 2]].position;
+				float area = (b[0] - a[0]) * (c[2] - a[2]) - (c[0] - a[0]) * (b[2] - a[2]);
+				if (fabsf(area) < 1e-12f)
+				{
+					continue;
+				}
+				float u = ((b[0] - x) * (c[2] - z) - (c[0] - x) * (b[2] - z)) / area;
+				float v = ((c[0] - x) * (a[2] - z) - (a[0] - x) * (c[2] - z)) / area;
+				float w = 1.0f - u - v;
+				const float epsilon = -1e-5f;
+				if (u >= epsilon && v >= epsilon && w >= epsilon)
+				{
+					height = u * a[1] + v * b[1] + w * c[1];
+					return true;
+				}
+			}
+			return false;
+		}
+
+	private:
+		int Cell(float coordinate) const
+		{
+			return std::min(std::max((int)(coordinate / m_extent * m_buckets), 0), m_buckets - 1);
+		}
+
+		const ImportedMesh &					m_mesh;
+		float									m_extent;
+		int										m_buckets;
+		std::vector<std::vector<uint32_t>>		m_cells;
+	};
+
+	bool IndicesValid(const ImportedMesh & mesh)
+	{
+		bool valid = mesh.indices.size() % 3 == 0;
+		for (size_t i = 0; i < mesh.indices.size(); i++)
+		{
+			valid &= mesh.indices[i] < mesh.vertices.size();
+		}
+		return valid;
+	}
+}
+
+void MeshSimplifierTests()
+{
+	const int GRIDS[] = { 64, 128 };
+	for (int grid : GRIDS)
+	{
+		ImportedMesh mesh;
+		BuildGrid(grid, mesh);
+		size_t triangles = mesh.indices.size() / 3;
+
+		//every budget is met, with no error bound in the way
+		const float fractions[] = { 0.5f, 0.25f, 0.1f, 0.05f };
+		for (float fraction : fractions)
+		{
+			size_t target = (size_t)(triangles * fraction);
+			ImportedMesh simplified;
+			MeshSimplifier::Simplify(mesh, target, FLT_MAX, simplified);
+			if (!CHECK(simplified.indices.size() / 3 <= target))
+			{
+				printf("  grid %d: %zu triangles for a budget of %zu\n", grid, simplified.indices.size() / 3, target);
+			}
+			CHECK(IndicesValid(simplified));
+		}
+
+		//with no budget, the simplified surface stays within the bound of every original vertex, and covers them all
+		const float bound = 0.25f;
+		ImportedMesh bounded;
+		float error = MeshSimplifier::Simplify(mesh, 0, bound, bounded);
+		CHECK(error <= bound);
+		CHECK(IndicesValid(bounded));
+		CHECK(bounded.indices.size() < mesh.indices.size());
+		HeightfieldSampler sampler(bounded, (float)grid, 64);
+		float worst = 0.0f;
+		bool covered = true;
+		for (size_t v = 0; v < mesh.vertices.size(); v++)
+		{
+			const float * p = mesh.vertices[v].position;
+			float height;
+			if (sampler.Height(p[0], p[2], height))
+			{
+				worst = std::max(worst, fabsf(height - p[1]));
+			}
+			else
+			{
+				covered = false;
+			}
+		}
+		CHECK(covered);
+		if (!CHECK(worst <= bound))
+		{
+			printf("  grid %d: %g from the original with a bound of %g\n", grid, worst, bound);
+		}
+	}
+}
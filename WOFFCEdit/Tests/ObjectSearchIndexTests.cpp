@@ -0,0 +1,89 @@
+#include "Check.h"
+#include "ObjectSearchIndex.h"
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+	std::string Lower(const std::string & text)
+	{
+		std::string lower = text;
+		for (size_t i = 0; i < lower.size(); i++)
+		{
+			lower[i] = (char)tolower((unsigned char)lower[i]);
+		}
+		return lower;
+	}
+
+	//what the index has to find, by looking at every row - the rows with the query, ignoring case, inside their ID,
+	//their name or their model path
+	std::vector<int> Scan(const Scene & scene, const std::string & text)
+	{
+		std::string query = Lower(text);
+		std::vector<int> rows;
+		for (int row = 0; row < scene.Size(); row++)
+		{
+			const std::string fields[] = { std::to_string(scene.GetID(row)), Lower(scene.GetName(row)),
+				Lower(StringTable::AssetPaths().Lookup(scene.GetRender(row).model_path)) };
+			for (const std::string & field : fields)
+			{
+				if (field.find(query) != std::string::npos)
+				{
+					rows.push_back(row);
+					break;
+				}
+			}
+		}
+		return rows;
+	}
+
+	void CheckQueries(ObjectSearchIndex & index, const Scene & scene, const char * const * queries, int count)
+	{
+		for (int q = 0; q < count; q++)
+		{
+			if (!CHECK(index.Query(queries[q]) == Scan(scene, queries[q])))
+			{
+				printf("  query \"%s\"\n", queries[q]);
+			}
+			CHECK(index.GetResults() == Scan(scene, queries[q]));
+		}
+	}
+}
+
+void ObjectSearchIndexTests()
+{
+	const char * names[] = { "Tree", "Rock", "House", "Fence", "Lamp Post", "Crate" };
+	const char * models[] = { "tree", "rock", "house", "fence", "lamp", "crate" };
+	Scene scene;
+	for (int i = 0; i < 5000; i++)
+	{
+		SceneObject object;
+		object.ID = i + 1;
+		object.name = std::string(names[i % 6]) + "_" + std::to_string(i % 97);
+		object.model_path = StringTable::AssetPaths().Intern("database/data/" + std::string(models[(i / 6) % 6]) + std::to_string(i % 13) + ".cmo");
+		scene.Add(object);
+	}
+	ObjectSearchIndex index;
+	index.Build(scene);
+
+	//typed a character at a time, where each query only re-checks the last results, then backspaced and retyped
+	const char * typed[] = { "r", "ro", "roc", "rock", "rock_", "rock_4", "rock_42", "rock_4", "rock", "rocks", "" };
+	CheckQueries(index, scene, typed, sizeof(typed) / sizeof(typed[0]));
+
+	//fresh searches - mixed case, one and two characters, an ID, a path, misses, and text spanning two fields
+	const char * fresh[] = { "HOUSE", "lamp p", "LaMp PoSt_1", "fence_9", "data/crate1", ".cmo", "12", "4999", "7", "zzz",
+		"1tree", "_96database", "e", "" };
+	CheckQueries(index, scene, fresh, sizeof(fresh) / sizeof(fresh[0]));
+
+	//after rows are removed and the index rebuilt, the last query is forgotten and the rows are the new ones
+	index.Query("tree");
+	for (int id = 1; id <= 5000; id += 7)
+	{
+		scene.Remove(id);
+	}
+	index.Build(scene);
+	const char * rebuilt[] = { "tree", "tree_1", "", "8" };
+	CheckQueries(index, scene, rebuilt, sizeof(rebuilt) / sizeof(rebuilt[0]));
+}
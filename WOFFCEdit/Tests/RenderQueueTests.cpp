@@ -0,0 +1,126 @@
+#include "Check.h"
+#include "RenderQueue.h"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+namespace
+{
+	//the order the radix sort has to give - by key, and packets with equal keys in the order they were added
+	std::vector<RenderPacket> StableSorted(std::vector<RenderPacket> packets)
+	{
+		std::stable_sort(packets.begin(), packets.end(), [](const RenderPacket & a, const RenderPacket & b) { return a.key < b.key; });
+		return packets;
+	}
+
+	bool SamePackets(const std::vector<RenderPacket> & a, const std::vector<RenderPacket> & b)
+	{
+		bool same = a.size() == b.size();
+		for (size_t i = 0; same && i < a.size(); i++)
+		{
+			same = a[i].key == b[i].key && a[i].item == b[i].item;
+		}
+		return same;
+	}
+
+	void CheckKeys()
+	{
+		//each field outranks everything below it, whatever the lower fields hold
+		CHECK(RenderQueue::MakeKey(0, 15, 4095, 1048575, 16777215) < RenderQueue::MakeKey(1, 0, 0, 0, 0));
+		CHECK(RenderQueue::MakeKey(0, 0, 4095, 1048575, 16777215) < RenderQueue::MakeKey(0, 1, 0, 0, 0));
+		CHECK(RenderQueue::MakeKey(0, 0, 0, 1048575, 16777215) < RenderQueue::MakeKey(0, 0, 1, 0, 0));
+		CHECK(RenderQueue::MakeKey(0, 0, 0, 0, 16777215) < RenderQueue::MakeKey(0, 0, 0, 1, 0));
+		CHECK(RenderQueue::MakeKey(0, 0, 0, 0, 0) < RenderQueue::MakeKey(0, 0, 0, 0, 1));
+
+		//the pass comes back out, and an ID too wide for its field wraps without reaching the next one up
+		for (int pass = 0; pass < RENDER_PASSES; pass++)
+		{
+			CHECK(RenderQueue::KeyPass(RenderQueue::MakeKey(pass, 15, 4095, 1048575, 16777215)) == pass);
+		}
+		CHECK(RenderQueue::MakeKey(0, 3, 7, 9, (1u << 24) + 5) == RenderQueue::MakeKey(0, 3, 7, 9, 5));
+		CHECK(RenderQueue::MakeKey(0, 3, 7, (1u << 20) + 9, 5) == RenderQueue::MakeKey(0, 3, 7, 9, 5));
+		CHECK(RenderQueue::MakeKey(0, 3, (1u << 12) + 7, 9, 5) == RenderQueue::MakeKey(0, 3, 7, 9, 5));
+
+		//depth buckets double from a metre out, near first, or far first for alpha
+		CHECK(RenderQueue::DepthBucket(0.5f, false) == 0);
+		CHECK(RenderQueue::DepthBucket(1e9f, false) == 15);
+		CHECK(RenderQueue::DepthBucket(3.0f, false) < RenderQueue::DepthBucket(30.0f, false));
+		CHECK(RenderQueue::DepthBucket(3.0f, true) > RenderQueue::DepthBucket(30.0f, true));
+		bool ordered = true;
+		for (float depth = 0.1f; depth < 1e6f; depth *= 1.3f)
+		{
+			ordered &= RenderQueue::DepthBucket(depth, false) <= RenderQueue::DepthBucket(depth * 1.3f, false);
+			ordered &= RenderQueue::DepthBucket(depth, false) + RenderQueue::DepthBucket(depth, true) == 15;
+		}
+		CHECK(ordered);
+	}
+
+	void CheckStateIDs()
+	{
+		char states[3];
+		RenderQueue queue;
+		CHECK(queue.StateID(RENDER_STATE_TEXTURE, &states[0]) == 0);
+		CHECK(queue.StateID(RENDER_STATE_TEXTURE, &states[1]) == 1);
+		CHECK(queue.StateID(RENDER_STATE_TEXTURE, &states[0]) == 0);
+		CHECK(queue.StateID(RENDER_STATE_MESH, &states[2]) == 0);		//each kind counts on its own
+		queue.Clear();
+		CHECK(queue.StateID(RENDER_STATE_TEXTURE, &states[1]) == 0);
+	}
+
+	void CheckSort()
+	{
+		//random keys, keys that only differ in the top or bottom byte, and all the same key, at sizes from empty up
+		std::mt19937 random(5);
+		const int SIZES[] = { 0, 1, 2, 17, 1000, 100000 };
+		for (int size : SIZES)
+		{
+			for (int shape = 0; shape < 4; shape++)
+			{
+				RenderQueue queue;
+				std::uniform_int_distribution<int> pickPass(0, RENDER_PASSES - 1), pickDepth(0, 15), pickSmall(0, 3);
+				for (int i = 0; i < size; i++)
+				{
+					uint64_t key = 0;
+					switch (shape)
+					{
+					case 0:	key = RenderQueue::MakeKey(pickPass(random), pickDepth(random), random(), random(), random());	break;
+					case 1:	key = RenderQueue::MakeKey(pickPass(random), 0, 0, 0, 0);											break;
+					case 2:	key = RenderQueue::MakeKey(0, 0, 0, 0, pickSmall(random));											break;
+					case 3:	key = RenderQueue::MakeKey(1, 2, 3, 4, 5);															break;
+					}
+					queue.Add(key, (uint32_t)i);
+				}
+				std::vector<RenderPacket> expected = StableSorted(queue.Packets());
+				RenderStateChanges before = RenderQueue::CountChanges(queue.Packets());
+				queue.Sort();
+				if (!CHECK(SamePackets(queue.Packets(), expected)))
+				{
+					printf("  %d packets, key shape %d\n", size, shape);
+				}
+				CHECK(RenderQueue::CountChanges(queue.Packets()).Total() <= before.Total());
+			}
+		}
+	}
+
+	void CheckChanges()
+	{
+		//the first packet sets every part of the state, after that only what differs counts
+		std::vector<RenderPacket> packets(4);
+		packets[0].key = RenderQueue::MakeKey(0, 0, 1, 1, 1);
+		packets[1].key = RenderQueue::MakeKey(0, 0, 1, 1, 2);
+		packets[2].key = RenderQueue::MakeKey(0, 0, 1, 2, 2);
+		packets[3].key = RenderQueue::MakeKey(1, 0, 2, 2, 2);
+		RenderStateChanges changes = RenderQueue::CountChanges(packets);
+		CHECK(changes.passes == 2 && changes.shaders == 2 && changes.textures == 2 && changes.meshes == 2);
+		CHECK(RenderQueue::CountChanges(std::vector<RenderPacket>()).Total() == 0);
+	}
+}
+
+void RenderQueueTests()
+{
+	CheckKeys();
+	CheckStateIDs();
+	CheckSort();
+	CheckChanges();
+}
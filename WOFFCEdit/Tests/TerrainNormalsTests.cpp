@@ -0,0 +1,76 @@
+#include "Check.h"
+#include "TerrainNormals.h"
+#include "HeightmapGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	//the normal and tangent at a sample written out the plain way - central differences, with a missing neighbour
+	//along an edge clamped to the sample itself
+	void ScalarNormal(const std::vector<float> & heights, int resolution, float spacing, int x, int z, XMFLOAT3 & normal, XMFLOAT3 & tangent)
+	{
+		int left = std::max(x - 1, 0), right = std::min(x + 1, resolution - 1);
+		int down = std::max(z - 1, 0), up = std::min(z + 1, resolution - 1);
+		float slopeX = right > left ? (heights[z * resolution + right] - heights[z * resolution + left]) / ((right - left) * spacing) : 0.0f;
+		float slopeZ = up > down ? (heights[up * resolution + x] - heights[down * resolution + x]) / ((up - down) * spacing) : 0.0f;
+
+		//the cross product of the slopes along z and along x, normalised
+		float length = sqrtf(slopeX * slopeX + 1.0f + slopeZ * slopeZ);
+		normal = XMFLOAT3(-slopeX / length, 1.0f / length, -slopeZ / length);
+		float tangentLength = sqrtf(1.0f + slopeX * slopeX);
+		tangent = XMFLOAT3(1.0f / tangentLength, slopeX / tangentLength, 0.0f);
+	}
+
+	float Difference(const XMFLOAT3 & a, const XMFLOAT3 & b)
+	{
+		return std::max(std::max(fabsf(a.x - b.x), fabsf(a.y - b.y)), fabsf(a.z - b.z));
+	}
+}
+
+void TerrainNormalsTests()
+{
+	//sizes with every remainder of the four wide columns, and a map big enough to be split across the workers
+	const int RESOLUTIONS[] = { 1, 2, 5, 6, 7, 64, 129, 515 };
+	const float spacing = 4.0f;
+	for (int resolution : RESOLUTIONS)
+	{
+		size_t samples = (size_t)resolution * resolution;
+		std::vector<float> heights(samples);
+		HeightmapGenerator::Generate(HeightmapSettings(), resolution, heights.data());
+		for (size_t i = 0; i < samples; i++)
+		{
+			heights[i] *= 64.0f;
+		}
+
+		std::vector<XMFLOAT3> normals(samples), tangents(samples), normalsOnly(samples);
+		TerrainNormals::Generate(heights.data(), resolution, spacing, normals.data(), tangents.data());
+		TerrainNormals::Generate(heights.data(), resolution, spacing, normalsOnly.data(), NULL);
+
+		float worst = 0.0f, worstLength = 0.0f;
+		bool sameWithoutTangents = true;
+		for (int z = 0; z < resolution; z++)
+		{
+			for (int x = 0; x < resolution; x++)
+			{
+				size_t i = (size_t)z * resolution + x;
+				XMFLOAT3 normal, tangent;
+				ScalarNormal(heights, resolution, spacing, x, z, normal, tangent);
+				worst = std::max(worst, std::max(Difference(normals[i], normal), Difference(tangents[i], tangent)));
+				const XMFLOAT3 & n = normals[i];
+				worstLength = std::max(worstLength, fabsf(sqrtf(n.x * n.x + n.y * n.y + n.z * n.z) - 1.0f));
+				sameWithoutTangents &= Difference(normalsOnly[i], normals[i]) == 0.0f;
+			}
+		}
+		if (!CHECK(worst <= 1e-5f))
+		{
+			printf("  %d x %d: %g from the scalar reference\n", resolution, resolution, worst);
+		}
+		CHECK(worstLength <= 1e-5f);
+		CHECK(sameWithoutTangents);
+	}
+}
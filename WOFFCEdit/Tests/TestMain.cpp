@@ -0,0 +1,45 @@
+#include "Check.h"
+#include <cstdio>
+
+//each module's checks, in the file named after it
+void HeightmapGeneratorTests();
+void MeshSimplifierTests();
+void ObjectSearchIndexTests();
+void RenderQueueTests();
+void TerrainNormalsTests();
+
+namespace
+{
+	int		g_checks = 0;
+	int		g_failures = 0;
+
+	void RunTests(const char * name, void (*tests)())
+	{
+		int failures = g_failures;
+		tests();
+		printf("%s: %s\n", name, g_failures == failures ? "ok" : "FAILED");
+	}
+}
+
+bool CheckResult(bool passed, const char * condition, const char * file, int line)
+{
+	g_checks++;
+	if (!passed)
+	{
+		g_failures++;
+		printf("%s(%d): check failed: %s\n", file, line, condition);
+	}
+	return passed;
+}
+
+int main()
+{
+	RunTests("HeightmapGenerator", HeightmapGeneratorTests);
+	RunTests("MeshSimplifier", MeshSimplifierTests);
+	RunTests("ObjectSearchIndex", ObjectSearchIndexTests);
+	RunTests("RenderQueue", RenderQueueTests);
+	RunTests("TerrainNormals", TerrainNormalsTests);
+
+	printf("%d checks, %d failed\n", g_checks, g_failures);
+	return g_failures == 0 ? 0 : 1;
+}
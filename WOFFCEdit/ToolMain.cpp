@@ -1,5 +1,11 @@
 #include "ToolMain.h"
 #include "resource.h"
+#include "DatabaseMigration.h"
+#include "TerrainNormals.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "LevelPack.h"
+#include "ObjectSearchIndex.h"
 #include <vector>
 #include <sstream>
 
@@ -12,8 +18,8 @@ ToolMain::ToolMain()
 {
 
 	m_currentChunk = 0;		//default value
-	m_selectedObject = 0;	//initial selection ID
-	m_sceneGraph.clear();	//clear the vector for the scenegraph
+	m_selectedObject = -1;	//initial selection ID, nothing selected
+	m_sceneGraph.Clear();	//clear the scenegraph
 	m_databaseConnection = NULL;
 
 	//zero input commands
@@ -57,6 +63,13 @@ void ToolMain::onActionInitialise(HWND handle, int width, int height)
 	else 
 	{
 		TRACE("Opened database successfully");
+
+		//bring older levels up to the current schema (keys and indexes) before anything reads from them
+		DatabaseMigration migration(m_databaseConnection);
+		if (!migration.Migrate())
+		{
+			TRACE("Database migration failed, level left at schema version %d", migration.GetSchemaVersion());
+		}
 	}
 
 	onActionLoad();
@@ -65,219 +78,194 @@ void ToolMain::onActionInitialise(HWND handle, int width, int height)
 void ToolMain::onActionLoad()
 {
 	//load current chunk and objects into lists
-	if (!m_sceneGraph.empty())		//is the vector empty
+	m_sceneGraph.Clear();		//empty the scenegraph
+	m_journal.Clear();
+
+	//a pack cooked from the level as it is saved now loads in one go, anything older and the database is read as before
+	LevelPack pack;
+	if (pack.Open("database/test.pack") && pack.IsCurrent("database/test.db"))
 	{
-		m_sceneGraph.clear();		//if not, empty it
+		TRACE("Loading from database/test.pack");
+		pack.ReadScene(m_sceneGraph, m_chunk);
+		m_d3dRenderer.SetLevelPack(&pack);
 	}
-
-	//SQL
-	int rc;
-	char *sqlCommand;
-	char *ErrMSG = 0;
-	sqlite3_stmt *pResults;								//results of the query
-	sqlite3_stmt *pResultsChunk;
-
-	//OBJECTS IN THE WORLD
-	//prepare SQL Text
-	sqlCommand = "SELECT * from Objects";				//sql command which will return all records from the objects table.
-	//Send Command and fill result object
-	rc = sqlite3_prepare_v2(m_databaseConnection, sqlCommand, -1, &pResults, 0 );
-	
-	//loop for each row in results until there are no more rows.  ie for every row in the results. We create and object
-	while (sqlite3_step(pResults) == SQLITE_ROW)
-	{	
-		SceneObject newSceneObject;
-		newSceneObject.ID = sqlite3_column_int(pResults, 0);
-		newSceneObject.chunk_ID = sqlite3_column_int(pResults, 1);
-		newSceneObject.model_path		= reinterpret_cast<const char*>(sqlite3_column_text(pResults, 2));
-		newSceneObject.tex_diffuse_path = reinterpret_cast<const char*>(sqlite3_column_text(pResults, 3));
-		newSceneObject.posX = sqlite3_column_double(pResults, 4);
-		newSceneObject.posY = sqlite3_column_double(pResults, 5);
-		newSceneObject.posZ = sqlite3_column_double(pResults, 6);
-		newSceneObject.rotX = sqlite3_column_double(pResults, 7);
-		newSceneObject.rotY = sqlite3_column_double(pResults, 8);
-		newSceneObject.rotZ = sqlite3_column_double(pResults, 9);
-		newSceneObject.scaX = sqlite3_column_double(pResults, 10);
-		newSceneObject.scaY = sqlite3_column_double(pResults, 11);
-		newSceneObject.scaZ = sqlite3_column_double(pResults, 12);
-		newSceneObject.render = sqlite3_column_int(pResults, 13);
-		newSceneObject.collision = sqlite3_column_int(pResults, 14);
-		newSceneObject.collision_mesh = reinterpret_cast<const char*>(sqlite3_column_text(pResults, 15));
-		newSceneObject.collectable = sqlite3_column_int(pResults, 16);
-		newSceneObject.destructable = sqlite3_column_int(pResults, 17);
-		newSceneObject.health_amount = sqlite3_column_int(pResults, 18);
-		newSceneObject.editor_render = sqlite3_column_int(pResults, 19);
-		newSceneObject.editor_texture_vis = sqlite3_column_int(pResults, 20);
-		newSceneObject.editor_normals_vis = sqlite3_column_int(pResults, 21);
-		newSceneObject.editor_collision_vis = sqlite3_column_int(pResults, 22);
-		newSceneObject.editor_pivot_vis = sqlite3_column_int(pResults, 23);
-		newSceneObject.pivotX = sqlite3_column_double(pResults, 24);
-		newSceneObject.pivotY = sqlite3_column_double(pResults, 25);
-		newSceneObject.pivotZ = sqlite3_column_double(pResults, 26);
-		newSceneObject.snapToGround = sqlite3_column_int(pResults, 27);
-		newSceneObject.AINode = sqlite3_column_int(pResults, 28);
-		newSceneObject.audio_path = reinterpret_cast<const char*>(sqlite3_column_text(pResults, 29));
-		newSceneObject.volume = sqlite3_column_double(pResults, 30);
-		newSceneObject.pitch = sqlite3_column_double(pResults, 31);
-		newSceneObject.pan = sqlite3_column_int(pResults, 32);
-		newSceneObject.one_shot = sqlite3_column_int(pResults, 33);
-		newSceneObject.play_on_init = sqlite3_column_int(pResults, 34);
-		newSceneObject.play_in_editor = sqlite3_column_int(pResults, 35);
-		newSceneObject.min_dist = sqlite3_column_double(pResults, 36);
-		newSceneObject.max_dist = sqlite3_column_double(pResults, 37);
-		newSceneObject.camera = sqlite3_column_int(pResults, 38);
-		newSceneObject.path_node = sqlite3_column_int(pResults, 39);
-		newSceneObject.path_node_start = sqlite3_column_int(pResults, 40);
-		newSceneObject.path_node_end = sqlite3_column_int(pResults, 41);
-		newSceneObject.parent_id = sqlite3_column_int(pResults, 42);
-		newSceneObject.editor_wireframe = sqlite3_column_int(pResults, 43);
-		newSceneObject.name = reinterpret_cast<const char*>(sqlite3_column_text(pResults, 44));
-
-		newSceneObject.light_type = sqlite3_column_int(pResults, 45);
-		newSceneObject.light_diffuse_r = sqlite3_column_double(pResults, 46);
-		newSceneObject.light_diffuse_g = sqlite3_column_double(pResults, 47);
-		newSceneObject.light_diffuse_b = sqlite3_column_double(pResults, 48);
-		newSceneObject.light_specular_r = sqlite3_column_double(pResults, 49);
-		newSceneObject.light_specular_g = sqlite3_column_double(pResults, 50);
-		newSceneObject.light_specular_b = sqlite3_column_double(pResults, 51);
-		newSceneObject.light_spot_cutoff = sqlite3_column_double(pResults, 52);
-		newSceneObject.light_constant = sqlite3_column_double(pResults, 53);
-		newSceneObject.light_linear = sqlite3_column_double(pResults, 54);
-		newSceneObject.light_quadratic = sqlite3_column_double(pResults, 55);
-	
-
-		//send completed object to scenegraph
-		m_sceneGraph.push_back(newSceneObject);
+	else
+	{
+		pack.Close();
+		LevelPack::ReadDatabase(m_databaseConnection, m_sceneGraph, m_chunk);
 	}
 
-	//THE WORLD CHUNK
-	//prepare SQL Text
-	sqlCommand = "SELECT * from Chunks";				//sql command which will return all records from  chunks table. There is only one tho.
-														//Send Command and fill result object
-	rc = sqlite3_prepare_v2(m_databaseConnection, sqlCommand, -1, &pResultsChunk, 0);
-
-
-	sqlite3_step(pResultsChunk);
-	m_chunk.ID = sqlite3_column_int(pResultsChunk, 0);
-	m_chunk.name = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 1));
-	m_chunk.chunk_x_size_metres = sqlite3_column_int(pResultsChunk, 2);
-	m_chunk.chunk_y_size_metres = sqlite3_column_int(pResultsChunk, 3);
-	m_chunk.chunk_base_resolution = sqlite3_column_int(pResultsChunk, 4);
-	m_chunk.heightmap_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 5));
-	m_chunk.tex_diffuse_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 6));
-	m_chunk.tex_splat_alpha_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 7));
-	m_chunk.tex_splat_1_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 8));
-	m_chunk.tex_splat_2_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 9));
-	m_chunk.tex_splat_3_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 10));
-	m_chunk.tex_splat_4_path = reinterpret_cast<const char*>(sqlite3_column_text(pResultsChunk, 11));
-	m_chunk.render_wireframe = sqlite3_column_int(pResultsChunk, 12);
-	m_chunk.render_normals = sqlite3_column_int(pResultsChunk, 13);
-	m_chunk.tex_diffuse_tiling = sqlite3_column_int(pResultsChunk, 14);
-	m_chunk.tex_splat_1_tiling = sqlite3_column_int(pResultsChunk, 15);
-	m_chunk.tex_splat_2_tiling = sqlite3_column_int(pResultsChunk, 16);
-	m_chunk.tex_splat_3_tiling = sqlite3_column_int(pResultsChunk, 17);
-	m_chunk.tex_splat_4_tiling = sqlite3_column_int(pResultsChunk, 18);
-
-
 	//Process REsults into renderable
-	m_d3dRenderer.BuildDisplayList(&m_sceneGraph);
+	m_d3dRenderer.BuildDisplayList(m_sceneGraph);
 	//build the renderable chunk 
 	m_d3dRenderer.BuildDisplayChunk(&m_chunk);
+	m_d3dRenderer.SetLevelPack(NULL);		//everything is on the gpu, assets loaded from here on come from their files
 
 }
 
 void ToolMain::onActionSave()
 {
-	//SQL
-	int rc;
-	char *sqlCommand;
-	char *ErrMSG = 0;
-	sqlite3_stmt *pResults;								//results of the query
-	
+	//replaces the Objects table in one transaction, so a failed save leaves the level as it was
+	if (!LevelPack::WriteDatabase(m_databaseConnection, m_sceneGraph))
+	{
+		MessageBox(NULL, L"Objects could not be saved, the level is as it was", L"Error", MB_OK);
+		return;
+	}
+	MessageBox(NULL, L"Objects Saved", L"Notification", MB_OK);
+}
+
+void ToolMain::onActionBenchmark()
+{
+	std::string report;
+	report += DatabaseMigration::Benchmark(100000);
+	report += StringTable::Benchmark(1000000);
+	report += Scene::Benchmark(100000);
+	report += SceneJournal::Benchmark(100000, 600);
+	report += TransformHierarchy::Benchmark(10000, 10);
+	report += TerrainQuery::Benchmark(1000000);
+	report += Scatter::Benchmark(1000000);
+	report += HeightmapGenerator::Benchmark(4096);
+	report += Erosion::Benchmark(1024, 10);
+	report += Erosion::Benchmark(4096, 2);
+	report += TerrainNormals::Benchmark(4096);
+	report += HeightmapFile::Benchmark(4096);
+	report += TerrainHistory::Benchmark(4096, 200);
+	report += ObjToCmo::Benchmark(512);
+	report += MeshOptimizer::Benchmark(512);
+	report += MeshSimplifier::Benchmark(64);
+	report += MeshSimplifier::Benchmark(256);
+	report += LevelPack::Benchmark(100000);
+	report += MeshBvh::Benchmark(512);
+	report += FrustumQuery::Benchmark(100000);
+	report += SelectionSet::Benchmark(20000, 10000);
+	report += ObjectSearchIndex::Benchmark(50000);
+	report += Gizmo::Benchmark(10000);
+	report += RenderQueue::Benchmark(100000);
+
+	TRACE("%s", report.c_str());
+	std::wstring reportwstr = StringToWCHART(report);
+	MessageBox(NULL, reportwstr.c_str(), L"Benchmarks", MB_OK);
+}
 
-	//OBJECTS IN THE WORLD Delete them all
-	//prepare SQL Text
-	sqlCommand = "DELETE FROM Objects";	 //will delete the whole object table.   Slightly risky but hey.
-	rc = sqlite3_prepare_v2(m_databaseConnection, sqlCommand, -1, &pResults, 0);
-	sqlite3_step(pResults);
+void ToolMain::onActionScatter()
+{
+	m_d3dRenderer.ScatterObjects(0.0f, 0.0f, 0.0f);
+}
 
-	//Populate with our new objects
-	std::wstring sqlCommand2;
-	int numObjects = m_sceneGraph.size();	//Loop thru the scengraph.
+void ToolMain::onActionGenerateTerrain()
+{
+	m_d3dRenderer.GenerateTerrain();
+}
 
-	for (int i = 0; i < numObjects; i++)
+void ToolMain::onActionErodeTerrain()
+{
+	m_d3dRenderer.ErodeTerrain();
+}
+
+void ToolMain::onActionImportObj(const std::string & path)
+{
+	//the model goes beside the others so the path saved with the objects is relative like theirs
+	size_t slash = path.find_last_of("/\\");
+	std::string name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+	std::string modelPath = "database/data/" + name.substr(0, name.find_last_of('.')) + ".cmo";
+
+	std::string error;
+	if (!ObjToCmo::Convert(path, modelPath, error))
 	{
-		std::stringstream command;
-		command << "INSERT INTO Objects " 
-			<<"VALUES(" << m_sceneGraph.at(i).ID << ","
-			<< m_sceneGraph.at(i).chunk_ID  << ","
-			<< "'" << m_sceneGraph.at(i).model_path <<"'" << ","
-			<< "'" << m_sceneGraph.at(i).tex_diffuse_path << "'" << ","
-			<< m_sceneGraph.at(i).posX << ","
-			<< m_sceneGraph.at(i).posY << ","
-			<< m_sceneGraph.at(i).posZ << ","
-			<< m_sceneGraph.at(i).rotX << ","
-			<< m_sceneGraph.at(i).rotY << ","
-			<< m_sceneGraph.at(i).rotZ << ","
-			<< m_sceneGraph.at(i).scaX << ","
-			<< m_sceneGraph.at(i).scaY << ","
-			<< m_sceneGraph.at(i).scaZ << ","
-			<< m_sceneGraph.at(i).render << ","
-			<< m_sceneGraph.at(i).collision << ","
-			<< "'" << m_sceneGraph.at(i).collision_mesh << "'" << ","
-			<< m_sceneGraph.at(i).collectable << ","
-			<< m_sceneGraph.at(i).destructable << ","
-			<< m_sceneGraph.at(i).health_amount << ","
-			<< m_sceneGraph.at(i).editor_render << ","
-			<< m_sceneGraph.at(i).editor_texture_vis << ","
-			<< m_sceneGraph.at(i).editor_normals_vis << ","
-			<< m_sceneGraph.at(i).editor_collision_vis << ","
-			<< m_sceneGraph.at(i).editor_pivot_vis << ","
-			<< m_sceneGraph.at(i).pivotX << ","
-			<< m_sceneGraph.at(i).pivotY << ","
-			<< m_sceneGraph.at(i).pivotZ << ","
-			<< m_sceneGraph.at(i).snapToGround << ","
-			<< m_sceneGraph.at(i).AINode << ","
-			<< "'" << m_sceneGraph.at(i).audio_path << "'" << ","
-			<< m_sceneGraph.at(i).volume << ","
-			<< m_sceneGraph.at(i).pitch << ","
-			<< m_sceneGraph.at(i).pan << ","
-			<< m_sceneGraph.at(i).one_shot << ","
-			<< m_sceneGraph.at(i).play_on_init << ","
-			<< m_sceneGraph.at(i).play_in_editor << ","
-			<< m_sceneGraph.at(i).min_dist << ","
-			<< m_sceneGraph.at(i).max_dist << ","
-			<< m_sceneGraph.at(i).camera << ","
-			<< m_sceneGraph.at(i).path_node << ","
-			<< m_sceneGraph.at(i).path_node_start << ","
-			<< m_sceneGraph.at(i).path_node_end << ","
-			<< m_sceneGraph.at(i).parent_id << ","
-			<< m_sceneGraph.at(i).editor_wireframe << ","
-			<< "'" << m_sceneGraph.at(i).name << "'" << ","
-
-			<< m_sceneGraph.at(i).light_type << ","
-			<< m_sceneGraph.at(i).light_diffuse_r << ","
-			<< m_sceneGraph.at(i).light_diffuse_g << ","
-			<< m_sceneGraph.at(i).light_diffuse_b << ","
-			<< m_sceneGraph.at(i).light_specular_r << ","
-			<< m_sceneGraph.at(i).light_specular_g << ","
-			<< m_sceneGraph.at(i).light_specular_b << ","
-			<< m_sceneGraph.at(i).light_spot_cutoff << ","
-			<< m_sceneGraph.at(i).light_constant << ","
-			<< m_sceneGraph.at(i).light_linear << ","
-			<< m_sceneGraph.at(i).light_quadratic
-
-			<< ")";
-		std::string sqlCommand2 = command.str();
-		rc = sqlite3_prepare_v2(m_databaseConnection, sqlCommand2.c_str(), -1, &pResults, 0);
-		sqlite3_step(pResults);	
+		std::wstring errorwstr = StringToWCHART("Import failed: " + error);
+		MessageBox(NULL, errorwstr.c_str(), L"Import OBJ", MB_OK);
+		return;
+	}
+	//the levels of detail are built now rather than when the first object is placed
+	std::vector<LodLevel> levels;
+	if (!MeshSimplifier::CachedLods(modelPath, levels, error))
+	{
+		TRACE("No levels of detail for %s, %s\n", modelPath.c_str(), error.c_str());
+	}
+	TRACE("Imported %s as %s with %d levels of detail\n", path.c_str(), modelPath.c_str(), (int)levels.size());
+	m_d3dRenderer.SetPlacementModel(StringTable::AssetPaths().Intern(modelPath));
+	std::wstring messagewstr = StringToWCHART("Imported as " + modelPath + ", new objects are placed with it");
+	MessageBox(NULL, messagewstr.c_str(), L"Import OBJ", MB_OK);
+}
+
+void ToolMain::onActionCookPack()
+{
+	//cooked from what is on disk, so unsaved edits are not in it until they are saved and it is cooked again
+	std::string error;
+	if (!LevelPack::Cook("database/test.pack", m_databaseConnection, "database/test.db", TERRAINRESOLUTION, TERRAINHEIGHTSCALE, error))
+	{
+		std::wstring errorwstr = StringToWCHART("Cook failed: " + error);
+		MessageBox(NULL, errorwstr.c_str(), L"Cook Level Pack", MB_OK);
+		return;
+	}
+	TRACE("Cooked database/test.pack\n");
+	MessageBox(NULL, L"Cooked database/test.pack, the level loads from it until it is next saved", L"Cook Level Pack", MB_OK);
+}
+
+void ToolMain::onActionUndo()
+{
+	//anything still going on becomes an edit of its own first, so that is what gets undone
+	m_d3dRenderer.EndTerrainStroke();
+	SyncSceneChanges();
+	if (m_journal.Undo(m_sceneGraph, m_sceneChanges))
+	{
+		ApplyJournalChanges(true);
+	}
+}
+
+void ToolMain::onActionRedo()
+{
+	m_d3dRenderer.EndTerrainStroke();
+	SyncSceneChanges();
+	if (m_journal.Redo(m_sceneGraph, m_sceneChanges))
+	{
+		ApplyJournalChanges(false);
 	}
-	MessageBox(NULL, L"Objects Saved", L"Notification", MB_OK);
+}
+
+void ToolMain::ApplyJournalChanges(bool undo)
+{
+	for (const SceneChange & change : m_sceneChanges)
+	{
+		if (change.type != SCENE_TERRAIN_CHANGED)
+		{
+			m_d3dRenderer.ApplySceneChange(change);
+		}
+		else
+		{
+			if (undo)
+			{
+				m_d3dRenderer.UndoTerrain();
+			}
+			else
+			{
+				m_d3dRenderer.RedoTerrain();
+			}
+			TRACE("%s", m_d3dRenderer.TerrainReport().c_str());
+		}
+	}
+	m_sceneChanges.clear();
+	TRACE("%s", m_journal.Report().c_str());
 }
 
 void ToolMain::onActionSaveTerrain()
 {
-	m_d3dRenderer.SaveDisplayChunk(&m_chunk);
+	std::string heightmapPath = m_chunk.heightmap_path;
+	if (!m_d3dRenderer.SaveDisplayChunk(&m_chunk) || m_chunk.heightmap_path == heightmapPath)
+	{
+		return;
+	}
+
+	//the first save of an old .raw heightmap writes the container beside it, which the level loads from now on
+	sqlite3_stmt * pUpdate;
+	sqlite3_prepare_v2(m_databaseConnection, "UPDATE Chunks SET heightmap = ? WHERE ID = ?", -1, &pUpdate, 0);
+	sqlite3_bind_text(pUpdate, 1, m_chunk.heightmap_path.c_str(), -1, SQLITE_STATIC);
+	sqlite3_bind_int(pUpdate, 2, m_chunk.ID);
+	if (sqlite3_step(pUpdate) != SQLITE_DONE)
+	{
+		TRACE("Can't point chunk %d at %s\n", m_chunk.ID, m_chunk.heightmap_path.c_str());
+	}
+	sqlite3_finalize(pUpdate);
 }
 
 void ToolMain::Tick(MSG *msg)
@@ -286,48 +274,37 @@ void ToolMain::Tick(MSG *msg)
 	//do we have a selection
 	//do we have a mode
 	//are we clicking / dragging /releasing
-	if (objectSpawning && m_toolInputCommands.mouse_LB_Down && !isObjectSpawned) {
-		isObjectSpawned = true;
+	if (objectSpawning && m_toolInputCommands.mouse_LB_Down) {
+		// holding the button paints objects along the surface under the cursor
+		if (!isObjectSpawned) {
+			isObjectSpawned = true;
+			m_d3dRenderer.BeginPlacement();
+		}
 		m_d3dRenderer.ObjectPlacement();
 	}
 	else if (terrainEdit && (m_toolInputCommands.mouse_LB_Down || m_toolInputCommands.mouse_RB_Down)) {
 		m_d3dRenderer.TerrainEdit();
 	}
 
-	if (!objectSpawning && !terrainEdit && (m_toolInputCommands.mouse_LB_Down || m_toolInputCommands.mouse_LB_Hold)) {
-		// check if the object we are clicking on is the same as what is selected
-		if (0 == m_d3dRenderer.MousePicking(false) || 1 == m_d3dRenderer.MousePicking(false)  || 2 == m_d3dRenderer.MousePicking(false) || m_toolInputCommands.mouse_LB_Hold || m_d3dRenderer.GetSelectedAxis() != 'a') {
-			// calculate the difference in the mouse position transforms
-			int moveX = 0;
-			int moveY = 0;
-			if ((m_toolInputCommands.mouse_X - prevX) < 0) {
-				moveX = 1;
-			}
-			else if ((m_toolInputCommands.mouse_X - prevX) > 0) {
-				moveX = -1;
-			}
-
-			if ((m_toolInputCommands.mouse_Y - prevY) < 0) {
-				moveY = 1;
-			}
-			else if ((m_toolInputCommands.mouse_Y - prevY) > 0) {
-				moveY = -1;
-			}
-
-			if (0 == m_d3dRenderer.MousePicking(false)) {
-				m_d3dRenderer.MoveObject(moveX, moveY, m_selectedObject, 'z');
-			}
-			else if (1 == m_d3dRenderer.MousePicking(false)) {
-				m_d3dRenderer.MoveObject(moveX, moveY, m_selectedObject, 'x');
-			}
-			if (2 == m_d3dRenderer.MousePicking(false)) {
-				m_d3dRenderer.MoveObject(moveX, moveY, m_selectedObject, 'y');
-			}
-			//m_d3dRenderer.MoveObject(moveX, moveY, m_selectedObject, true);
+	if (!objectSpawning && !terrainEdit && (m_marquee || (m_toolInputCommands.shift && m_toolInputCommands.mouse_LB_Down))) {
+		// shift + drag draws a rectangle, the selection is made when the button comes up
+		if (!m_marquee) {
+			m_marquee = true;
+			m_marqueeX = m_toolInputCommands.mouse_X;
+			m_marqueeY = m_toolInputCommands.mouse_Y;
+		}
+		m_toolInputCommands.mouse_LB_Down = false;
+		m_d3dRenderer.SetMarquee(true, m_marqueeX, m_marqueeY, m_toolInputCommands.mouse_X, m_toolInputCommands.mouse_Y);
+	}
+	else if (!objectSpawning && !terrainEdit && (m_toolInputCommands.mouse_LB_Down || m_toolInputCommands.mouse_LB_Hold)) {
+		// the gizmo is tried before the scene, and keeps the drag once it has it
+		if (m_d3dRenderer.IsGizmoDragging() || (m_toolInputCommands.mouse_LB_Down && m_d3dRenderer.BeginGizmoDrag())) {
+			m_d3dRenderer.GizmoDrag(m_selection);
 			m_toolInputCommands.mouse_LB_Down = false;
 			m_toolInputCommands.mouse_LB_Hold = true;
 		}
-		else if (m_selectedObject == m_d3dRenderer.MousePicking(true) || m_toolInputCommands.mouse_LB_Hold) {
+		// check if the object we are clicking on is part of the selection
+		else if ((!m_toolInputCommands.control && m_selection.Contains(m_d3dRenderer.MousePicking())) || m_toolInputCommands.mouse_LB_Hold) {
 			// calculate the difference in the mouse position transforms
 			int moveX = 0;
 			int moveY = 0;
@@ -344,25 +321,36 @@ void ToolMain::Tick(MSG *msg)
 			else if ((m_toolInputCommands.mouse_Y - prevY) > 0) {
 				moveY = -1;
 			}
-			m_d3dRenderer.MoveObject(moveX, moveY, m_selectedObject, false);
+			m_d3dRenderer.MoveObject(moveX, moveY, m_selection);
 			m_toolInputCommands.mouse_LB_Down = false;
 			m_toolInputCommands.mouse_LB_Hold = true;
 		}
 		// otherwise, set the mouse to click on the new object
 		else {
 			m_toolInputCommands.mouse_LB_Down = false;
-			m_selectedObject = m_d3dRenderer.MousePicking(true);
+			int clicked = m_d3dRenderer.MousePicking();
+			// ctrl + click adds an object to the selection or takes it out, a plain click selects just it
+			if (m_toolInputCommands.control) {
+				m_selection.Toggle(clicked);
+			}
+			else {
+				m_selection.Select(clicked);
+			}
+			m_selectedObject = m_selection.Contains(clicked) ? clicked : m_selection.Front();
 		}
 	}
 
 	// copy/paste
 	 if (m_toolInputCommands.key_c && m_toolInputCommands.control) {
+		 RememberCopiedObject(m_selectedObject);
 		 m_d3dRenderer.Copy(m_selectedObject);
 	 }
 	 else if (m_toolInputCommands.key_x && m_toolInputCommands.control) {
 		 if (m_selectedObject != -1) {
+			 RememberCopiedObject(m_selectedObject);
 			 m_d3dRenderer.Cut(m_selectedObject);
 			 m_selectedObject = -1;
+			 m_selection.Clear();
 		}
 		 
 	 }
@@ -372,12 +360,46 @@ void ToolMain::Tick(MSG *msg)
 
 	 }
 
-	 if (m_selectedObject != 1) {
-		 m_d3dRenderer.WidgetGeneration(m_selectedObject);
+	 // undo / redo
+	 bool undo = m_toolInputCommands.key_z && m_toolInputCommands.control;
+	 bool redo = m_toolInputCommands.key_y && m_toolInputCommands.control;
+	 if (undo && !undoHeld) {
+		 onActionUndo();
+	 }
+	 if (redo && !redoHeld) {
+		 onActionRedo();
+	 }
+	 undoHeld = undo;
+	 redoHeld = redo;
+
+	 // turn the selection about its centre, or scale it
+	 bool turnOrScale = m_toolInputCommands.key_lbracket || m_toolInputCommands.key_rbracket || m_toolInputCommands.key_minus || m_toolInputCommands.key_plus;
+	 if (turnOrScale && !transformHeld && !m_selection.Empty()) {
+		 DirectX::XMFLOAT3 pivot;
+		 m_d3dRenderer.SelectionPivot(m_selection, pivot);
+		 if (m_toolInputCommands.key_lbracket) {
+			 m_d3dRenderer.TransformObjects(m_selection, SelectionTransform::Rotate(pivot, -15.0f));
+		 }
+		 else if (m_toolInputCommands.key_rbracket) {
+			 m_d3dRenderer.TransformObjects(m_selection, SelectionTransform::Rotate(pivot, 15.0f));
+		 }
+		 else if (m_toolInputCommands.key_minus) {
+			 m_d3dRenderer.TransformObjects(m_selection, SelectionTransform::Scale(pivot, 1.0f / 1.1f));
+		 }
+		 else {
+			 m_d3dRenderer.TransformObjects(m_selection, SelectionTransform::Scale(pivot, 1.1f));
+		 }
+	 }
+	 transformHeld = turnOrScale;
 
+	 // an object picked some other way, from the select dialogue, becomes the whole selection
+	 if (m_selectedObject != -1 && !m_selection.Contains(m_selectedObject)) {
+		 m_selection.Select(m_selectedObject);
 	 }
 
-	 if (m_selectedObject != 1 && m_toolInputCommands.key_r) {
+	 m_d3dRenderer.PlaceGizmo(m_selection);
+
+	 if (m_selectedObject != -1 && m_toolInputCommands.key_r) {
 		 m_d3dRenderer.ResetTexture(m_selectedObject);
 
 	 }
@@ -385,8 +407,7 @@ void ToolMain::Tick(MSG *msg)
 
 	//has something changed
 		//update Scenegraph
-		//add to scenegraph
-		//resend scenegraph to Direct X renderer
+	SyncSceneChanges();
 
 	//Renderer Update Call
 	m_d3dRenderer.Tick(&m_toolInputCommands);
@@ -395,6 +416,25 @@ void ToolMain::Tick(MSG *msg)
 	prevY = m_toolInputCommands.mouse_Y;
 }
 
+void ToolMain::EndMarquee()
+{
+	m_marquee = false;
+	m_d3dRenderer.SetMarquee(false, 0, 0, 0, 0);
+
+	// a shift click that barely moved is not a rectangle
+	int x = m_toolInputCommands.mouse_X, y = m_toolInputCommands.mouse_Y;
+	if (abs(x - m_marqueeX) < 3 || abs(y - m_marqueeY) < 3)
+	{
+		return;
+	}
+
+	std::vector<int> IDs;
+	m_d3dRenderer.MarqueeSelect(m_marqueeX, m_marqueeY, x, y, IDs);
+	m_selection.Assign(IDs);
+	m_selectedObject = m_selection.Front();
+	TRACE("Marquee selected %d objects\n", m_selection.Size());
+}
+
 void ToolMain::UpdateInput(MSG * msg)
 {
 	
@@ -426,10 +466,18 @@ void ToolMain::UpdateInput(MSG * msg)
 	case WM_LBUTTONUP:
 		m_toolInputCommands.mouse_LB_Down = false;
 		m_toolInputCommands.mouse_LB_Hold = false;
-		m_d3dRenderer.ResetSelectedAxis();
+		m_d3dRenderer.EndGizmoDrag();
 		isObjectSpawned = false;
+		if (m_marquee)
+		{
+			EndMarquee();
+		}
 
-		if (terrainEdit) m_d3dRenderer.RecalcuateTerrainNormals();
+		if (terrainEdit)
+		{
+			m_d3dRenderer.EndTerrainStroke();
+			m_d3dRenderer.SnapToGround();
+		}
 		break;
 		
 
@@ -446,7 +494,11 @@ void ToolMain::UpdateInput(MSG * msg)
 		//set some flag for the mouse button in inputcommands
 		//mouse right up.	
 		m_toolInputCommands.mouse_RB_Down = false;
-		if (terrainEdit) m_d3dRenderer.RecalcuateTerrainNormals();
+		if (terrainEdit)
+		{
+			m_d3dRenderer.EndTerrainStroke();
+			m_d3dRenderer.SnapToGround();
+		}
 		break;
 
 	case WM_MBUTTONDOWN:	// checks if the middle mouse button is down, and updates input commands correctly
@@ -473,8 +525,15 @@ void ToolMain::UpdateInput(MSG * msg)
 
 	// copy paste
 	m_toolInputCommands.control = m_keyArray[17];
+	m_toolInputCommands.shift = m_keyArray[16];
 	m_toolInputCommands.key_c = m_keyArray['C'];
 	m_toolInputCommands.key_r = m_keyArray['R'];
+	m_toolInputCommands.key_z = m_keyArray['Z'];
+	m_toolInputCommands.key_y = m_keyArray['Y'];
+	m_toolInputCommands.key_lbracket = m_keyArray[VK_OEM_4];
+	m_toolInputCommands.key_rbracket = m_keyArray[VK_OEM_6];
+	m_toolInputCommands.key_minus = m_keyArray[VK_OEM_MINUS];
+	m_toolInputCommands.key_plus = m_keyArray[VK_OEM_PLUS];
 
 	if (m_keyArray['V']) {
 		m_toolInputCommands.key_v = true;
@@ -497,6 +556,66 @@ void ToolMain::UpdateInput(MSG * msg)
 	
 }
 
+void ToolMain::SyncSceneChanges()
+{
+	m_d3dRenderer.TakeSceneChanges(m_sceneChanges);
+
+	for (SceneChange & change : m_sceneChanges)
+	{
+		if (change.type == SCENE_OBJECT_ADDED)
+		{
+			//pastes keep every column of the row they were copied from, new objects start from the defaults
+			if (change.sourceID != -1 && change.sourceID == m_copiedObject.ID)
+			{
+				SceneObject newSceneObject = m_copiedObject;
+				newSceneObject.ID = change.object.ID;
+				newSceneObject.posX = change.object.posX;	newSceneObject.posY = change.object.posY;	newSceneObject.posZ = change.object.posZ;
+				newSceneObject.rotX = change.object.rotX;	newSceneObject.rotY = change.object.rotY;	newSceneObject.rotZ = change.object.rotZ;
+				newSceneObject.scaX = change.object.scaX;	newSceneObject.scaY = change.object.scaY;	newSceneObject.scaZ = change.object.scaZ;
+				newSceneObject.tex_diffuse_path = change.object.tex_diffuse_path;
+				newSceneObject.parent_id = change.object.parent_id;
+				change.object = newSceneObject;
+			}
+		}
+		if (change.type == SCENE_OBJECT_ADDED || change.type == SCENE_OBJECTS_ADDED)
+		{
+			change.object.chunk_ID = m_chunk.ID;
+		}
+
+		if (change.type == SCENE_TERRAIN_CHANGED)
+		{
+			TRACE("%s", m_d3dRenderer.TerrainReport().c_str());
+		}
+
+		//the journal reads what the change replaces, so it goes first
+		m_journal.Record(change, m_sceneGraph);
+		SceneJournal::Apply(change, m_sceneGraph);
+	}
+	m_sceneChanges.clear();
+
+	//models and textures that would not load, since the last tick
+	m_d3dRenderer.TakeAssetWarnings(m_assetWarnings);
+	for (const std::string & warning : m_assetWarnings)
+	{
+		TRACE("AssetCache: %s\n", warning.c_str());
+	}
+
+	//a drag, a placement stroke or a sculpt is one edit for as long as the button is held
+	if (!m_toolInputCommands.mouse_LB_Down && !m_toolInputCommands.mouse_LB_Hold && !m_toolInputCommands.mouse_RB_Down)
+	{
+		m_journal.EndEdit();
+	}
+}
+
+void ToolMain::RememberCopiedObject(int ID)
+{
+	int row = m_sceneGraph.Find(ID);
+	if (row != -1)
+	{
+		m_copiedObject = m_sceneGraph.GetRow(row);
+	}
+}
+
 int ToolMain::GetToolMode()
 {
 	if (terrainEdit) {
@@ -7,6 +7,9 @@
 #include "SceneObject.h"
 #include "InputCommands.h"
 #include "objToCmo.h"
+#include "Scene.h"
+#include "SceneJournal.h"
+#include "SelectionSet.h"
 #include <vector>
 
 
@@ -23,6 +26,14 @@ public: //methods
 	void	onActionLoad();													//load the current chunk
 	afx_msg	void	onActionSave();											//save the current chunk
 	afx_msg void	onActionSaveTerrain();									//save chunk geometry
+	afx_msg void	onActionBenchmark();									//runs the headless benchmarks and reports the timings
+	afx_msg void	onActionScatter();										//scatters props over the whole terrain
+	afx_msg void	onActionGenerateTerrain();								//replaces the terrain with a procedural one
+	afx_msg void	onActionErodeTerrain();									//erodes the terrain over the next few seconds
+	void	onActionImportObj(const std::string & path);					//converts an OBJ to a CMO in the data folder and places with it
+	afx_msg void	onActionCookPack();										//cooks the saved level into one file that loads faster
+	afx_msg void	onActionUndo();											//steps the scene and terrain back one edit
+	afx_msg void	onActionRedo();
 
 	void	Tick(MSG *msg);
 	void	UpdateInput(MSG *msg);
@@ -45,6 +56,11 @@ public: //methods
 	}
 	bool GetTerrainEdit() { return terrainEdit; };
 
+	void	SetAlignToSurface(bool b) { m_d3dRenderer.SetAlignToSurface(b); }
+	bool	GetAlignToSurface() { return m_d3dRenderer.GetAlignToSurface(); }
+	void	SetScatterBrush(bool b) { m_d3dRenderer.SetScatterBrush(b); }
+	bool	GetScatterBrush() { return m_d3dRenderer.GetScatterBrush(); }
+
 	int GetToolMode();
 
 	DirectX::SimpleMath::Vector3 GetTerrainIntersect();
@@ -56,12 +72,17 @@ public: //methods
 	
 
 public:	//variables
-	std::vector<SceneObject>    m_sceneGraph;	//our scenegraph storing all the objects in the current chunk
+	Scene						m_sceneGraph;	//our scenegraph storing all the objects in the current chunk
 	ChunkObject					m_chunk;		//our landscape chunk
-	int m_selectedObject;						//ID of current Selection
+	int m_selectedObject;						//database ID of current Selection, -1 for none. stays valid across deletes
+	SelectionSet m_selection;					//everything selected, m_selectedObject among them. the gizmo sits on m_selectedObject
 
 private:	//methods
 	void	onContentAdded();
+	void	SyncSceneChanges();			//applies the renderers edits since last tick to the scenegraph
+	void	RememberCopiedObject(int ID);
+	void	ApplyJournalChanges(bool undo);	//brings the renderer in line with an undo or redo the journal made to the scenegraph
+	void	EndMarquee();				//selects what the dragged rectangle covers
 
 
 		
@@ -73,6 +94,11 @@ private:	//variables
 	char	m_keyArray[256];
 	sqlite3 *m_databaseConnection;	//sqldatabase handle
 
+	std::vector<SceneChange>	m_sceneChanges;		//reused every tick so syncing does not allocate
+	std::vector<std::string>	m_assetWarnings;	//the same, for load failures on their way to the log
+	SceneJournal				m_journal;			//undo / redo, fed with the same changes
+	SceneObject	m_copiedObject;						//row copied with ctrl+c / ctrl+x, so pastes keep every column
+
 	int m_width;		//dimensions passed to directX
 	int m_height;
 	int m_currentChunk;			//the current chunk of thedatabase that we are operating on.  Dictates loading and saving. 
@@ -83,6 +109,12 @@ private:	//variables
 	bool objectSpawning   = false;
 	bool terrainEdit = false;
 	bool isObjectSpawned = false;
+	bool undoHeld = false;		//ctrl+z / ctrl+y act once per press
+	bool redoHeld = false;
+	bool transformHeld = false;	//turning and scaling the selection act once per press
+	bool m_marquee = false;		//shift + drag is drawing a selection rectangle
+	int m_marqueeX = 0;			//where the drag started
+	int m_marqueeY = 0;
 
 	bool localWireframe = false;
 	
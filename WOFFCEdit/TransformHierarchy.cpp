@@ -0,0 +1,227 @@
+#include "TransformHierarchy.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <unordered_map>
+
+using namespace DirectX;
+
+
+TransformHierarchy::TransformHierarchy()
+{
+	m_anyDirty = false;
+}
+
+
+TransformHierarchy::~TransformHierarchy()
+{
+}
+
+XMMATRIX TransformHierarchy::LocalMatrix(const XMFLOAT3 & position, const XMFLOAT3 & rotationDegrees, const XMFLOAT3 & scale)
+{
+	XMMATRIX rotation = XMMatrixRotationRollPitchYaw(XMConvertToRadians(rotationDegrees.x), XMConvertToRadians(rotationDegrees.y), XMConvertToRadians(rotationDegrees.z));
+	return XMMatrixScaling(scale.x, scale.y, scale.z) * rotation * XMMatrixTranslation(position.x, position.y, position.z);
+}
+
+void TransformHierarchy::Build(const std::vector<int> & IDs, const std::vector<int> & parentIDs, const std::vector<XMFLOAT4X4> & locals)
+{
+	int count = (int)IDs.size();
+
+	std::unordered_map<int, int> lookup;
+	lookup.reserve(count);
+	for (int i = 0; i < count; i++)
+	{
+		lookup[IDs[i]] = i;
+	}
+
+	m_parents.assign(count, -1);
+	for (int i = 0; i < count; i++)
+	{
+		if (parentIDs[i] == 0)
+		{
+			continue;
+		}
+		auto found = lookup.find(parentIDs[i]);
+		if (found != lookup.end() && found->second != i)
+		{
+			m_parents[i] = found->second;
+		}
+	}
+
+	//depth of every index, walking up until we reach something whose depth is known.
+	//-1 unknown, -2 on the current walk - meeting a -2 means the walk has gone round a loop
+	m_depth.assign(count, -1);
+	std::vector<int> walk;
+	for (int i = 0; i < count; i++)
+	{
+		walk.clear();
+		int current = i;
+		while (current != -1 && m_depth[current] == -1)
+		{
+			m_depth[current] = -2;
+			walk.push_back(current);
+			current = m_parents[current];
+		}
+
+		if (current != -1 && m_depth[current] == -2)
+		{
+			//cut the loop at the object that closes it
+			m_parents[walk.back()] = -1;
+			current = -1;
+		}
+
+		int depth = current == -1 ? -1 : m_depth[current];
+		for (int w = (int)walk.size() - 1; w >= 0; w--)
+		{
+			m_depth[walk[w]] = ++depth;
+		}
+	}
+
+	m_levels.clear();
+	for (int i = 0; i < count; i++)
+	{
+		if (m_depth[i] >= (int)m_levels.size())
+		{
+			m_levels.resize(m_depth[i] + 1);
+		}
+		m_levels[m_depth[i]].push_back(i);
+	}
+
+	m_local = locals;
+	m_world.resize(count);
+	m_dirty.assign(count, 1);
+	m_levelDirty.assign(m_levels.size(), 1);
+	m_anyDirty = count > 0;
+}
+
+void XM_CALLCONV TransformHierarchy::SetLocal(int index, FXMMATRIX local)
+{
+	XMStoreFloat4x4(&m_local[index], local);
+	m_dirty[index] = 1;
+	m_levelDirty[m_depth[index]] = 1;
+	m_anyDirty = true;
+}
+
+void TransformHierarchy::Update()
+{
+	if (!m_anyDirty)
+	{
+		return;
+	}
+
+	//a depth needs visiting if something at it was edited, or something one level up was recomputed
+	bool parentLevelChanged = false;
+	for (size_t depth = 0; depth < m_levels.size(); depth++)
+	{
+		if (!parentLevelChanged && !m_levelDirty[depth])
+		{
+			continue;
+		}
+
+		const std::vector<int> & level = m_levels[depth];
+		std::atomic<bool> levelChanged(false);
+
+		ParallelFor((int)level.size(), 1024, [&](int begin, int end)
+		{
+			bool changed = false;
+			for (int k = begin; k < end; k++)
+			{
+				int index = level[k];
+				int parent = m_parents[index];
+				if (!m_dirty[index] && (parent == -1 || !m_dirty[parent]))
+				{
+					continue;
+				}
+
+				XMMATRIX world = XMLoadFloat4x4(&m_local[index]);
+				if (parent != -1)
+				{
+					world = world * XMLoadFloat4x4(&m_world[parent]);
+				}
+				XMStoreFloat4x4(&m_world[index], world);
+				m_dirty[index] = 1;		//so this index's children pick it up on the next depth
+				changed = true;
+			}
+			if (changed)
+			{
+				levelChanged = true;
+			}
+		});
+
+		parentLevelChanged = levelChanged;
+	}
+
+	memset(m_dirty.data(), 0, m_dirty.size());
+	memset(m_levelDirty.data(), 0, m_levelDirty.size());
+	m_anyDirty = false;
+}
+
+//one root with children, each child having its own grandchildren. the root is moved and the pass timed,
+//against recomputing each descendant on its own by walking its parent chain, which is what moving them one by one costs
+std::string TransformHierarchy::Benchmark(int children, int grandchildren)
+{
+	std::vector<int> IDs;
+	std::vector<int> parentIDs;
+	std::vector<XMFLOAT4X4> locals;
+
+	XMFLOAT4X4 offset;
+	XMStoreFloat4x4(&offset, LocalMatrix(XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(0.0f, 10.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)));
+
+	int nextID = 1;
+	IDs.push_back(nextID++);
+	parentIDs.push_back(0);
+	locals.push_back(offset);
+	for (int c = 0; c < children; c++)
+	{
+		int childID = nextID++;
+		IDs.push_back(childID);
+		parentIDs.push_back(1);
+		locals.push_back(offset);
+		for (int g = 0; g < grandchildren; g++)
+		{
+			IDs.push_back(nextID++);
+			parentIDs.push_back(childID);
+			locals.push_back(offset);
+		}
+	}
+
+	TransformHierarchy hierarchy;
+	hierarchy.Build(IDs, parentIDs, locals);
+	hierarchy.Update();
+
+	auto passStart = std::chrono::high_resolution_clock::now();
+	hierarchy.SetLocal(0, LocalMatrix(XMFLOAT3(5.0f, 0.0f, 5.0f), XMFLOAT3(0.0f, 45.0f, 0.0f), XMFLOAT3(1.0f, 1.0f, 1.0f)));
+	hierarchy.Update();
+	auto passEnd = std::chrono::high_resolution_clock::now();
+
+	auto idleStart = std::chrono::high_resolution_clock::now();
+	hierarchy.Update();
+	auto idleEnd = std::chrono::high_resolution_clock::now();
+
+	auto walkStart = std::chrono::high_resolution_clock::now();
+	float worstError = 0.0f;
+	for (int i = 1; i < hierarchy.Size(); i++)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&hierarchy.m_local[i]);
+		for (int parent = hierarchy.m_parents[i]; parent != -1; parent = hierarchy.m_parents[parent])
+		{
+			world = world * XMLoadFloat4x4(&hierarchy.m_local[parent]);
+		}
+		XMFLOAT4X4 stored;
+		XMStoreFloat4x4(&stored, world);
+		worstError = std::max(worstError, fabsf(stored._41 - hierarchy.m_world[i]._41));
+	}
+	auto walkEnd = std::chrono::high_resolution_clock::now();
+
+	std::stringstream report;
+	report << "Transform hierarchy, " << hierarchy.Size() - 1 << " descendants on " << ParallelWorkerCount() << " threads: move root "
+		<< std::chrono::duration<double, std::milli>(passEnd - passStart).count() << " ms, idle pass "
+		<< std::chrono::duration<double, std::milli>(idleEnd - idleStart).count() << " ms, one by one "
+		<< std::chrono::duration<double, std::milli>(walkEnd - walkStart).count() << " ms"
+		<< (worstError < 0.001f ? "" : " (MISMATCH)") << "\n";
+	return report.str();
+}
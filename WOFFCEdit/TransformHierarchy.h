@@ -0,0 +1,42 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <string>
+#include <vector>
+
+//world matrices for objects parented to each other through parent_id.
+//objects are grouped by their depth in the tree, and a pass walks the depths in order so every parent is finished
+//before its children. each depth is split across the worker threads. only objects whose local transform changed,
+//and everything below them, are recomputed - moving a parent is one SetLocal and one Update however many children it has.
+//indices are whatever order the owner keeps its objects in. Build again when objects are added, removed or reparented.
+
+class TransformHierarchy
+{
+public:
+	TransformHierarchy();
+	~TransformHierarchy();
+
+	//parentIDs[i] is the ID of i's parent, 0 or an ID not in IDs makes i a root. parent loops are broken by making one member a root
+	void	Build(const std::vector<int> & IDs, const std::vector<int> & parentIDs, const std::vector<DirectX::XMFLOAT4X4> & locals);
+	void	XM_CALLCONV SetLocal(int index, DirectX::FXMMATRIX local);
+	void	Update();
+
+	int		Size() const { return (int)m_parents.size(); }
+	int		GetParent(int index) const { return m_parents[index]; }	//index of the parent, -1 for roots
+	DirectX::XMMATRIX	GetWorld(int index) const { return DirectX::XMLoadFloat4x4(&m_world[index]); }
+
+	//scale, then rotation in degrees (x pitch, y yaw, z roll), then translation - the order objects have always been drawn with
+	static DirectX::XMMATRIX LocalMatrix(const DirectX::XMFLOAT3 & position, const DirectX::XMFLOAT3 & rotationDegrees, const DirectX::XMFLOAT3 & scale);
+
+	static std::string Benchmark(int children, int grandchildren);	//moving one parent of children * (1 + grandchildren) descendants
+
+private:
+	std::vector<int>					m_parents;
+	std::vector<std::vector<int>>		m_levels;		//indices at each depth, roots at 0
+	std::vector<DirectX::XMFLOAT4X4>	m_local;
+	std::vector<DirectX::XMFLOAT4X4>	m_world;
+	std::vector<unsigned char>			m_dirty;		//local changed since the last Update, and during an Update "world was recomputed"
+	std::vector<unsigned char>			m_levelDirty;	//some index at this depth has its local changed
+	std::vector<int>					m_depth;
+	bool								m_anyDirty;
+};
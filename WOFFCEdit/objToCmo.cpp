@@ -0,0 +1,1110 @@
+#include "objToCmo.h"
+#include "MeshOptimizer.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+	const size_t	CHUNK_BYTES = 1 << 20;
+	const size_t	MAX_PART_VERTICES = 65535;		//16 bit indices, 0xffff left alone
+	const int		VERTICES_PER_TASK = 4096;
+	const uint32_t	WHITE = 0xffffffff;
+
+	//one corner of a face, 0 based, -1 where the face left it out
+	struct Corner
+	{
+		int	position, uv, normal;
+	};
+
+	//a negative, relative, index can only be resolved once the chunk knows how much came before it
+	struct Fixup
+	{
+		size_t	corner;
+		int		component;
+	};
+
+	struct Chunk
+	{
+		const char *		begin;
+		const char *		end;
+		std::vector<float>	positions, uvs, normals;	//3, 2 and 3 floats each
+		std::vector<Corner>	corners;					//three per triangle
+		std::vector<Fixup>	fixups;
+		bool				failed;
+	};
+
+	//the CMO structures, see ModelLoadCMO.cpp in DirectXTK
+#pragma pack(push, 1)
+	struct CmoMaterial
+	{
+		float	ambient[4];
+		float	diffuse[4];
+		float	specular[4];
+		float	specularPower;
+		float	emissive[4];
+		float	uvTransform[16];
+	};
+
+	struct CmoSubMesh
+	{
+		uint32_t	materialIndex;
+		uint32_t	indexBufferIndex;
+		uint32_t	vertexBufferIndex;
+		uint32_t	startIndex;
+		uint32_t	primCount;
+	};
+
+	struct CmoExtents
+	{
+		float	centerX, centerY, centerZ;
+		float	radius;
+		float	minX, minY, minZ;
+		float	maxX, maxY, maxZ;
+	};
+#pragma pack(pop)
+
+	static_assert(sizeof(CmoVertex) == 52, "CMO vertex size incorrect");
+	static_assert(sizeof(CmoMaterial) == 132, "CMO material size incorrect");
+	static_assert(sizeof(CmoSubMesh) == 20, "CMO submesh size incorrect");
+	static_assert(sizeof(CmoExtents) == 40, "CMO extents size incorrect");
+
+	inline bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	inline bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	double PowerOfTen(int exponent)
+	{
+		static const double exact[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+		return exponent <= 22 ? exact[exponent] : pow(10.0, exponent);
+	}
+
+	//strtod without the locale, the allocation or the full precision - the digits go into an integer and are scaled
+	//once, which is exact for anything a modelling package writes
+	const char * ParseFloat(const char * p, const char * end, float & value)
+	{
+		while (p < end && IsSpace(*p))
+		{
+			p++;
+		}
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+
+		uint64_t digits = 0;
+		int significant = 0, exponent = 0;
+		bool any = false;
+		for (; p < end && IsDigit(*p); p++)
+		{
+			any = true;
+			if (significant < 19)
+			{
+				digits = digits * 10 + (*p - '0');
+				significant += digits != 0;
+			}
+			else
+			{
+				exponent++;
+			}
+		}
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && IsDigit(*p); p++)
+			{
+				any = true;
+				if (significant < 19)
+				{
+					digits = digits * 10 + (*p - '0');
+					significant += digits != 0;
+					exponent--;
+				}
+			}
+		}
+		if (!any)
+		{
+			return NULL;
+		}
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char * q = p + 1;
+			bool negativeExponent = false;
+			if (q < end && (*q == '-' || *q == '+'))
+			{
+				negativeExponent = *q == '-';
+				q++;
+			}
+			if (q < end && IsDigit(*q))
+			{
+				int e = 0;
+				for (; q < end && IsDigit(*q); q++)
+				{
+					e = std::min(e * 10 + (*q - '0'), 1000);
+				}
+				exponent += negativeExponent ? -e : e;
+				p = q;
+			}
+		}
+
+		double result = (double)digits;
+		if (exponent < 0)
+		{
+			result = exponent < -300 ? 0.0 : result / PowerOfTen(-exponent);
+		}
+		else if (exponent > 0)
+		{
+			result *= PowerOfTen(std::min(exponent, 300));
+		}
+		value = (float)(negative ? -result : result);
+		return p;
+	}
+
+	const char * ParseInt(const char * p, const char * end, int & value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+		if (p >= end || !IsDigit(*p))
+		{
+			return NULL;
+		}
+		int result = 0;
+		for (; p < end && IsDigit(*p); p++)
+		{
+			result = result * 10 + (*p - '0');
+		}
+		value = negative ? -result : result;
+		return p;
+	}
+
+	//an OBJ index, 1 based from the start of the file or negative from the latest element, to 0 based
+	void ResolveIndex(int index, int localCount, Chunk & chunk, int component, int & resolved)
+	{
+		if (index > 0)
+		{
+			resolved = index - 1;
+		}
+		else
+		{
+			resolved = localCount + index;		//relative to the start of the chunk until it is fixed up
+			Fixup fixup;
+			fixup.corner = chunk.corners.size();
+			fixup.component = component;
+			chunk.fixups.push_back(fixup);
+		}
+	}
+
+	void ParseChunk(Chunk & chunk)
+	{
+		chunk.failed = false;
+		std::vector<Corner> polygon;
+		const char * p = chunk.begin;
+		const char * end = chunk.end;
+		while (p < end)
+		{
+			while (p < end && IsSpace(*p))
+			{
+				p++;
+			}
+			const char * line = p;
+			while (p < end && *p != '\n')
+			{
+				p++;
+			}
+			const char * lineEnd = p;
+			p++;
+			if (lineEnd - line < 2)
+			{
+				continue;
+			}
+
+			if (line[0] == 'v' && IsSpace(line[1]))
+			{
+				float x = 0.0f, y = 0.0f, z = 0.0f;
+				const char * q = ParseFloat(line + 1, lineEnd, x);
+				q = q ? ParseFloat(q, lineEnd, y) : NULL;
+				q = q ? ParseFloat(q, lineEnd, z) : NULL;
+				chunk.failed |= q == NULL;
+				chunk.positions.push_back(x);
+				chunk.positions.push_back(y);
+				chunk.positions.push_back(z);
+			}
+			else if (line[0] == 'v' && line[1] == 't' && lineEnd - line > 2 && IsSpace(line[2]))
+			{
+				float u = 0.0f, v = 0.0f;
+				const char * q = ParseFloat(line + 2, lineEnd, u);
+				chunk.failed |= q == NULL;
+				if (q)
+				{
+					ParseFloat(q, lineEnd, v);		//the v is optional
+				}
+				chunk.uvs.push_back(u);
+				chunk.uvs.push_back(v);
+			}
+			else if (line[0] == 'v' && line[1] == 'n' && lineEnd - line > 2 && IsSpace(line[2]))
+			{
+				float x = 0.0f, y = 0.0f, z = 0.0f;
+				const char * q = ParseFloat(line + 2, lineEnd, x);
+				q = q ? ParseFloat(q, lineEnd, y) : NULL;
+				q = q ? ParseFloat(q, lineEnd, z) : NULL;
+				chunk.failed |= q == NULL;
+				chunk.normals.push_back(x);
+				chunk.normals.push_back(y);
+				chunk.normals.push_back(z);
+			}
+			else if (line[0] == 'f' && IsSpace(line[1]))
+			{
+				//corners are p, p/t, p//n or p/t/n
+				polygon.clear();
+				const char * q = line + 1;
+				while (true)
+				{
+					while (q < lineEnd && IsSpace(*q))
+					{
+						q++;
+					}
+					if (q >= lineEnd)
+					{
+						break;
+					}
+					int index[3] = { 0, 0, 0 };
+					bool present[3] = { false, false, false };
+					for (int component = 0; component < 3; component++)
+					{
+						if (q < lineEnd && (IsDigit(*q) || *q == '-' || *q == '+'))
+						{
+							q = ParseInt(q, lineEnd, index[component]);
+							if (!q)
+							{
+								break;
+							}
+							present[component] = true;
+						}
+						if (q >= lineEnd || *q != '/')
+						{
+							break;
+						}
+						q++;
+					}
+					if (!q || !present[0] || index[0] == 0 || (present[1] && index[1] == 0) || (present[2] && index[2] == 0))
+					{
+						chunk.failed = true;
+						break;
+					}
+					//skip anything else glued to the corner
+					while (q < lineEnd && !IsSpace(*q))
+					{
+						q++;
+					}
+
+					Corner corner;
+					corner.position = index[0];
+					corner.uv = present[1] ? index[1] : 0;
+					corner.normal = present[2] ? index[2] : 0;
+					polygon.push_back(corner);
+				}
+
+				//a fan from the first corner. relative indices count back from what has been read so far
+				for (size_t k = 2; k < polygon.size(); k++)
+				{
+					const Corner * fan[3] = { &polygon[0], &polygon[k - 1], &polygon[k] };
+					for (int c = 0; c < 3; c++)
+					{
+						Corner corner;
+						ResolveIndex(fan[c]->position, (int)chunk.positions.size() / 3, chunk, 0, corner.position);
+						if (fan[c]->uv)
+						{
+							ResolveIndex(fan[c]->uv, (int)chunk.uvs.size() / 2, chunk, 1, corner.uv);
+						}
+						else
+						{
+							corner.uv = -1;
+						}
+						if (fan[c]->normal)
+						{
+							ResolveIndex(fan[c]->normal, (int)chunk.normals.size() / 3, chunk, 2, corner.normal);
+						}
+						else
+						{
+							corner.normal = -1;
+						}
+						chunk.corners.push_back(corner);
+					}
+				}
+			}
+		}
+	}
+
+	uint32_t HashCorner(const Corner & corner)
+	{
+		uint32_t h = (uint32_t)corner.position * 0x9e3779b1u;
+		h ^= (uint32_t)corner.uv * 0x85ebca77u;
+		h ^= (uint32_t)corner.normal * 0xc2b2ae3du;
+		h ^= h >> 15;
+		h *= 0x2c1b3c6du;
+		h ^= h >> 13;
+		return h;
+	}
+
+	void Subtract(const float * a, const float * b, float * out)
+	{
+		out[0] = a[0] - b[0];
+		out[1] = a[1] - b[1];
+		out[2] = a[2] - b[2];
+	}
+
+	void Cross(const float * a, const float * b, float * out)
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	float Dot(const float * a, const float * b)
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	bool Normalise(float * v)
+	{
+		float length = sqrtf(Dot(v, v));
+		if (length <= 1e-20f)
+		{
+			return false;
+		}
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+		return true;
+	}
+
+	//area weighted face normals, summed per OBJ position so smooth shading survives uv seams
+	void GenerateNormals(ImportedMesh & mesh, const std::vector<int> & vertexPositions, int positionCount)
+	{
+		std::vector<float> sums((size_t)positionCount * 3, 0.0f);
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const CmoVertex & a = mesh.vertices[mesh.indices[i]];
+			const CmoVertex & b = mesh.vertices[mesh.indices[i + 1]];
+			const CmoVertex & c = mesh.vertices[mesh.indices[i + 2]];
+			float ab[3], ac[3], normal[3];
+			Subtract(b.position, a.position, ab);
+			Subtract(c.position, a.position, ac);
+			Cross(ab, ac, normal);
+			for (int k = 0; k < 3; k++)
+			{
+				float * sum = &sums[(size_t)vertexPositions[mesh.indices[i + k]] * 3];
+				sum[0] += normal[0];
+				sum[1] += normal[1];
+				sum[2] += normal[2];
+			}
+		}
+		ParallelFor((int)mesh.vertices.size(), VERTICES_PER_TASK, [&](int begin, int end)
+		{
+			for (int v = begin; v < end; v++)
+			{
+				float * normal = mesh.vertices[v].normal;
+				if (normal[0] == 0.0f && normal[1] == 0.0f && normal[2] == 0.0f)
+				{
+					memcpy(normal, &sums[(size_t)vertexPositions[v] * 3], sizeof(float) * 3);
+					if (!Normalise(normal))
+					{
+						normal[1] = 1.0f;
+					}
+				}
+			}
+		});
+	}
+
+	//per triangle uv derivatives summed per vertex, then made orthogonal to the normal
+	void GenerateTangents(ImportedMesh & mesh)
+	{
+		size_t count = mesh.vertices.size();
+		std::vector<float> tangents(count * 3, 0.0f), bitangents(count * 3, 0.0f);
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+		{
+			const CmoVertex & a = mesh.vertices[mesh.indices[i]];
+			const CmoVertex & b = mesh.vertices[mesh.indices[i + 1]];
+			const CmoVertex & c = mesh.vertices[mesh.indices[i + 2]];
+			float ab[3], ac[3];
+			Subtract(b.position, a.position, ab);
+			Subtract(c.position, a.position, ac);
+			float s1 = b.uv[0] - a.uv[0], t1 = b.uv[1] - a.uv[1];
+			float s2 = c.uv[0] - a.uv[0], t2 = c.uv[1] - a.uv[1];
+			float determinant = s1 * t2 - s2 * t1;
+			if (fabsf(determinant) < 1e-20f)
+			{
+				continue;
+			}
+			float r = 1.0f / determinant;
+			float tangent[3], bitangent[3];
+			for (int k = 0; k < 3; k++)
+			{
+				tangent[k] = (ab[k] * t2 - ac[k] * t1) * r;
+				bitangent[k] = (ac[k] * s1 - ab[k] * s2) * r;
+			}
+			for (int k = 0; k < 3; k++)
+			{
+				size_t v = mesh.indices[i + k];
+				for (int axis = 0; axis < 3; axis++)
+				{
+					tangents[v * 3 + axis] += tangent[axis];
+					bitangents[v * 3 + axis] += bitangent[axis];
+				}
+			}
+		}
+
+		ParallelFor((int)count, VERTICES_PER_TASK, [&](int begin, int end)
+		{
+			for (int v = begin; v < end; v++)
+			{
+				CmoVertex & vertex = mesh.vertices[v];
+				const float * normal = vertex.normal;
+				float * tangent = &tangents[(size_t)v * 3];
+				float along = Dot(normal, tangent);
+				float t[3] = { tangent[0] - normal[0] * along, tangent[1] - normal[1] * along, tangent[2] - normal[2] * along };
+				if (!Normalise(t))
+				{
+					//no usable uvs, any direction across the normal will do
+					float axis[3] = { fabsf(normal[0]) < 0.9f ? 1.0f : 0.0f, fabsf(normal[0]) < 0.9f ? 0.0f : 1.0f, 0.0f };
+					float across[3];
+					Cross(axis, normal, across);
+					Cross(normal, across, t);
+					Normalise(t);
+				}
+				float crossed[3];
+				Cross(normal, t, crossed);
+				vertex.tangent[0] = t[0];
+				vertex.tangent[1] = t[1];
+				vertex.tangent[2] = t[2];
+				vertex.tangent[3] = Dot(crossed, &bitangents[(size_t)v * 3]) < 0.0f ? -1.0f : 1.0f;
+			}
+		});
+	}
+
+	void Append(std::vector<uint8_t> & out, const void * data, size_t bytes)
+	{
+		const uint8_t * p = static_cast<const uint8_t*>(data);
+		out.insert(out.end(), p, p + bytes);
+	}
+
+	void AppendUint(std::vector<uint8_t> & out, uint32_t value)
+	{
+		Append(out, &value, sizeof(value));
+	}
+
+	//CMO strings are counted UTF-16 with the terminator included. wchar_t is only 16 bits on windows, so it is spelt out
+	void AppendString(std::vector<uint8_t> & out, const std::string & text)
+	{
+		AppendUint(out, (uint32_t)text.size() + 1);
+		for (size_t i = 0; i <= text.size(); i++)
+		{
+			uint16_t c = i < text.size() ? (uint8_t)text[i] : 0;
+			Append(out, &c, sizeof(c));
+		}
+	}
+
+	//the reading side of the above, walking the same way as the DirectXTK loader
+	class CmoReader
+	{
+	public:
+		CmoReader(const uint8_t * data, size_t size) : m_data(data), m_size(size), m_used(0) {}
+
+		const uint8_t * Take(size_t bytes)
+		{
+			if (bytes > m_size - m_used)
+			{
+				throw std::string("End of file");
+			}
+			const uint8_t * p = m_data + m_used;
+			m_used += bytes;
+			return p;
+		}
+		uint32_t Uint()
+		{
+			uint32_t value;
+			memcpy(&value, Take(sizeof(value)), sizeof(value));
+			return value;
+		}
+		void SkipString()
+		{
+			uint32_t length = Uint();
+			Take((size_t)length * sizeof(uint16_t));
+		}
+
+	private:
+		const uint8_t *	m_data;
+		size_t			m_size;
+		size_t			m_used;
+	};
+}
+
+bool ObjToCmo::Parse(const char * text, size_t size, ImportedMesh & mesh, std::string & error)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+
+	//chunks end just after a newline, so no line is split
+	std::vector<Chunk> chunks;
+	const char * end = text + size;
+	const char * begin = text;
+	while (begin < end)
+	{
+		const char * chunkEnd = begin + std::min(CHUNK_BYTES, (size_t)(end - begin));
+		while (chunkEnd < end && chunkEnd[-1] != '\n')
+		{
+			chunkEnd++;
+		}
+		Chunk chunk;
+		chunk.begin = begin;
+		chunk.end = chunkEnd;
+		chunks.push_back(chunk);
+		begin = chunkEnd;
+	}
+
+	ParallelFor((int)chunks.size(), 1, [&](int first, int last)
+	{
+		for (int c = first; c < last; c++)
+		{
+			ParseChunk(chunks[c]);
+		}
+	});
+
+	//where each chunk's elements land in the whole file
+	std::vector<size_t> positionBase(chunks.size() + 1, 0), uvBase(chunks.size() + 1, 0), normalBase(chunks.size() + 1, 0), cornerBase(chunks.size() + 1, 0);
+	for (size_t c = 0; c < chunks.size(); c++)
+	{
+		if (chunks[c].failed)
+		{
+			error = "malformed line";
+			return false;
+		}
+		positionBase[c + 1] = positionBase[c] + chunks[c].positions.size() / 3;
+		uvBase[c + 1] = uvBase[c] + chunks[c].uvs.size() / 2;
+		normalBase[c + 1] = normalBase[c] + chunks[c].normals.size() / 3;
+		cornerBase[c + 1] = cornerBase[c] + chunks[c].corners.size();
+	}
+	size_t positionCount = positionBase.back();
+	size_t uvCount = uvBase.back();
+	size_t normalCount = normalBase.back();
+	size_t cornerCount = cornerBase.back();
+	if (cornerCount == 0)
+	{
+		error = "no faces";
+		return false;
+	}
+	if (positionCount >= (size_t)INT32_MAX || cornerCount >= (size_t)UINT32_MAX)
+	{
+		error = "too big";
+		return false;
+	}
+
+	std::vector<float> positions(positionCount * 3), uvs(uvCount * 2), normals(normalCount * 3);
+	std::vector<Corner> corners(cornerCount);
+	std::vector<char> outOfRange(chunks.size(), 0);
+	ParallelFor((int)chunks.size(), 1, [&](int first, int last)
+	{
+		for (int c = first; c < last; c++)
+		{
+			Chunk & chunk = chunks[c];
+			for (size_t f = 0; f < chunk.fixups.size(); f++)
+			{
+				Corner & corner = chunk.corners[chunk.fixups[f].corner];
+				int & index = chunk.fixups[f].component == 0 ? corner.position : chunk.fixups[f].component == 1 ? corner.uv : corner.normal;
+				size_t base = chunk.fixups[f].component == 0 ? positionBase[c] : chunk.fixups[f].component == 1 ? uvBase[c] : normalBase[c];
+				index += (int)base;
+				outOfRange[c] |= index < 0;
+			}
+			for (size_t k = 0; k < chunk.corners.size(); k++)
+			{
+				const Corner & corner = chunk.corners[k];
+				outOfRange[c] |= corner.position >= (int)positionCount || corner.uv >= (int)uvCount || corner.normal >= (int)normalCount;
+			}
+			std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[c] * 3);
+			std::copy(chunk.uvs.begin(), chunk.uvs.end(), uvs.begin() + uvBase[c] * 2);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[c] * 3);
+			std::copy(chunk.corners.begin(), chunk.corners.end(), corners.begin() + cornerBase[c]);
+			std::vector<float>().swap(chunk.positions);
+			std::vector<float>().swap(chunk.uvs);
+			std::vector<float>().swap(chunk.normals);
+			std::vector<Corner>().swap(chunk.corners);
+		}
+	});
+	if (std::find(outOfRange.begin(), outOfRange.end(), 1) != outOfRange.end())
+	{
+		error = "a face refers to a vertex that is not in the file";
+		return false;
+	}
+
+	//one vertex per distinct corner, numbered in the order they first appear. open addressing, the table at most half full
+	std::vector<uint32_t> hashes(cornerCount);
+	ParallelFor((int)cornerCount, VERTICES_PER_TASK * 4, [&](int first, int last)
+	{
+		for (int k = first; k < last; k++)
+		{
+			hashes[k] = HashCorner(corners[k]);
+		}
+	});
+	size_t tableSize = 1;
+	while (tableSize < cornerCount * 2)
+	{
+		tableSize <<= 1;
+	}
+	std::vector<uint32_t> table(tableSize, UINT32_MAX);
+	std::vector<Corner> unique;
+	unique.reserve(cornerCount / 4 + 16);
+	mesh.indices.resize(cornerCount);
+	for (size_t k = 0; k < cornerCount; k++)
+	{
+		const Corner & corner = corners[k];
+		size_t slot = hashes[k] & (tableSize - 1);
+		while (true)
+		{
+			uint32_t vertex = table[slot];
+			if (vertex == UINT32_MAX)
+			{
+				table[slot] = (uint32_t)unique.size();
+				mesh.indices[k] = (uint32_t)unique.size();
+				unique.push_back(corner);
+				break;
+			}
+			const Corner & other = unique[vertex];
+			if (other.position == corner.position && other.uv == corner.uv && other.normal == corner.normal)
+			{
+				mesh.indices[k] = vertex;
+				break;
+			}
+			slot = (slot + 1) & (tableSize - 1);
+		}
+	}
+
+	//OBJ puts v = 0 at the bottom of the texture, direct3d at the top
+	bool missingNormals = false;
+	std::vector<int> vertexPositions(unique.size());
+	mesh.vertices.resize(unique.size());
+	ParallelFor((int)unique.size(), VERTICES_PER_TASK, [&](int first, int last)
+	{
+		for (int v = first; v < last; v++)
+		{
+			const Corner & corner = unique[v];
+			CmoVertex & vertex = mesh.vertices[v];
+			memcpy(vertex.position, &positions[(size_t)corner.position * 3], sizeof(float) * 3);
+			if (corner.normal >= 0)
+			{
+				memcpy(vertex.normal, &normals[(size_t)corner.normal * 3], sizeof(float) * 3);
+				Normalise(vertex.normal);
+			}
+			else
+			{
+				vertex.normal[0] = vertex.normal[1] = vertex.normal[2] = 0.0f;
+			}
+			vertex.uv[0] = corner.uv >= 0 ? uvs[(size_t)corner.uv * 2] : 0.0f;
+			vertex.uv[1] = corner.uv >= 0 ? 1.0f - uvs[(size_t)corner.uv * 2 + 1] : 0.0f;
+			vertex.color = WHITE;
+			vertexPositions[v] = corner.position;
+		}
+	});
+	for (size_t v = 0; v < unique.size(); v++)
+	{
+		if (unique[v].normal < 0)
+		{
+			missingNormals = true;
+			break;
+		}
+	}
+	if (missingNormals)
+	{
+		GenerateNormals(mesh, vertexPositions, (int)positionCount);
+	}
+	GenerateTangents(mesh);
+	return true;
+}
+
+bool ObjToCmo::Serialise(const ImportedMesh & mesh, const std::string & name, std::vector<uint8_t> & out)
+{
+	//split the triangles, in order, into parts small enough for 16 bit indices
+	std::vector<std::vector<uint16_t>> partIndices;
+	std::vector<std::vector<CmoVertex>> partVertices;
+	std::vector<uint32_t> local(mesh.vertices.size(), UINT32_MAX);
+	std::vector<uint32_t> localPart(mesh.vertices.size(), UINT32_MAX);
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		uint32_t part = (uint32_t)partVertices.size() - 1;
+		size_t added = 0;
+		for (int k = 0; k < 3 && !partVertices.empty(); k++)
+		{
+			added += localPart[mesh.indices[i + k]] != part;
+		}
+		if (partVertices.empty() || partVertices.back().size() + added > MAX_PART_VERTICES)
+		{
+			partVertices.push_back(std::vector<CmoVertex>());
+			partIndices.push_back(std::vector<uint16_t>());
+			part = (uint32_t)partVertices.size() - 1;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			uint32_t vertex = mesh.indices[i + k];
+			if (localPart[vertex] != part)
+			{
+				localPart[vertex] = part;
+				local[vertex] = (uint32_t)partVertices.back().size();
+				partVertices.back().push_back(mesh.vertices[vertex]);
+			}
+			partIndices.back().push_back((uint16_t)local[vertex]);
+		}
+	}
+	if (partVertices.empty())
+	{
+		return false;
+	}
+
+	CmoExtents extents;
+	float minimum[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, maximum[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (size_t v = 0; v < mesh.vertices.size(); v++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			minimum[axis] = std::min(minimum[axis], mesh.vertices[v].position[axis]);
+			maximum[axis] = std::max(maximum[axis], mesh.vertices[v].position[axis]);
+		}
+	}
+	extents.minX = minimum[0];	extents.minY = minimum[1];	extents.minZ = minimum[2];
+	extents.maxX = maximum[0];	extents.maxY = maximum[1];	extents.maxZ = maximum[2];
+	extents.centerX = (minimum[0] + maximum[0]) * 0.5f;
+	extents.centerY = (minimum[1] + maximum[1]) * 0.5f;
+	extents.centerZ = (minimum[2] + maximum[2]) * 0.5f;
+	float centre[3] = { extents.centerX, extents.centerY, extents.centerZ };
+	float radiusSquared = 0.0f;
+	for (size_t v = 0; v < mesh.vertices.size(); v++)
+	{
+		float offset[3];
+		Subtract(mesh.vertices[v].position, centre, offset);
+		radiusSquared = std::max(radiusSquared, Dot(offset, offset));
+	}
+	extents.radius = sqrtf(radiusSquared);
+
+	//the same default material the placeholder model has
+	CmoMaterial material;
+	memset(&material, 0, sizeof(material));
+	const float ambient[4] = { 0.2f, 0.2f, 0.2f, 1.0f }, diffuse[4] = { 0.8f, 0.8f, 0.8f, 1.0f }, black[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	memcpy(material.ambient, ambient, sizeof(ambient));
+	memcpy(material.diffuse, diffuse, sizeof(diffuse));
+	memcpy(material.specular, black, sizeof(black));
+	memcpy(material.emissive, black, sizeof(black));
+	material.specularPower = 1.0f;
+	material.uvTransform[0] = material.uvTransform[5] = material.uvTransform[10] = material.uvTransform[15] = 1.0f;
+
+	out.clear();
+	out.reserve(mesh.vertices.size() * sizeof(CmoVertex) + mesh.indices.size() * sizeof(uint16_t) + 4096);
+	AppendUint(out, 1);			//meshes
+	AppendString(out, name);
+	AppendUint(out, 1);			//materials
+	AppendString(out, "default");
+	Append(out, &material, sizeof(material));
+	AppendString(out, "lambert.dgsl");
+	for (int t = 0; t < 8; t++)
+	{
+		AppendString(out, "");
+	}
+	out.push_back(0);			//no skeleton
+	AppendUint(out, (uint32_t)partVertices.size());
+	for (size_t part = 0; part < partVertices.size(); part++)
+	{
+		CmoSubMesh subMesh;
+		subMesh.materialIndex = 0;
+		subMesh.indexBufferIndex = (uint32_t)part;
+		subMesh.vertexBufferIndex = (uint32_t)part;
+		subMesh.startIndex = 0;
+		subMesh.primCount = (uint32_t)partIndices[part].size() / 3;
+		Append(out, &subMesh, sizeof(subMesh));
+	}
+	AppendUint(out, (uint32_t)partIndices.size());
+	for (size_t part = 0; part < partIndices.size(); part++)
+	{
+		AppendUint(out, (uint32_t)partIndices[part].size());
+		Append(out, partIndices[part].data(), partIndices[part].size() * sizeof(uint16_t));
+	}
+	AppendUint(out, (uint32_t)partVertices.size());
+	for (size_t part = 0; part < partVertices.size(); part++)
+	{
+		AppendUint(out, (uint32_t)partVertices[part].size());
+		Append(out, partVertices[part].data(), partVertices[part].size() * sizeof(CmoVertex));
+	}
+	AppendUint(out, 0);			//skinning vertex buffers
+	Append(out, &extents, sizeof(extents));
+	return true;
+}
+
+bool ObjToCmo::Write(const ImportedMesh & mesh, const std::string & name, const std::string & path)
+{
+	std::vector<uint8_t> out;
+	if (!Serialise(mesh, name, out))
+	{
+		return false;
+	}
+	FILE * file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+	bool written = fwrite(out.data(), 1, out.size(), file) == out.size();
+	return fclose(file) == 0 && written;
+}
+
+bool ObjToCmo::Read(const uint8_t * data, size_t size, ImportedMesh & mesh, std::string & error)
+{
+	mesh.vertices.clear();
+	mesh.indices.clear();
+	try
+	{
+		CmoReader reader(data, size);
+		uint32_t meshes = reader.Uint();
+		if (!meshes)
+		{
+			throw std::string("No meshes found");
+		}
+		for (uint32_t m = 0; m < meshes; m++)
+		{
+			reader.SkipString();
+			uint32_t materials = reader.Uint();
+			for (uint32_t j = 0; j < materials; j++)
+			{
+				reader.SkipString();
+				reader.Take(sizeof(CmoMaterial));
+				reader.SkipString();
+				for (int t = 0; t < 8; t++)
+				{
+					reader.SkipString();
+				}
+			}
+			reader.Take(1);
+			uint32_t subMeshCount = reader.Uint();
+			if (!subMeshCount)
+			{
+				throw std::string("No submeshes found");
+			}
+			std::vector<CmoSubMesh> subMeshes(subMeshCount);
+			memcpy(subMeshes.data(), reader.Take(subMeshCount * sizeof(CmoSubMesh)), subMeshCount * sizeof(CmoSubMesh));
+
+			uint32_t indexBufferCount = reader.Uint();
+			if (!indexBufferCount)
+			{
+				throw std::string("No index buffers found");
+			}
+			std::vector<std::vector<uint16_t>> indexBuffers(indexBufferCount);
+			for (uint32_t j = 0; j < indexBufferCount; j++)
+			{
+				uint32_t count = reader.Uint();
+				if (!count)
+				{
+					throw std::string("Empty index buffer found");
+				}
+				indexBuffers[j].resize(count);
+				memcpy(indexBuffers[j].data(), reader.Take(count * sizeof(uint16_t)), count * sizeof(uint16_t));
+			}
+
+			uint32_t vertexBufferCount = reader.Uint();
+			if (!vertexBufferCount)
+			{
+				throw std::string("No vertex buffers found");
+			}
+			std::vector<std::vector<CmoVertex>> vertexBuffers(vertexBufferCount);
+			for (uint32_t j = 0; j < vertexBufferCount; j++)
+			{
+				uint32_t count = reader.Uint();
+				if (!count)
+				{
+					throw std::string("Empty vertex buffer found");
+				}
+				vertexBuffers[j].resize(count);
+				memcpy(vertexBuffers[j].data(), reader.Take(count * sizeof(CmoVertex)), count * sizeof(CmoVertex));
+			}
+			if (reader.Uint() != 0)
+			{
+				throw std::string("Skinned meshes are not read");
+			}
+			reader.Take(sizeof(CmoExtents));
+
+			//flatten the parts back into one indexed mesh
+			for (uint32_t j = 0; j < subMeshCount; j++)
+			{
+				const CmoSubMesh & subMesh = subMeshes[j];
+				if (subMesh.indexBufferIndex >= indexBufferCount || subMesh.vertexBufferIndex >= vertexBufferCount || subMesh.materialIndex >= materials)
+				{
+					throw std::string("Invalid submesh found");
+				}
+				const std::vector<uint16_t> & indices = indexBuffers[subMesh.indexBufferIndex];
+				const std::vector<CmoVertex> & vertices = vertexBuffers[subMesh.vertexBufferIndex];
+				if ((size_t)subMesh.startIndex + (size_t)subMesh.primCount * 3 > indices.size())
+				{
+					throw std::string("Invalid submesh found");
+				}
+				uint32_t base = (uint32_t)mesh.vertices.size();
+				mesh.vertices.insert(mesh.vertices.end(), vertices.begin(), vertices.end());
+				for (size_t k = subMesh.startIndex; k < subMesh.startIndex + (size_t)subMesh.primCount * 3; k++)
+				{
+					if (indices[k] >= vertices.size())
+					{
+						throw std::string("Invalid index found");
+					}
+					mesh.indices.push_back(base + indices[k]);
+				}
+			}
+		}
+	}
+	catch (const std::string & message)
+	{
+		error = message;
+		return false;
+	}
+	return true;
+}
+
+bool ObjToCmo::Convert(const std::string & objPath, const std::string & cmoPath, std::string & error)
+{
+	FILE * file = fopen(objPath.c_str(), "rb");
+	if (!file)
+	{
+		error = "can't open " + objPath;
+		return false;
+	}
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fseek(file, 0, SEEK_SET);
+	std::vector<char> text(size > 0 ? size : 0);
+	bool read = size > 0 && fread(text.data(), 1, text.size(), file) == text.size();
+	fclose(file);
+	if (!read)
+	{
+		error = "can't read " + objPath;
+		return false;
+	}
+
+	ImportedMesh mesh;
+	if (!Parse(text.data(), text.size(), mesh, error))
+	{
+		return false;
+	}
+	MeshOptimizer::Optimize(mesh);
+
+	//the mesh is named after the file
+	size_t slash = objPath.find_last_of("/\\");
+	std::string name = objPath.substr(slash == std::string::npos ? 0 : slash + 1);
+	name = name.substr(0, name.find_last_of('.'));
+	if (!Write(mesh, name, cmoPath))
+	{
+		error = "can't write " + cmoPath;
+		return false;
+	}
+	return true;
+}
+
+//a heightfield grid written out the way a modelling package exports one, quads with positions, uvs and normals,
+//imported, written as a CMO, and read back to check the triangles survived
+std::string ObjToCmo::Benchmark(int gridResolution)
+{
+	const char * path = "objtocmo_benchmark.cmo";
+	int n = gridResolution;
+	std::string text;
+	text.reserve((size_t)(n + 1) * (n + 1) * 110 + (size_t)n * n * 50);
+	text += "# benchmark grid\nmtllib grid.mtl\ng default\n";
+	char line[160];
+	for (int z = 0; z <= n; z++)
+	{
+		for (int x = 0; x <= n; x++)
+		{
+			snprintf(line, sizeof(line), "v %f %f %f\n", x * 4.0f - n * 2.0f, sinf(x * 0.1f) * cosf(z * 0.13f) * 8.0f, z * 4.0f - n * 2.0f);
+			text += line;
+		}
+	}
+	for (int z = 0; z <= n; z++)
+	{
+		for (int x = 0; x <= n; x++)
+		{
+			snprintf(line, sizeof(line), "vt %f %f\n", (float)x / n, (float)z / n);
+			text += line;
+		}
+	}
+	for (int z = 0; z <= n; z++)
+	{
+		for (int x = 0; x <= n; x++)
+		{
+			float normal[3] = { -cosf(x * 0.1f) * 0.8f * cosf(z * 0.13f) / 4.0f, 1.0f, sinf(x * 0.1f) * sinf(z * 0.13f) * 1.04f / 4.0f };
+			Normalise(normal);
+			snprintf(line, sizeof(line), "vn %f %f %f\n", normal[0], normal[1], normal[2]);
+			text += line;
+		}
+	}
+	text += "s 1\ng grid\nusemtl initialShadingGroup\n";
+	for (int z = 0; z < n; z++)
+	{
+		for (int x = 0; x < n; x++)
+		{
+			int a = z * (n + 1) + x + 1, b = a + 1, c = a + n + 2, d = a + n + 1;
+			snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, b, b, b, c, c, c, d, d, d);
+			text += line;
+		}
+	}
+
+	ImportedMesh mesh;
+	std::string error;
+	double bestMs = 1e30;
+	bool parsed = true;
+	for (int run = 0; run < 3 && parsed; run++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		parsed = Parse(text.data(), text.size(), mesh, error);
+		auto end = std::chrono::high_resolution_clock::now();
+		bestMs = std::min(bestMs, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+
+	auto writeStart = std::chrono::high_resolution_clock::now();
+	bool written = parsed && Write(mesh, "grid", path);
+	auto writeEnd = std::chrono::high_resolution_clock::now();
+
+	//read the file back and compare triangle by triangle, the parts renumber the vertices so positions are compared
+	std::vector<uint8_t> file;
+	FILE * handle = written ? fopen(path, "rb") : NULL;
+	if (handle)
+	{
+		fseek(handle, 0, SEEK_END);
+		file.resize(ftell(handle));
+		fseek(handle, 0, SEEK_SET);
+		written = fread(file.data(), 1, file.size(), handle) == file.size();
+		fclose(handle);
+	}
+	remove(path);
+	ImportedMesh reloaded;
+	bool valid = written && Read(file.data(), file.size(), reloaded, error) && reloaded.indices.size() == mesh.indices.size()
+		&& mesh.vertices.size() == (size_t)(n + 1) * (n + 1);
+	for (size_t k = 0; valid && k < mesh.indices.size(); k++)
+	{
+		valid = memcmp(&mesh.vertices[mesh.indices[k]], &reloaded.vertices[reloaded.indices[k]], sizeof(CmoVertex)) == 0;
+	}
+
+	double megabytes = text.size() / (1024.0 * 1024.0);
+	std::ostringstream report;
+	report << "OBJ import, " << megabytes << " MB on " << ParallelWorkerCount() << " threads: " << bestMs << " ms, "
+		<< megabytes / (bestMs / 1000.0) << " MB/s, " << mesh.indices.size() << " corners to " << mesh.vertices.size()
+		<< " vertices. CMO " << file.size() / 1024 << " KB written in "
+		<< std::chrono::duration<double, std::milli>(writeEnd - writeStart).count() << " ms"
+		<< (valid ? "" : " (ROUND TRIP BROKEN)") << "\n";
+	return report.str();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//wavefront OBJ import. the text is cut into chunks at line ends and parsed on the ParallelFor workers, polygons are
+//fanned into triangles, each distinct position / uv / normal corner becomes one vertex, and normals (when the file has
+//none) and tangents are generated. Convert puts the result through MeshOptimizer and writes it as a CMO, which is
+//what the editor loads every model from.
+//only geometry is imported - groups, materials and smoothing groups are ignored, and the model gets one default material.
+
+//laid out as DirectX::VertexPositionNormalTangentColorTexture, which is the vertex a CMO stores
+struct CmoVertex
+{
+	float		position[3];
+	float		normal[3];
+	float		tangent[4];		//w is the handedness of the bitangent
+	uint32_t	color;
+	float		uv[2];
+};
+
+struct ImportedMesh
+{
+	std::vector<CmoVertex>	vertices;
+	std::vector<uint32_t>	indices;	//triangles, counter clockwise as in the OBJ
+};
+
+class ObjToCmo
+{
+public:
+	static bool Parse(const char * text, size_t size, ImportedMesh & mesh, std::string & error);
+	//a one mesh CMO. parts are split wherever the 16 bit indices a CMO uses run out
+	static bool Serialise(const ImportedMesh & mesh, const std::string & name, std::vector<uint8_t> & out);
+	static bool Write(const ImportedMesh & mesh, const std::string & name, const std::string & path);
+	static bool Convert(const std::string & objPath, const std::string & cmoPath, std::string & error);
+	//reads a CMO back, making the same checks as Model::CreateFromCMO but without needing a device
+	static bool Read(const uint8_t * data, size_t size, ImportedMesh & mesh, std::string & error);
+
+	static std::string Benchmark(int gridResolution);
+};